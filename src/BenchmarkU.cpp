@@ -0,0 +1,488 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "BenchmarkU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Guest workloads (RV32IM, loaded at 0, endless loops)
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// ball.c .text as shipped in the default program (main() loop calling Tick())
+static const unsigned long WorkloadBall[] = {
+    0xfe010113, 0x00112e23, 0x00812c23, 0x02010413, 0x00000513, 0xfea42a23, 0x00002537, 0xb0050593,
+    0xfeb42823, 0xb0250593, 0xfeb42623, 0xb0450513, 0xfea42423, 0x0e4000ef, 0x0040006f, 0x438000ef,
+    0xff042583, 0x00100513, 0x00a59023, 0x00001537, 0x00052503, 0x024000ef, 0xfec42583, 0x00a59023,
+    0x00001537, 0x00452503, 0x010000ef, 0xfe842583, 0x00a59023, 0xfc9ff06f, 0xff010113, 0x00112623,
+    0x00812423, 0x01010413, 0xfea42a23, 0xff442503, 0x000015b7, 0x0085a583, 0x40b55533, 0x00c12083,
+    0x00812403, 0x01010113, 0x00008067, 0xff010113, 0x00112623, 0x00812423, 0x01010413, 0xfea42a23,
+    0xff442503, 0x000015b7, 0x0085a583, 0x00b51533, 0x00c12083, 0x00812403, 0x01010113, 0x00008067,
+    0xff010113, 0x00112623, 0x00812423, 0x01010413, 0xfea42a23, 0xff442503, 0x000015b7, 0x0085a583,
+    0x40b55533, 0x00b51533, 0x00c12083, 0x00812403, 0x01010113, 0x00008067, 0xff010113, 0x00112623,
+    0x00812423, 0x01010413, 0x000015b7, 0x55aa5537, 0x5aa50513, 0x00a5a623, 0x000015b7, 0x00200513,
+    0x00a5a823, 0x000015b7, 0x00a00513, 0x00a5aa23, 0x00001537, 0x16f00593, 0x00b52c23, 0x00001637,
+    0x0df00593, 0x00b62e23, 0x01852503, 0x000105b7, 0x00b54c63, 0x0040006f, 0x000015b7, 0x00800513,
+    0x00a5a423, 0x1700006f, 0x00001537, 0x01852503, 0x000085b7, 0x00b54c63, 0x0040006f, 0x000015b7,
+    0x00f00513, 0x00a5a423, 0x1480006f, 0x00001537, 0x01852503, 0x000045b7, 0x00b54c63, 0x0040006f,
+    0x000015b7, 0x01000513, 0x00a5a423, 0x1200006f, 0x00001537, 0x01852503, 0x000025b7, 0x00b54c63,
+    0x0040006f, 0x000015b7, 0x01100513, 0x00a5a423, 0x0f80006f, 0x00001537, 0x01852503, 0x000015b7,
+    0x00b54c63, 0x0040006f, 0x000015b7, 0x01200513, 0x00a5a423, 0x0d00006f, 0x00001537, 0x01852503,
+    0x000015b7, 0x80058593, 0x00b54c63, 0x0040006f, 0x000015b7, 0x01300513, 0x00a5a423, 0x0a40006f,
+    0x00001537, 0x01852503, 0x40000593, 0x00b54c63, 0x0040006f, 0x000015b7, 0x01400513, 0x00a5a423,
+    0x07c0006f, 0x00001537, 0x01852503, 0x20000593, 0x00b54c63, 0x0040006f, 0x000015b7, 0x01500513,
+    0x00a5a423, 0x0540006f, 0x00001537, 0x01852503, 0x10000593, 0x00b54c63, 0x0040006f, 0x000015b7,
+    0x01600513, 0x00a5a423, 0x02c0006f, 0x00001537, 0x01852503, 0x08000593, 0x00b54c63, 0x0040006f,
+    0x000015b7, 0x01700513, 0x00a5a423, 0x0040006f, 0x0040006f, 0x0040006f, 0x0040006f, 0x0040006f,
+    0x0040006f, 0x0040006f, 0x0040006f, 0x0040006f, 0x0040006f, 0x00001537, 0x01852503, 0x000015b7,
+    0x0145a603, 0x00161613, 0x40c50533, 0x00001637, 0x02a62023, 0x00001537, 0x01c52503, 0x0145a583,
+    0x00159593, 0x40b50533, 0x000015b7, 0xfeb42a23, 0x02a5a223, 0x000015b7, 0x00300513, 0x02a5a423,
+    0x000015b7, 0x00000513, 0x00a5a023, 0x00001537, 0x00c50513, 0x038000ef, 0xff442583, 0x0245a583,
+    0xf9c58593, 0x6f8000ef, 0x03250513, 0xd41ff0ef, 0x000015b7, 0x00a5a223, 0x374000ef, 0x00c12083,
+    0x00812403, 0x01010113, 0x00008067, 0xfc010113, 0x02112e23, 0x02812c23, 0x04010413, 0xfea42a23,
+    0x80000537, 0xfff50513, 0xfea42823, 0x0000c537, 0xc8f50513, 0xfca42423, 0xfea42623, 0x0000b537,
+    0xdc850593, 0xfcb42223, 0xfeb42423, 0x00001537, 0xd4750513, 0xfca42623, 0xfea42223, 0xff442503,
+    0x00052503, 0x630000ef, 0xfc442583, 0xfea42023, 0xff442503, 0x00052503, 0x664000ef, 0xfc842583,
+    0xfca42e23, 0xfdc42503, 0x5e0000ef, 0xfcc42583, 0xfca42c23, 0xfe042503, 0x5d0000ef, 0xfca42a23,
+    0xfd842503, 0xfd442583, 0x40b50533, 0xfca42823, 0x00000593, 0x00100513, 0x02b51063, 0x0040006f,
+    0xfd042503, 0x800005b7, 0xfff58593, 0x00b50533, 0xfca42823, 0x0040006f, 0xfd042503, 0xff442583,
+    0x00a5a023, 0x03c12083, 0x03812403, 0x04010113, 0x00008067, 0xfd010113, 0x02112623, 0x02812423,
+    0x03010413, 0x00001537, 0x02852503, 0xfea42a23, 0x00000593, 0x02b50c63, 0x0040006f, 0xff442503,
+    0x00100593, 0x0ab50063, 0x0040006f, 0xff442503, 0x00200593, 0x12b50063, 0x0040006f, 0xff442503,
+    0x00300593, 0x1ab50063, 0x2140006f, 0x00001537, 0x00452583, 0x00000513, 0x00b54863, 0x0040006f,
+    0x20c000ef, 0x05c0006f, 0x00001537, 0x02c52503, 0x000015b7, 0xfeb42823, 0x0105a583, 0x4ec000ef,
+    0x00050613, 0x000015b7, 0x0005a503, 0x00c50533, 0x00a5a023, 0x00100513, 0xb95ff0ef, 0xff042583,
+    0x0105a583, 0x4c4000ef, 0x00050613, 0x000015b7, 0x0045a503, 0x40c50533, 0x00a5a223, 0x0040006f,
+    0x19c0006f, 0x00001537, 0x00052503, 0xfea42623, 0x00001537, 0x02052503, 0xfff50513, 0xb51ff0ef,
+    0x00050593, 0xfec42503, 0x00b54863, 0x0040006f, 0x17c000ef, 0x05c0006f, 0x00100513, 0xb31ff0ef,
+    0x000015b7, 0xfeb42423, 0x0105a583, 0x45c000ef, 0xfe842583, 0x00050693, 0x00001637, 0x00062503,
+    0x00d50533, 0x00a62023, 0x00001537, 0x02c52503, 0x0105a583, 0x434000ef, 0x00050613, 0x000015b7,
+    0x0045a503, 0x00c50533, 0x00a5a223, 0x0040006f, 0x10c0006f, 0x00001537, 0x00452503, 0xfea42223,
+    0x00001537, 0x02452503, 0xfff50513, 0xac1ff0ef, 0x00050593, 0xfe442503, 0x00b54863, 0x0040006f,
+    0x0ec000ef, 0x05c0006f, 0x00001537, 0x02c52503, 0x000015b7, 0xfeb42023, 0x0105a583, 0x3cc000ef,
+    0x00050613, 0x000015b7, 0x0005a503, 0x40c50533, 0x00a5a023, 0x00100513, 0xa75ff0ef, 0xfe042583,
+    0x0105a583, 0x3a4000ef, 0x00050613, 0x000015b7, 0x0045a503, 0x00c50533, 0x00a5a223, 0x0040006f,
+    0x07c0006f, 0x00001537, 0x00052583, 0x00000513, 0x00b54863, 0x0040006f, 0x074000ef, 0x05c0006f,
+    0x00100513, 0xa29ff0ef, 0x000015b7, 0xfcb42e23, 0x0105a583, 0x354000ef, 0xfdc42583, 0x00050693,
+    0x00001637, 0x00062503, 0x40d50533, 0x00a62023, 0x00001537, 0x02c52503, 0x0105a583, 0x32c000ef,
+    0x00050613, 0x000015b7, 0x0045a503, 0x40c50533, 0x00a5a223, 0x0040006f, 0x0040006f, 0x02c12083,
+    0x02812403, 0x03010113, 0x00008067, 0xfc010113, 0x02112e23, 0x02812c23, 0x04010413, 0x00001537,
+    0x02852503, 0xfea42a23, 0x00000593, 0x02b50c63, 0x0040006f, 0xff442503, 0x00100593, 0x0ab50863,
+    0x0040006f, 0xff442503, 0x00200593, 0x12b50863, 0x0040006f, 0xff442503, 0x00300593, 0x18b50e63,
+    0x2080006f, 0x000015b7, 0x00100513, 0x02a5a423, 0x00001537, 0xfea42423, 0x00052503, 0x985ff0ef,
+    0xfe842583, 0x00a5a023, 0x000015b7, 0x00000513, 0x00a5a223, 0x224000ef, 0x00050593, 0x00001537,
+    0x02b52823, 0x03052503, 0x925ff0ef, 0x00050593, 0xfe842503, 0xfeb42823, 0x000015b7, 0x0205a583,
+    0xfeb42623, 0x00052503, 0x8d1ff0ef, 0xfec42583, 0x00050613, 0xff042503, 0x40c585b3, 0x250000ef,
+    0x000015b7, 0x02a5a623, 0x1800006f, 0x000015b7, 0x00200513, 0x02a5a423, 0x00001537, 0x02052503,
+    0x8cdff0ef, 0x000015b7, 0x00a5a023, 0x00001537, 0xfca42e23, 0x00452503, 0x8e9ff0ef, 0xfdc42583,
+    0x00a5a223, 0x154000ef, 0x00050593, 0x00001537, 0x02b52823, 0x03052503, 0x895ff0ef, 0x00050593,
+    0xfdc42503, 0xfeb42223, 0x000015b7, 0x0245a583, 0xfeb42023, 0x00452503, 0x841ff0ef, 0xfe042583,
+    0x00050613, 0xfe442503, 0x40c585b3, 0x1c0000ef, 0x000015b7, 0x02a5a623, 0x0f00006f, 0x000015b7,
+    0x00300513, 0x02a5a423, 0x00001537, 0xfca42a23, 0x00052503, 0x86dff0ef, 0xfd442583, 0x00a5a023,
+    0x00001537, 0x02452503, 0x825ff0ef, 0x000015b7, 0x00a5a223, 0x104000ef, 0x00050593, 0x00001537,
+    0x02b52823, 0x03052503, 0x805ff0ef, 0x00050593, 0xfd442503, 0xfcb42c23, 0x00052503, 0xfbcff0ef,
+    0x00050593, 0xfd842503, 0x144000ef, 0x000015b7, 0x02a5a623, 0x0740006f, 0x000015b7, 0x00000513,
+    0x02a5a423, 0x000015b7, 0x00a5a023, 0x00001537, 0xfca42623, 0x00452503, 0xfe8ff0ef, 0xfcc42583,
+    0x00a5a223, 0x054000ef, 0x00050593, 0x00001537, 0x02b52823, 0x03052503, 0xf94ff0ef, 0x00050593,
+    0xfcc42503, 0xfcb42823, 0x00452503, 0xf4cff0ef, 0x00050593, 0xfd042503, 0x0d4000ef, 0x000015b7,
+    0x02a5a623, 0x0040006f, 0x03c12083, 0x03812403, 0x04010113, 0x00008067, 0xff010113, 0x00112623,
+    0x00812423, 0x01010413, 0x00001537, 0x00c50513, 0xa1dff0ef, 0x000015b7, 0x0205a583, 0xf9c58593,
+    0x0dc000ef, 0x03250513, 0x00c12083, 0x00812403, 0x01010113, 0x00008067, 0xff010113, 0x00112623,
+    0x00812423, 0x01010413, 0x00001537, 0x00c50513, 0x9ddff0ef, 0x000015b7, 0x0245a583, 0xf9c58593,
+    0x09c000ef, 0x03250513, 0x00c12083, 0x00812403, 0x01010113, 0x00008067, 0xff010113, 0x00112623,
+    0x00812423, 0x01010413, 0x00050613, 0x00000513, 0x0015f693, 0x00068463, 0x00c50533, 0x0015d593,
+    0x00161613, 0xfe0596e3, 0x00008067, 0x06054063, 0x0605c663, 0x00058613, 0x00050593, 0xfff00513,
+    0x02060c63, 0x00100693, 0x00b67a63, 0x00c05863, 0x00161613, 0x00169693, 0xfeb66ae3, 0x00000513,
+    0x00c5e663, 0x40c585b3, 0x00d56533, 0x0016d693, 0x00165613, 0xfe0696e3, 0x00008067, 0x00008293,
+    0xfb5ff0ef, 0x00058513, 0x00028067, 0x40a00533, 0x00b04863, 0x40b005b3, 0xf9dff06f, 0x40b005b3,
+    0x00008293, 0xf91ff0ef, 0x40a00533, 0x00028067, 0x00008293, 0x0005ca63, 0x00054c63, 0xf79ff0ef,
+    0x00058513, 0x00028067, 0x40b005b3, 0xfe0558e3, 0x40a00533, 0xf61ff0ef, 0x40b00533, 0x00028067,
+    0x00c12083, 0x00812403, 0x01010113, 0x00008067
+};
+
+// Integer kernel (Dhrystone-style: record copy, string compare, calls, mul/div)
+static const unsigned long WorkloadInteger[] = {
+    0x00010137, //   0: lui    sp, 16
+    0x00004437, //   4: lui    s0, 4
+    0x000044b7, //   8: lui    s1, 4
+    0x04048493, //   c: addi   s1, s1, 64
+    0x00004937, //  10: lui    s2, 4
+    0x10090913, //  14: addi   s2, s2, 256
+    0x000049b7, //  18: lui    s3, 4
+    0x14098993, //  1c: addi   s3, s3, 320
+    0x00000293, //  20: li     t0, 0
+    0x01e00313, //  24: li     t1, 30
+    0x01a00393, //  28: li     t2, 26
+                // init:
+    0x0272fe33, //  2c: remu   t3, t0, t2
+    0x041e0e13, //  30: addi   t3, t3, 65
+    0x00590eb3, //  34: add    t4, s2, t0
+    0x01ce8023, //  38: sb     t3, 0(t4)
+    0x00598eb3, //  3c: add    t4, s3, t0
+    0x01ce8023, //  40: sb     t3, 0(t4)
+    0x00128293, //  44: addi   t0, t0, 1
+    0xfe62e2e3, //  48: bltu   t0, t1, init
+    0x00000a13, //  4c: li     s4, 0
+                // loop:
+    0x001a0a13, //  50: addi   s4, s4, 1
+    0x00040513, //  54: mv     a0, s0
+    0x00048593, //  58: mv     a1, s1
+    0x054000ef, //  5c: jal    copy_record
+    0x00200293, //  60: li     t0, 2
+    0x00300313, //  64: li     t1, 3
+    0x026283b3, //  68: mul    t2, t0, t1
+    0x014383b3, //  6c: add    t2, t2, s4
+    0x0263ce33, //  70: div    t3, t2, t1
+    0x0253eeb3, //  74: rem    t4, t2, t0
+    0x01ca8ab3, //  78: add    s5, s5, t3
+    0x01da8ab3, //  7c: add    s5, s5, t4
+    0x00090513, //  80: mv     a0, s2
+    0x00098593, //  84: mv     a1, s3
+    0x06c000ef, //  88: jal    strcmp
+    0x00ab0b33, //  8c: add    s6, s6, a0
+    0x000a0513, //  90: mv     a0, s4
+    0x00a00593, //  94: li     a1, 10
+    0x088000ef, //  98: jal    proc7
+    0x00a42423, //  9c: sw     a0, 8(s0)
+    0x003a7293, //  a0: andi   t0, s4, 3
+    0x00028463, //  a4: beqz   t0, skip
+    0x001b8b93, //  a8: addi   s7, s7, 1
+                // skip:
+    0xfa5ff06f, //  ac: j      loop
+                // copy_record:
+    0x00052283, //  b0: lw     t0, 0(a0)
+    0x00452303, //  b4: lw     t1, 4(a0)
+    0x00852383, //  b8: lw     t2, 8(a0)
+    0x00c52e03, //  bc: lw     t3, 12(a0)
+    0x0055a023, //  c0: sw     t0, 0(a1)
+    0x0065a223, //  c4: sw     t1, 4(a1)
+    0x0075a423, //  c8: sw     t2, 8(a1)
+    0x01c5a623, //  cc: sw     t3, 12(a1)
+    0x01052283, //  d0: lw     t0, 16(a0)
+    0x01452303, //  d4: lw     t1, 20(a0)
+    0x01852383, //  d8: lw     t2, 24(a0)
+    0x01c52e03, //  dc: lw     t3, 28(a0)
+    0x0055a823, //  e0: sw     t0, 16(a1)
+    0x0065aa23, //  e4: sw     t1, 20(a1)
+    0x0075ac23, //  e8: sw     t2, 24(a1)
+    0x01c5ae23, //  ec: sw     t3, 28(a1)
+    0x00008067, //  f0: ret
+                // strcmp:
+    0x00054283, //  f4: lbu    t0, 0(a0)
+    0x0005c303, //  f8: lbu    t1, 0(a1)
+    0x00629a63, //  fc: bne    t0, t1, differ
+    0x00028c63, // 100: beqz   t0, equal
+    0x00150513, // 104: addi   a0, a0, 1
+    0x00158593, // 108: addi   a1, a1, 1
+    0xfe9ff06f, // 10c: j      strcmp
+                // differ:
+    0x40628533, // 110: sub    a0, t0, t1
+    0x00008067, // 114: ret
+                // equal:
+    0x00000513, // 118: li     a0, 0
+    0x00008067, // 11c: ret
+                // proc7:
+    0xff010113, // 120: addi   sp, sp, -16
+    0x00112623, // 124: sw     ra, 12(sp)
+    0x00812423, // 128: sw     s0, 8(sp)
+    0x00b50433, // 12c: add    s0, a0, a1
+    0x00240513, // 130: addi   a0, s0, 2
+    0x00812403, // 134: lw     s0, 8(sp)
+    0x00c12083, // 138: lw     ra, 12(sp)
+    0x01010113, // 13c: addi   sp, sp, 16
+    0x00008067, // 140: ret
+};
+
+// memset/memcpy kernel (word and unaligned byte loops on 4 KiB buffers)
+static const unsigned long WorkloadMemory[] = {
+    0x00010137, //   0: lui    sp, 16
+    0x00004437, //   4: lui    s0, 4
+    0x000064b7, //   8: lui    s1, 6
+    0x00001937, //   c: lui    s2, 1
+                // loop:
+    0x00040513, //  10: mv     a0, s0
+    0x5a5a65b7, //  14: lui    a1, 370086
+    0xa5a58593, //  18: addi   a1, a1, -1446
+    0x00090613, //  1c: mv     a2, s2
+    0x038000ef, //  20: jal    memset_w
+    0x00048513, //  24: mv     a0, s1
+    0x00040593, //  28: mv     a1, s0
+    0x00090613, //  2c: mv     a2, s2
+    0x048000ef, //  30: jal    memcpy_w
+    0x00340513, //  34: addi   a0, s0, 3
+    0x00148593, //  38: addi   a1, s1, 1
+    0x3fd00613, //  3c: li     a2, 1021
+    0x06c000ef, //  40: jal    memcpy_b
+    0x00148513, //  44: addi   a0, s1, 1
+    0x03300593, //  48: li     a1, 51
+    0x3ff00613, //  4c: li     a2, 1023
+    0x078000ef, //  50: jal    memset_b
+    0xfbdff06f, //  54: j      loop
+                // memset_w:
+    0x00c506b3, //  58: add    a3, a0, a2
+    0x00b52023, //  5c: sw     a1, 0(a0)
+    0x00b52223, //  60: sw     a1, 4(a0)
+    0x00b52423, //  64: sw     a1, 8(a0)
+    0x00b52623, //  68: sw     a1, 12(a0)
+    0x01050513, //  6c: addi   a0, a0, 16
+    0xfed566e3, //  70: bltu   a0, a3, 0x5c <memset_w+0x4>
+    0x00008067, //  74: ret
+                // memcpy_w:
+    0x00c586b3, //  78: add    a3, a1, a2
+    0x0005a283, //  7c: lw     t0, 0(a1)
+    0x0045a303, //  80: lw     t1, 4(a1)
+    0x0085a383, //  84: lw     t2, 8(a1)
+    0x00c5ae03, //  88: lw     t3, 12(a1)
+    0x00552023, //  8c: sw     t0, 0(a0)
+    0x00652223, //  90: sw     t1, 4(a0)
+    0x00752423, //  94: sw     t2, 8(a0)
+    0x01c52623, //  98: sw     t3, 12(a0)
+    0x01050513, //  9c: addi   a0, a0, 16
+    0x01058593, //  a0: addi   a1, a1, 16
+    0xfcd5ece3, //  a4: bltu   a1, a3, 0x7c <memcpy_w+0x4>
+    0x00008067, //  a8: ret
+                // memcpy_b:
+    0x00c586b3, //  ac: add    a3, a1, a2
+    0x0005c283, //  b0: lbu    t0, 0(a1)
+    0x00550023, //  b4: sb     t0, 0(a0)
+    0x00150513, //  b8: addi   a0, a0, 1
+    0x00158593, //  bc: addi   a1, a1, 1
+    0xfed598e3, //  c0: bne    a1, a3, 0xb0 <memcpy_b+0x4>
+    0x00008067, //  c4: ret
+                // memset_b:
+    0x00c506b3, //  c8: add    a3, a0, a2
+    0x00b50023, //  cc: sb     a1, 0(a0)
+    0x00150513, //  d0: addi   a0, a0, 1
+    0xfed51ce3, //  d4: bne    a0, a3, 0xcc <memset_b+0x4>
+    0x00008067, //  d8: ret
+};
+
+// Branchy sort (LCG fill + insertion sort of 256 words)
+static const unsigned long WorkloadSort[] = {
+    0x00010137, //   0: lui    sp, 16
+    0x00004437, //   4: lui    s0, 4
+    0x10000493, //   8: li     s1, 256
+    0x12345937, //   c: lui    s2, 74565
+    0x67890913, //  10: addi   s2, s2, 1656
+    0x41c659b7, //  14: lui    s3, 269413
+    0xe6d98993, //  18: addi   s3, s3, -403
+    0x00003a37, //  1c: lui    s4, 3
+    0x039a0a13, //  20: addi   s4, s4, 57
+                // loop:
+    0x00040293, //  24: mv     t0, s0
+    0x00000313, //  28: li     t1, 0
+                // fill:
+    0x03390933, //  2c: mul    s2, s2, s3
+    0x01490933, //  30: add    s2, s2, s4
+    0x01095393, //  34: srli   t2, s2, 16
+    0x0072a023, //  38: sw     t2, 0(t0)
+    0x00428293, //  3c: addi   t0, t0, 4
+    0x00130313, //  40: addi   t1, t1, 1
+    0xfe9344e3, //  44: blt    t1, s1, fill
+    0x00100293, //  48: li     t0, 1
+                // outer:
+    0xfc92dce3, //  4c: bge    t0, s1, loop
+    0x00229313, //  50: slli   t1, t0, 2
+    0x00640333, //  54: add    t1, s0, t1
+    0x00032383, //  58: lw     t2, 0(t1)
+    0xfff28e13, //  5c: addi   t3, t0, -1
+                // inner:
+    0x020e4063, //  60: bltz   t3, insert
+    0x002e1e93, //  64: slli   t4, t3, 2
+    0x01d40eb3, //  68: add    t4, s0, t4
+    0x000eaf03, //  6c: lw     t5, 0(t4)
+    0x01e3d863, //  70: bge    t2, t5, insert
+    0x01eea223, //  74: sw     t5, 4(t4)
+    0xfffe0e13, //  78: addi   t3, t3, -1
+    0xfe5ff06f, //  7c: j      inner
+                // insert:
+    0x002e1e93, //  80: slli   t4, t3, 2
+    0x01d40eb3, //  84: add    t4, s0, t4
+    0x007ea223, //  88: sw     t2, 4(t4)
+    0x00128293, //  8c: addi   t0, t0, 1
+    0xfbdff06f, //  90: j      outer
+};
+
+typedef struct {
+    const char          *Name;
+    const unsigned long *Code;
+    unsigned long        cCode;         // Instructions
+    unsigned long        MemorySize;
+    unsigned long        StackPointer;
+} TWorkload;
+
+#define WORKLOAD(AName, ACode, AMemorySize, AStackPointer) \
+    { AName, ACode, sizeof(ACode) / sizeof(ACode[0]), AMemorySize, AStackPointer }
+
+static const TWorkload Workloads[] = {
+    WORKLOAD("ball",    WorkloadBall,    0x2000,  0x1a40),   // Same layout of the visualizer
+    WORKLOAD("integer", WorkloadInteger, 0x10000, 0x10000),  // Data at 0x4000
+    WORKLOAD("memory",  WorkloadMemory,  0x10000, 0x10000),  // Buffers at 0x4000 and 0x6000
+    WORKLOAD("sort",    WorkloadSort,    0x10000, 0x10000)   // Array at 0x4000
+};
+
+static const char *ModeNames[TRiscVBenchmark::modeCount] = {
+    "step",
+    "run",
+    "run-bp",
+    "run-watch",
+    "history"
+};
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Benchmark
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+TRiscVBenchmark::TRiscVBenchmark()
+{
+    FInstructions = 20000000;
+}
+//---------------------------------------------------------------------------
+
+TRiscVBenchmark::TResult TRiscVBenchmark::RunWorkload(int AWorkload, Mode AMode)
+{
+const TWorkload    &Workload = Workloads[AWorkload];
+std::vector<char>   Ram(Workload.MemorySize, 0);
+unsigned long       TextEnd  = (Workload.cCode + 1) * sizeof(unsigned long); // + unreachable word (run-bp)
+RiscV_RV32IM        CPU;
+TResult             Result;
+std::chrono::steady_clock::time_point Start;
+
+    memcpy(&Ram[0], Workload.Code, Workload.cCode * sizeof(unsigned long));
+    CPU.Load(&Ram[0], Workload.MemorySize, 0, Workload.StackPointer, 0, TextEnd);
+    CPU.IdleSkip = false;   // Measure every instruction
+
+    switch (AMode) {
+        case modeRunBreakpoint:
+            CPU.Breakpoints->AddBreakpoint(TextEnd - sizeof(unsigned long));
+            break;
+
+        case modeRunWatchpoint:
+            CPU.Breakpoints->AddWatchpoint(Workload.MemorySize, sizeof(unsigned long), TRiscVBreakpoints::watchAccess);
+            break;
+
+        case modeHistory:
+            CPU.EnableHistory(100000, 10000);
+            break;
+
+        default:
+            break;
+    }
+
+    Start = std::chrono::steady_clock::now();
+
+    if (AMode == modeStep)
+        for (unsigned long c=0; c<FInstructions; c++)
+            CPU.Step();
+    else
+        CPU.Run(FInstructions);
+
+    Result.Workload     = Workload.Name;
+    Result.Mode         = ModeNames[AMode];
+    Result.Seconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    Result.Instructions = CPU.InstructionCount;
+    Result.PeakRss      = PeakRss();
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBenchmark::RunAll(std::vector<TResult> &AResults)
+{
+    for (unsigned c=0; c<sizeof(Workloads)/sizeof(Workloads[0]); c++)
+        for (int m=0; m<modeCount; m++)
+            AResults.push_back(RunWorkload(c, (Mode)m));
+}
+//---------------------------------------------------------------------------
+
+unsigned __int64 TRiscVBenchmark::PeakRss()
+{
+#ifdef _WIN32
+PROCESS_MEMORY_COUNTERS Counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+        return 0;
+
+    return Counters.PeakWorkingSetSize;
+#else
+rusage Usage;
+
+    if (getrusage(RUSAGE_SELF, &Usage))
+        return 0;
+
+    return (unsigned __int64)Usage.ru_maxrss * 1024;    // KiB on Linux
+#endif
+}
+//---------------------------------------------------------------------------
+
+String TRiscVBenchmark::FormatText(const TResult &AResult)
+{
+char Buffer[256];
+
+    sprintf(Buffer, "%-8s %-10s %12.0f insns %8.3f s %9.2f MIPS %8.2f ns/insn %9.0f KiB peak RSS",
+        AnsiString(AResult.Workload).c_str(),
+        AnsiString(AResult.Mode).c_str(),
+        (double)AResult.Instructions,
+        AResult.Seconds,
+        AResult.Seconds > 0 ? AResult.Instructions / AResult.Seconds / 1e6 : 0.0,
+        AResult.Instructions ? AResult.Seconds * 1e9 / AResult.Instructions : 0.0,
+        AResult.PeakRss / 1024.0);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
+
+String TRiscVBenchmark::FormatJson(const TResult &AResult)
+{
+char Buffer[256];
+
+    sprintf(Buffer, "{\"workload\":\"%s\",\"mode\":\"%s\",\"instructions\":%.0f,\"seconds\":%.6f,"
+                    "\"mips\":%.3f,\"ns_per_insn\":%.3f,\"peak_rss_bytes\":%.0f}",
+        AnsiString(AResult.Workload).c_str(),
+        AnsiString(AResult.Mode).c_str(),
+        (double)AResult.Instructions,
+        AResult.Seconds,
+        AResult.Seconds > 0 ? AResult.Instructions / AResult.Seconds / 1e6 : 0.0,
+        AResult.Instructions ? AResult.Seconds * 1e9 / AResult.Instructions : 0.0,
+        (double)AResult.PeakRss);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
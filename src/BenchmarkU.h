@@ -0,0 +1,79 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef BenchmarkUH
+#define BenchmarkUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+
+/*
+Emulator speed benchmark
+
+Built-in guest workloads (endless loops: ball.c main/Tick(), integer kernel,
+memset/memcpy, branchy sort) run a fixed number of instructions in every
+execution mode of the core:
+    step        RiscV::Step() per instruction
+    run         RiscV::Run() fast loop
+    run-bp      RiscV::Run() with a breakpoint set (never hit)
+    run-watch   RiscV::Run() with a watchpoint set (never hit)
+    history     RiscV::Run() with reverse execution recording
+Peak RSS is process wide, so it includes every run done before.
+*/
+class TRiscVBenchmark
+{
+public:
+    enum Mode {
+        modeStep,
+        modeRun,
+        modeRunBreakpoint,
+        modeRunWatchpoint,
+        modeHistory,
+        modeCount
+    };
+
+    typedef struct {
+        String              Workload;
+        String              Mode;
+        unsigned __int64    Instructions;
+        double              Seconds;
+        unsigned __int64    PeakRss;        // Bytes
+    } TResult;
+
+private:
+    unsigned long   FInstructions;          // Per run
+
+    TResult RunWorkload(int AWorkload, Mode AMode);
+
+public:
+    TRiscVBenchmark();
+
+    void RunAll(std::vector<TResult> &AResults);
+
+    static String FormatText(const TResult &AResult);
+    static String FormatJson(const TResult &AResult);   // One JSON object per line
+    static unsigned __int64 PeakRss();
+
+    __property unsigned long Instructions = { read=FInstructions, write=FInstructions };
+};
+//---------------------------------------------------------------------------
+#endif
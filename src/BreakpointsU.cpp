@@ -0,0 +1,152 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <algorithm>
+
+#include "BreakpointsU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+TRiscVBreakpoints::TRiscVBreakpoints()
+{
+    FTextStart    = 0;
+    FcTextWords   = 0;
+    FcBreakpoints = 0;
+    FNextWatchId  = 1;
+    FWatchHit     = false;
+    FHitId        = 0;
+    FHitAddress   = 0;
+    FHitKind      = watchAccess;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBreakpoints::SetTextSegment(unsigned long AStart, unsigned long AEnd)
+{
+    FTextStart  = AStart;
+    FcTextWords = (AEnd > AStart) ? (AEnd - AStart) >> 2 : 0;
+
+    FBits.assign((FcTextWords + 31) >> 5, 0);
+    FcBreakpoints = 0;
+}
+//---------------------------------------------------------------------------
+
+unsigned long TRiscVBreakpoints::WordIndex(unsigned long AAddress)
+{
+unsigned long Index = (AAddress - FTextStart) >> 2;
+
+    if (AAddress & 3)
+        throw Exception("Breakpoint address is not word aligned");
+
+    if (Index >= FcTextWords)
+        throw Exception("Breakpoint outside .text segment");
+
+    return Index;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBreakpoints::AddBreakpoint(unsigned long AAddress)
+{
+    if (!IsBreakpoint(AAddress))
+        ToggleBreakpoint(AAddress);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBreakpoints::RemoveBreakpoint(unsigned long AAddress)
+{
+    if (IsBreakpoint(AAddress))
+        ToggleBreakpoint(AAddress);
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVBreakpoints::ToggleBreakpoint(unsigned long AAddress)
+{
+unsigned long Index = WordIndex(AAddress);
+
+    FBits[Index >> 5] ^= 1UL << (Index & 31);
+
+    if (IsBreakpoint(AAddress)) {
+        FcBreakpoints++;
+        return true;
+    }
+
+    FcBreakpoints--;
+    return false;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBreakpoints::ClearBreakpoints()
+{
+    std::fill(FBits.begin(), FBits.end(), 0);
+    FcBreakpoints = 0;
+}
+//---------------------------------------------------------------------------
+
+int TRiscVBreakpoints::AddWatchpoint(unsigned long AAddress, unsigned long ALength, WatchKind AKind)
+{
+TWatchpoint Watchpoint;
+
+    if (!ALength || AAddress + ALength < AAddress)
+        throw Exception("Invalid watchpoint range");
+
+    Watchpoint.Id    = FNextWatchId++;
+    Watchpoint.Start = AAddress;
+    Watchpoint.End   = AAddress + ALength;
+    Watchpoint.Kind  = AKind;
+    FWatchpoints.push_back(Watchpoint);
+
+    return Watchpoint.Id;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBreakpoints::RemoveWatchpoint(int AId)
+{
+    for (size_t c=0; c<FWatchpoints.size(); c++)
+        if (FWatchpoints[c].Id == AId) {
+            FWatchpoints.erase(FWatchpoints.begin() + c);
+            break;
+        }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVBreakpoints::ClearWatchpoints()
+{
+    FWatchpoints.clear();
+}
+//---------------------------------------------------------------------------
+
+// Only the first hit is latched (and reported) until ResetHit()
+void TRiscVBreakpoints::CheckWatch(unsigned long AAddress, int ASize, WatchKind AKind)
+{
+    if (FWatchHit)
+        return;
+
+    for (size_t c=0; c<FWatchpoints.size(); c++)
+        if ((FWatchpoints[c].Kind & AKind)
+            && AAddress < FWatchpoints[c].End
+            && AAddress + ASize > FWatchpoints[c].Start) {
+                FWatchHit   = true;
+                FHitId      = FWatchpoints[c].Id;
+                FHitAddress = AAddress;
+                FHitKind    = AKind;
+                return;
+        }
+}
+//---------------------------------------------------------------------------
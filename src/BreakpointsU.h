@@ -0,0 +1,114 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef BreakpointsUH
+#define BreakpointsUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Breakpoints and watchpoints
+
+PC breakpoints are one bit per .text word: checking the PC is a single bit
+test. Watchpoints are address ranges checked on the load/store path; a hit
+is latched and the run loop stops after the accessing instruction.
+*/
+class TRiscVBreakpoints
+{
+public:
+    enum WatchKind {
+        watchRead   = 1,
+        watchWrite  = 2,
+        watchAccess = watchRead | watchWrite
+    };
+
+private:
+    typedef struct {
+        int           Id;
+        unsigned long Start;    // First watched address
+        unsigned long End;      // Last watched address + 1
+        WatchKind     Kind;
+    } TWatchpoint;
+
+    std::vector<unsigned long> FBits;           // Breakpoint bitmap (32 .text words per item)
+    unsigned long              FTextStart;
+    unsigned long              FcTextWords;
+    int                        FcBreakpoints;
+
+    std::vector<TWatchpoint>   FWatchpoints;
+    int                        FNextWatchId;
+
+    bool                       FWatchHit;       // Latched until ResetHit()
+    int                        FHitId;
+    unsigned long              FHitAddress;
+    WatchKind                  FHitKind;
+
+    void CheckWatch(unsigned long AAddress, int ASize, WatchKind AKind);
+    unsigned long WordIndex(unsigned long AAddress);
+
+    int getWatchpointCount() { return (int)FWatchpoints.size(); }
+
+public:
+    TRiscVBreakpoints();
+
+    void SetTextSegment(unsigned long AStart, unsigned long AEnd); // Clears breakpoints
+
+    // PC breakpoints
+    void AddBreakpoint   (unsigned long AAddress);
+    void RemoveBreakpoint(unsigned long AAddress);
+    bool ToggleBreakpoint(unsigned long AAddress);  // true => now set
+    void ClearBreakpoints();
+
+    bool IsBreakpoint(unsigned long APC)
+    {
+        unsigned long Index = (APC - FTextStart) >> 2;
+        return Index < FcTextWords && (FBits[Index >> 5] >> (Index & 31)) & 1;
+    }
+
+    // Watchpoints on [AAddress, AAddress+ALength)
+    int  AddWatchpoint   (unsigned long AAddress, unsigned long ALength, WatchKind AKind); // Returns id
+    void RemoveWatchpoint(int AId);
+    void ClearWatchpoints();
+
+    // Load/store path
+    void OnLoad(unsigned long AAddress, int ASize)
+    {
+        if (!FWatchpoints.empty())
+            CheckWatch(AAddress, ASize, watchRead);
+    }
+
+    void OnStore(unsigned long AAddress, int ASize)
+    {
+        if (!FWatchpoints.empty())
+            CheckWatch(AAddress, ASize, watchWrite);
+    }
+
+    void ResetHit() { FWatchHit = false; }
+
+    __property int           BreakpointCount = { read=FcBreakpoints };
+    __property int           WatchpointCount = { read=getWatchpointCount };
+    __property bool          WatchHit        = { read=FWatchHit };
+    __property int           HitId           = { read=FHitId };
+    __property unsigned long HitAddress      = { read=FHitAddress };
+    __property WatchKind     HitKind         = { read=FHitKind };
+};
+//---------------------------------------------------------------------------
+#endif
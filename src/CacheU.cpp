@@ -0,0 +1,305 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "CacheU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const char *PolicyNames[] = { "lru", "fifo", "random" };
+
+static const unsigned __int64 MaxCacheSize = (unsigned __int64)1 << 31;    // Largest power of 2 in TConfig::Size
+//---------------------------------------------------------------------------
+
+TRiscVCache::TRiscVCache()
+{
+    TConfig Config = { 0, 1, 64, replLru, 0 };
+
+    Configure(Config);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCache::Configure(const TConfig &AConfig)
+{
+unsigned long cSets;
+
+    if (AConfig.Size) {
+        if (AConfig.Ways < 1 || AConfig.LineSize < 4 || (AConfig.LineSize & (AConfig.LineSize - 1)))
+            throw Exception("Invalid cache geometry");
+
+        cSets = AConfig.Size / AConfig.LineSize / AConfig.Ways;
+
+        if (!cSets || (cSets & (cSets - 1)) || cSets * AConfig.LineSize * AConfig.Ways != AConfig.Size)
+            throw Exception("Cache sets must be a power of 2");
+    }
+    else
+        cSets = 0;
+
+    FConfig   = AConfig;
+    FLineBits = 0;
+    while ((1 << FLineBits) < FConfig.LineSize)
+        FLineBits++;
+
+    FSetMask = cSets ? cSets - 1 : 0;
+    FTags.assign(cSets * FConfig.Ways, (unsigned long)-1);
+    FStamps.assign(cSets * FConfig.Ways, 0);
+
+    Invalidate();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCache::Invalidate()
+{
+    std::fill(FTags.begin(),   FTags.end(),   (unsigned long)-1);
+    std::fill(FStamps.begin(), FStamps.end(), 0);
+
+    FTick     = 0;
+    FRandom   = 0x2545F491;
+    FLastLine = (unsigned long)-1;
+    FHits     = 0;
+    FMisses   = 0;
+}
+//---------------------------------------------------------------------------
+
+// Victim: an invalid way first, then by policy. Stamps wrap after 4G
+// accesses: all reset, the order is lost once
+void TRiscVCache::Fill(unsigned long ALine, unsigned long *ApTags, unsigned long *ApStamps)
+{
+int Victim = 0;
+
+    if (!++FTick)
+        std::fill(FStamps.begin(), FStamps.end(), 0);
+
+    while (Victim < FConfig.Ways && ApTags[Victim] != (unsigned long)-1)
+        Victim++;
+
+    if (Victim == FConfig.Ways && FConfig.Policy == replRandom) {
+        FRandom ^= FRandom << 13;
+        FRandom ^= FRandom >> 17;
+        FRandom ^= FRandom << 5;
+        Victim   = FRandom % FConfig.Ways;
+    }
+    else if (Victim == FConfig.Ways) {
+        Victim = 0;
+        for (int w=1; w<FConfig.Ways; w++)
+            if (ApStamps[w] < ApStamps[Victim])
+                Victim = w;
+    }
+
+    ApTags[Victim]   = ALine;
+    ApStamps[Victim] = FTick;
+}
+//---------------------------------------------------------------------------
+
+TRiscVCache::TConfig TRiscVCache::ParseConfig(const String &AText, int ADefaultLatency)
+{
+TConfig          Config = { 0, 1, 64, replLru, ADefaultLatency };
+char             Unit   = 0;
+char             Policy[16] = "lru";
+int              Size, cFields;
+unsigned __int64 Bytes;
+
+    if (AText == "none")
+        return Config;
+
+    cFields = sscanf(AnsiString(AText).c_str(), "%d%c", &Size, &Unit);
+    if (cFields < 1 || Size <= 0)
+        throw Exception("Invalid cache configuration: " + AText);
+
+    // 64 bits: "4096M" must not wrap into a small valid size
+    Bytes = (unsigned __int64)Size * (Unit == 'K' || Unit == 'k' ? 1024 : Unit == 'M' || Unit == 'm' ? 1024 * 1024 : 1);
+    if (Bytes > MaxCacheSize)
+        throw Exception("Cache size out of range: " + AText);
+
+    Config.Size = (unsigned long)Bytes;
+
+    cFields = sscanf(AnsiString(AText).c_str(), "%*[^:]:%d:%d:%15[a-z]:%d", &Config.Ways, &Config.LineSize, Policy, &Config.Latency);
+    if (cFields < 2)
+        throw Exception("Invalid cache configuration: " + AText);
+
+    for (Config.Policy = replLru; strcmp(Policy, PolicyNames[Config.Policy]); Config.Policy = (Replacement)(Config.Policy + 1))
+        if (Config.Policy == replRandom)
+            throw Exception("Invalid cache replacement policy: " + AText);
+
+    return Config;
+}
+//---------------------------------------------------------------------------
+
+String TRiscVCache::FormatConfig(const TConfig &AConfig)
+{
+char Buffer[64];
+
+    if (!AConfig.Size)
+        return "none";
+
+    // Bytes unless a whole number of K (ParseConfig reads both)
+    if (AConfig.Size % 1024)
+        sprintf(Buffer, "%lu:%d:%d:%s:%d", AConfig.Size, AConfig.Ways, AConfig.LineSize,
+            PolicyNames[AConfig.Policy], AConfig.Latency);
+    else
+        sprintf(Buffer, "%luK:%d:%d:%s:%d", AConfig.Size / 1024, AConfig.Ways, AConfig.LineSize,
+            PolicyNames[AConfig.Policy], AConfig.Latency);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
+
+TRiscVCaches::TRiscVCaches()
+{
+    FMemoryLatency = 0;
+    FStallCycles   = 0;
+    FTextStart     = 0;
+
+    FRegions.resize(1);
+    FRegions.back().Name = "other";
+    FRegions.back().Base = 0;
+    FRegions.back().Size = 0;
+    FRegions.back().Accesses = 0;
+    FRegions.back().Misses   = 0;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCaches::Configure(const TRiscVCache::TConfig &AL1I, const TRiscVCache::TConfig &AL1D,
+                             const TRiscVCache::TConfig &AL2, int AMemoryLatency)
+{
+    if (!AL1I.Size || !AL1D.Size)
+        throw Exception("L1 caches cannot be disabled");
+
+    FL1I.Configure(AL1I);
+    FL1D.Configure(AL1D);
+    FL2.Configure(AL2);
+    FMemoryLatency = AMemoryLatency;
+
+    Clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCaches::SetText(unsigned long ATextStart, unsigned long ATextEnd)
+{
+    FTextStart = ATextStart;
+    FPcStats.resize((ATextEnd - ATextStart) / 4);
+
+    Clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCaches::AddRegion(const String &AName, unsigned long ABase, unsigned long ASize)
+{
+TRegion Region;
+
+    Region.Name     = AName;
+    Region.Base     = ABase;
+    Region.Size     = ASize;
+    Region.Accesses = 0;
+    Region.Misses   = 0;
+
+    FRegions.insert(FRegions.end() - 1, Region);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCaches::Clear()
+{
+TPcStats Zero = { 0, 0, 0, 0 };
+
+    FL1I.Invalidate();
+    FL1D.Invalidate();
+    FL2.Invalidate();
+    FStallCycles = 0;
+
+    std::fill(FPcStats.begin(), FPcStats.end(), Zero);
+
+    for (size_t r=0; r<FRegions.size(); r++) {
+        FRegions[r].Accesses = 0;
+        FRegions[r].Misses   = 0;
+    }
+}
+//---------------------------------------------------------------------------
+
+static bool MoreMisses(const std::pair<unsigned long, unsigned long> &A, const std::pair<unsigned long, unsigned long> &B)
+{
+    return A.first > B.first;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCaches::Report(TStrings *AReport, unsigned __int64 AInstructions, int ATopCount)
+{
+std::vector<std::pair<unsigned long, unsigned long> >  Worst;   // Misses, index
+TRiscVCache                                           *Levels[3] = { &FL1I, &FL1D, &FL2 };
+const char                                            *Names[3]  = { "L1 I", "L1 D", "L2" };
+char                                                   Buffer[256];
+char                                                   Range[32];
+unsigned __int64                                       cAccesses;
+
+    for (int l=0; l<3; l++) {
+        if (!Levels[l]->Enabled)
+            continue;
+
+        cAccesses = Levels[l]->Hits + Levels[l]->Misses;
+        sprintf(Buffer, "%-5s %-22s %14.0f accesses %12.0f misses %7.3f%%",
+            Names[l], AnsiString(TRiscVCache::FormatConfig(Levels[l]->Config)).c_str(),
+            (double)cAccesses, (double)Levels[l]->Misses,
+            cAccesses ? Levels[l]->Misses * 100.0 / cAccesses : 0.0);
+        AReport->Add(Buffer);
+    }
+
+    sprintf(Buffer, "Memory latency %d, stall cycles %.0f, estimated CPI %.3f",
+        FMemoryLatency, (double)FStallCycles,
+        AInstructions ? (double)(AInstructions + FStallCycles) / AInstructions : 0.0);
+    AReport->Add(Buffer);
+
+    AReport->Add("");
+    AReport->Add("Data regions");
+    for (size_t r=0; r<FRegions.size(); r++) {
+        if (r < FRegions.size() - 1)
+            sprintf(Range, "%08lX-%08lX", FRegions[r].Base, FRegions[r].Base + FRegions[r].Size - 1);
+        else
+            Range[0] = 0;
+
+        sprintf(Buffer, "  %-16s %-17s %14.0f accesses %12.0f misses %7.3f%%",
+            AnsiString(FRegions[r].Name).c_str(), Range,
+            (double)FRegions[r].Accesses, (double)FRegions[r].Misses,
+            FRegions[r].Accesses ? FRegions[r].Misses * 100.0 / FRegions[r].Accesses : 0.0);
+        AReport->Add(Buffer);
+    }
+
+    for (size_t p=0; p<FPcStats.size(); p++)
+        if (FPcStats[p].FetchMisses + FPcStats[p].DataMisses)
+            Worst.push_back(std::make_pair(FPcStats[p].FetchMisses + FPcStats[p].DataMisses, (unsigned long)p));
+
+    std::sort(Worst.begin(), Worst.end(), MoreMisses);
+    if ((int)Worst.size() > ATopCount)
+        Worst.resize(ATopCount);
+
+    AReport->Add("");
+    AReport->Add("PC        executed   fetch misses  data accesses  data misses");
+    for (size_t w=0; w<Worst.size(); w++) {
+        const TPcStats &Stats = FPcStats[Worst[w].second];
+
+        sprintf(Buffer, "%08lX %10lu %14lu %14lu %12lu",
+            FTextStart + Worst[w].second * 4, Stats.Fetches, Stats.FetchMisses, Stats.DataAccesses, Stats.DataMisses);
+        AReport->Add(Buffer);
+    }
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,238 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef CacheUH
+#define CacheUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Cache level
+
+Set associative, Size / LineSize lines in Ways ways, write-allocate (no
+write-back traffic modelled). Tags are line numbers packed per set in one
+array ([set][way], -1 => invalid), replacement stamps in another (LRU: last
+use, FIFO: fill time; random: xorshift). A run of accesses to the same line
+(the common case of fetch and stack) hits at the first compare.
+Latency: stall cycles charged for an access served by this level.
+*/
+class TRiscVCache
+{
+public:
+    enum Replacement {
+        replLru,
+        replFifo,
+        replRandom
+    };
+
+    typedef struct {
+        unsigned long Size;         // Bytes, 0 => level disabled
+        int           Ways;
+        int           LineSize;     // Bytes, power of 2
+        Replacement   Policy;
+        int           Latency;      // Cycles
+    } TConfig;
+
+private:
+    TConfig                     FConfig;
+    int                         FLineBits;
+    unsigned long               FSetMask;
+    std::vector<unsigned long>  FTags;
+    std::vector<unsigned long>  FStamps;
+    unsigned long               FTick;
+    unsigned long               FRandom;
+    unsigned long               FLastLine;      // Line of the last access (-1 => none)
+
+    unsigned __int64            FHits;
+    unsigned __int64            FMisses;
+
+    void Fill(unsigned long ALine, unsigned long *ApTags, unsigned long *ApStamps);
+
+public:
+    TRiscVCache();
+
+    void Configure(const TConfig &AConfig);
+    void Invalidate();      // Contents and counters
+
+    // true => hit, a miss fills the line
+    bool Access(unsigned long AAddress)
+    {
+        unsigned long Line = AAddress >> FLineBits;
+        unsigned long Set  = (Line & FSetMask) * FConfig.Ways;
+
+        if (Line == FLastLine) {
+            FHits++;
+            return true;
+        }
+
+        FLastLine = Line;
+
+        for (int w=0; w<FConfig.Ways; w++)
+            if (FTags[Set + w] == Line) {
+                if (FConfig.Policy == replLru)
+                    FStamps[Set + w] = ++FTick;
+
+                FHits++;
+                return true;
+            }
+
+        Fill(Line, &FTags[Set], &FStamps[Set]);
+        FMisses++;
+        return false;
+    }
+
+    // "<size>[K|M]:<ways>:<line size>[:lru|fifo|random[:<latency>]]", "none" => disabled
+    static TConfig ParseConfig(const String &AText, int ADefaultLatency);
+    static String  FormatConfig(const TConfig &AConfig);
+
+    __property bool             Enabled = { read=getEnabled };
+    __property TConfig          Config  = { read=FConfig };
+    __property unsigned __int64 Hits    = { read=FHits };
+    __property unsigned __int64 Misses  = { read=FMisses };
+
+private:
+    bool getEnabled() { return FConfig.Size != 0; }
+};
+//---------------------------------------------------------------------------
+
+/*
+Cache hierarchy timing model
+
+Split L1 (instruction fetch, data load/store) and an optional unified L2
+in front of memory. Every access adds the latency of the level serving it
+to StallCycles (estimated cycles = instructions + StallCycles on a
+single issue core). Hits and misses are kept per insn of .text (fetch and
+data accesses of the insn) and per data region given by AddRegion()
+(addresses in no region count in the last, "other" entry).
+Host accesses, CLINT registers and idle loop insns skipped bypass it.
+*/
+class TRiscVCaches
+{
+public:
+    typedef struct {
+        unsigned long Fetches;
+        unsigned long FetchMisses;      // L1 I
+        unsigned long DataAccesses;
+        unsigned long DataMisses;       // L1 D
+    } TPcStats;
+
+    typedef struct {
+        String           Name;
+        unsigned long    Base;
+        unsigned long    Size;
+        unsigned __int64 Accesses;
+        unsigned __int64 Misses;        // L1 D
+    } TRegion;
+
+private:
+    TRiscVCache             FL1I;
+    TRiscVCache             FL1D;
+    TRiscVCache             FL2;
+    int                     FMemoryLatency;
+    unsigned __int64        FStallCycles;
+
+    unsigned long           FTextStart;
+    std::vector<TPcStats>   FPcStats;       // Per .text insn
+    std::vector<TRegion>    FRegions;       // Last: "other"
+
+    void Miss(unsigned long AAddress)
+    {
+        FStallCycles += !FL2.Enabled  ? FMemoryLatency
+                      : FL2.Access(AAddress) ? FL2.Config.Latency
+                      : FL2.Config.Latency + FMemoryLatency;
+    }
+
+    TPcStats *PcStats(unsigned long APC)
+    {
+        unsigned long Index = (APC - FTextStart) >> 2;
+        return Index < FPcStats.size() ? &FPcStats[Index] : NULL;
+    }
+
+public:
+    TRiscVCaches();
+
+    void Configure(const TRiscVCache::TConfig &AL1I, const TRiscVCache::TConfig &AL1D,
+                   const TRiscVCache::TConfig &AL2, int AMemoryLatency);
+    void SetText(unsigned long ATextStart, unsigned long ATextEnd); // Called by RiscV::Load
+    void AddRegion(const String &AName, unsigned long ABase, unsigned long ASize);
+    void Clear();   // Contents and counters
+
+    void Fetch(unsigned long APC)
+    {
+        TPcStats *pStats = PcStats(APC);
+        bool      Hit    = FL1I.Access(APC);
+
+        if (pStats) {
+            pStats->Fetches++;
+            pStats->FetchMisses += !Hit;
+        }
+
+        if (Hit)
+            FStallCycles += FL1I.Config.Latency;
+        else
+            Miss(APC);
+    }
+
+    // Misaligned accesses crossing a line count on the first line only
+    void Data(unsigned long APC, unsigned long AAddress)
+    {
+        TPcStats *pStats = PcStats(APC);
+        bool      Hit    = FL1D.Access(AAddress);
+        size_t    r      = 0;
+
+        if (pStats) {
+            pStats->DataAccesses++;
+            pStats->DataMisses += !Hit;
+        }
+
+        while (r < FRegions.size() - 1 && AAddress - FRegions[r].Base >= FRegions[r].Size)
+            r++;
+
+        FRegions[r].Accesses++;
+        FRegions[r].Misses += !Hit;
+
+        if (Hit)
+            FStallCycles += FL1D.Config.Latency;
+        else
+            Miss(AAddress);
+    }
+
+    // Levels, regions and the ATopCount insns with most misses
+    void Report(TStrings *AReport, unsigned __int64 AInstructions, int ATopCount);
+
+    __property TRiscVCache      *L1I          = { read=getL1I };
+    __property TRiscVCache      *L1D          = { read=getL1D };
+    __property TRiscVCache      *L2           = { read=getL2 };
+    __property unsigned __int64  StallCycles  = { read=FStallCycles };
+    __property unsigned long     TextStart    = { read=FTextStart };
+    __property std::vector<TPcStats> *PcTable = { read=getPcTable };   // [(PC - TextStart) / 4]
+    __property std::vector<TRegion>  *Regions = { read=getRegions };
+
+private:
+    TRiscVCache           *getL1I()      { return &FL1I; }
+    TRiscVCache           *getL1D()      { return &FL1D; }
+    TRiscVCache           *getL2()       { return &FL2; }
+    std::vector<TPcStats> *getPcTable()  { return &FPcStats; }
+    std::vector<TRegion>  *getRegions()  { return &FRegions; }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,326 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <algorithm>
+#include "CfgU.h"
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+enum {
+    opLoad   = 0x03,
+    opImm    = 0x13,
+    opAuipc  = 0x17,
+    opReg    = 0x33,
+    opLui    = 0x37,
+    opBranch = 0x63,
+    opJal    = 0x6f,
+    opJalr   = 0x67,
+    opSystem = 0x73
+};
+
+static const unsigned long Mret = 0x30200073;
+//---------------------------------------------------------------------------
+
+TRiscVCfg::TRiscVCfg()
+{
+    FpMemory   = NULL;
+    FTextStart = 0;
+    FTextEnd   = 0;
+    FEntry     = 0;
+    FLegalInsn = NULL;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCfg::Clear()
+{
+    FBlocks.clear();
+    FBlockOf.clear();
+    FRemaining.clear();
+    FLoop.clear();
+    FFunctions.clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCfg::Build(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd, unsigned long AEntry, TLegalInsn ALegalInsn)
+{
+    FpMemory   = ApMemory;
+    FTextStart = ATextStart;
+    FTextEnd   = ATextEnd;
+    FEntry     = AEntry;
+    FLegalInsn = ALegalInsn;
+
+    Rebuild();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCfg::Rebuild()
+{
+unsigned long     cWords;
+std::vector<char> Leader;
+unsigned long     Address;
+unsigned long     Insn;
+unsigned long     Target;
+int               Rd;
+
+    Clear();
+
+    if (!FpMemory || !FLegalInsn || FTextEnd <= FTextStart)
+        return;
+
+    cWords = (FTextEnd - FTextStart) >> 2;
+    Leader.assign(cWords, 0);
+
+    // Leaders: .text start, entry, static targets, insns following a control transfer
+    Leader[0] = 1;
+    if (FEntry >= FTextStart && FEntry < FTextEnd && !(FEntry & 0x3))
+        Leader[(FEntry - FTextStart) >> 2] = 1;
+
+    FFunctions.push_back(FEntry);
+
+    for (unsigned long c=0; c<cWords; c++) {
+        Address = FTextStart + c*4;
+        Insn    = Word(Address);
+        Rd      = Insn >> 7 & 0x1F;
+
+        switch (Insn & 0x7F)
+        {
+            case opBranch:
+            case opJal:
+                Target = Address + ((Insn & 0x7F) == opBranch ? RiscV_RV32IM::DecodeImm(Insn, RiscV_RV32IM::fmtB)
+                                                              : RiscV_RV32IM::DecodeImm(Insn, RiscV_RV32IM::fmtJ));
+
+                if (Target >= FTextStart && Target < FTextEnd && !(Target & 0x3))
+                    Leader[(Target - FTextStart) >> 2] = 1;
+
+                if ((Insn & 0x7F) == opJal && IsLinkRegister(Rd))
+                    FFunctions.push_back(Target);
+
+                if (c+1 < cWords)
+                    Leader[c+1] = 1;
+                break;
+
+            case opJalr:
+            case opSystem:
+                if (c+1 < cWords)
+                    Leader[c+1] = 1;
+                break;
+
+            default:
+                if (!FLegalInsn(Insn) && c+1 < cWords)
+                    Leader[c+1] = 1;    // Illegal insn: may trap
+                break;
+        }
+    }
+
+    std::sort(FFunctions.begin(), FFunctions.end());
+    FFunctions.erase(std::unique(FFunctions.begin(), FFunctions.end()), FFunctions.end());
+
+    // Blocks
+    FBlockOf.resize(cWords);
+    FRemaining.resize(cWords);
+    FLoop.assign(cWords, loopNone);
+
+    for (unsigned long c=0; c<cWords; c++) {
+        if (Leader[c]) {
+            TBlock Block;
+
+            Block.Start  = FTextStart + c*4;
+            Block.End    = Block.Start;
+            Block.Exit   = exitFallThrough;
+            Block.Target = 0;
+            Block.Loop   = loopNone;
+            FBlocks.push_back(Block);
+        }
+
+        FBlockOf[c] = (int)FBlocks.size() - 1;
+        FBlocks.back().End += 4;
+    }
+
+    // Exits and remaining insns
+    for (size_t b=0; b<FBlocks.size(); b++) {
+        TBlock &Block = FBlocks[b];
+
+        Address = Block.End - 4;
+        Insn    = Word(Address);
+        Rd      = Insn >> 7 & 0x1F;
+
+        switch (Insn & 0x7F)
+        {
+            case opBranch:
+                Block.Exit   = exitBranch;
+                Block.Target = Address + RiscV_RV32IM::DecodeImm(Insn, RiscV_RV32IM::fmtB);
+                break;
+
+            case opJal:
+                Block.Exit   = IsLinkRegister(Rd) ? exitCall : exitJump;
+                Block.Target = Address + RiscV_RV32IM::DecodeImm(Insn, RiscV_RV32IM::fmtJ);
+                break;
+
+            case opJalr:
+                if (IsLinkRegister(Rd))
+                    Block.Exit = exitIndirectCall;
+                else if (!Rd && IsLinkRegister(Insn >> 15 & 0x1F) && !(Insn >> 20))
+                    Block.Exit = exitReturn;
+                else
+                    Block.Exit = exitIndirect;
+                break;
+
+            case opSystem:
+                if (Insn == Mret)
+                    Block.Exit = exitIndirect;
+                break;
+        }
+
+        for (unsigned long a=Block.Start; a<Block.End; a+=4)
+            FRemaining[(a - FTextStart) >> 2] = (Block.End - a) >> 2;
+
+        Block.Loop = ClassifyLoop(Block);
+        FLoop[(Block.Start - FTextStart) >> 2] = (char)Block.Loop;
+    }
+
+    // Static edges (calls also fall through to the return point)
+    for (size_t b=0; b<FBlocks.size(); b++)
+        switch (FBlocks[b].Exit)
+        {
+            case exitBranch:
+            case exitCall:
+                AddEdge((int)b, FBlocks[b].Target);
+                AddEdge((int)b, FBlocks[b].End);
+                break;
+
+            case exitJump:
+                AddEdge((int)b, FBlocks[b].Target);
+                break;
+
+            case exitFallThrough:
+            case exitIndirectCall:
+                AddEdge((int)b, FBlocks[b].End);
+                break;
+
+            default:
+                break;
+        }
+}
+//---------------------------------------------------------------------------
+
+TRiscVCfg::BlockLoop TRiscVCfg::ClassifyLoop(const TBlock &ABlock)
+{
+unsigned long Insn;
+unsigned long Induction = 0;    // Bitmap of "addi r, r, k" registers
+bool          Counter   = true;
+int           Rd;
+int           cInduction;
+
+    if (ABlock.Exit != exitBranch || ABlock.Target != ABlock.Start || ABlock.End - ABlock.Start > MaxIdleLoop*4)
+        return loopNone;
+
+    for (unsigned long a=ABlock.Start; a<ABlock.End-4; a+=4) {
+        Insn = Word(a);
+        Rd   = Insn >> 7 & 0x1F;
+
+        switch (Insn & 0x7F)
+        {
+            case opLoad:
+            case opImm:
+            case opAuipc:
+            case opReg:
+            case opLui:
+                break;
+
+            default:
+                return loopNone;    // Stores, system insns...
+        }
+
+        if ((Insn & 0x707F) == opImm && Rd && Rd == (int)(Insn >> 15 & 0x1F) && (Insn >> 20) && !(Induction >> Rd & 1))
+            Induction |= 1UL << Rd;
+        else
+            Counter = false;
+    }
+
+    // Counter: exactly one branch operand is an induction register
+    Insn       = Word(ABlock.End - 4);
+    cInduction = (Induction >> (Insn >> 15 & 0x1F) & 1) + (Induction >> (Insn >> 20 & 0x1F) & 1);
+
+    return Counter && cInduction == 1 ? loopCounter : loopPoll;
+}
+//---------------------------------------------------------------------------
+
+// Targets outside .text (or misaligned) have no edge: the run loop faults on them
+void TRiscVCfg::AddEdge(int AFrom, unsigned long ATo)
+{
+int iTo = (ATo & 0x3) ? -1 : FindBlock(ATo);
+
+    if (iTo < 0)
+        return;
+
+    std::vector<int> &Successors = FBlocks[AFrom].Successors;
+    if (std::find(Successors.begin(), Successors.end(), iTo) != Successors.end())
+        return;     // Branch to the next insn
+
+    Successors.push_back(iTo);
+    FBlocks[iTo].Predecessors.push_back(AFrom);
+}
+//---------------------------------------------------------------------------
+
+int TRiscVCfg::FindBlock(unsigned long APC)
+{
+    if (APC < FTextStart || APC >= FTextEnd || FBlockOf.empty())
+        return -1;
+
+    return FBlockOf[(APC - FTextStart) >> 2];
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVCfg::IsBlockEntry(unsigned long APC)
+{
+int iBlock = FindBlock(APC);
+
+    return iBlock >= 0 && FBlocks[iBlock].Start == APC;
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVCfg::IsCall(unsigned long APC)
+{
+int iBlock = FindBlock(APC);
+
+    return iBlock >= 0 && FBlocks[iBlock].End - 4 == APC &&
+           (FBlocks[iBlock].Exit == exitCall || FBlocks[iBlock].Exit == exitIndirectCall);
+}
+//---------------------------------------------------------------------------
+
+const TRiscVCfg::TBlock & TRiscVCfg::getBlock(int AIndex)
+{
+    if (AIndex < 0 || AIndex >= (int)FBlocks.size())
+        throw Exception("Invalid block index");
+
+    return FBlocks[AIndex];
+}
+//---------------------------------------------------------------------------
+
+unsigned long TRiscVCfg::getFunction(int AIndex)
+{
+    if (AIndex < 0 || AIndex >= (int)FFunctions.size())
+        throw Exception("Invalid function index");
+
+    return FFunctions[AIndex];
+}
+//---------------------------------------------------------------------------
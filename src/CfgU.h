@@ -0,0 +1,130 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef CfgUH
+#define CfgUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Static control flow graph of .text
+
+Built at load time: basic block leaders are .text start, program entry,
+static jal/branch targets and the instructions following a jal, branch,
+jalr, system insn or illegal insn (traps, wfi, mret). Illegal is decided by
+the core configuration (LegalInsn: an M insn traps on RV32I). Only the last
+instruction of a block can change the PC, so the run loop validates the PC
+at block entries only (straight-line code cannot leave .text) and executes
+the rest of the block unchecked. Interrupts are taken on block entries.
+
+Edges are static only: jalr targets are unknown (no edge).
+
+Idle loop candidates are single block loops (backward branch to the block
+start) of a few insns without side effects:
+  - loopPoll:    only loads and ALU ops (e.g. polling a flag): once an
+                 iteration leaves all registers unchanged it spins forever
+  - loopCounter: only "addi r, r, k" + a branch on one of them against a
+                 loop invariant (delay loop): iterations are computable
+*/
+class TRiscVCfg
+{
+public:
+    enum BlockExit {
+        exitFallThrough,    // Next insn is a leader (or end of .text)
+        exitBranch,         // Conditional branch: Target + fall through
+        exitJump,           // jal x0 / jal to a non link register
+        exitCall,           // jal ra/t0: Target + return point
+        exitIndirect,       // jalr (not call/return), mret
+        exitIndirectCall,   // jalr ra/t0
+        exitReturn          // jalr x0, 0(ra/t0)
+    };
+
+    enum BlockLoop {
+        loopNone,
+        loopPoll,
+        loopCounter
+    };
+
+    enum {
+        MaxIdleLoop = 16    // Max insns of an idle loop candidate
+    };
+
+    typedef bool (*TLegalInsn)(unsigned long AInsn);   // Configuration decoder
+
+    typedef struct {
+        unsigned long    Start;         // First insn address
+        unsigned long    End;           // Last insn address + 4
+        BlockExit        Exit;
+        unsigned long    Target;        // Static target (exitBranch, exitJump, exitCall)
+        BlockLoop        Loop;
+        std::vector<int> Successors;    // Block indexes (static edges inside .text)
+        std::vector<int> Predecessors;
+    } TBlock;
+
+private:
+    const char                *FpMemory;
+    unsigned long              FTextStart;
+    unsigned long              FTextEnd;
+    unsigned long              FEntry;
+    TLegalInsn                 FLegalInsn;
+
+    std::vector<TBlock>        FBlocks;         // Sorted by address
+    std::vector<int>           FBlockOf;        // .text word => block index
+    std::vector<unsigned long> FRemaining;      // .text word => insns up to block end (included)
+    std::vector<char>          FLoop;           // .text word => BlockLoop (idle loop start only)
+    std::vector<unsigned long> FFunctions;      // Entry + call targets, sorted
+
+    unsigned long Word(unsigned long AAddress) { return *(const unsigned long *)(FpMemory + AAddress); }
+
+    void      AddEdge(int AFrom, unsigned long ATo);
+    BlockLoop ClassifyLoop(const TBlock &ABlock);
+
+    int getBlockCount() { return (int)FBlocks.size(); }
+    const TBlock &getBlock(int AIndex);
+    int getFunctionCount() { return (int)FFunctions.size(); }
+    unsigned long getFunction(int AIndex);
+
+public:
+    TRiscVCfg();
+
+    // ApMemory = guest memory base, .text = [ATextStart, ATextEnd)
+    void Build  (const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd, unsigned long AEntry, TLegalInsn ALegalInsn);
+    void Rebuild();     // .text modified (debugger)
+    void Clear  ();
+
+    int  FindBlock   (unsigned long APC);  // -1 => outside .text
+    bool IsBlockEntry(unsigned long APC);
+    bool IsCall      (unsigned long APC);  // jal/jalr linking ra/t0 (step over target: APC + 4)
+
+    // Run loop: APC must be inside .text and aligned
+    unsigned long Remaining(unsigned long APC) { return FRemaining[(APC - FTextStart) >> 2]; }
+    BlockLoop     LoopAt   (unsigned long APC) { return (BlockLoop)FLoop[(APC - FTextStart) >> 2]; }
+
+    // Standard link registers (calling convention)
+    static bool IsLinkRegister(int AReg) { return AReg == 1 || AReg == 5; }   // ra, t0
+
+    __property int           BlockCount              = { read=getBlockCount };
+    __property const TBlock &Blocks[int Index]       = { read=getBlock };
+    __property int           FunctionCount           = { read=getFunctionCount };
+    __property unsigned long Functions[int Index]    = { read=getFunction };
+};
+//---------------------------------------------------------------------------
+#endif
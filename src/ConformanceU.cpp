@@ -0,0 +1,409 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "ConformanceU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const unsigned long Ecall = 0x00000073;
+
+static const int DecoderFills      = 8;     // Random register fields per key bits combination
+static const int DecoderMaxReport  = 20;    // Mismatches listed
+
+// Configuration check program: mul at ConfigMul traps on RV32I (the handler
+// skips it, a2 = mcause), the jal at ConfigEnd spins
+static const unsigned long ConfigProgram[] = {
+    0x00000297,     // auipc t0, 0
+    0x02028293,     // addi  t0, t0, 32      (handler)
+    0x30529073,     // csrw  mtvec, t0
+    0x00600513,     // li    a0, 6
+    0x02a50533,     // mul   a0, a0, a0
+    0x00150593,     // addi  a1, a0, 1
+    0x0000006F,     // j     .
+    0x00000013,     // nop
+    0x34102373,     // csrr  t1, mepc
+    0x00430313,     // addi  t1, t1, 4
+    0x34131073,     // csrw  mepc, t1
+    0x34202673,     // csrr  a2, mcause
+    0x30200073      // mret
+};
+static const unsigned long ConfigMul = 0x10;
+static const unsigned long ConfigEnd = 0x18;
+//---------------------------------------------------------------------------
+
+// Reference decoder: instruction name by opcode/funct3/funct7 as listed in
+// the ISA manual (RV32I, M, Zicsr), NULL => illegal. Independent of the
+// FInsnTable masks
+static const char *ReferenceInsn(unsigned long AInsn)
+{
+static const char  *Branch[8] = { "beq",  "bne",  NULL,   NULL,    "blt",    "bge",   "bltu",   "bgeu"   };
+static const char  *Load  [8] = { "lb",   "lh",   "lw",   NULL,    "lbu",    "lhu",   NULL,     NULL     };
+static const char  *Store [8] = { "sb",   "sh",   "sw",   NULL,    NULL,     NULL,    NULL,     NULL     };
+static const char  *OpImm [8] = { "addi", NULL,   "slti", "sltiu", "xori",   NULL,    "ori",    "andi"   };
+static const char  *Op    [8] = { "add",  "sll",  "slt",  "sltu",  "xor",    "srl",   "or",     "and"    };
+static const char  *MulDiv[8] = { "mul",  "mulh", "mulhsu", "mulhu", "div",  "divu",  "rem",    "remu"   };
+static const char  *System[8] = { "system", "csrrw", "csrrs", "csrrc", NULL, "csrrwi", "csrrsi", "csrrci" };
+unsigned long       Funct3 = AInsn >> 12 & 0x7;
+unsigned long       Funct7 = AInsn >> 25;
+
+    switch (AInsn & 0x7F)
+    {
+        case 0x37:  return "lui";
+        case 0x17:  return "auipc";
+        case 0x6F:  return "jal";
+        case 0x67:  return Funct3 == 0 ? "jalr" : NULL;
+        case 0x63:  return Branch[Funct3];
+        case 0x03:  return Load[Funct3];
+        case 0x23:  return Store[Funct3];
+        case 0x13:
+            if (Funct3 == 1)
+                return Funct7 == 0x00 ? "slli" : NULL;
+            if (Funct3 == 5)
+                return Funct7 == 0x00 ? "srli" : Funct7 == 0x20 ? "srai" : NULL;
+            return OpImm[Funct3];
+        case 0x33:
+            if (Funct7 == 0x00)
+                return Op[Funct3];
+            if (Funct7 == 0x20)
+                return Funct3 == 0 ? "sub" : Funct3 == 5 ? "sra" : NULL;
+            if (Funct7 == 0x01)
+                return MulDiv[Funct3];
+            return NULL;
+        case 0x0F:  return "fence";     // fence, fence.i (this core: every funct3)
+        case 0x73:  return System[Funct3];
+        default:    return NULL;
+    }
+}
+//---------------------------------------------------------------------------
+
+// Reference immediate: fields gathered bit by bit, sign bit extended by
+// subtraction
+static long ReferenceImm(unsigned long AInsn, RiscV_RV32Isa::InsnFormat AFormat)
+{
+unsigned long Imm;
+int           cBits;
+
+    switch (AFormat)
+    {
+        case RiscV_RV32Isa::fmtI:
+            Imm   = AInsn >> 20;
+            cBits = 12;
+            break;
+        case RiscV_RV32Isa::fmtS:
+            Imm   = (AInsn >> 25) << 5 | (AInsn >> 7 & 0x1F);
+            cBits = 12;
+            break;
+        case RiscV_RV32Isa::fmtB:
+            Imm   = (AInsn >> 31) << 12 | (AInsn >> 7 & 0x1) << 11 | (AInsn >> 25 & 0x3F) << 5 | (AInsn >> 8 & 0xF) << 1;
+            cBits = 13;
+            break;
+        case RiscV_RV32Isa::fmtU:
+            return (long)(AInsn & 0xFFFFF000);
+        case RiscV_RV32Isa::fmtJ:
+            Imm   = (AInsn >> 31) << 20 | (AInsn >> 12 & 0xFF) << 12 | (AInsn >> 20 & 0x1) << 11 | (AInsn >> 21 & 0x3FF) << 1;
+            cBits = 21;
+            break;
+        default:
+            return 0;
+    }
+
+    return Imm & 1UL << (cBits - 1) ? (long)Imm - (1L << cBits) : (long)Imm;
+}
+//---------------------------------------------------------------------------
+
+TRiscVConformance::TRiscVConformance()
+{
+    FMaxInstructions = 10000000;
+    FStackSize       = 0x10000;
+}
+//---------------------------------------------------------------------------
+
+TRiscVConformance::TResult TRiscVConformance::RunTest(const String &AFileName)
+{
+TResult             Result;
+TElfImage           Image;
+RiscV_RV32IM        CPU;
+std::vector<char>   Ram;
+unsigned long       ToHost;
+unsigned long       Value;
+RiscV::StopReason   Reason = RiscV::stopCount;
+String              Reference = ChangeFileExt(AFileName, ".reference_output");
+std::chrono::steady_clock::time_point Start;
+
+    Result.Name         = ExtractFileName(AFileName);
+    Result.Passed       = false;
+    Result.Instructions = 0;
+    Result.Seconds      = 0;
+
+    Start = std::chrono::steady_clock::now();
+    try
+    {
+        Image.LoadFromFile(AFileName);
+        Image.LoadCore(CPU, Ram, FStackSize);
+
+        // End of test: every ecall is a breakpoint, tohost a write watchpoint
+        for (unsigned long Address = Image.TextStart; Address + 4 <= Image.TextEnd; Address += 4)
+            if (*(unsigned long *)&Ram[Address] == Ecall)
+                CPU.Breakpoints->AddBreakpoint(Address);
+
+        if (Image.FindSymbol("tohost", ToHost))
+            CPU.Breakpoints->AddWatchpoint(ToHost, 4, TRiscVBreakpoints::watchWrite);
+
+        Start  = std::chrono::steady_clock::now();
+        Reason = CPU.Run(FMaxInstructions);
+    }
+    catch (Exception &e)
+    {
+        Result.Detail = e.Message;
+    }
+
+    Result.Seconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    Result.Instructions = CPU.InstructionCount;
+
+    if (!Result.Detail.IsEmpty())
+        return Result;
+
+    switch (Reason) {
+        case RiscV::stopCount:
+            Result.Detail = "Timeout after " + IntToStr((__int64)FMaxInstructions) + " instructions";
+            return Result;
+
+        case RiscV::stopWait:
+            Result.Detail = "Hart waiting for interrupt (wfi)";
+            return Result;
+
+        case RiscV::stopBreakpoint:
+            Value = CPU.Registers[RiscV::gp];
+            break;
+
+        case RiscV::stopWatchpoint:
+            CPU.ReadMemory(ToHost, &Value, 4);
+            break;
+    }
+
+    if (FileExists(Reference))
+        Result.Passed = CheckSignature(Image, CPU, Reference, Result.Detail);
+    else if (Value == 1)
+        Result.Passed = true;
+    else
+        Result.Detail = "Failed test case " + IntToStr((int)(Value >> 1));
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+// riscv-arch-test: one 32 bits hex word per line, from begin_signature
+bool TRiscVConformance::CheckSignature(TElfImage &AImage, RiscV &ACPU, const String &AReference, String &ADetail)
+{
+TStringList   *pLines = new TStringList();
+unsigned long  Begin;
+unsigned long  End;
+unsigned long  Word;
+int            Index = 0;
+
+    try
+    {
+        if (!AImage.FindSymbol("begin_signature", Begin) || !AImage.FindSymbol("end_signature", End))
+            ADetail = "Signature symbols not found";
+        else {
+            pLines->LoadFromFile(AReference);
+
+            for (int c=0; c<pLines->Count && ADetail.IsEmpty(); c++) {
+                if (pLines->Strings[c].Trim().IsEmpty())
+                    continue;
+
+                if (Begin + Index * 4 + 4 > End)
+                    ADetail = "Signature shorter than reference";
+                else {
+                    ACPU.ReadMemory(Begin + Index * 4, &Word, 4);
+
+                    if (Word != strtoul(AnsiString(pLines->Strings[c].Trim()).c_str(), NULL, 16))
+                        ADetail = "Signature mismatch at word " + IntToStr(Index);
+                }
+                Index++;
+            }
+        }
+    }
+    catch(...)
+    {
+        delete pLines;
+        throw;
+    }
+    delete pLines;
+
+    return ADetail.IsEmpty();
+}
+//---------------------------------------------------------------------------
+
+String TRiscVConformance::FormatResult(const TResult &AResult)
+{
+char Buffer[256];
+
+    sprintf(Buffer, "%-28s %s %12.0f insns %10.3f MIPS",
+        AnsiString(AResult.Name).c_str(),
+        AResult.Passed ? "PASS" : "FAIL",
+        (double)AResult.Instructions,
+        AResult.Seconds > 0 ? AResult.Instructions / AResult.Seconds / 1e6 : 0.0);
+
+    return AResult.Passed ? String(Buffer) : String(Buffer) + "  " + AResult.Detail;
+}
+//---------------------------------------------------------------------------
+
+// Test images are the files matching AMask without extension (riscv-tests,
+// skipping .dump listings) or with .elf extension (riscv-arch-test)
+int TRiscVConformance::RunSuite(const String &ADirectory, const String &AMask, TStrings *AReport)
+{
+TStringList *pFiles = new TStringList();
+TSearchRec   SearchRec;
+TResult      Result;
+String       Extension;
+int          cFailed = 0;
+
+    try
+    {
+        if (FindFirst(IncludeTrailingPathDelimiter(ADirectory) + AMask, faAnyFile & ~faDirectory, SearchRec) == 0) {
+            do {
+                Extension = ExtractFileExt(SearchRec.Name).LowerCase();
+
+                if (Extension.IsEmpty() || Extension == ".elf")
+                    pFiles->Add(SearchRec.Name);
+            } while (FindNext(SearchRec) == 0);
+
+            FindClose(SearchRec);
+        }
+
+        pFiles->Sort();
+
+        for (int c=0; c<pFiles->Count; c++) {
+            Result = RunTest(IncludeTrailingPathDelimiter(ADirectory) + pFiles->Strings[c]);
+
+            if (!Result.Passed)
+                cFailed++;
+
+            AReport->Add(FormatResult(Result));
+        }
+
+        AReport->Add(IntToStr(pFiles->Count - cFailed) + " passed, " + IntToStr(cFailed) + " failed");
+    }
+    catch(...)
+    {
+        delete pFiles;
+        throw;
+    }
+    delete pFiles;
+
+    return cFailed;
+}
+//---------------------------------------------------------------------------
+
+// ConfigProgram on ACPU up to ConfigEnd: a0/a1/a2 and the block split after
+// the mul must be the ones of the configuration
+static int CheckConfiguration(RiscV &ACPU, const char *AName, bool AMul, TStrings *AReport)
+{
+std::vector<char> Ram(0x1000, 0);
+unsigned long     Expected = AMul ? 36 : 6;
+bool              Passed;
+char              Line[128];
+
+    memcpy(&Ram[0], ConfigProgram, sizeof(ConfigProgram));
+
+    ACPU.Load(&Ram[0], (unsigned long)Ram.size(), 0, (unsigned long)Ram.size(), 0, sizeof(ConfigProgram));
+    ACPU.HostWait = false;
+    ACPU.Breakpoints->AddBreakpoint(ConfigEnd);
+    ACPU.Run(1000);
+
+    Passed = ACPU.PC == ConfigEnd && ACPU.Registers[RiscV::a0] == Expected && ACPU.Registers[RiscV::a1] == Expected + 1 &&
+             ACPU.Registers[RiscV::a2] == (AMul ? 0 : 2) && ACPU.Cfg->IsBlockEntry(ConfigMul + 4) != AMul;
+
+    sprintf(Line, "%s  %s  a0 %lu a1 %lu a2 %lu, block after mul %s", Passed ? "ok  " : "FAIL", AName,
+            ACPU.Registers[RiscV::a0], ACPU.Registers[RiscV::a1], ACPU.Registers[RiscV::a2],
+            ACPU.Cfg->IsBlockEntry(ConfigMul + 4) ? "split" : "joined");
+    AReport->Add(Line);
+
+    return Passed ? 0 : 1;
+}
+//---------------------------------------------------------------------------
+
+// Every combination of the key bits (opcode, funct3, funct7) with register
+// fields all zeros, all ones and DecoderFills pseudo-random values
+int TRiscVConformance::CheckDecoder(TStrings *AReport)
+{
+unsigned long   Key;
+unsigned long   Insn;
+unsigned long   Fill;
+unsigned long   Seed     = 0x12345678;
+const char     *pName;
+int             iRow;
+int             cWords   = 0;
+int             cLegal   = 0;
+int             cFailed  = 0;
+char            Line[128];
+
+    for (Key=0; Key<1UL << 17; Key++)
+        for (int c=0; c<DecoderFills + 2; c++) {
+            Seed  = Seed * 1103515245 + 12345;
+            Fill  = c == 0 ? 0 : c == 1 ? 0x7FFF : Seed >> 16 & 0x7FFF;                 // rd, rs1, rs2
+            Insn  = (Key & 0x7F) | (Fill & 0x1F) << 7 | (Key >> 7 & 0x7) << 12 |
+                    (Fill >> 5 & 0x3FF) << 15 | (Key >> 10) << 25;
+
+            pName = ReferenceInsn(Insn);
+            iRow  = RiscV_RV32Isa::FindInsn(Insn);
+            cWords++;
+
+            if (pName)
+                cLegal++;
+
+            if (pName ? iRow && !strcmp(pName, RiscV_RV32Isa::InsnInfo(iRow).Name) &&
+                            RiscV_RV32Isa::DecodeImm(Insn, RiscV_RV32Isa::InsnInfo(iRow).Format) ==
+                            ReferenceImm(Insn, RiscV_RV32Isa::InsnInfo(iRow).Format)
+                      : !iRow)
+                continue;
+
+            if (++cFailed <= DecoderMaxReport) {
+                sprintf(Line, "FAIL  %08lX  table %s, reference %s%s", Insn,
+                        iRow ? RiscV_RV32Isa::InsnInfo(iRow).Name : "illegal", pName ? pName : "illegal",
+                        pName && iRow ? " (immediate)" : "");
+                AReport->Add(Line);
+            }
+        }
+
+    AReport->Add(IntToStr(cWords) + " words, " + IntToStr(cLegal) + " legal, " + IntToStr(cFailed) + " mismatches");
+
+    return cFailed;
+}
+//---------------------------------------------------------------------------
+
+// Each configuration runs and splits blocks by its own decode table
+int TRiscVConformance::CheckConfigurations(TStrings *AReport)
+{
+RiscV_RV32I  CPU32I;
+RiscV_RV32IM CPU32IM;
+
+    return CheckConfiguration(CPU32I,  "RV32I ", false, AReport) +
+           CheckConfiguration(CPU32IM, "RV32IM", true,  AReport);
+}
+//---------------------------------------------------------------------------
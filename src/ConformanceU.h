@@ -0,0 +1,85 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef ConformanceUH
+#define ConformanceUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+#include "ElfU.h"
+//---------------------------------------------------------------------------
+
+/*
+ISA conformance runner (riscv-tests rv32ui/rv32um, riscv-arch-test)
+
+Every test is an ELF executable run headless on a fresh core by the fast run
+loop. The test ends on:
+  - ecall (RVTEST_PASS/RVTEST_FAIL): gp == 1 => pass, else failed case gp >> 1
+  - write to "tohost" (when defined): 1 => pass, else failed case value >> 1
+When begin_signature/end_signature are defined and <test>.reference_output
+exists, the signature region must match it instead (riscv-arch-test).
+
+CheckDecoder() is the differential check of the decode table: every legal
+encoding must decode to the reference instruction, every other one to illegal.
+CheckConfigurations() runs the same program on every core configuration.
+
+The core implements the machine mode CSRs, traps and mret, so the "p"
+environment setup (mtvec, mstatus, mret into the test body) runs as on
+hardware; the ecall ending the test is stopped by a breakpoint before it
+traps.
+*/
+class TRiscVConformance
+{
+public:
+    typedef struct {
+        String              Name;
+        bool                Passed;
+        String              Detail;         // Failure reason
+        unsigned __int64    Instructions;
+        double              Seconds;
+    } TResult;
+
+private:
+    unsigned long   FMaxInstructions;   // Timeout
+    unsigned long   FStackSize;         // Memory added above the image
+
+    bool CheckSignature(TElfImage &AImage, RiscV &ACPU, const String &AReference, String &ADetail);
+
+public:
+    TRiscVConformance();
+
+    TResult RunTest (const String &AFileName);
+    int     RunSuite(const String &ADirectory, const String &AMask, TStrings *AReport); // Returns failed tests
+
+    static String FormatResult(const TResult &AResult);
+
+    // Table decoder (RiscV_RV32Isa::FindInsn, DecodeImm) vs a reference
+    // decoder written from the ISA encoding tables, returns mismatches
+    static int CheckDecoder(TStrings *AReport);
+
+    // ConfigProgram (mul inside a block, illegal insn trap handler) on
+    // RiscV_RV32I and RiscV_RV32IM, returns failed configurations
+    static int CheckConfigurations(TStrings *AReport);
+
+    __property unsigned long MaxInstructions = { read=FMaxInstructions, write=FMaxInstructions };
+    __property unsigned long StackSize       = { read=FStackSize,       write=FStackSize       };
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,200 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+
+#include "CoverageU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+TRiscVCoverage::TRiscVCoverage()
+{
+    FpMemory   = NULL;
+    FTextStart = 0;
+    FTextEnd   = 0;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCoverage::SetText(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd)
+{
+    FpMemory   = ApMemory;
+    FTextStart = ATextStart;
+    FTextEnd   = ATextEnd > ATextStart ? ATextEnd : ATextStart;
+    FFlags.assign((FTextEnd - FTextStart) >> 2, 0);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCoverage::Clear()
+{
+    FFlags.assign(FFlags.size(), 0);
+}
+//---------------------------------------------------------------------------
+
+// The last insn branches back; its fall through is taken only if the loop ended
+void TRiscVCoverage::Loop(unsigned long AStart, unsigned long ALength, unsigned long ANextPC)
+{
+unsigned long Last = AStart + (ALength - 1) * 4;
+
+    for (unsigned long a=AStart; a<Last; a+=4)
+        FFlags[(a - FTextStart) >> 2] |= covFallThrough;
+
+    FFlags[(Last - FTextStart) >> 2] |= covTaken;
+    if (ANextPC == Last + 4)
+        FFlags[(Last - FTextStart) >> 2] |= covFallThrough;
+}
+//---------------------------------------------------------------------------
+
+unsigned char TRiscVCoverage::Flags(unsigned long APC)
+{
+    if (APC < FTextStart || APC >= FTextEnd)
+        return 0;
+
+    return FFlags[(APC - FTextStart) >> 2];
+}
+//---------------------------------------------------------------------------
+
+void TRiscVCoverage::Merge(TStrings *ACoverage)
+{
+unsigned long Address;
+unsigned int  Flags;
+
+    for (int c=0; c<ACoverage->Count; c++)
+        if (sscanf(AnsiString(ACoverage->Strings[c]).c_str(), "%lx %*s %x", &Address, &Flags) == 2
+            && Address >= FTextStart && Address < FTextEnd && !(Address & 0x3))
+            FFlags[(Address - FTextStart) >> 2] |= Flags & (covFallThrough | covTaken);
+}
+//---------------------------------------------------------------------------
+
+TRiscVCoverage::TSummary TRiscVCoverage::Summary(unsigned long AStart, unsigned long AEnd)
+{
+TSummary Result = { 0, 0, 0, 0 };
+
+    for (unsigned long a=AStart; a<AEnd; a+=4) {
+        Result.Insns++;
+        Result.Hits += FFlags[(a - FTextStart) >> 2] != 0;
+
+        if (IsBranch(a)) {
+            Result.BranchInsns++;
+            Result.Directions += (FFlags[(a - FTextStart) >> 2] & covFallThrough) != 0;
+            Result.Directions += (FFlags[(a - FTextStart) >> 2] & covTaken) != 0;
+        }
+    }
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+// Summary (program, then per function: up to the next symbol), one line per insn
+void TRiscVCoverage::Save(TStrings *ACoverage, TRiscVListing *AListing)
+{
+char          Line[400];
+TSummary      Total = Summary(FTextStart, FTextEnd);
+TSummary      Function;
+unsigned long Next;
+int           s = 0;
+
+    sprintf(Line, "# %d/%d insns executed, %d/%d branch directions",
+            Total.Hits, Total.Insns, Total.Directions, 2 * Total.BranchInsns);
+    ACoverage->Add(Line);
+
+    for (unsigned long a=FTextStart; a<FTextEnd; a=Next) {
+        while (s < AListing->SymbolCount && AListing->Symbols[s].Address <= a)
+            s++;
+        Next = s < AListing->SymbolCount && AListing->Symbols[s].Address < FTextEnd ? AListing->Symbols[s].Address : FTextEnd;
+
+        Function = Summary(a, Next);
+        sprintf(Line, "# %s: %d/%d insns, %d/%d branch directions", AListing->SymbolName(a).c_str(),
+                Function.Hits, Function.Insns, Function.Directions, 2 * Function.BranchInsns);
+        ACoverage->Add(Line);
+    }
+
+    ACoverage->Add("# <address> <symbol+offset> <flags: 0 not executed, 1 fall through, 2 taken, 3 both>");
+    for (unsigned long a=FTextStart; a<FTextEnd; a+=4) {
+        sprintf(Line, "%08lx %s %d", a, AListing->SymbolName(a).c_str(), FFlags[(a - FTextStart) >> 2]);
+        ACoverage->Add(Line);
+    }
+}
+//---------------------------------------------------------------------------
+
+// Tracefile for lcov/genhtml: lines = insn numbers, one function per symbol
+void TRiscVCoverage::Lcov(TStrings *ACoverage, TRiscVListing *AListing, const String &ASourceFile)
+{
+char          Line[400];
+TSummary      Total = Summary(FTextStart, FTextEnd);
+unsigned long Address;
+unsigned char Flags;
+int           cFunctions = 0, cFunctionsHit = 0;
+
+    ACoverage->Add("TN:");
+    ACoverage->Add("SF:" + ASourceFile);
+
+    for (int s=0; s<AListing->SymbolCount; s++) {
+        Address = AListing->Symbols[s].Address;
+        if (Address < FTextStart || Address >= FTextEnd || (Address & 0x3))
+            continue;
+
+        sprintf(Line, "FN:%lu,%s", (Address >> 2) + 1, AListing->Symbols[s].Name.c_str());
+        ACoverage->Add(Line);
+        sprintf(Line, "FNDA:%d,%s", FFlags[(Address - FTextStart) >> 2] != 0, AListing->Symbols[s].Name.c_str());
+        ACoverage->Add(Line);
+
+        cFunctions++;
+        cFunctionsHit += FFlags[(Address - FTextStart) >> 2] != 0;
+    }
+
+    sprintf(Line, "FNF:%d", cFunctions);
+    ACoverage->Add(Line);
+    sprintf(Line, "FNH:%d", cFunctionsHit);
+    ACoverage->Add(Line);
+
+    for (unsigned long a=FTextStart; a<FTextEnd; a+=4) {
+        Flags = FFlags[(a - FTextStart) >> 2];
+
+        if (IsBranch(a)) {
+            if (Flags) {
+                sprintf(Line, "BRDA:%lu,0,0,%d", (a >> 2) + 1, (Flags & covTaken) != 0);
+                ACoverage->Add(Line);
+                sprintf(Line, "BRDA:%lu,0,1,%d", (a >> 2) + 1, (Flags & covFallThrough) != 0);
+            }
+            else {
+                sprintf(Line, "BRDA:%lu,0,0,-", (a >> 2) + 1);
+                ACoverage->Add(Line);
+                sprintf(Line, "BRDA:%lu,0,1,-", (a >> 2) + 1);
+            }
+            ACoverage->Add(Line);
+        }
+
+        sprintf(Line, "DA:%lu,%d", (a >> 2) + 1, Flags != 0);
+        ACoverage->Add(Line);
+    }
+
+    sprintf(Line, "BRF:%d", 2 * Total.BranchInsns);
+    ACoverage->Add(Line);
+    sprintf(Line, "BRH:%d", Total.Directions);
+    ACoverage->Add(Line);
+    sprintf(Line, "LF:%d", Total.Insns);
+    ACoverage->Add(Line);
+    sprintf(Line, "LH:%d", Total.Hits);
+    ACoverage->Add(Line);
+    ACoverage->Add("end_of_record");
+}
+//---------------------------------------------------------------------------
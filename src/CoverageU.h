@@ -0,0 +1,98 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef CoverageUH
+#define CoverageUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "ListingU.h"
+//---------------------------------------------------------------------------
+
+/*
+Guest code coverage
+
+One flag byte per .text insn, set by the run loop with a single OR:
+covFallThrough when the insn executed and the next one followed, covTaken
+when the PC moved (branch taken, jump, trap). Any flag => executed, on a
+conditional branch the two flags are its two directions. Idle loops
+skipped by the core are marked as a whole by Loop().
+Coverage is exported as text ("<address> <symbol+offset> <flags>" lines,
+merged back by Merge() so runs accumulate) or as an lcov tracefile whose
+"lines" are insn numbers (address / 4 + 1) of the program.
+*/
+class TRiscVCoverage
+{
+public:
+    enum {
+        covFallThrough = 0x01,
+        covTaken       = 0x02
+    };
+
+private:
+    const char                 *FpMemory;
+    unsigned long               FTextStart;
+    unsigned long               FTextEnd;
+    std::vector<unsigned char>  FFlags;         // .text word => cov flags
+
+    typedef struct {
+        int Insns;
+        int Hits;           // Executed insns
+        int BranchInsns;
+        int Directions;     // Branch directions taken (of 2*BranchInsns)
+    } TSummary;
+
+    bool     IsBranch(unsigned long AAddress) { return (*(const unsigned long *)(FpMemory + AAddress) & 0x7F) == 0x63; }
+    TSummary Summary (unsigned long AStart, unsigned long AEnd);
+
+    int getInstructions()     { return Summary(FTextStart, FTextEnd).Insns; }
+    int getExecuted()         { return Summary(FTextStart, FTextEnd).Hits; }
+    int getBranches()         { return Summary(FTextStart, FTextEnd).BranchInsns; }
+    int getBranchDirections() { return Summary(FTextStart, FTextEnd).Directions; }
+
+public:
+    TRiscVCoverage();
+
+    void SetText(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd);    // Flags cleared
+    void Clear();
+
+    // AInsn at APC executed (in .text), ATaken => the PC did not fall through
+    void Retire(unsigned long APC, bool ATaken)
+    {
+        FFlags[(APC - FTextStart) >> 2] |= covFallThrough << ATaken;
+    }
+
+    // Idle loop of ALength insns at AStart skipped up to ANextPC
+    void Loop(unsigned long AStart, unsigned long ALength, unsigned long ANextPC);
+
+    unsigned char Flags(unsigned long APC);
+
+    void Merge(TStrings *ACoverage);    // Text format (same program): flags ORed
+    void Save (TStrings *ACoverage, TRiscVListing *AListing);
+    void Lcov (TStrings *ACoverage, TRiscVListing *AListing, const String &ASourceFile);
+
+    __property int Instructions      = { read=getInstructions };
+    __property int Executed          = { read=getExecuted };
+    __property int Branches          = { read=getBranches };
+    __property int BranchDirections  = { read=getBranchDirections };    // Of 2*Branches
+};
+//---------------------------------------------------------------------------
+#endif
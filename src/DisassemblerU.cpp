@@ -0,0 +1,287 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+
+#include "DisassemblerU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const char *RegNames[] =
+{
+    "zero",
+    "ra",
+    "sp",
+    "gp",
+    "tp",
+    "t0", "t1", "t2",
+    "s0",
+    "s1",
+    "a0", "a1",
+    "a2", "a3", "a4", "a5", "a6", "a7",
+    "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11",
+    "t3", "t4", "t5", "t6"
+};
+//---------------------------------------------------------------------------
+
+TRiscVDisassembler::TRiscVDisassembler()
+{
+    FpMemory   = NULL;
+    FTextStart = 0;
+    FTextEnd   = 0;
+    FpListing  = NULL;
+    FcRendered = 0;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVDisassembler::SetText(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd)
+{
+TEntry Empty;
+
+    Empty.Word  = 0;
+    Empty.Valid = false;
+
+    FpMemory   = ApMemory;
+    FTextStart = ATextStart;
+    FTextEnd   = ATextEnd;
+    FcRendered = 0;
+    FCache.assign((ATextEnd - ATextStart) >> 2, Empty);
+}
+//---------------------------------------------------------------------------
+
+const char * TRiscVDisassembler::RegName(int AIndex)
+{
+    return RegNames[AIndex & 0x1F];
+}
+//---------------------------------------------------------------------------
+
+const char * TRiscVDisassembler::CsrName(int ACsr)
+{
+    switch (ACsr)
+    {
+        case RiscV::csrMstatus:   return "mstatus";
+        case RiscV::csrMisa:      return "misa";
+        case RiscV::csrMie:       return "mie";
+        case RiscV::csrMtvec:     return "mtvec";
+        case RiscV::csrMscratch:  return "mscratch";
+        case RiscV::csrMepc:      return "mepc";
+        case RiscV::csrMcause:    return "mcause";
+        case RiscV::csrMtval:     return "mtval";
+        case RiscV::csrMip:       return "mip";
+        case RiscV::csrMcycle:    return "mcycle";
+        case RiscV::csrMinstret:  return "minstret";
+        case RiscV::csrMcycleh:   return "mcycleh";
+        case RiscV::csrMinstreth: return "minstreth";
+        case RiscV::csrCycle:     return "cycle";
+        case RiscV::csrTime:      return "time";
+        case RiscV::csrInstret:   return "instret";
+        case RiscV::csrCycleh:    return "cycleh";
+        case RiscV::csrTimeh:     return "timeh";
+        case RiscV::csrInstreth:  return "instreth";
+        case RiscV::csrMvendorid: return "mvendorid";
+        case RiscV::csrMarchid:   return "marchid";
+        case RiscV::csrMimpid:    return "mimpid";
+        case RiscV::csrMhartid:   return "mhartid";
+        default:                  return NULL;
+    }
+}
+//---------------------------------------------------------------------------
+
+// "<address> <symbol+offset>" (objdump), the address alone with no symbol
+void TRiscVDisassembler::Target(char *ApText, size_t ASize, unsigned long AAddress)
+{
+unsigned long Entry;
+
+    if (FpListing && FpListing->FindFunction(AAddress, Entry))
+        snprintf(ApText, ASize, "%lx <%s>", AAddress, FpListing->SymbolName(AAddress).c_str());
+    else
+        snprintf(ApText, ASize, "%lx", AAddress);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVDisassembler::Format(unsigned long AInstruction, unsigned long AAddress, char *AMnemonic, char *AOperands)
+{
+int                            iRow   = RiscV_RV32IM::FindInsn(AInstruction);
+int                            Rd     = AInstruction >>  7 & 0x1F;
+int                            Rs1    = AInstruction >> 15 & 0x1F;
+int                            Rs2    = AInstruction >> 20 & 0x1F;
+int                            Funct3 = AInstruction >> 12 & 0x7;
+const RiscV_RV32IM::TInsnDesc *pDesc;
+long                           Imm;
+const char                    *Csr;
+char                           CsrNumber[8];
+int                            cText;
+
+    AOperands[0] = 0;
+
+    if (!iRow) {
+        strcpy(AMnemonic, ".word");
+        sprintf(AOperands, "0x%08lx", AInstruction);
+        return;
+    }
+
+    pDesc = &RiscV_RV32IM::InsnInfo(iRow);
+    Imm   = RiscV_RV32IM::DecodeImm(AInstruction, pDesc->Format);
+    strcpy(AMnemonic, pDesc->Name);
+
+    switch (pDesc->Format)
+    {
+        case RiscV_RV32IM::fmtR:
+            sprintf(AOperands, "%s,%s,%s", RegNames[Rd], RegNames[Rs1], RegNames[Rs2]);
+            break;
+
+        case RiscV_RV32IM::fmtS:
+            sprintf(AOperands, "%s,%ld(%s)", RegNames[Rs2], Imm, RegNames[Rs1]);
+            break;
+
+        case RiscV_RV32IM::fmtB:
+            cText = sprintf(AOperands, "%s,%s,", RegNames[Rs1], RegNames[Rs2]);
+            Target(AOperands + cText, OperandsSize - cText, AAddress + Imm);
+            break;
+
+        case RiscV_RV32IM::fmtU:
+            sprintf(AOperands, "%s,0x%lx", RegNames[Rd], (unsigned long)Imm >> 12);
+            break;
+
+        case RiscV_RV32IM::fmtJ:
+            if (Rd == RiscV::zero)
+                strcpy(AMnemonic, "j");
+            cText = Rd == RiscV::zero || Rd == RiscV::ra ? 0 : sprintf(AOperands, "%s,", RegNames[Rd]);
+            Target(AOperands + cText, OperandsSize - cText, AAddress + Imm);
+            break;
+
+        case RiscV_RV32IM::fmtI:
+            switch (AInstruction & 0x7F)
+            {
+                case 0x67:  // jalr
+                    if (Rd == RiscV::zero && Rs1 == RiscV::ra && !Imm)
+                        strcpy(AMnemonic, "ret");
+                    else
+                        sprintf(AOperands, "%s,%ld(%s)", RegNames[Rd], Imm, RegNames[Rs1]);
+                    break;
+
+                case 0x03:  // Loads
+                    sprintf(AOperands, "%s,%ld(%s)", RegNames[Rd], Imm, RegNames[Rs1]);
+                    break;
+
+                case 0x13:  // Immediate ops
+                    if (Funct3 == 1 || Funct3 == 5)
+                        sprintf(AOperands, "%s,%s,%ld", RegNames[Rd], RegNames[Rs1], Imm & 0x1F);
+                    else if (Funct3 != 0)
+                        sprintf(AOperands, "%s,%s,%ld", RegNames[Rd], RegNames[Rs1], Imm);
+                    else if (Rd == RiscV::zero && Rs1 == RiscV::zero && !Imm)
+                        strcpy(AMnemonic, "nop");
+                    else if (Rs1 == RiscV::zero) {
+                        strcpy(AMnemonic, "li");
+                        sprintf(AOperands, "%s,%ld", RegNames[Rd], Imm);
+                    }
+                    else if (!Imm) {
+                        strcpy(AMnemonic, "mv");
+                        sprintf(AOperands, "%s,%s", RegNames[Rd], RegNames[Rs1]);
+                    }
+                    else
+                        sprintf(AOperands, "%s,%s,%ld", RegNames[Rd], RegNames[Rs1], Imm);
+                    break;
+
+                case 0x73:  // System row (funct12), csr* (csr, rs1 or uimm)
+                    if (!Funct3) {
+                        switch (AInstruction)
+                        {
+                            case 0x00000073: strcpy(AMnemonic, "ecall");  break;
+                            case 0x00100073: strcpy(AMnemonic, "ebreak"); break;
+                            case 0x30200073: strcpy(AMnemonic, "mret");   break;
+                            case 0x10500073: strcpy(AMnemonic, "wfi");    break;
+                            default:
+                                strcpy(AMnemonic, ".word");
+                                sprintf(AOperands, "0x%08lx", AInstruction);
+                                break;
+                        }
+                        break;
+                    }
+
+                    if ((Csr = CsrName(AInstruction >> 20)) == NULL) {
+                        sprintf(CsrNumber, "0x%03lx", AInstruction >> 20);
+                        Csr = CsrNumber;
+                    }
+
+                    if (Funct3 & 0x4)
+                        sprintf(AOperands, "%s,%s,%d", RegNames[Rd], Csr, Rs1);
+                    else
+                        sprintf(AOperands, "%s,%s,%s", RegNames[Rd], Csr, RegNames[Rs1]);
+                    break;
+
+                default:    // fence: no operands
+                    break;
+            }
+            break;
+    }
+}
+//---------------------------------------------------------------------------
+
+const TRiscVDisassembler::TEntry & TRiscVDisassembler::Insn(unsigned long AAddress)
+{
+TEntry        *pEntry;
+unsigned long  Word;
+char           Mnemonic[MnemonicSize];
+char           Operands[OperandsSize];
+
+    if (AAddress < FTextStart || AAddress >= FTextEnd || (AAddress & 0x3))
+        throw Exception("Disassembly outside .text");
+
+    pEntry = &FCache[(AAddress - FTextStart) >> 2];
+    memcpy(&Word, FpMemory + AAddress, sizeof(Word));
+
+    if (!pEntry->Valid || pEntry->Word != Word) {
+        Format(Word, AAddress, Mnemonic, Operands);
+
+        pEntry->Word        = Word;
+        pEntry->Mnemonic    = Mnemonic;
+        pEntry->Operands    = Operands;
+        pEntry->Valid       = true;
+        FcRendered++;
+    }
+
+    return *pEntry;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVDisassembler::Save(TStrings *AListing)
+{
+const TEntry  *pEntry;
+unsigned long  Entry;
+char           Line[300];
+
+    AListing->Add("Disassembly of section .text:");
+
+    for (unsigned long Address=FTextStart; Address<FTextEnd; Address+=4) {
+        if (FpListing && FpListing->FindFunction(Address, Entry) && Entry == Address) {
+            snprintf(Line, sizeof(Line), "%08lx <%s>:", Address, FpListing->SymbolName(Address).c_str());
+            AListing->Add("");
+            AListing->Add(Line);
+        }
+
+        pEntry = &Insn(Address);
+        sprintf(Line, "%8lx:\t%08lx\t", Address, pEntry->Word);
+        AListing->Add(String(Line) + pEntry->Mnemonic + "\t" + pEntry->Operands);
+    }
+}
+//---------------------------------------------------------------------------
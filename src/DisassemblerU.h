@@ -0,0 +1,90 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef DisassemblerUH
+#define DisassemblerUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+#include "ListingU.h"
+//---------------------------------------------------------------------------
+
+/*
+RV32IM disassembler
+
+Decoding goes through the core instruction table (RiscV_RV32IM::FindInsn,
+InsnInfo, DecodeImm), so the text always matches what the emulator runs;
+the "system" row is split into ecall/ebreak/mret/wfi here. Output follows
+objdump: ABI register names, common aliases (nop, li, mv, ret, j), branch
+and jump targets as "<address> <symbol+offset>" from the Listing.
+Insn() renders a .text word on first use and caches the text with the word
+it came from: a word changed since (debugger, GDB, self-modifying code) is
+rendered again on its next lookup, so the cache needs no write hooks and a
+view pays only for the rows it shows.
+*/
+class TRiscVDisassembler
+{
+public:
+    typedef struct {
+        unsigned long Word;         // Insn the text was rendered from
+        String        Mnemonic;
+        String        Operands;
+        bool          Valid;
+    } TEntry;
+
+    enum {
+        MnemonicSize = 16,              // Format() buffers
+        OperandsSize = 320
+    };
+
+private:
+    const char          *FpMemory;     // Host buffer, guest address 0
+    unsigned long        FTextStart;
+    unsigned long        FTextEnd;
+    std::vector<TEntry>  FCache;       // Per .text word
+    TRiscVListing       *FpListing;    // Target symbols (NULL => addresses only)
+    unsigned long        FcRendered;   // Cache misses
+
+    void Target(char *ApText, size_t ASize, unsigned long AAddress);
+
+public:
+    TRiscVDisassembler();
+
+    // Cache cleared: call on every program load
+    void SetText(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd);
+
+    const TEntry &Insn(unsigned long AAddress);    // .text address, 4 aligned
+
+    // Any word (no cache): mnemonic and operands (MnemonicSize, OperandsSize buffers)
+    void Format(unsigned long AInstruction, unsigned long AAddress, char *AMnemonic, char *AOperands);
+
+    // objdump style listing of .text (loaded back by the debugger)
+    void Save(TStrings *AListing);
+
+    static const char *RegName(int AIndex);
+    static const char *CsrName(int ACsr);            // NULL => not implemented
+
+    __property TRiscVListing *Listing   = { read=FpListing, write=FpListing };
+    __property unsigned long  Rendered  = { read=FcRendered };
+};
+//---------------------------------------------------------------------------
+#endif
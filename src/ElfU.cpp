@@ -0,0 +1,249 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <string.h>
+#include <algorithm>
+
+#include "ElfU.h"
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+// ELF32 little endian layouts (unsigned long = 32 bits)
+typedef struct {
+    unsigned char   e_ident[16];
+    unsigned short  e_type;
+    unsigned short  e_machine;
+    unsigned long   e_version;
+    unsigned long   e_entry;
+    unsigned long   e_phoff;
+    unsigned long   e_shoff;
+    unsigned long   e_flags;
+    unsigned short  e_ehsize;
+    unsigned short  e_phentsize;
+    unsigned short  e_phnum;
+    unsigned short  e_shentsize;
+    unsigned short  e_shnum;
+    unsigned short  e_shstrndx;
+} TElf32Header;
+
+typedef struct {
+    unsigned long   p_type;
+    unsigned long   p_offset;
+    unsigned long   p_vaddr;
+    unsigned long   p_paddr;
+    unsigned long   p_filesz;
+    unsigned long   p_memsz;
+    unsigned long   p_flags;
+    unsigned long   p_align;
+} TElf32Program;
+
+typedef struct {
+    unsigned long   sh_name;
+    unsigned long   sh_type;
+    unsigned long   sh_flags;
+    unsigned long   sh_addr;
+    unsigned long   sh_offset;
+    unsigned long   sh_size;
+    unsigned long   sh_link;
+    unsigned long   sh_info;
+    unsigned long   sh_addralign;
+    unsigned long   sh_entsize;
+} TElf32Section;
+
+typedef struct {
+    unsigned long   st_name;
+    unsigned long   st_value;
+    unsigned long   st_size;
+    unsigned char   st_info;
+    unsigned char   st_other;
+    unsigned short  st_shndx;
+} TElf32Symbol;
+
+enum {
+    ElfClass32   = 1,
+    ElfData2LSB  = 1,
+    ElfExec      = 2,
+    ElfRiscV     = 243,
+    ElfLoad      = 1,       // p_type
+    ElfExecute   = 1,       // p_flags
+    ElfSymTab    = 2,       // sh_type
+    ElfReserved  = 0xff00,  // st_shndx: absolute, common, ...
+    ElfMaxImage  = 32 << 20 // Rebased image below the CLINT registers (0x02000000)
+};
+//---------------------------------------------------------------------------
+
+TElfImage::TElfImage()
+{
+    FBase      = 0;
+    FEntry     = 0;
+    FTextStart = 0;
+    FTextEnd   = 0;
+}
+//---------------------------------------------------------------------------
+
+void TElfImage::LoadFromFile(const String &AFileName)
+{
+TFileStream             *pStream;
+std::vector<char>        File;
+const TElf32Header      *pHeader;
+const TElf32Program     *pProgram;
+unsigned long            Start = ~0UL;
+unsigned __int64         End   = 0;     // Up to 4 GiB (no 32 bits wrap)
+
+    pStream = new TFileStream(AFileName, fmOpenRead | fmShareDenyWrite);
+    try
+    {
+        File.resize((size_t)pStream->Size);
+        if (!File.empty())
+            pStream->ReadBuffer(&File[0], (int)File.size());
+    }
+    catch(...)
+    {
+        delete pStream;
+        throw;
+    }
+    delete pStream;
+
+    if (File.size() < sizeof(TElf32Header) || memcmp(&File[0], "\x7f" "ELF", 4))
+        throw Exception("Not an ELF file: " + AFileName);
+
+    pHeader = (const TElf32Header *)&File[0];
+
+    if (pHeader->e_ident[4] != ElfClass32 || pHeader->e_ident[5] != ElfData2LSB
+        || pHeader->e_type != ElfExec || pHeader->e_machine != ElfRiscV)
+            throw Exception("Not a RV32 executable: " + AFileName);
+
+    if (pHeader->e_phoff + (unsigned __int64)pHeader->e_phnum * sizeof(TElf32Program) > File.size())
+        throw Exception("Corrupted ELF program headers: " + AFileName);
+
+    pProgram = (const TElf32Program *)&File[pHeader->e_phoff];
+
+    // Image bounds: a segment wrapping past 4 GiB is rejected, not folded
+    // back to low addresses
+    for (int c=0; c<pHeader->e_phnum; c++)
+        if (pProgram[c].p_type == ElfLoad && pProgram[c].p_memsz) {
+            if (pProgram[c].p_offset + (unsigned __int64)pProgram[c].p_filesz > File.size()
+                || pProgram[c].p_filesz > pProgram[c].p_memsz
+                || pProgram[c].p_vaddr + (unsigned __int64)pProgram[c].p_memsz > 0x100000000ULL)
+                    throw Exception("Corrupted ELF segment: " + AFileName);
+
+            Start = std::min(Start, pProgram[c].p_vaddr);
+            End   = std::max(End,   pProgram[c].p_vaddr + (unsigned __int64)pProgram[c].p_memsz);
+        }
+
+    if (Start >= End || End - Start > ElfMaxImage)
+        throw Exception("Invalid ELF image size: " + AFileName);
+
+    FBase      = Start;
+    FEntry     = pHeader->e_entry - Start;
+    FTextStart = ~0UL;
+    FTextEnd   = 0;
+    FImage.assign((size_t)(End - Start), 0);
+
+    for (int c=0; c<pHeader->e_phnum; c++)
+        if (pProgram[c].p_type == ElfLoad && pProgram[c].p_memsz) {
+            memcpy(&FImage[pProgram[c].p_vaddr - Start], &File[pProgram[c].p_offset], pProgram[c].p_filesz);
+
+            if (pProgram[c].p_flags & ElfExecute) {
+                FTextStart = std::min(FTextStart, pProgram[c].p_vaddr - Start);
+                FTextEnd   = std::max(FTextEnd,   pProgram[c].p_vaddr - Start + pProgram[c].p_memsz);
+            }
+        }
+
+    if (FTextStart >= FTextEnd)
+        throw Exception("No executable segment: " + AFileName);
+
+    LoadSymbols(File);
+}
+//---------------------------------------------------------------------------
+
+void TElfImage::LoadCore(RiscV &ACPU, char *ApRam, unsigned long AcRam)
+{
+    if (FImage.empty() || AcRam < FImage.size())
+        throw Exception("Guest RAM smaller than the ELF image");
+
+    memcpy(ApRam, &FImage[0], FImage.size());
+    memset(ApRam + FImage.size(), 0, AcRam - FImage.size());
+
+    ACPU.Load(ApRam, AcRam, FEntry, AcRam, FTextStart, FTextEnd);
+    ACPU.HostWait = false;
+}
+//---------------------------------------------------------------------------
+
+void TElfImage::LoadCore(RiscV &ACPU, std::vector<char> &ARam, unsigned long AStackSize)
+{
+    ARam.resize(FImage.size() + AStackSize);     // Zeroed by LoadCore
+    LoadCore(ACPU, &ARam[0], (unsigned long)ARam.size());
+}
+//---------------------------------------------------------------------------
+
+// Symbol table is optional (stripped executables)
+void TElfImage::LoadSymbols(const std::vector<char> &AFile)
+{
+const TElf32Header  *pHeader = (const TElf32Header *)&AFile[0];
+const TElf32Section *pSection;
+const TElf32Symbol  *pSymbol;
+const TElf32Section *pStrings;
+unsigned long        cSymbols;
+
+    FSymbols.clear();
+
+    if (!pHeader->e_shoff || pHeader->e_shoff + (unsigned __int64)pHeader->e_shnum * sizeof(TElf32Section) > AFile.size())
+        return;
+
+    pSection = (const TElf32Section *)&AFile[pHeader->e_shoff];
+
+    for (int c=0; c<pHeader->e_shnum; c++) {
+        if (pSection[c].sh_type != ElfSymTab || pSection[c].sh_link >= pHeader->e_shnum)
+            continue;
+
+        pStrings = &pSection[pSection[c].sh_link];
+        if (pSection[c].sh_offset + (unsigned __int64)pSection[c].sh_size > AFile.size()
+            || pStrings->sh_offset + (unsigned __int64)pStrings->sh_size > AFile.size())
+                continue;
+
+        pSymbol  = (const TElf32Symbol *)&AFile[pSection[c].sh_offset];
+        cSymbols = pSection[c].sh_size / sizeof(TElf32Symbol);
+
+        for (unsigned long s=1; s<cSymbols; s++)
+            if (pSymbol[s].st_name < pStrings->sh_size
+                && pSymbol[s].st_shndx && pSymbol[s].st_shndx < ElfReserved) {
+                const char *pName = &AFile[pStrings->sh_offset + pSymbol[s].st_name];
+
+                if (*pName && memchr(pName, 0, pStrings->sh_size - pSymbol[s].st_name))
+                    FSymbols[pName] = pSymbol[s].st_value - FBase;
+            }
+    }
+}
+//---------------------------------------------------------------------------
+
+bool TElfImage::FindSymbol(const std::string &AName, unsigned long &AAddress)
+{
+std::map<std::string, unsigned long>::iterator Symbol = FSymbols.find(AName);
+
+    if (Symbol == FSymbols.end())
+        return false;
+
+    AAddress = Symbol->second;
+    return true;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,78 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef ElfUH
+#define ElfUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <map>
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+
+class RiscV;
+
+/*
+RV32 ELF executable image
+
+PT_LOAD segments are copied into one flat image rebased to address 0 (the
+emulator memory starts at 0): code built with -mcmodel=medany addresses
+everything PC-relative, so it runs unchanged. Entry point, .text range and
+symbols are rebased too.
+
+Headless runs load a core with LoadCore: the image at 0 of the guest RAM,
+the rest zeroed as stack, sp at the end of the RAM, no host waits (wfi in
+virtual time only).
+*/
+class TElfImage
+{
+    std::vector<char>                     FImage;
+    unsigned long                         FBase;        // Lowest PT_LOAD address (link address of image offset 0)
+    unsigned long                         FEntry;
+    unsigned long                         FTextStart;   // Executable segments
+    unsigned long                         FTextEnd;
+    std::map<std::string, unsigned long>  FSymbols;
+
+    void LoadSymbols(const std::vector<char> &AFile);
+
+    unsigned long getSize() { return (unsigned long)FImage.size(); }
+    const char   *getData() { return FImage.empty() ? NULL : &FImage[0]; }
+
+    const std::map<std::string, unsigned long> &getSymbols() { return FSymbols; }
+
+public:
+    TElfImage();
+
+    void LoadFromFile(const String &AFileName);
+    void LoadCore    (RiscV &ACPU, char *ApRam, unsigned long AcRam);
+    void LoadCore    (RiscV &ACPU, std::vector<char> &ARam, unsigned long AStackSize);    // ARam = image + AStackSize
+    bool FindSymbol  (const std::string &AName, unsigned long &AAddress);
+
+    __property unsigned long Base      = { read=FBase      };
+    __property unsigned long Entry     = { read=FEntry     };
+    __property unsigned long TextStart = { read=FTextStart };
+    __property unsigned long TextEnd   = { read=FTextEnd   };
+    __property unsigned long Size      = { read=getSize    };
+    __property const char   *Data      = { read=getData    };
+
+    // Name => rebased address (function, object and local labels alike)
+    __property const std::map<std::string, unsigned long> &Symbols = { read=getSymbols };
+};
+//---------------------------------------------------------------------------
+#endif
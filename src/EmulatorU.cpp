@@ -18,7 +18,23 @@
 
 //---------------------------------------------------------------------------
 #pragma hdrstop
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #include "EmulatorU.h"
+#include "CacheU.h"
+#include "CoverageU.h"
+#include "FuzzU.h"
+#include "GuardedMemoryU.h"
+#include "HistoryU.h"
+#include "PipelineU.h"
+#include "ProfilerU.h"
+#include "StateHashU.h"
 //---------------------------------------------------------------------------
 #pragma package(smart_init)
 //---------------------------------------------------------------------------
@@ -34,13 +50,47 @@ RiscV::RiscV()
 {
     FpMemory = NULL;
     FcMemory = 0;
+    FSparseMemory = false;
+    FpGuard       = NULL;
+    FStatistics   = false;
+    FpCaches      = NULL;
+    FpPipeline    = NULL;
+    FpProfiler    = NULL;
+    FpCoverage    = NULL;
+    FpFuzzer      = NULL;
+    FpStateHash   = NULL;
     FminText = 0;
     FmaxText = 0;
+    FPC      = 0;
+    FInstret = 0;
+    FpHistory  = NULL;
+    FMisa      = misaBase;
+    FLegalInsn = NULL;
+
+    FIdleSkip         = true;
+    FIdleInstructions = 0;
+    FIdleHead         = (unsigned long)-1;
+    FIdleInstret      = 0;
+    FIdleChanges      = 0;
+
+    FNativeLibcalls = false;
+
+    FClintMtime     = 0;
+    FClintUnmapped  = 0;
+    FTimerFrequency = 10000000;
+    FHostWait       = true;
+    ResetMachine();
 
     memset(FReg, 0, sizeof(FReg));
 }
 //---------------------------------------------------------------------------
 
+RiscV::~RiscV()
+{
+    delete FpHistory;
+}
+//---------------------------------------------------------------------------
+
 unsigned long RiscV::getRegister( int AIndex )
 {
     if (!AIndex) // zero
@@ -76,6 +126,172 @@ char * RiscV::getMemory(unsigned long AAddress)
 }
 //---------------------------------------------------------------------------
 
+// Same checks of getMemory() + access size
+char * RiscV::LoadPtr(unsigned long AAddress, int ASize)
+{
+char *pMemory;
+
+    if (AAddress - ClintBase < ClintSize)
+        pMemory = ClintPtr(AAddress - ClintBase, ASize, false);
+    else if (FpGuard)
+        pMemory = FpMemory + AAddress;      // Faults are caught by RunGuarded()
+    else if (AAddress >= FcMemory && FSparseMemory)
+        pMemory = SparsePtr(AAddress, ASize, false);
+    else {
+        pMemory = getMemory(AAddress);
+
+        if (AAddress + ASize > FcMemory)
+            throw Exception("Segmentation fault");
+    }
+
+    if (FpCaches && AAddress - ClintBase >= ClintSize)
+        FpCaches->Data(FPC, AAddress);
+
+    FBreakpoints.OnLoad(AAddress, ASize);
+
+    return pMemory;
+}
+//---------------------------------------------------------------------------
+
+char * RiscV::StorePtr(unsigned long AAddress, int ASize)
+{
+char *pMemory = AAddress - ClintBase < ClintSize ? ClintPtr(AAddress - ClintBase, ASize, true)
+                                                 : HostPtr(AAddress, ASize);
+
+    if (FpCaches && AAddress - ClintBase >= ClintSize)
+        FpCaches->Data(FPC, AAddress);
+
+    FBreakpoints.OnStore(AAddress, ASize);
+
+    return pMemory;
+}
+//---------------------------------------------------------------------------
+
+// Stores into .text take the checked path (stop)
+char * RiscV::StoreGuarded(unsigned long AAddress, int ASize)
+{
+    if (AAddress - FminText < FmaxText - FminText)
+        return StorePtr(AAddress, ASize);
+
+    return FpMemory + AAddress;
+}
+//---------------------------------------------------------------------------
+
+// Same checks of getMemory() + dirty page tracking for reverse execution,
+// fuzzing and state hashing, and dirty framebuffer tiles
+char * RiscV::HostPtr(unsigned long AAddress, int ASize)
+{
+char *pMemory;
+
+    if (FpGuard) {
+        if (AAddress - FminText < FmaxText - FminText)
+            throw Exception("Access to .text segment");
+
+        pMemory = FpMemory + AAddress;
+    }
+    else if (AAddress >= FcMemory && FSparseMemory)
+        pMemory = SparsePtr(AAddress, ASize, true);
+    else {
+        pMemory = getMemory(AAddress);
+
+        if (AAddress + ASize > FcMemory)
+            throw Exception("Segmentation fault");
+    }
+
+    if (FpHistory)
+        FpHistory->BeforeWrite(AAddress, ASize);
+
+    if (FpFuzzer)
+        FpFuzzer->BeforeWrite(AAddress, ASize);
+
+    if (FpStateHash)
+        FpStateHash->BeforeWrite(AAddress, ASize);
+
+    FFramebuffer.OnStore(AAddress, ASize);
+
+    return pMemory;
+}
+//---------------------------------------------------------------------------
+
+// CLINT register under a guest load/store (little endian host). The CLINT
+// state is part of FMachine: checkpoints cover it, no undo log needed
+char * RiscV::ClintPtr(unsigned long AOffset, int ASize, bool AStore)
+{
+    if (FStatistics)
+        FStats.Mmio++;
+
+    if (AOffset & (ASize - 1))
+        throw Exception("Misaligned CLINT access");
+
+    if (AStore)
+        FInterruptAt = 0;   // Deadline may change: checked on next block entry
+
+    if (AOffset >= ClintMtimecmp && AOffset < ClintMtimecmp + 8)
+        return (char *)&FMachine.Mtimecmp + (AOffset - ClintMtimecmp);
+
+    // The word read is a device input: replayed by reverse execution
+    if (AOffset >= ClintMtime && AOffset < ClintMtime + 8 && !AStore) {
+        FClintMtime = 0;
+        ((unsigned long *)&FClintMtime)[(AOffset - ClintMtime) / 4] = DeviceRead((unsigned long)(getTime() >> ((AOffset - ClintMtime) / 4 * 32)));
+        FIdleHead   = (unsigned long)-1;    // A loop reading the time is not idle
+        return (char *)&FClintMtime + (AOffset - ClintMtime);
+    }
+
+    if (AOffset < ClintMsip + 4)
+        return (char *)&FMachine.Msip + AOffset;
+
+    FClintUnmapped = 0;
+    return (char *)&FClintUnmapped;
+}
+//---------------------------------------------------------------------------
+
+// Sparse memory: loads of pages never written read the shared zero page
+char * RiscV::SparsePtr(unsigned long AAddress, int ASize, bool AStore)
+{
+    if ((AAddress & (PageSize - 1)) + ASize > PageSize)
+        throw Exception("Access across sparse memory pages");
+
+    return AStore ? FSparse.WritePtr(AAddress) : (char *)FSparse.ReadPtr(AAddress);
+}
+//---------------------------------------------------------------------------
+
+bool RiscV::InMemory(unsigned long AAddress, unsigned long ASize)
+{
+    if (FpGuard)
+        return FpGuard->IsMapped(AAddress, ASize);
+
+    if (FSparseMemory)
+        return !ASize || AAddress + (ASize - 1) >= AAddress;   // No wrap around
+
+    return AAddress <= FcMemory && ASize <= FcMemory - AAddress;
+}
+//---------------------------------------------------------------------------
+
+void RiscV::RawRead(unsigned long AAddress, void *ApData, unsigned long ASize)
+{
+unsigned long cDense = AAddress < FcMemory ? std::min(ASize, FcMemory - AAddress) : 0;
+
+    if (cDense)
+        memcpy(ApData, FpMemory + AAddress, cDense);
+
+    FSparse.Read(AAddress + cDense, (char *)ApData + cDense, ASize - cDense);
+}
+//---------------------------------------------------------------------------
+
+void RiscV::RawWrite(unsigned long AAddress, const void *ApData, unsigned long ASize)
+{
+unsigned long cDense = AAddress < FcMemory ? std::min(ASize, FcMemory - AAddress) : 0;
+
+    if (cDense)
+        memcpy(FpMemory + AAddress, ApData, cDense);
+
+    FSparse.Write(AAddress + cDense, (const char *)ApData + cDense, ASize - cDense);
+
+    if (FpStateHash && ASize)
+        FpStateHash->BeforeWrite(AAddress, ASize);
+}
+//---------------------------------------------------------------------------
+
 void RiscV::Load
 (
     char         *ApMemory,
@@ -86,12 +302,56 @@ void RiscV::Load
     unsigned long ATextSegmentEnd
 )
 {
+    if (ATextSegmentEnd > AcMemory)
+        throw Exception(".text segment outside memory");
+
+    if (!FpGuard && AcMemory > ClintBase)
+        throw Exception("Memory overlaps the CLINT registers (0x02000000)");
+
+    if (FpGuard && ApMemory != FpGuard->Base)
+        throw Exception("Guarded memory: load at its base");
+
+    // Guarded: CLINT accesses must fault to reach ClintPtr()
+    if (FpGuard && FpGuard->Overlaps(ClintBase, ClintSize))
+        throw Exception("Guarded memory: CLINT registers (0x02000000) mapped");
+
     FpMemory = ApMemory;
     FcMemory = AcMemory;
+    FSparse.Clear();
     FminText = ATextSegmentStart;
     FmaxText = ATextSegmentEnd;
     FPC      = AInitialPC;
+
+    FBreakpoints.SetTextSegment(ATextSegmentStart, ATextSegmentEnd);
+    FCfg.Build(ApMemory, ATextSegmentStart, ATextSegmentEnd, AInitialPC, FLegalInsn);
+    FLibcalls.Build(ApMemory, ATextSegmentStart, ATextSegmentEnd);
+
+    if (FpCaches)
+        FpCaches->SetText(ATextSegmentStart, ATextSegmentEnd);
+
+    if (FpPipeline)
+        FpPipeline->Clear();
+
+    if (FpProfiler)
+        FpProfiler->Reset(AInitialPC);
+
+    if (FpCoverage)
+        FpCoverage->SetText(ApMemory, ATextSegmentStart, ATextSegmentEnd);
+
+    FFramebuffer.SetMemory(ApMemory, AcMemory);
+
+    if (FpStateHash)
+        FpStateHash->Clear();
+
+    FInstret = 0;
     Reg[sp]  = AStackPointer;
+
+    FIdleInstructions = 0;
+    FStats.Clear();
+    ResetMachine();
+
+    if (FpHistory)
+        FpHistory->Clear();
 }
 //---------------------------------------------------------------------------
 
@@ -100,7 +360,19 @@ void RiscV::Reset(unsigned long AInitialPC, unsigned long AStackPointer)
     memset(FReg, 0, sizeof(FReg));
 
     FPC      = AInitialPC;
+    FInstret = 0;
     Reg[sp]  = AStackPointer;
+
+    FIdleInstructions = 0;
+    FStats.Clear();
+    FLibcalls.ClearHits();
+    ResetMachine();
+
+    if (FpProfiler)
+        FpProfiler->Reset(AInitialPC);
+
+    if (FpHistory)
+        FpHistory->Clear();
 }
 //---------------------------------------------------------------------------
 
@@ -109,479 +381,1384 @@ void RiscV::GoTo(unsigned long APC)
     if (!FpMemory || !FcMemory)
         throw Exception("Program non loaded");
 
-    if (APC < FminText || FPC >= FmaxText)
+    if (APC < FminText || APC >= FmaxText)
         throw Exception("Invalid offset");
 
     FPC = APC;
+
+    if (FpHistory)
+        FpHistory->Clear();
 }
 //---------------------------------------------------------------------------
 
 void RiscV::Step()
 {
+unsigned long InsnPC;
+
     if (!FpMemory || !FcMemory)
         throw Exception("Program non loaded");
 
     if (FPC < FminText || FPC >= FmaxText)
         throw Exception("Segmentation fault");
 
-    Process();
-    FPC += sizeof(long);
-}
-//---------------------------------------------------------------------------
+    if (FPC & 0x3)
+        throw Exception("Instruction address misaligned");
 
-void RiscV::Process()
-{
-unsigned long iInstruction = Instruction;
-String hInstruction;
+    // Same interrupt points of the run loop, a sleeping hart wakes at once
+    if (FInstret >= FInterruptAt && FCfg.IsBlockEntry(FPC)) {
+        CheckInterrupts();
 
-    hInstruction.SetLength(sizeof(unsigned long)*2);
-    BinToHex( &iInstruction, hInstruction.c_str(), sizeof(unsigned long) );
+        if (FMachine.Wfi && (FMachine.Mie & mipMTIP) && FMachine.Mtimecmp != (unsigned __int64)-1) {
+            SleepUntilInterrupt((unsigned long)-1, false);
+            CheckInterrupts();
+        }
 
-    throw Exception( String("Illegal instruction at PC ") + PC + " (" + hInstruction + ")" );
-}
-//---------------------------------------------------------------------------
+        if (FMachine.Wfi)
+            return;         // Nothing can wake it
 
+        if (FPC < FminText || FPC >= FmaxText || (FPC & 0x3))
+            throw Exception("Invalid trap vector");
+    }
 
-/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+    if (FpHistory)
+        FpHistory->BeforeStep();
 
-   RISC-V RV32I implementation
+    if (NativeLibcallsOn() && FLibcalls.At(FPC) && !FBreakpoints.IsBreakpoint(FPC)) {
+        NativeCall();
+        return;
+    }
 
- * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    InsnPC = FPC;
 
-bool RiscV_RV32I::Decode()
-{
-    switch(Instruction & 0x7F)
-    {
-        case R_type:        DecodeFunct_7();  Execute_R     ();  break;
-        case I_bits_type:   DecodeImm_I  ();  Execute_I_bits();  break;
-        case I_load_type:   DecodeImm_I  ();  Execute_I_load();  break;
-        case S_type:        DecodeImm_S  ();  Execute_S     ();  break;
-        case B_type:        DecodeImm_B  ();  Execute_B     ();  break;
-        case lui:           DecodeImm_U  ();  Execute_lui   ();  break;
-        case auipc:         DecodeImm_U  ();  Execute_auipc ();  break;
-        case jal:           DecodeImm_J  ();  Execute_jal   ();  break;
-        case jalr:          DecodeImm_I  ();  Execute_jalr  ();  break;
-        case ecall_ebreak:  DecodeImm_U  ();  Execute_ecall_ebreak();  break;
-        case fence:                           Execute_fence ();  break;
-        default:
-            return false;
-    }
-    return true;
-}
-//---------------------------------------------------------------------------
+    if (FpCaches)
+        FpCaches->Fetch(FPC);
 
-void RiscV_RV32I::Process()
-{
-    if( !Decode() )            // true => Instruction decoded successfully (for the current arch)
-        inherited::Process();  //         and ready to be executed
+    if (FpGuard)
+        ProcessGuarded();
+    else
+        Process();
+
+    if (FStatistics)
+        FStats.Retire(*(unsigned long *)(FpMemory + InsnPC), FPC != InsnPC);
+
+    if (FpPipeline)
+        FpPipeline->Retire(InsnPC, *(unsigned long *)(FpMemory + InsnPC), FPC != InsnPC);
+
+    if (FpCoverage)
+        FpCoverage->Retire(InsnPC, FPC != InsnPC);
+
+    FPC += sizeof(long);
+    FInstret++;
+
+    if (FpProfiler && FCfg.Remaining(InsnPC) == 1)
+        FpProfiler->AfterBlock(InsnPC, *(unsigned long *)(FpMemory + InsnPC), FPC, FInstret);
+
+    if (FpFuzzer && FCfg.Remaining(InsnPC) == 1)
+        FpFuzzer->Edge(FPC);
 }
 //---------------------------------------------------------------------------
 
+void RiscV::setCaches(TRiscVCaches *ApCaches)
+{
+    FpCaches = ApCaches;
 
-//---------------------------------------------------------------------------
-// RV32I decoders
+    if (FpCaches)
+        FpCaches->SetText(FminText, FmaxText);
+}
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::DecodeFunct_7()
-{
-// InsnFunct_7: funct7 rs2 rs1 funct3 rd opcode
-union
+RiscV::StopReason RiscV::Run(unsigned long ACount, bool AResume)
 {
-    unsigned long packed;
-    struct
-    {
-        unsigned opcode:7; // 6..0
-        unsigned rd    :5; // 11..7
-        unsigned funct3:3; // 14..12
-        unsigned rs1   :5; // 19..15
-        unsigned rs2   :5; // 24..20
-        unsigned funct7:7; // 31..25
-    } str;
-} InsnFunct_7;
-
+std::chrono::steady_clock::time_point Start;
+StopReason                            Reason;
 
+    if (!FStatistics)
+        return FpGuard ? RunGuarded(ACount, AResume) : RunChecked(ACount, AResume);
 
-    InsnFunct_7.packed = Instruction;
+    Start  = std::chrono::steady_clock::now();
+    Reason = FpGuard ? RunGuarded(ACount, AResume) : RunChecked(ACount, AResume);
+    FStats.RunEnded(std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
 
-    Ffunct  = (InsnFunct_7.str.funct7 << 3) | InsnFunct_7.str.funct3;
-    Frs1    =  InsnFunct_7.str.rs1;
-    Frs2    =  InsnFunct_7.str.rs2;
-    Frd     =  InsnFunct_7.str.rd;
-    Fopcode =  InsnFunct_7.str.opcode;   // Extracted but unused
+    return Reason;
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::DecodeImm_I()
+// Called by the RunChecked() of the configuration ACore
+template<class ACore>
+RiscV::StopReason RiscV::RunCore(unsigned long ACount, bool AResume)
 {
-// InsnImm_I: imm[12] rs1 funct3 rd opcode
-union
+    return FStatistics ? RunPolicy<ACore, TRiscVStatsOn> (ACount, AResume)
+                       : RunPolicy<ACore, TRiscVStatsOff>(ACount, AResume);
+}
+//---------------------------------------------------------------------------
+
+// Run loop flag AFlag (RunFlag) of the current setup
+bool RiscV::RunFlagOn(int AFlag)
 {
-    unsigned long packed;
-    struct
-    {
-        unsigned opcode:7;  // 6..0
-        unsigned rd    :5;  // 11..7
-        unsigned funct3:3;  // 14..12
-        unsigned rs1   :5;  // 19..15
-        unsigned imm   :12; // 31..20
-    } str;
-} InsnImm_I;
+    switch (AFlag) {
+        case runBreakpoints:
+            return FBreakpoints.BreakpointCount != 0;
 
+        case runWatchpoints:
+            return FBreakpoints.WatchpointCount != 0;
 
+        case runInsnHooks:
+            return FpHistory || FpCaches || FpPipeline || FpCoverage;
 
-    InsnImm_I.packed = Instruction;
+        case runBlockHooks:
+            return NativeLibcallsOn() || FIdleSkip || FpProfiler || FpFuzzer;
 
-    Fimm    = InsnImm_I.str.imm; // 12 bits
-    Frs1    = InsnImm_I.str.rs1;
-    Frs2    = -1;                     // Illegal value (only for debugging purposes)
-    Ffunct  = InsnImm_I.str.funct3;
-    Frd     = InsnImm_I.str.rd;
-    Fopcode = InsnImm_I.str.opcode;   // Extracted but unused
+        case runGuarded:    // Nothing to check or track on loads/stores
+            return FpGuard && !FBreakpoints.WatchpointCount && !RunFlagOn(runInsnHooks) &&
+                   !FpFuzzer && !FpStateHash && !FFramebuffer.Enabled;
+    }
 
-    // Immediate sing fixup
-    if (Fimm & 0x800)   // Sign bit (minus)
-        Fimm |= ~0xFFF; // 1-bitwise OR on 31..12
+    return true;
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::DecodeImm_S()
+// Checks not needed are compiled out: one flag (RunFlag order) appended
+// per instance level, the RunLoop() of all the flags at the last one
+template<class ACore, class AStats, bool... AFlags>
+RiscV::StopReason RiscV::RunPolicy(unsigned long ACount, bool AResume)
 {
-// InsnImm_S: imm[11:5] rs2 rs1 funct3 imm[4:0] opcode
-union
+    if constexpr (sizeof...(AFlags) == runFlagCount)
+        return RunLoop<ACore, AStats, AFlags...>(ACount, AResume);
+    else
+        return RunFlagOn(sizeof...(AFlags)) ? RunPolicy<ACore, AStats, AFlags..., true> (ACount, AResume)
+                                            : RunPolicy<ACore, AStats, AFlags..., false>(ACount, AResume);
+}
+//---------------------------------------------------------------------------
+
+// Guarded memory: a guest access outside the mapped regions comes back
+// here from the fault handler with the state before the faulting insn,
+// that is executed again with the checks (CLINT registers, or the guest
+// fault). The budget left is measured on guest time, that advances 1 tick
+// per insn/idle insn skipped/tick slept as the loop counter does
+RiscV::StopReason RiscV::RunGuarded(unsigned long ACount, bool AResume)
 {
-    unsigned long packed;
-    struct
-    {
-        unsigned opcode :7;  // 6..0
-        unsigned imm4_0 :5;  // 11..7
-        unsigned funct3 :3;  // 14..12
-        unsigned rs1    :5;  // 19..15
-        unsigned rs2    :5;  // 24..20
-        unsigned imm11_5:7;  // 31..25
-    } str;
-} InsnImm_S;
+unsigned __int64 Start = getTime();
+StopReason       Reason;
+bool             Done;
+
+    for (;;) {
+        FpGuard->Arm();
 
+        try {
+            Done = RunArmed(ACount - (unsigned long)(getTime() - Start), AResume, Reason);
+        }
+        catch (...) {
+            FpGuard->Disarm();
+            throw;
+        }
 
+        FpGuard->Disarm();
 
-    InsnImm_S.packed = Instruction;
+        if (Done)
+            return Reason;
 
-    Fimm    = (InsnImm_S.str.imm11_5<<5) | InsnImm_S.str.imm4_0; // 7 + 5 = 12 bits
-    Frs1    = InsnImm_S.str.rs1;
-    Frs2    = InsnImm_S.str.rs2;
-    Ffunct  = InsnImm_S.str.funct3;
-    Frd     = -1;                     // Illegal value (only for debugging purposes)
-    Fopcode = InsnImm_S.str.opcode;   // Extracted but unused
+        Step();
+        AResume = false;
 
-    // Immediate sing fixup
-    if (Fimm & 0x800)   // Sign bit (minus)
-        Fimm |= ~0xFFF; // 1-bitwise OR on 31..12
+        if (getTime() - Start >= ACount)
+            return stopCount;
+    }
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::DecodeImm_B()
-{
-// InsnImm_B: imm[12] imm[10:5] rs2 rs1 funct3 imm[4:1] imm[11] opcode
-// Note: Immediate is always even (i.e. bit0 always set to 0)
-union
+void RiscV::ProcessGuarded()
 {
-    unsigned long packed;
-    struct
-    {
-        unsigned opcode :7; // 6..0
-        unsigned imm11  :1; // 7
-        unsigned imm4_1 :4; // 11..8
-        unsigned funct3 :3; // 14..12
-        unsigned rs1    :5; // 19..15
-        unsigned rs2    :5; // 24..20
-        unsigned imm10_5:6; // 30..25
-        unsigned imm12  :1; // 31
-    } str;
-} InsnImm_B;
+bool Done;
+
+    FpGuard->Arm();
 
+    try {
+        Done = ProcessArmed();
+    }
+    catch (...) {
+        FpGuard->Disarm();
+        throw;
+    }
 
+    FpGuard->Disarm();
 
-    InsnImm_B.packed = Instruction;
+    if (!Done)
+        GuestFault(FpGuard->FaultAddress);
+}
+//---------------------------------------------------------------------------
 
-    Fimm    = (InsnImm_B.str.imm12<<12) | (InsnImm_B.str.imm11<<11) | (InsnImm_B.str.imm10_5<<5) | (InsnImm_B.str.imm4_1<<1);
-    Frs1    = InsnImm_B.str.rs1;
-    Frs2    = InsnImm_B.str.rs2;
-    Ffunct  = InsnImm_B.str.funct3;
-    Frd     = -1;                     // Illegal value (only for debugging purposes)
-    Fopcode = InsnImm_B.str.opcode;   // Extracted but unused
+#ifdef _WIN32
+// No C++ objects or try blocks next to __try: the armed call only
+bool RiscV::RunArmed(unsigned long ACount, bool AResume, StopReason &AReason)
+{
+    __try {
+        AReason = RunChecked(ACount, AResume);
+    }
+    __except (FpGuard->Filter(GetExceptionInformation())) {
+        return false;
+    }
 
-    // Immediate sing fixup
-    if (Fimm & 0x1000)   // Minus
-        Fimm |= ~0x1FFF; // 1-OR on 31..13
+    return true;
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::DecodeImm_U()
+bool RiscV::ProcessArmed()
 {
-// InsnImm_U: imm[20] rd opcode
-union
+    __try {
+        Process();
+    }
+    __except (FpGuard->Filter(GetExceptionInformation())) {
+        return false;
+    }
+
+    return true;
+}
+#else
+// No guarded memory off Windows (TRiscVGuardedMemory::Supported()): never
+// armed, plain calls
+bool RiscV::RunArmed(unsigned long ACount, bool AResume, StopReason &AReason)
 {
-    unsigned long packed;
-    struct
-    {
-        unsigned opcode:7;  // 6..0
-        unsigned rd    :5;  // 11..7
-        unsigned imm   :20; // 31..12
-    } str;
-} InsnImm_U;
+    AReason = RunChecked(ACount, AResume);
 
+    return true;
+}
+//---------------------------------------------------------------------------
 
+bool RiscV::ProcessArmed()
+{
+    Process();
 
-    InsnImm_U.packed = Instruction;
+    return true;
+}
+#endif
+//---------------------------------------------------------------------------
 
-    Fimm    = InsnImm_U.str.imm;
-    Frs1    = -1;                     // Illegal value (only for debugging purposes)
-    Frs2    = -1;                     // Illegal value (only for debugging purposes)
-    Ffunct  = -1;                     // Illegal value (only for debugging purposes)
-    Frd     = InsnImm_U.str.rd;
-    Fopcode = InsnImm_U.str.opcode;   // Extracted but unused
+// Guarded memory fault of the insn at PC (not executed): access fault trap
+// (handler PC - 4, as RaiseTrap()) or the same stop of the checked memory
+void RiscV::GuestFault(unsigned long AAddress)
+{
+    if (!HasTrapHandler())
+        throw Exception("Segmentation fault");
 
-    // Immediate sing fixup
-    if (Fimm & 0x80000)   // Minus
-        Fimm |= ~0xFFFFF; // 1-bitwise OR on 31..20
+    RaiseTrap((getInstruction() & 0x7F) == 0x23 ? causeStoreAccessFault : causeLoadAccessFault, AAddress);
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::DecodeImm_J()
+// Executes a basic block at a time: the PC is validated on block entry
+// only, the following insns of the block are straight-line code
+template<class ACore, class AStats, bool ABreakpoints, bool AWatchpoints, bool AInsnHooks, bool ABlockHooks, bool AGuarded>
+RiscV::StopReason RiscV::RunLoop(unsigned long ACount, bool AResume)
 {
-// InsnImm_J: imm[20] imm[10:1] imm[11] imm[19:12] rd opcode
-// Note: Immediate is always even (i.e. bit0 always set to 0)
-union
-{
-    unsigned long packed;
-    struct
-    {
-        unsigned opcode  :7;  // 6..0
-        unsigned rd      :5;  // 11..7
-        unsigned imm19_12:8;  // 19..12
-        unsigned imm11   :1;  // 20
-        unsigned imm10_1 :10; // 30..21
-        unsigned imm20   :1;  // 31
-    } str;
-} InsnImm_J;
+unsigned long c = 0;
+unsigned long cBlock;
+unsigned long cSkipped;
+unsigned long InsnPC;
 
+    if (!FpMemory || !FcMemory)
+        throw Exception("Program non loaded");
 
-    InsnImm_J.packed = Instruction;
+    FBreakpoints.ResetHit();
+    FIdleHead = (unsigned long)-1;  // Memory may be changed by the host since last run
 
-    Fimm    = (InsnImm_J.str.imm20<<20) | (InsnImm_J.str.imm19_12<<12) | (InsnImm_J.str.imm11<<11) | (InsnImm_J.str.imm10_1<<1);
-    Frs1    = -1;                     // Illegal value (only for debugging purposes)
-    Frs2    = -1;                     // Illegal value (only for debugging purposes)
-    Ffunct  = -1;                     // Illegal value (only for debugging purposes)
-    Frd     = InsnImm_J.str.rd;
-    Fopcode = InsnImm_J.str.opcode;   // Extracted but unused
+    while (c < ACount) {
+        // Interrupts on block entry only (FInterruptAt: nothing to do before)
+        if (FInstret >= FInterruptAt && FCfg.IsBlockEntry(FPC)) {
+            if (CheckInterrupts())
+                AResume = false;    // PC moved to the trap handler
 
-    // Immediate sing fixup
-    if (Fimm & 0x100000)   // Minus
-        Fimm |= ~0x1FFFFF; // 1-OR on 31..21
-}
-//---------------------------------------------------------------------------
+            if (FMachine.Wfi) {
+                c += SleepUntilInterrupt(ACount - c, FHostWait);
 
+                if (CheckInterrupts())
+                    AResume = false;
+                else if (FMachine.Wfi)
+                    return stopWait;
 
+                continue;           // Budget may be over
+            }
+        }
 
-//---------------------------------------------------------------------------
-// Illegal function
-//---------------------------------------------------------------------------
+        if (FPC < FminText || FPC >= FmaxText)
+            throw Exception("Segmentation fault");
 
-void RiscV_RV32I::Execute_IllegalFunction()
-{
-unsigned int   iInstruction = Instruction;
-UnicodeString  hInstruction;
-unsigned short iFunct       = funct;
-UnicodeString  hFunct;
+        if (FPC & 0x3)
+            throw Exception("Instruction address misaligned");
 
-    hInstruction.SetLength(8);
-    BinToHex( &iInstruction, hInstruction.c_str(), hInstruction.Length()*2 );
+        if (ABlockHooks && NativeLibcallsOn() && FLibcalls.At(FPC) && !(ABreakpoints && FBreakpoints.IsBreakpoint(FPC))) {
+            if (AInsnHooks && FpHistory)
+                FpHistory->BeforeStep();
 
-    hFunct.SetLength(4);
-    BinToHex( &iFunct, hFunct.c_str(), hFunct.Length()*2 );
+            NativeCall();
+            c++;
+            continue;
+        }
 
-    throw Exception( UnicodeString("RiscV_RV32I::Execute_IllegalFunction - Illegal funct ") + hFunct + " at PC " + hInstruction );
-}
-//---------------------------------------------------------------------------
+        cBlock = FCfg.Remaining(FPC);
 
+        if (ABlockHooks && FIdleSkip && !(AInsnHooks && FpHistory) && FCfg.LoopAt(FPC) != TRiscVCfg::loopNone) {
+            InsnPC   = FPC;     // Loop start
+            cSkipped = SkipIdleLoop(FCfg.LoopAt(FPC), cBlock, ACount - c);
+            if (cSkipped) {
+                AStats::Skip(FStats, cSkipped);
 
+                if (AInsnHooks && FpCoverage)
+                    FpCoverage->Loop(InsnPC, cBlock, FPC);
 
-//---------------------------------------------------------------------------
-// RV32I executors
-//---------------------------------------------------------------------------
+                c += cSkipped;
+                continue;
+            }
+        }
 
-void RiscV_RV32I::Execute_R()
-{
-    switch (funct)
-    {
-        case R_add:     Reg[rd] = (long)Reg[rs1] +  (long)Reg[rs2];    break; // signed op
-        case R_mul:     Reg[rd] = (long)Reg[rs1] *  (long)Reg[rs2];    break; // signed op
-        case R_sub:     Reg[rd] = (long)Reg[rs1] -  (long)Reg[rs2];    break; // signed op
-        case R_slt:     Reg[rd] = (long)Reg[rs1] <  (long)Reg[rs2];    break; // signed op
-        case R_sltu:    Reg[rd] =       Reg[rs1] <        Reg[rs2];    break; // unsigned op
-        case R_and:     Reg[rd] =       Reg[rs1] &        Reg[rs2];    break;
-        case R_or:      Reg[rd] =       Reg[rs1] |        Reg[rs2];    break;
-        case R_xor:     Reg[rd] =       Reg[rs1] ^        Reg[rs2];    break;
-
-        case R_ssl:     Reg[rd] =       Reg[rs1] <<       Reg[rs2];    break;
-        case R_srl:     Reg[rd] =       Reg[rs1] >>       Reg[rs2];    break; // unsigned op
-        case R_sra:     Reg[rd] = (long)Reg[rs1] >>       Reg[rs2];    break; // signed op
-
-        case R_mulh:    Reg[rd] = ( (int64_t)(long)Reg[rs1] *  (int64_t)(long)Reg[rs2]) >> 32;    break; // signed op
-        case R_mulhu:   Reg[rd] = ((uint64_t)      Reg[rs1] * (uint64_t)      Reg[rs2]) >> 32;    break; // signed op
-        case R_mulhsu:  Reg[rd] = ( (int64_t)(long)Reg[rs1] * (uint64_t)      Reg[rs2]) >> 32;    break; // signed op
-
-
-        case R_div:
-            if( !Reg[rs2] )
-                Reg[rd] = -1;       // Division by 0 returns -1
-            else if((Reg[rs1] & 0x80000000) && (long)Reg[rs2] == -1)
-                Reg[rd] = Reg[rs1]; // Division overflow returns source reg.
-            else
-                Reg[rd] = (long)Reg[rs1] / (long)Reg[rs2];
-            break;
+        if (cBlock > ACount - c)
+            cBlock = ACount - c;
 
-        case R_divu:
-            if( !Reg[rs2] )
-                Reg[rd] = ~0UL;
-            else
-                Reg[rd] = Reg[rs1] / Reg[rs2];
-            break;
+        for (; cBlock; cBlock--, c++) {
+            if (ABreakpoints && FBreakpoints.IsBreakpoint(FPC) && !(AResume && !c))
+                return stopBreakpoint;
 
+            if (AInsnHooks && FpHistory)
+                FpHistory->BeforeStep();
 
-        case R_rem:
-            if( !Reg[rs2] )
-                Reg[rd] = Reg[rs1]; // Reminder overflow returns 0
-            else if((Reg[rs1] & 0x80000000) && (long)Reg[rs2] == -1)
-                Reg[rd] = 0;        // Reminder overflow returns 0
-            else
-                Reg[rd] = (long)Reg[rs1] % (long)Reg[rs2];
-            break;
+            InsnPC = FPC;
 
-        case R_remu:
-            if( !Reg[rs2] )
-                Reg[rd] = Reg[rs1];
+            if (AInsnHooks && FpCaches)
+                FpCaches->Fetch(FPC);
+
+            if (AGuarded)
+                static_cast<ACore *>(this)->ACore::ProcessGuardedMemory();
             else
-                Reg[rd] = Reg[rs1] % Reg[rs2];
-            break;
+                static_cast<ACore *>(this)->ACore::Process();
+            AStats::Retire(FStats, *(unsigned long *)(FpMemory + InsnPC), FPC != InsnPC);
 
-        default:
-            Execute_IllegalFunction();
-    }
-}
-//---------------------------------------------------------------------------
+            if (AInsnHooks && FpPipeline)
+                FpPipeline->Retire(InsnPC, *(unsigned long *)(FpMemory + InsnPC), FPC != InsnPC);
 
-void RiscV_RV32I::Execute_I_bits()
-{
-    switch (funct)
-    {
-        case I_addi:        Reg[rd] = Reg[rs1] + imm;     break;
-        case I_xori:        Reg[rd] = Reg[rs1] ^ imm;     break;
-        case I_ori:         Reg[rd] = Reg[rs1] | imm;     break;
-        case I_andi:        Reg[rd] = Reg[rs1] & imm;     break;
-        case I_slli:        Reg[rd] = Reg[rs1] << (imm & 0x1F); break;  // (imm & 0x1F) = shamt
-        case I_srli_srai:                                                 // shamt
-                 if ( (imm & 0xFE0) == 0x400) Reg[rd] = ((long)Reg[rs1]) >> (imm & 0x1F);  // imm[11:5] = 0x20 => srai
-            else if (!(imm & 0xFE0))          Reg[rd] =        Reg[rs1]  >> (imm & 0x1F);  // imm[11:5] = 0x00 => srli
-            else
-                Execute_IllegalFunction();
-            break;
-        case I_slti:        Reg[rd] = (long)Reg[rs1] <                imm;  break;
-        case I_sltiu:       Reg[rd] =       Reg[rs1] < (unsigned long)imm;  break;
-        default:
-            Execute_IllegalFunction();
-            break;
-    }
-}
-//---------------------------------------------------------------------------
+            if (AInsnHooks && FpCoverage)
+                FpCoverage->Retire(InsnPC, FPC != InsnPC);
 
-void RiscV_RV32I::Execute_I_load()
-{
-// Memory pointer is signed char so no sign extension needed
-// RISC-V is little-endian arch so no byte swap needed
-    switch( funct )
-    {
-        case I_lb:    Reg[rd] =                    *Memory[Reg[rs1] + imm];   break;
-        case I_lh:    Reg[rd] =          *(short *)(Memory[Reg[rs1] + imm]);  break;
-        case I_lw:    Reg[rd] =           *(long *)(Memory[Reg[rs1] + imm]);  break;
-        case I_lbu:   Reg[rd] =  *(unsigned char *)(Memory[Reg[rs1] + imm]);  break;
-        case I_lhu:   Reg[rd] = *(unsigned short *)(Memory[Reg[rs1] + imm]);  break;
+            FPC += sizeof(long);
+            FInstret++;
 
-        default:
-            Execute_IllegalFunction();
-    }
-}
-//---------------------------------------------------------------------------
+            if (AWatchpoints && FBreakpoints.WatchHit)
+                return stopWatchpoint;
+        }
 
-void RiscV_RV32I::Execute_S()
-{
-// Memory pointer is signed char so no sign extension needed
-// RISC-V is little-endian arch so no byte swap needed
-    switch( funct )
-    {
-        case S_sb:              *Memory[Reg[rs1] + imm]  = (char) Reg[rs2];   break;
-        case S_sh:    *(short *)(Memory[Reg[rs1] + imm]) = (short)Reg[rs2];   break;
-        case S_sw:     *(long *)(Memory[Reg[rs1] + imm]) = (long) Reg[rs2];   break;
-        default:
-            Execute_IllegalFunction();
+        // Block exits only: calls and returns end blocks, edges join blocks
+        if (ABlockHooks && FpProfiler && FCfg.Remaining(InsnPC) == 1)
+            FpProfiler->AfterBlock(InsnPC, *(unsigned long *)(FpMemory + InsnPC), FPC, FInstret);
+
+        if (ABlockHooks && FpFuzzer && FCfg.Remaining(InsnPC) == 1)
+            FpFuzzer->Edge(FPC);
     }
+
+    return stopCount;
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::Execute_B()
+// PC = libgcc routine entry: the whole call as one insn, a block exit
+// returning to ra
+void RiscV::NativeCall()
 {
-    switch( funct )
-    {
-        case B_beq:   if (Reg[rs1] == Reg[rs2]) FPC += imm - sizeof(long);   break; // Unsigned comp.
-        case B_bne:   if (Reg[rs1] != Reg[rs2]) FPC += imm - sizeof(long);   break; // Unsigned comp.
-        case B_blt:   if ( ((long)Reg[rs1]) <  ((long)Reg[rs2]) ) FPC += imm - sizeof(long);   break; // Signed comp.
+unsigned long ReturnPC = FReg[ra] & ~1UL;
 
-        case B_bge:   if ( ((long)Reg[rs1]) >= ((long)Reg[rs2]) ) FPC += imm - sizeof(long);   break; // Signed comp.
-        case B_bltu:  if (Reg[rs1] <  Reg[rs2]) FPC += imm - sizeof(long);   break; // Unsigned comp.
-        case B_bgeu:  if (Reg[rs1] >= Reg[rs2]) FPC += imm - sizeof(long);   break; // Unsigned comp.
+    FLibcalls.Execute(FLibcalls.At(FPC), FReg[a0], FReg[a1]);
 
-        default:
-            Execute_IllegalFunction();
-    }
-}
-//---------------------------------------------------------------------------
+    if (FpProfiler)
+        FpProfiler->AfterBlock(FPC, TRiscVLibcalls::RetInsn, ReturnPC, FInstret + 1);
 
-void RiscV_RV32I::Execute_lui()
-{
-    Reg[rd] = imm << 12; // Signed op
-}
-//---------------------------------------------------------------------------
+    FPC = ReturnPC;
+    FInstret++;
 
-void RiscV_RV32I::Execute_auipc()
-{
-    Reg[rd] = PC + (imm << 12);
+    if (FpFuzzer)
+        FpFuzzer->Edge(FPC);
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::Execute_jal()
+// Called on an idle loop start (PC = loop start): returns insns skipped
+// (0 => execute the loop normally)
+unsigned long RiscV::SkipIdleLoop(TRiscVCfg::BlockLoop ALoop, unsigned long ALength, unsigned long ABudget)
 {
-    Reg[rd] = PC + sizeof(long);
-    FPC += imm - sizeof(long); // -sizeof(long) => expects PC increment
+unsigned long cSkipped;
+
+    // Skipped insns would not go through the timing models
+    if (FpCaches || FpPipeline)
+        return 0;
+
+    // Up to the next interrupt check (timer deadline)
+    if (FInterruptAt - FInstret < ABudget)
+        ABudget = (unsigned long)(FInterruptAt - FInstret);
+
+    if (ABudget < ALength)
+        return 0;
+
+    // A breakpoint inside the loop must be hit
+    if (FBreakpoints.BreakpointCount)
+        for (unsigned long a=FPC; a<FPC + ALength*4; a+=4)
+            if (FBreakpoints.IsBreakpoint(a))
+                return 0;
+
+    cSkipped = ALoop == TRiscVCfg::loopCounter ? SkipCounterLoop(ALength, ABudget)
+                                               : SkipPollLoop   (ALength, ABudget);
+
+    FInstret          += cSkipped;
+    FIdleInstructions += cSkipped;
+
+    return cSkipped;
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::Execute_jalr()
+// No stores inside the loop: if an iteration leaves the registers unchanged
+// every following iteration is the same (until the host changes memory,
+// i.e. up to the end of this run)
+unsigned long RiscV::SkipPollLoop(unsigned long ALength, unsigned long ABudget)
 {
-    if( funct ) // funct must be 0x0
-        Execute_IllegalFunction();
+bool Next = FIdleHead == FPC && FInstret == FIdleInstret + ALength;  // One iteration since last check
 
-    Reg[rd] = PC + sizeof(long);
-    FPC  = ( (((long)Reg[rs1]) + imm) & ~0x1 ) - sizeof(long); // -sizeof(long) => expects PC increment
+    if (!Next) {
+        FIdleHead    = FPC;
+        FIdleChanges = 0;
+    }
+    else if (FIdleChanges >= MaxIdleChanges) {
+        FIdleInstret = FInstret;    // Busy loop: registers not compared any more
+        return 0;
+    }
+    else if (!memcmp(FIdleReg, FReg, sizeof(FReg))) {
+        FIdleInstret = FInstret + (ABudget / ALength) * ALength;
+        return (ABudget / ALength) * ALength;
+    }
+    else
+        FIdleChanges++;
+
+    FIdleInstret = FInstret;
+    memcpy(FIdleReg, FReg, sizeof(FReg));
+
+    return 0;
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::Execute_ecall_ebreak()
+// Loop body: "addi r, r, k" insns + branch comparing one of them against an
+// invariant. Iterations to exit are computed and the registers advanced.
+// The words are checked again (as TRiscVCfg::ClassifyLoop() does): the
+// classification is per block, the code may have been changed since
+unsigned long RiscV::SkipCounterLoop(unsigned long ALength, unsigned long ABudget)
 {
-    // Nothing to do
+unsigned long    Branch    = *(unsigned long *)(FpMemory + FPC + (ALength-1)*4);
+int              Funct3    = Branch >> 12 & 0x7;
+int              Rs1       = Branch >> 15 & 0x1F;
+int              Rs2       = Branch >> 20 & 0x1F;
+long             Offset    = ((long)Branch >> 31 << 12) | (Branch >> 7 & 0x1) << 11 | (Branch >> 25 & 0x3F) << 5 | (Branch >> 8 & 0xF) << 1;
+unsigned long    Written   = 0;     // Bitmap of "addi r, r, k" registers
+int              Induction = -1;
+long             Step      = 0;
+unsigned long    Insn;
+int              Rd;
+unsigned __int64 cIterations;
+unsigned __int64 cSkip;
+
+    if ((Branch & 0x7F) != 0x63 || Offset != -(long)(ALength-1)*4)
+        return 0;
+
+    for (unsigned long c=0; c<ALength-1; c++) {
+        Insn = *(unsigned long *)(FpMemory + FPC + c*4);
+        Rd   = Insn >> 7 & 0x1F;
+
+        if ((Insn & 0x707F) != 0x13 || !Rd || Rd != (int)(Insn >> 15 & 0x1F) || !(Insn >> 20) || (Written >> Rd & 1))
+            return 0;
+
+        Written |= 1UL << Rd;
+
+        if (Rd == Rs1 || Rd == Rs2) {
+            Induction = Rd;
+            Step      = (long)Insn >> 20;
+        }
+    }
+
+    // Exactly one branch operand is an induction register
+    if ((Written >> Rs1 & 1) + (Written >> Rs2 & 1) != 1)
+        return 0;
+
+    if (!LoopIterations(Funct3, Induction == Rs1, Reg[Induction], Step, Reg[Induction == Rs1 ? Rs2 : Rs1], cIterations))
+        return 0;
+
+    cSkip = cIterations < ABudget / ALength ? cIterations : ABudget / ALength;
+    if (!cSkip)
+        return 0;
+
+    for (unsigned long c=0; c<ALength-1; c++) {
+        Insn = *(unsigned long *)(FpMemory + FPC + c*4);
+        Reg[Insn >> 7 & 0x1F] = Reg[Insn >> 7 & 0x1F] + (unsigned long)(cSkip * (unsigned __int64)(__int64)((long)Insn >> 20));
+    }
+
+    if (cSkip == cIterations)
+        FPC += ALength*4;   // Loop exit (fall through)
+
+    return (unsigned long)(cSkip * ALength);
 }
 //---------------------------------------------------------------------------
 
-void RiscV_RV32I::Execute_fence()
+// Iterations of a loop whose branch (AFunct3) compares x(i) = AValue + i*AStep
+// against AInvariant (AInductionRs1 => x is rs1), false => not computable
+bool RiscV::LoopIterations(int AFunct3, bool AInductionRs1, unsigned long AValue, long AStep, unsigned long AInvariant, unsigned __int64 &AIterations)
+{
+bool             Signed = AFunct3 == 4 || AFunct3 == 5;
+__int64          Value  = Signed ? (__int64)(long)AValue     : (__int64)AValue;
+__int64          Other  = Signed ? (__int64)(long)AInvariant : (__int64)AInvariant;
+__int64          Min    = Signed ? -0x80000000LL : 0;
+__int64          Max    = Signed ?  0x7FFFFFFFLL : 0xFFFFFFFFLL;
+unsigned long    Distance;
+unsigned __int64 Low;
+unsigned __int64 High;
+__int64          Last;
+
+    switch (AFunct3)
+    {
+        case 1: // bne: loops until x(i) == invariant (modulo 2^32)
+            Distance = AStep > 0 ? AInvariant - AValue : AValue - AInvariant;
+            if (!Distance || Distance % (unsigned long)(AStep > 0 ? AStep : -AStep))
+                return false;
+
+            AIterations = Distance / (unsigned long)(AStep > 0 ? AStep : -AStep);
+            return true;
+
+        case 4: case 5: case 6: case 7:
+            break;
+
+        default:
+            return false;
+    }
+
+    // blt/bge/bltu/bgeu: condition is monotonic in i without overflow,
+    // binary search of the first iteration not taking the branch
+    Low  = 1;
+    High = 0x200000000ULL;
+
+    if (LoopTaken(AFunct3, AInductionRs1, Value + (__int64)High*AStep, Other))
+        return false;   // Exits only by overflow
+
+    while (Low < High) {
+        unsigned __int64 Mid = (Low + High) / 2;
+
+        if (LoopTaken(AFunct3, AInductionRs1, Value + (__int64)Mid*AStep, Other))
+            Low  = Mid + 1;
+        else
+            High = Mid;
+    }
+
+    Last = Value + (__int64)Low*AStep;
+    if (Last < Min || Last > Max)
+        return false;   // Overflow before exit
+
+    AIterations = Low;
+    return true;
+}
+//---------------------------------------------------------------------------
+
+bool RiscV::LoopTaken(int AFunct3, bool AInductionRs1, __int64 AInduction, __int64 AInvariant)
+{
+__int64 Rs1 = AInductionRs1 ? AInduction : AInvariant;
+__int64 Rs2 = AInductionRs1 ? AInvariant : AInduction;
+
+    return AFunct3 & 1 ? Rs1 >= Rs2 : Rs1 < Rs2;   // bge/bgeu : blt/bltu
+}
+//---------------------------------------------------------------------------
+
+void RiscV::DeviceWrite(unsigned long AAddress, const void *ApData, int ASize)
+{
+    if (ASize < 1 || ASize > (int)sizeof(unsigned long))
+        throw Exception("Invalid device write size");
+
+    memcpy(HostPtr(AAddress, ASize), ApData, ASize);
+
+    if (FpHistory)
+        FpHistory->LogHostWrite(AAddress, ApData, ASize);
+}
+//---------------------------------------------------------------------------
+
+unsigned long RiscV::DeviceRead(unsigned long AValue)
+{
+    return FpHistory ? FpHistory->LogDeviceRead(AValue) : AValue;
+}
+//---------------------------------------------------------------------------
+
+void RiscV::ReadMemory(unsigned long AAddress, void *ApData, unsigned long ASize)
+{
+    if (!InMemory(AAddress, ASize))
+        throw Exception("Segmentation fault");
+
+    RawRead(AAddress, ApData, ASize);
+}
+//---------------------------------------------------------------------------
+
+void RiscV::WriteMemory(unsigned long AAddress, const void *ApData, unsigned long ASize)
+{
+    if (!InMemory(AAddress, ASize))
+        throw Exception("Segmentation fault");
+
+    RawWrite(AAddress, ApData, ASize);
+    FFramebuffer.OnStore(AAddress, ASize);
+
+    if (AAddress < FmaxText && AAddress + ASize > FminText)
+        FCfg.Rebuild();     // Code patched
+
+    if (FpHistory)
+        FpHistory->Clear();
+}
+//---------------------------------------------------------------------------
+
+void RiscV::WriteRegister(int AIndex, unsigned long AValue)
+{
+    if (AIndex < 0 || AIndex > t6)
+        throw Exception("Invalid register");
+
+    Reg[AIndex] = AValue;
+
+    if (FpHistory)
+        FpHistory->Clear();
+}
+//---------------------------------------------------------------------------
+
+void RiscV::EnableHistory(unsigned long AInterval, int AMaxCheckpoints)
+{
+    delete FpHistory;
+    FpHistory = NULL;
+
+    if (AInterval) {
+        FpHistory = new TRiscVHistory(this, AInterval, AMaxCheckpoints);
+        FpHistory->Clear();
+    }
+}
+//---------------------------------------------------------------------------
+
+void RiscV::StepBack()
+{
+    if (!FpHistory)
+        throw Exception("Reverse execution not enabled");
+
+    FpHistory->StepBack();
+}
+//---------------------------------------------------------------------------
+
+bool RiscV::ContinueBack()
+{
+    if (!FpHistory)
+        throw Exception("Reverse execution not enabled");
+
+    return FpHistory->ContinueBack();
+}
+//---------------------------------------------------------------------------
+
+void RiscV::ResetMachine()
+{
+    memset(&FMachine, 0, sizeof(FMachine));
+
+    FMachine.Priv    = Machine;
+    FMachine.Mtimecmp = (unsigned __int64)-1;
+
+    FInterruptAt = (unsigned __int64)-1;
+}
+//---------------------------------------------------------------------------
+
+unsigned long RiscV::getMip()
+{
+    return (FMachine.Msip & 1 ? mipMSIP : 0) | (getTime() >= FMachine.Mtimecmp ? mipMTIP : 0);
+}
+//---------------------------------------------------------------------------
+
+// Trap entry: PC = handler (vectored mode: base + 4*cause for interrupts)
+void RiscV::EnterTrap(unsigned long ACause, unsigned long ATval)
+{
+    if (FStatistics) {
+        FStats.Traps++;
+        FStats.Interrupts += (ACause & causeInterrupt) != 0;
+    }
+
+    FMachine.Mepc    = FPC;
+    FMachine.Mcause  = ACause;
+    FMachine.Mtval   = ATval;
+    FMachine.Mstatus = (FMachine.Mstatus & ~(mstatusMPIE | mstatusMPP | mstatusMIE))
+                     | (FMachine.Mstatus & mstatusMIE ? mstatusMPIE : 0)
+                     | (FMachine.Priv << 11);
+    FMachine.Priv   = Machine;
+
+    FPC = FMachine.Mtvec & ~0x3;
+    if ((FMachine.Mtvec & 0x3) == 1 && (ACause & causeInterrupt))
+        FPC += (ACause & ~causeInterrupt) * 4;
+
+    FInterruptAt = 0;
+}
+//---------------------------------------------------------------------------
+
+// Called by the insn raising it
+void RiscV::RaiseTrap(unsigned long ACause, unsigned long ATval)
+{
+    EnterTrap(ACause, ATval);
+    FPC -= sizeof(long);    // Expects PC increment
+}
+//---------------------------------------------------------------------------
+
+void RiscV::ReturnFromTrap()
+{
+    FPC            = FMachine.Mepc - sizeof(long);  // Expects PC increment
+    FMachine.Priv = (FMachine.Mstatus & mstatusMPP) == mstatusMPP ? Machine : User;
+
+    FMachine.Mstatus = (FMachine.Mstatus & ~(mstatusMIE | mstatusMPP))
+                     | (FMachine.Mstatus & mstatusMPIE ? mstatusMIE : 0)
+                     | mstatusMPIE;
+
+    FInterruptAt = 0;
+}
+//---------------------------------------------------------------------------
+
+// wfi: the hart sleeps from the next block entry (the insn ends its block)
+void RiscV::WaitForInterrupt()
+{
+    FMachine.Wfi = true;
+    FInterruptAt     = 0;
+}
+//---------------------------------------------------------------------------
+
+// Takes the highest priority pending interrupt if enabled (true => trap
+// entered), then computes the next instret worth a check
+bool RiscV::CheckInterrupts()
+{
+unsigned long Pending = getMip() & FMachine.Mie;
+bool          Taken   = false;
+
+    if (Pending) {
+        FMachine.Wfi = false;   // wfi resumes even if globally disabled
+
+        if (FMachine.Priv != Machine || (FMachine.Mstatus & mstatusMIE)) {
+            EnterTrap(Pending & mipMSIP ? causeMachineSoftware : causeMachineTimer, 0);
+            Taken = true;
+        }
+    }
+
+    FInterruptAt = NextInterruptCheck();
+
+    return Taken;
+}
+//---------------------------------------------------------------------------
+
+// Nothing can happen before the timer deadline: CSR writes, CLINT stores,
+// traps and wfi reset FInterruptAt to 0 (check on next block entry)
+unsigned __int64 RiscV::NextInterruptCheck()
+{
+unsigned __int64 Mtime = getTime();
+
+    if (FMachine.Wfi)
+        return 0;
+
+    if (FMachine.Priv == Machine && !(FMachine.Mstatus & mstatusMIE))
+        return (unsigned __int64)-1;
+
+    if ((FMachine.Mie & mipMSIP) && (FMachine.Msip & 1))
+        return FInstret;
+
+    if (!(FMachine.Mie & mipMTIP) || FMachine.Mtimecmp == (unsigned __int64)-1)
+        return (unsigned __int64)-1;
+
+    return FMachine.Mtimecmp <= Mtime ? FInstret : FInstret + (FMachine.Mtimecmp - Mtime);
+}
+//---------------------------------------------------------------------------
+
+// Sleeping hart: virtual time jumps to the timer deadline (at most ABudget
+// ticks), APark => the host thread sleeps the same time. Returns ticks slept
+unsigned long RiscV::SleepUntilInterrupt(unsigned long ABudget, bool APark)
+{
+unsigned __int64 Mtime = getTime();
+unsigned __int64 Ticks = ABudget;
+
+    if ((FMachine.Mie & mipMTIP) && FMachine.Mtimecmp > Mtime && FMachine.Mtimecmp - Mtime < Ticks)
+        Ticks = FMachine.Mtimecmp - Mtime;
+
+    if (APark && FTimerFrequency)
+        std::this_thread::sleep_for(std::chrono::microseconds(Ticks * 1000000 / FTimerFrequency));
+
+    FMachine.TimeOffset += Ticks;
+    FInterruptAt         = 0;
+
+    return (unsigned long)Ticks;
+}
+//---------------------------------------------------------------------------
+
+// Privilege: csr[9:8] (minimum mode), read-only: csr[11:10] == 3
+bool RiscV::CsrRead(int ACsr, unsigned long &AValue)
+{
+    if ((ACsr >> 8 & 0x3) > FMachine.Priv)
+        return false;
+
+    switch (ACsr)
+    {
+        case csrMstatus:    AValue = FMachine.Mstatus;              break;
+        case csrMisa:       AValue = FMisa;                         break;
+        case csrMie:        AValue = FMachine.Mie;                  break;
+        case csrMtvec:      AValue = FMachine.Mtvec;                break;
+        case csrMscratch:   AValue = FMachine.Mscratch;             break;
+        case csrMepc:       AValue = FMachine.Mepc;                 break;
+        case csrMcause:     AValue = FMachine.Mcause;               break;
+        case csrMtval:      AValue = FMachine.Mtval;                break;
+        case csrMip:        AValue = getMip();                      break;
+
+        case csrMcycle:
+        case csrMinstret:
+        case csrCycle:
+        case csrInstret:    AValue = (unsigned long)FInstret;       break;
+        case csrMcycleh:
+        case csrMinstreth:
+        case csrCycleh:
+        case csrInstreth:   AValue = (unsigned long)(FInstret >> 32); break;
+        case csrTime:       AValue = (unsigned long)getTime();      break;
+        case csrTimeh:      AValue = (unsigned long)(getTime() >> 32); break;
+
+        case csrMvendorid:
+        case csrMarchid:
+        case csrMimpid:
+        case csrMhartid:    AValue = 0;                             break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+//---------------------------------------------------------------------------
+
+bool RiscV::CsrWrite(int ACsr, unsigned long AValue)
+{
+    if ((ACsr >> 8 & 0x3) > FMachine.Priv || (ACsr >> 10 & 0x3) == 0x3)
+        return false;
+
+    switch (ACsr)
+    {
+        case csrMstatus:
+            // MPP: User/Machine only (others read as User)
+            FMachine.Mstatus = (AValue & (mstatusMIE | mstatusMPIE))
+                             | ((AValue & mstatusMPP) == mstatusMPP ? mstatusMPP : 0);
+            break;
+
+        case csrMie:        FMachine.Mie      = AValue & (mipMSIP | mipMTIP);  break;
+        case csrMtvec:      FMachine.Mtvec    = AValue & ((AValue & 0x3) == 1 ? ~0x2UL : ~0x3UL); break;
+        case csrMscratch:   FMachine.Mscratch = AValue;                        break;
+        case csrMepc:       FMachine.Mepc     = AValue & ~0x3;                 break;
+        case csrMcause:     FMachine.Mcause   = AValue;                        break;
+        case csrMtval:      FMachine.Mtval    = AValue;                        break;
+
+        case csrMisa:       // WARL registers: fixed value
+        case csrMip:        // Pending bits driven by the CLINT
+        case csrMcycle:
+        case csrMinstret:
+        case csrMcycleh:
+        case csrMinstreth:
+            break;
+
+        default:
+            return false;
+    }
+
+    FInterruptAt = 0;
+
+    return true;
+}
+//---------------------------------------------------------------------------
+
+// Illegal instruction: trap once the guest has a handler, else stop
+void RiscV::Process()
+{
+unsigned long iInstruction = Instruction;
+String hInstruction;
+
+    if (HasTrapHandler()) {
+        RaiseTrap(causeIllegalInsn, iInstruction);
+        return;
+    }
+
+    hInstruction.SetLength(sizeof(unsigned long)*2);
+    BinToHex( &iInstruction, hInstruction.c_str(), sizeof(unsigned long) );
+
+    throw Exception( String("Illegal instruction at PC ") + PC + " (" + hInstruction + ")" );
+}
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   RISC-V RV32I implementation
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//---------------------------------------------------------------------------
+// RV32I immediate decoders
+//---------------------------------------------------------------------------
+
+long RiscV_RV32Isa::DecodeImm_R(unsigned long)
+{
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+// imm[11:0] = insn[31:20]
+long RiscV_RV32Isa::DecodeImm_I(unsigned long AInstruction)
+{
+    return (long)AInstruction >> 20;
+}
+//---------------------------------------------------------------------------
+
+// imm[11:5] = insn[31:25], imm[4:0] = insn[11:7]
+long RiscV_RV32Isa::DecodeImm_S(unsigned long AInstruction)
+{
+    return ((long)(AInstruction & 0xFE000000) >> 20) | (AInstruction >> 7 & 0x1F);
+}
+//---------------------------------------------------------------------------
+
+// imm[12] = insn[31], imm[11] = insn[7], imm[10:5] = insn[30:25], imm[4:1] = insn[11:8]
+long RiscV_RV32Isa::DecodeImm_B(unsigned long AInstruction)
+{
+    return ((long)(AInstruction & 0x80000000) >> 19) | (AInstruction << 4 & 0x800) | (AInstruction >> 20 & 0x7E0) | (AInstruction >> 7 & 0x1E);
+}
+//---------------------------------------------------------------------------
+
+// imm[31:12] = insn[31:12] (already shifted)
+long RiscV_RV32Isa::DecodeImm_U(unsigned long AInstruction)
+{
+    return (long)(AInstruction & 0xFFFFF000);
+}
+//---------------------------------------------------------------------------
+
+// imm[20] = insn[31], imm[19:12] = insn[19:12], imm[11] = insn[20], imm[10:1] = insn[30:21]
+long RiscV_RV32Isa::DecodeImm_J(unsigned long AInstruction)
+{
+    return ((long)(AInstruction & 0x80000000) >> 11) | (AInstruction & 0xFF000) | (AInstruction >> 9 & 0x800) | (AInstruction >> 20 & 0x7FE);
+}
+//---------------------------------------------------------------------------
+
+template<RiscV_RV32Isa::InsnFormat AFormat, RiscV_RV32Isa::THandler AExecute>
+void RiscV_RV32Isa::Dispatch()
+{
+    // Format is a constant: only one decoder is compiled in
+    switch (AFormat)
+    {
+        case fmtR:  Fimm = DecodeImm_R(FInsn);  break;
+        case fmtI:  Fimm = DecodeImm_I(FInsn);  break;
+        case fmtS:  Fimm = DecodeImm_S(FInsn);  break;
+        case fmtB:  Fimm = DecodeImm_B(FInsn);  break;
+        case fmtU:  Fimm = DecodeImm_U(FInsn);  break;
+        case fmtJ:  Fimm = DecodeImm_J(FInsn);  break;
+    }
+
+    (this->*AExecute)();
+}
+//---------------------------------------------------------------------------
+
+
+/*
+Instruction set: one row per instruction, (Instruction & Mask) == Match.
+Every mask includes opcode, funct3/funct7 fields are included when defined.
+Row 0 never matches (illegal instruction entry of the decode table).
+Loads/stores (INSN_MEM) have a guarded memory run loop handler of their own.
+*/
+#define INSN(AFormat, AExecute)     fmt##AFormat, &RiscV_RV32Isa::Dispatch<fmt##AFormat, &RiscV_RV32Isa::AExecute>, \
+                                                  &RiscV_RV32Isa::Dispatch<fmt##AFormat, &RiscV_RV32Isa::AExecute>
+#define INSN_MEM(AFormat, AExecute) fmt##AFormat, &RiscV_RV32Isa::Dispatch<fmt##AFormat, &RiscV_RV32Isa::AExecute<false> >, \
+                                                  &RiscV_RV32Isa::Dispatch<fmt##AFormat, &RiscV_RV32Isa::AExecute<true> >
+
+constexpr const RiscV_RV32Isa::TInsnDesc RiscV_RV32Isa::FInsnTable[] =
+{
+    // Name        Mask        Match       Isa       Format, Handler, GuardedHandler
+    { "illegal",   0x00000000, 0x00000001, extI,     fmtR,   NULL, NULL },
+
+    { "lui",       0x0000007F, 0x00000037, extI,     INSN(U, Execute_lui)    },
+    { "auipc",     0x0000007F, 0x00000017, extI,     INSN(U, Execute_auipc)  },
+    { "jal",       0x0000007F, 0x0000006F, extI,     INSN(J, Execute_jal)    },
+    { "jalr",      0x0000707F, 0x00000067, extI,     INSN(I, Execute_jalr)   },
+
+    { "beq",       0x0000707F, 0x00000063, extI,     INSN(B, Execute_beq)    },
+    { "bne",       0x0000707F, 0x00001063, extI,     INSN(B, Execute_bne)    },
+    { "blt",       0x0000707F, 0x00004063, extI,     INSN(B, Execute_blt)    },
+    { "bge",       0x0000707F, 0x00005063, extI,     INSN(B, Execute_bge)    },
+    { "bltu",      0x0000707F, 0x00006063, extI,     INSN(B, Execute_bltu)   },
+    { "bgeu",      0x0000707F, 0x00007063, extI,     INSN(B, Execute_bgeu)   },
+
+    { "lb",        0x0000707F, 0x00000003, extI,     INSN_MEM(I, Execute_lb)  },
+    { "lh",        0x0000707F, 0x00001003, extI,     INSN_MEM(I, Execute_lh)  },
+    { "lw",        0x0000707F, 0x00002003, extI,     INSN_MEM(I, Execute_lw)  },
+    { "lbu",       0x0000707F, 0x00004003, extI,     INSN_MEM(I, Execute_lbu) },
+    { "lhu",       0x0000707F, 0x00005003, extI,     INSN_MEM(I, Execute_lhu) },
+
+    { "sb",        0x0000707F, 0x00000023, extI,     INSN_MEM(S, Execute_sb)  },
+    { "sh",        0x0000707F, 0x00001023, extI,     INSN_MEM(S, Execute_sh)  },
+    { "sw",        0x0000707F, 0x00002023, extI,     INSN_MEM(S, Execute_sw)  },
+
+    { "addi",      0x0000707F, 0x00000013, extI,     INSN(I, Execute_addi)   },
+    { "slti",      0x0000707F, 0x00002013, extI,     INSN(I, Execute_slti)   },
+    { "sltiu",     0x0000707F, 0x00003013, extI,     INSN(I, Execute_sltiu)  },
+    { "xori",      0x0000707F, 0x00004013, extI,     INSN(I, Execute_xori)   },
+    { "ori",       0x0000707F, 0x00006013, extI,     INSN(I, Execute_ori)    },
+    { "andi",      0x0000707F, 0x00007013, extI,     INSN(I, Execute_andi)   },
+    { "slli",      0xFE00707F, 0x00001013, extI,     INSN(I, Execute_slli)   },
+    { "srli",      0xFE00707F, 0x00005013, extI,     INSN(I, Execute_srli)   },
+    { "srai",      0xFE00707F, 0x40005013, extI,     INSN(I, Execute_srai)   },
+
+    { "add",       0xFE00707F, 0x00000033, extI,     INSN(R, Execute_add)    },
+    { "sub",       0xFE00707F, 0x40000033, extI,     INSN(R, Execute_sub)    },
+    { "sll",       0xFE00707F, 0x00001033, extI,     INSN(R, Execute_sll)    },
+    { "slt",       0xFE00707F, 0x00002033, extI,     INSN(R, Execute_slt)    },
+    { "sltu",      0xFE00707F, 0x00003033, extI,     INSN(R, Execute_sltu)   },
+    { "xor",       0xFE00707F, 0x00004033, extI,     INSN(R, Execute_xor)    },
+    { "srl",       0xFE00707F, 0x00005033, extI,     INSN(R, Execute_srl)    },
+    { "sra",       0xFE00707F, 0x40005033, extI,     INSN(R, Execute_sra)    },
+    { "or",        0xFE00707F, 0x00006033, extI,     INSN(R, Execute_or)     },
+    { "and",       0xFE00707F, 0x00007033, extI,     INSN(R, Execute_and)    },
+
+    { "fence",     0x0000007F, 0x0000000F, extI,     INSN(I, Execute_fence)  },   // Also fence.i
+    { "system",    0x0000707F, 0x00000073, extI,     INSN(I, Execute_system) },   // ecall, ebreak, mret, wfi (funct12)
+    { "csrrw",     0x0000707F, 0x00001073, extZicsr, INSN(I, Execute_csrrw)  },
+    { "csrrs",     0x0000707F, 0x00002073, extZicsr, INSN(I, Execute_csrrs)  },
+    { "csrrc",     0x0000707F, 0x00003073, extZicsr, INSN(I, Execute_csrrc)  },
+    { "csrrwi",    0x0000707F, 0x00005073, extZicsr, INSN(I, Execute_csrrwi) },
+    { "csrrsi",    0x0000707F, 0x00006073, extZicsr, INSN(I, Execute_csrrsi) },
+    { "csrrci",    0x0000707F, 0x00007073, extZicsr, INSN(I, Execute_csrrci) },
+
+    // M extension
+    { "mul",       0xFE00707F, 0x02000033, extM,     INSN(R, Execute_mul)    },
+    { "mulh",      0xFE00707F, 0x02001033, extM,     INSN(R, Execute_mulh)   },
+    { "mulhsu",    0xFE00707F, 0x02002033, extM,     INSN(R, Execute_mulhsu) },
+    { "mulhu",     0xFE00707F, 0x02003033, extM,     INSN(R, Execute_mulhu)  },
+    { "div",       0xFE00707F, 0x02004033, extM,     INSN(R, Execute_div)    },
+    { "divu",      0xFE00707F, 0x02005033, extM,     INSN(R, Execute_divu)   },
+    { "rem",       0xFE00707F, 0x02006033, extM,     INSN(R, Execute_rem)    },
+    { "remu",      0xFE00707F, 0x02007033, extM,     INSN(R, Execute_remu)   }
+};
+
+constexpr const int RiscV_RV32Isa::FcInsnTable = sizeof(FInsnTable) / sizeof(FInsnTable[0]);
+//---------------------------------------------------------------------------
+
+// Every row of AExtensions is entered in all the decode keys it matches: the
+// key bits (opcode, funct3, funct7 bits 30 and 25) must be enough to tell
+// rows apart
+template<unsigned long AExtensions>
+constexpr RiscV_RV32Isa::TDecodeTable RiscV_RV32Isa::BuildDecodeTable()
+{
+const unsigned long KeyBits = 0x4200707F;
+TDecodeTable        Table   = {};
+
+    for (int cKey1=0; cKey1<DecodeKeys1; cKey1++)
+        for (int cKey2=0; cKey2<DecodeKeys2; cKey2++) {
+            unsigned long iKey = ((unsigned long)(cKey1 & 0x1F) << 2) | 0x3 | ((unsigned long)(cKey1 >> 5) << 12) |
+                                 ((unsigned long)(cKey2 & 0x1) << 25) | ((unsigned long)(cKey2 >> 1) << 30);
+
+            for (int cRow=1; cRow<FcInsnTable; cRow++)
+                if (!(FInsnTable[cRow].Isa & ~AExtensions) &&
+                    !((iKey ^ FInsnTable[cRow].Match) & FInsnTable[cRow].Mask & KeyBits)) {
+                    if (Table.Row[cKey1][cKey2])
+                        Table.Ambiguous++;
+
+                    Table.Row[cKey1][cKey2] = (unsigned char)cRow;
+                }
+        }
+
+    return Table;
+}
+//---------------------------------------------------------------------------
+
+constexpr const RiscV_RV32Isa::TDecodeTable RiscV_RV32Isa::FDecodeTable = BuildDecodeTable<extAll>();
+//---------------------------------------------------------------------------
+
+template<unsigned long AExtensions>
+const RiscV_RV32Isa::TDecodeTable RiscV_RV32<AExtensions>::FDecodeTable = BuildDecodeTable<AExtensions>();
+//---------------------------------------------------------------------------
+
+template<unsigned long AExtensions>
+template<bool AGuarded>
+bool RiscV_RV32<AExtensions>::Decode()
+{
+unsigned long    iInstruction = Instruction;
+const TInsnDesc &Desc         = FInsnTable[ FDecodeTable.Row[(iInstruction >> 2 & 0x1F) | (iInstruction >> 7 & 0xE0)]   // opcode[6:2] + funct3
+                                                            [(iInstruction >> 25 & 0x1) | (iInstruction >> 29 & 0x2)] ]; // funct7 bits 25, 30
+
+    static_assert(!BuildDecodeTable<AExtensions>().Ambiguous, "RiscV_RV32: ambiguous instruction table");
+
+    if ((iInstruction & Desc.Mask) != Desc.Match)   // Not a defined encoding (row 0 included)
+        return false;
+
+    // Register fields extracted for every format (ignored when not used),
+    // immediate extracted by the handler
+    FInsn = iInstruction;
+    Frd   = iInstruction >>  7 & 0x1F;
+    Frs1  = iInstruction >> 15 & 0x1F;
+    Frs2  = iInstruction >> 20 & 0x1F;
+
+    (this->*(AGuarded ? Desc.GuardedHandler : Desc.Handler))();
+
+    return true;
+}
+//---------------------------------------------------------------------------
+
+template<unsigned long AExtensions>
+void RiscV_RV32<AExtensions>::Process()
+{
+    if( !Decode<false>() )     // true => Instruction decoded successfully (for the current arch)
+        RiscV::Process();      //         and ready to be executed
+}
+//---------------------------------------------------------------------------
+
+// Guarded memory run loop: loads/stores straight to the host MMU
+template<unsigned long AExtensions>
+void RiscV_RV32<AExtensions>::ProcessGuardedMemory()
+{
+    if( !Decode<true>() )
+        RiscV::Process();
+}
+//---------------------------------------------------------------------------
+
+template<unsigned long AExtensions>
+bool RiscV_RV32<AExtensions>::IsLegal(unsigned long AInstruction)
+{
+    return FindRow(AInstruction, FDecodeTable) != 0;
+}
+//---------------------------------------------------------------------------
+
+template<unsigned long AExtensions>
+RiscV::StopReason RiscV_RV32<AExtensions>::RunChecked(unsigned long ACount, bool AResume)
+{
+    return RunCore<RiscV_RV32>(ACount, AResume);
+}
+//---------------------------------------------------------------------------
+
+int RiscV_RV32Isa::InsnCount()
+{
+    return FcInsnTable - 1;
+}
+//---------------------------------------------------------------------------
+
+const RiscV_RV32Isa::TInsnDesc & RiscV_RV32Isa::InsnInfo(int AIndex)
+{
+    if (AIndex < 1 || AIndex >= FcInsnTable)
+        throw Exception("Invalid instruction index");
+
+    return FInsnTable[AIndex];
+}
+//---------------------------------------------------------------------------
+
+int RiscV_RV32Isa::FindInsn(unsigned long AInstruction)
+{
+    return FindRow(AInstruction, FDecodeTable);
+}
+//---------------------------------------------------------------------------
+
+int RiscV_RV32Isa::FindRow(unsigned long AInstruction, const TDecodeTable &ATable)
+{
+int iRow = ATable.Row[(AInstruction >> 2 & 0x1F) | (AInstruction >> 7 & 0xE0)]
+                     [(AInstruction >> 25 & 0x1) | (AInstruction >> 29 & 0x2)];
+
+    return (AInstruction & FInsnTable[iRow].Mask) == FInsnTable[iRow].Match ? iRow : 0;
+}
+//---------------------------------------------------------------------------
+
+long RiscV_RV32Isa::DecodeImm(unsigned long AInstruction, InsnFormat AFormat)
+{
+    switch (AFormat)
+    {
+        case fmtI:  return DecodeImm_I(AInstruction);
+        case fmtS:  return DecodeImm_S(AInstruction);
+        case fmtB:  return DecodeImm_B(AInstruction);
+        case fmtU:  return DecodeImm_U(AInstruction);
+        case fmtJ:  return DecodeImm_J(AInstruction);
+        default:    return DecodeImm_R(AInstruction);
+    }
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+// RV32I executors
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_add()     { Reg[rd] = (long)Reg[rs1] +  (long)Reg[rs2]; }            // signed op
+void RiscV_RV32Isa::Execute_sub()     { Reg[rd] = (long)Reg[rs1] -  (long)Reg[rs2]; }            // signed op
+void RiscV_RV32Isa::Execute_sll()     { Reg[rd] =       Reg[rs1] << (Reg[rs2] & 0x1F); }         // shamt = rs2[4:0]
+void RiscV_RV32Isa::Execute_slt()     { Reg[rd] = (long)Reg[rs1] <  (long)Reg[rs2]; }            // signed op
+void RiscV_RV32Isa::Execute_sltu()    { Reg[rd] =       Reg[rs1] <        Reg[rs2]; }            // unsigned op
+void RiscV_RV32Isa::Execute_xor()     { Reg[rd] =       Reg[rs1] ^        Reg[rs2]; }
+void RiscV_RV32Isa::Execute_srl()     { Reg[rd] =       Reg[rs1] >> (Reg[rs2] & 0x1F); }         // unsigned op
+void RiscV_RV32Isa::Execute_sra()     { Reg[rd] = (long)Reg[rs1] >> (Reg[rs2] & 0x1F); }         // signed op
+void RiscV_RV32Isa::Execute_or()      { Reg[rd] =       Reg[rs1] |        Reg[rs2]; }
+void RiscV_RV32Isa::Execute_and()     { Reg[rd] =       Reg[rs1] &        Reg[rs2]; }
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_mul()     { Reg[rd] = (long)Reg[rs1] *  (long)Reg[rs2]; }            // signed op
+void RiscV_RV32Isa::Execute_mulh()    { Reg[rd] = ( (int64_t)(long)Reg[rs1] *  (int64_t)(long)Reg[rs2]) >> 32; } // signed op
+void RiscV_RV32Isa::Execute_mulhsu()  { Reg[rd] = ( (int64_t)(long)Reg[rs1] * (uint64_t)      Reg[rs2]) >> 32; } // signed x unsigned op
+void RiscV_RV32Isa::Execute_mulhu()   { Reg[rd] = ((uint64_t)      Reg[rs1] * (uint64_t)      Reg[rs2]) >> 32; } // unsigned op
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_div()
+{
+    if( !Reg[rs2] )
+        Reg[rd] = -1;       // Division by 0 returns -1
+    else if(Reg[rs1] == 0x80000000 && (long)Reg[rs2] == -1)
+        Reg[rd] = Reg[rs1]; // Division overflow returns source reg.
+    else
+        Reg[rd] = (long)Reg[rs1] / (long)Reg[rs2];
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_divu()
+{
+    if( !Reg[rs2] )
+        Reg[rd] = ~0UL;
+    else
+        Reg[rd] = Reg[rs1] / Reg[rs2];
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_rem()
+{
+    if( !Reg[rs2] )
+        Reg[rd] = Reg[rs1]; // Reminder by 0 returns dividend
+    else if((long)Reg[rs2] == -1)
+        Reg[rd] = 0;        // Reminder by -1 is 0 (also avoids host overflow trap)
+    else
+        Reg[rd] = (long)Reg[rs1] % (long)Reg[rs2];
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_remu()
+{
+    if( !Reg[rs2] )
+        Reg[rd] = Reg[rs1];
+    else
+        Reg[rd] = Reg[rs1] % Reg[rs2];
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_addi()    { Reg[rd] = Reg[rs1] + imm; }
+void RiscV_RV32Isa::Execute_slti()    { Reg[rd] = (long)Reg[rs1] <                imm; }
+void RiscV_RV32Isa::Execute_sltiu()   { Reg[rd] =       Reg[rs1] < (unsigned long)imm; }
+void RiscV_RV32Isa::Execute_xori()    { Reg[rd] = Reg[rs1] ^ imm; }
+void RiscV_RV32Isa::Execute_ori()     { Reg[rd] = Reg[rs1] | imm; }
+void RiscV_RV32Isa::Execute_andi()    { Reg[rd] = Reg[rs1] & imm; }
+void RiscV_RV32Isa::Execute_slli()    { Reg[rd] =        Reg[rs1]  << (imm & 0x1F); }          // (imm & 0x1F) = shamt
+void RiscV_RV32Isa::Execute_srli()    { Reg[rd] =        Reg[rs1]  >> (imm & 0x1F); }
+void RiscV_RV32Isa::Execute_srai()    { Reg[rd] = ((long)Reg[rs1]) >> (imm & 0x1F); }          // msb-extends
+//---------------------------------------------------------------------------
+
+// Memory pointer is signed char so no sign extension needed
+// RISC-V is little-endian arch so no byte swap needed
+template<bool AGuarded> void RiscV_RV32Isa::Execute_lb()  { Reg[rd] =                    *LoadAt<AGuarded>(Reg[rs1] + imm, 1);  }
+template<bool AGuarded> void RiscV_RV32Isa::Execute_lh()  { Reg[rd] =          *(short *)(LoadAt<AGuarded>(Reg[rs1] + imm, 2)); }
+template<bool AGuarded> void RiscV_RV32Isa::Execute_lw()  { Reg[rd] =           *(long *)(LoadAt<AGuarded>(Reg[rs1] + imm, 4)); }
+template<bool AGuarded> void RiscV_RV32Isa::Execute_lbu() { Reg[rd] =  *(unsigned char *)(LoadAt<AGuarded>(Reg[rs1] + imm, 1)); }
+template<bool AGuarded> void RiscV_RV32Isa::Execute_lhu() { Reg[rd] = *(unsigned short *)(LoadAt<AGuarded>(Reg[rs1] + imm, 2)); }
+//---------------------------------------------------------------------------
+
+template<bool AGuarded> void RiscV_RV32Isa::Execute_sb()  {           *StoreAt<AGuarded>(Reg[rs1] + imm, 1)  = (char) Reg[rs2]; }
+template<bool AGuarded> void RiscV_RV32Isa::Execute_sh()  { *(short *)(StoreAt<AGuarded>(Reg[rs1] + imm, 2)) = (short)Reg[rs2]; }
+template<bool AGuarded> void RiscV_RV32Isa::Execute_sw()  {  *(long *)(StoreAt<AGuarded>(Reg[rs1] + imm, 4)) = (long) Reg[rs2]; }
+//---------------------------------------------------------------------------
+
+// -sizeof(long) => expects PC increment
+void RiscV_RV32Isa::Execute_beq()     { if (Reg[rs1] == Reg[rs2]) FPC += imm - sizeof(long); }                   // Unsigned comp.
+void RiscV_RV32Isa::Execute_bne()     { if (Reg[rs1] != Reg[rs2]) FPC += imm - sizeof(long); }                   // Unsigned comp.
+void RiscV_RV32Isa::Execute_blt()     { if ( ((long)Reg[rs1]) <  ((long)Reg[rs2]) ) FPC += imm - sizeof(long); } // Signed comp.
+void RiscV_RV32Isa::Execute_bge()     { if ( ((long)Reg[rs1]) >= ((long)Reg[rs2]) ) FPC += imm - sizeof(long); } // Signed comp.
+void RiscV_RV32Isa::Execute_bltu()    { if (Reg[rs1] <  Reg[rs2]) FPC += imm - sizeof(long); }                   // Unsigned comp.
+void RiscV_RV32Isa::Execute_bgeu()    { if (Reg[rs1] >= Reg[rs2]) FPC += imm - sizeof(long); }                   // Unsigned comp.
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_lui()
+{
+    Reg[rd] = imm;  // imm[31:12], already shifted
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_auipc()
+{
+    Reg[rd] = PC + imm;
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_jal()
+{
+    Reg[rd] = PC + sizeof(long);
+    FPC += imm - sizeof(long); // -sizeof(long) => expects PC increment
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_jalr()
+{
+unsigned long iTarget = ( ((long)Reg[rs1]) + imm ) & ~0x1;  // Before rd write (rd may be rs1)
+
+    Reg[rd] = PC + sizeof(long);
+    FPC  = iTarget - sizeof(long); // -sizeof(long) => expects PC increment
+}
+//---------------------------------------------------------------------------
+
+// Without a trap handler (mtvec = 0) ecall/ebreak are nops
+void RiscV_RV32Isa::Execute_system()
+{
+    switch (FInsn)
+    {
+        case 0x00000073:    // ecall
+            if (HasTrapHandler())
+                RaiseTrap(Privilege == Machine ? causeEcallMachine : causeEcallUser, 0);
+            break;
+
+        case 0x00100073:    // ebreak
+            if (HasTrapHandler())
+                RaiseTrap(causeBreakpoint, PC);
+            break;
+
+        case 0x30200073:    // mret
+            if (Privilege != Machine)
+                inherited::Process();
+            else
+                ReturnFromTrap();
+            break;
+
+        case 0x10500073:    // wfi
+            WaitForInterrupt();
+            break;
+
+        default:
+            inherited::Process();
+            break;
+    }
+}
+//---------------------------------------------------------------------------
+
+// AFunct3 & 3: 1 = write, 2 = set bits, 3 = clear bits. csrrs/csrrc with
+// rs1 = x0 (uimm = 0) read only
+void RiscV_RV32Isa::ExecuteCsr(int AFunct3, unsigned long AOperand)
+{
+int           iCsr  = FInsn >> 20;
+bool          Write = (AFunct3 & 0x3) == 1 || rs1;
+unsigned long Value = 0;
+
+    if (!CsrRead(iCsr, Value) ||
+        (Write && !CsrWrite(iCsr, (AFunct3 & 0x3) == 1 ? AOperand : (AFunct3 & 0x3) == 2 ? Value | AOperand : Value & ~AOperand))) {
+        inherited::Process();
+        return;
+    }
+
+    Reg[rd] = Value;
+}
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_csrrw()   { ExecuteCsr(1, Reg[rs1]); }
+void RiscV_RV32Isa::Execute_csrrs()   { ExecuteCsr(2, Reg[rs1]); }
+void RiscV_RV32Isa::Execute_csrrc()   { ExecuteCsr(3, Reg[rs1]); }
+void RiscV_RV32Isa::Execute_csrrwi()  { ExecuteCsr(5, rs1); }        // rs1 field = uimm[4:0]
+void RiscV_RV32Isa::Execute_csrrsi()  { ExecuteCsr(6, rs1); }
+void RiscV_RV32Isa::Execute_csrrci()  { ExecuteCsr(7, rs1); }
+//---------------------------------------------------------------------------
+
+void RiscV_RV32Isa::Execute_fence()
 {
     // Nothing to do
 }
 //---------------------------------------------------------------------------
+
+// Configurations (see EmulatorU.h)
+template class RiscV_RV32<RiscV::extZicsr>;
+template class RiscV_RV32<RiscV::extAll>;
+//---------------------------------------------------------------------------
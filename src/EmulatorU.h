@@ -22,9 +22,29 @@
 //---------------------------------------------------------------------------
 #include <classes.hpp>
 //---------------------------------------------------------------------------
+#include "BreakpointsU.h"
+#include "CfgU.h"
+#include "FramebufferU.h"
+#include "LibcallsU.h"
+#include "MemoryU.h"
+#include "StatsU.h"
+//---------------------------------------------------------------------------
+
+class TRiscVCaches;
+class TRiscVCoverage;
+class TRiscVFuzzer;
+class TRiscVGuardedMemory;
+class TRiscVHistory;
+class TRiscVPipeline;
+class TRiscVProfiler;
+class TRiscVStateHash;
 
 class RiscV
 {
+    friend class TRiscVHistory;
+    friend class TRiscVFuzzer;
+    friend class TRiscVStateHash;
+
 public:
     enum Mode {
         User       = 0,
@@ -49,18 +69,221 @@ public:
         fp = s0                                   // Saved register 0 / Frame pointer   x8 (alias)
     };
 
+    enum {
+        PageBits = TRiscVMemory::PageBits,        // Memory page granularity (dirty tracking, sparse memory)
+        PageSize = 1 << PageBits
+    };
+
+    enum {
+        MaxIdleChanges = 2                        // Poll loop iterations changing registers before giving up
+    };
+
+    // ISA extensions of a core configuration (see RiscV_RV32): insns of the
+    // extensions left out are illegal instructions
+    enum Extension {
+        extI     = 0,                             // Base integer set (always)
+        extM     = 1 << 0,                        // Multiply/divide
+        extZicsr = 1 << 1,                        // CSR access
+        extAll   = extM | extZicsr                // Every extension implemented
+    };
+
+    // Machine mode CSRs (others are illegal instructions)
+    enum Csr {
+        csrMstatus   = 0x300,
+        csrMisa      = 0x301,
+        csrMie       = 0x304,
+        csrMtvec     = 0x305,
+        csrMscratch  = 0x340,
+        csrMepc      = 0x341,
+        csrMcause    = 0x342,
+        csrMtval     = 0x343,
+        csrMip       = 0x344,
+        csrMcycle    = 0xB00,                     // Counters: writes ignored
+        csrMinstret  = 0xB02,
+        csrMcycleh   = 0xB80,
+        csrMinstreth = 0xB82,
+        csrCycle     = 0xC00,                     // User mode read-only shadows
+        csrTime      = 0xC01,
+        csrInstret   = 0xC02,
+        csrCycleh    = 0xC80,
+        csrTimeh     = 0xC81,
+        csrInstreth  = 0xC82,
+        csrMvendorid = 0xF11,
+        csrMarchid   = 0xF12,
+        csrMimpid    = 0xF13,
+        csrMhartid   = 0xF14
+    };
+
+    enum {
+        mstatusMIE  = 1 << 3,                     // Interrupts enabled (machine mode)
+        mstatusMPIE = 1 << 7,                     // MIE before trap
+        mstatusMPP  = 3 << 11,                    // Mode before trap (User/Machine only)
+        mipMSIP     = 1 << 3,                     // Software interrupt (CLINT msip), also mie bit
+        mipMTIP     = 1 << 7,                     // Timer interrupt (mtime >= mtimecmp), also mie bit
+        misaBase    = (1 << 30) | (1 << 20) | (1 << 8),   // RV32 I U
+        misaM       = 1 << 12
+    };
+
+    enum TrapCause : unsigned long {
+        causeIllegalInsn      = 2,
+        causeBreakpoint       = 3,
+        causeLoadAccessFault  = 5,
+        causeStoreAccessFault = 7,
+        causeEcallUser        = 8,
+        causeEcallMachine     = 11,
+        causeInterrupt        = 0x80000000,
+        causeMachineSoftware  = causeInterrupt | 3,
+        causeMachineTimer     = causeInterrupt | 7
+    };
+
+    // CLINT registers (SiFive layout) mapped at ClintBase: guest memory given
+    // to Load() must end below it
+    enum {
+        ClintMsip      = 0x0000,
+        ClintMtimecmp  = 0x4000,
+        ClintMtime     = 0xBFF8,                  // Read-only: virtual time
+        ClintSize      = 0x10000,
+        ClintBase      = 0x02000000
+    };
+
+    // Trap state (saved by reverse execution checkpoints)
+    typedef struct {
+        Mode             Priv;        // Current privilege mode (User/Machine)
+        unsigned long    Mstatus;
+        unsigned long    Mie;
+        unsigned long    Mtvec;       // 0 => no trap handler (see Traps below)
+        unsigned long    Mscratch;
+        unsigned long    Mepc;
+        unsigned long    Mcause;
+        unsigned long    Mtval;
+        unsigned long    Msip;        // CLINT
+        unsigned __int64 Mtimecmp;    // CLINT
+        unsigned __int64 TimeOffset;  // mtime - instret (time slept in wfi)
+        bool             Wfi;         // wfi executed, no interrupt pending yet
+    } TMachineState;
+
+    enum StopReason {
+        stopCount,          // Requested number of instructions executed
+        stopBreakpoint,     // PC on a breakpoint (instruction not executed)
+        stopWatchpoint,     // Watched address accessed (instruction executed)
+        stopWait            // Hart in wfi, no interrupt up to the end of the budget
+    };
+
 private:
     char           *FpMemory;
     unsigned long   FcMemory;
+    TRiscVMemory    FSparse;        // Addresses from FcMemory up (FSparseMemory only)
+    bool            FSparseMemory;
+    TRiscVGuardedMemory *FpGuard;   // NULL => bounds checked host buffer
     unsigned long   FminText;
     unsigned long   FmaxText;
 
+    unsigned __int64 FInstret;   // Instructions retired since Load/Reset
+    TRiscVHistory  *FpHistory;   // Reverse execution (NULL => disabled)
+
+    TRiscVBreakpoints FBreakpoints;
+    TRiscVCfg         FCfg;        // .text basic blocks (built by Load)
+    TRiscVFramebuffer FFramebuffer;
+    TRiscVStats       FStats;
+    bool              FStatistics;
+    TRiscVCaches     *FpCaches;     // Timing model (NULL => disabled)
+    TRiscVPipeline   *FpPipeline;   // Timing model (NULL => disabled)
+    TRiscVProfiler   *FpProfiler;   // Call stack sampling (NULL => disabled)
+    TRiscVCoverage   *FpCoverage;   // Executed insns and branch directions (NULL => disabled)
+    TRiscVFuzzer     *FpFuzzer;     // Dirty pages and edges (set by TRiscVFuzzer::Snapshot)
+    TRiscVStateHash  *FpStateHash;  // Dirty pages (set by the TRiscVStateHash constructor)
+
+    // Idle loops fast-forward (see TRiscVCfg::BlockLoop)
+    bool             FIdleSkip;
+    unsigned __int64 FIdleInstructions;  // Insns skipped since Load/Reset
+    unsigned long    FIdleHead;          // Poll loop being checked (-1 => none)
+    unsigned __int64 FIdleInstret;       // Instret at FIdleHead
+    int              FIdleChanges;       // Iterations changing registers (checks stop at MaxIdleChanges)
+    unsigned long    FIdleReg[32];       // Registers at FIdleHead
+
+    // libgcc arithmetic run natively (see TRiscVLibcalls)
+    TRiscVLibcalls   FLibcalls;          // Entries (built by Load)
+    bool             FNativeLibcalls;
+
+    // Traps, CLINT
+    TMachineState    FMachine;
+    unsigned __int64 FInterruptAt;       // Instret of next interrupt check (0 => next block entry)
+    unsigned __int64 FClintMtime;        // mtime latched for a guest load
+    unsigned long    FClintUnmapped;     // Reserved CLINT offsets (read 0, writes ignored)
+    unsigned long    FTimerFrequency;    // mtime ticks (instructions) per host second
+    bool             FHostWait;
+
+    char *HostPtr (unsigned long AAddress, int ASize); // Host writes (no watchpoints), framebuffer tracking
+    char *ClintPtr(unsigned long AOffset, int ASize, bool AStore);
+    char *SparsePtr(unsigned long AAddress, int ASize, bool AStore);
+
+    // Dense + sparse memory, no checks
+    void RawRead (unsigned long AAddress, void *ApData, unsigned long ASize);
+    void RawWrite(unsigned long AAddress, const void *ApData, unsigned long ASize);
+    bool InMemory(unsigned long AAddress, unsigned long ASize);
+
+    // Run loop checks, compiled in only when needed (see RunPolicy())
+    enum RunFlag { runBreakpoints, runWatchpoints, runInsnHooks, runBlockHooks, runGuarded, runFlagCount };
+
+    bool       RunFlagOn(int AFlag);
+    template<class ACore, class AStats, bool... AFlags>
+    StopReason RunPolicy (unsigned long ACount, bool AResume);
+    StopReason RunGuarded(unsigned long ACount, bool AResume);
+    void       ProcessGuarded();
+    void       GuestFault(unsigned long AAddress);
+
+    // Guest code with the guarded memory armed: false => guest fault (insn
+    // at PC not executed, FpGuard->FaultAddress)
+    bool       RunArmed(unsigned long ACount, bool AResume, StopReason &AReason);
+    bool       ProcessArmed();
+
+    template<class ACore, class AStats, bool ABreakpoints, bool AWatchpoints, bool AInsnHooks, bool ABlockHooks, bool AGuarded>
+    StopReason RunLoop(unsigned long ACount, bool AResume);
+
+    void             ResetMachine();
+    void             EnterTrap(unsigned long ACause, unsigned long ATval);
+    bool             CheckInterrupts();
+    unsigned __int64 NextInterruptCheck();
+    unsigned long    SleepUntilInterrupt(unsigned long ABudget, bool APark);
+
+    unsigned __int64 getTime()      { return FInstret + FMachine.TimeOffset; }
+    unsigned long    getMip();
+    Mode             getPrivilege() { return FMachine.Priv; }
+    bool             getWaiting()   { return FMachine.Wfi; }
+
+    unsigned long SkipIdleLoop   (TRiscVCfg::BlockLoop ALoop, unsigned long ALength, unsigned long ABudget);
+    unsigned long SkipPollLoop   (unsigned long ALength, unsigned long ABudget);
+    unsigned long SkipCounterLoop(unsigned long ALength, unsigned long ABudget);
+
+    // A native call retires no routine insns: off while they are counted
+    bool NativeLibcallsOn() { return FNativeLibcalls && !FStatistics && !FpCaches && !FpPipeline; }
+    void NativeCall();
+
+    static bool LoopIterations(int AFunct3, bool AInductionRs1, unsigned long AValue, long AStep, unsigned long AInvariant, unsigned __int64 &AIterations);
+    static bool LoopTaken     (int AFunct3, bool AInductionRs1, __int64 AInduction, __int64 AInvariant);
+
+    TRiscVBreakpoints *getBreakpoints() { return &FBreakpoints; }
+    TRiscVCfg         *getCfg()         { return &FCfg; }
+    TRiscVFramebuffer *getFramebuffer() { return &FFramebuffer; }
+    TRiscVLibcalls    *getLibcalls()    { return &FLibcalls; }
+    TRiscVStats       *getStats()       { return &FStats; }
+    void               setCaches(TRiscVCaches *ApCaches);
+    unsigned long      getSparsePages() { return FSparse.PageCount; }
+
 protected:
     unsigned long   FPC;
     unsigned long   FReg[32];  // FReg[0] unused (zero reg.)
+    unsigned long   FMisa;     // misa CSR (configuration extensions)
+    TRiscVCfg::TLegalInsn FLegalInsn;   // Decoder of the configuration (CFG leaders)
 
     virtual     void Process();
 
+    // Run loop of the configuration: RunCore<ACore> instances call
+    // ACore::Process() directly (no virtual call per insn)
+    virtual StopReason RunChecked(unsigned long ACount, bool AResume) = 0;
+    template<class ACore>
+            StopReason RunCore   (unsigned long ACount, bool AResume);
+
                 void SetPC(unsigned long ANewPC);
 
        unsigned long getRegister(int AIndex);
@@ -68,20 +291,131 @@ protected:
 
        unsigned long getInstruction();
                char *getMemory(unsigned long AAddress); // MUST NOT BE INSIDE .text SEGMENT!
+               char *LoadPtr  (unsigned long AAddress, int ASize); // Load path (watchpoints)
+               char *StorePtr (unsigned long AAddress, int ASize); // Store path (watchpoints, write tracking)
+
+    // Guarded memory run loop (no watchpoints, hooks or write tracking): the
+    // host MMU checks the address, stores check .text only
+               char *LoadGuarded (unsigned long AAddress) { return FpMemory + AAddress; }
+               char *StoreGuarded(unsigned long AAddress, int ASize);
+
+    // Traps (synchronous: PC = faulting insn, handler PC - 4 as the PC is incremented after the insn)
+                bool CsrRead (int ACsr, unsigned long &AValue);  // false => illegal instruction
+                bool CsrWrite(int ACsr, unsigned long AValue);
+                void RaiseTrap(unsigned long ACause, unsigned long ATval);
+                void ReturnFromTrap();   // mret
+                void WaitForInterrupt(); // wfi
+                bool HasTrapHandler() { return FMachine.Mtvec != 0; }
 
     __property unsigned long Reg[int Index] = { read=getRegister, write=setRegister };
 
 public:
     RiscV();
+    virtual ~RiscV();
 
     void Load (char *ApMemory, unsigned long AcMemory, unsigned long AInitialPC, unsigned long AStackPointer, unsigned long ATextSegmentStart, unsigned long ATextSegmentEnd);
     void Reset(unsigned long AInitialPC, unsigned long AStackPointer);
     void GoTo (unsigned long APC);
     void Step ();
 
+    // Execute up to ACount insns stopping on breakpoints/watchpoints.
+    // AResume => don't stop on a breakpoint at current PC (continue from it)
+    // Time slept in wfi is part of the budget (1 tick = 1 insn)
+    StopReason Run(unsigned long ACount, bool AResume = false);
+
+    // Devices: every value entering the guest from outside must pass through
+    // these, so that reverse execution can replay it (CLINT mtime reads do)
+             void DeviceWrite(unsigned long AAddress, const void *ApData, int ASize);
+    unsigned long DeviceRead (unsigned long AValue);
+
+    // Debugger access: .text not protected, reverse execution history
+    // restarts from the modified state
+    void ReadMemory   (unsigned long AAddress, void *ApData, unsigned long ASize);
+    void WriteMemory  (unsigned long AAddress, const void *ApData, unsigned long ASize);
+    void WriteRegister(int AIndex, unsigned long AValue);
+
+    // Reverse execution (checkpoint every AInterval insns, AInterval=0 => disabled)
+    void EnableHistory(unsigned long AInterval, int AMaxCheckpoints);
+    void StepBack     ();
+    bool ContinueBack (); // Back to last breakpoint/watchpoint hit, false => beginning of history reached
+
     __property unsigned long Registers[int Index] = { read=getRegister };
     __property unsigned long PC                   = { read=FPC };
     __property unsigned long Instruction          = { read=getInstruction };
+    __property unsigned __int64 InstructionCount  = { read=FInstret };
+    __property TRiscVBreakpoints *Breakpoints     = { read=getBreakpoints };
+    __property TRiscVCfg         *Cfg             = { read=getCfg };
+    __property TRiscVFramebuffer *Framebuffer     = { read=getFramebuffer };   // Configure after Load
+
+    // Execution statistics (see TRiscVStats), cleared by Load/Reset. Off =>
+    // the run loop instance without counters
+    __property bool               Statistics      = { read=FStatistics, write=FStatistics };
+    __property TRiscVStats       *Stats           = { read=getStats };
+
+    // Cache timing model (see TRiscVCaches, host owned, NULL => none): every
+    // fetch and guest load/store goes through it. Cleared by Load
+    __property TRiscVCaches      *Caches          = { read=FpCaches, write=setCaches };
+
+    // Pipeline timing model (see TRiscVPipeline, host owned, NULL => none):
+    // every retired insn goes through it. Cleared by Load
+    __property TRiscVPipeline    *Pipeline        = { read=FpPipeline, write=FpPipeline };
+
+    // Call stack sampling profiler (see TRiscVProfiler, host owned, NULL =>
+    // none): fed at every basic block exit. Reset to the entry by Load
+    __property TRiscVProfiler    *Profiler        = { read=FpProfiler, write=FpProfiler };
+
+    // Code coverage (see TRiscVCoverage, host owned, NULL => none): every
+    // retired insn is flagged. Cleared by Load, kept across Reset
+    __property TRiscVCoverage    *Coverage        = { read=FpCoverage, write=FpCoverage };
+
+    // Memory: the host buffer given to Load() is guest memory from address
+    // 0, .text included. With SparseMemory the rest of the 4 GiB space is
+    // sparse (pages allocated on first write, read as zero before; freed by
+    // Load), otherwise accesses beyond the buffer are segmentation faults.
+    // A load/store must not cross a sparse page boundary
+    __property bool             SparseMemory      = { read=FSparseMemory, write=FSparseMemory };
+    __property unsigned long    SparsePages       = { read=getSparsePages };
+
+    // Guard page memory (see TRiscVGuardedMemory, Win64 hosts): set it, then
+    // Load() with its Base and Size. Guest address = host offset with no
+    // bounds checks (.text stores still checked, loads from .text allowed),
+    // faults are caught by the host MMU. CLINT pages must not be mapped:
+    // their accesses fault and are executed again with the checks. Without
+    // watchpoints, per insn hooks, write tracking (fuzzer, state hash) and
+    // framebuffer a load/store is a single add (see RunFlagOn()). Not
+    // together with SparseMemory
+    __property TRiscVGuardedMemory *GuardedMemory = { read=FpGuard, write=FpGuard };
+
+    // Idle loops (no side effects) jump ahead to the end of the Run() budget
+    // (or to the loop exit), observable state is the same of executing them.
+    // Disabled while reverse execution or a timing model is enabled
+    __property bool             IdleSkip          = { read=FIdleSkip, write=FIdleSkip };
+    __property unsigned __int64 IdleInstructions  = { read=FIdleInstructions };
+
+    // libgcc __mulsi3/__divsi3/__udivsi3/__modsi3/__umodsi3 (found by code
+    // signature at Load, Libcalls->AddSymbol() for the others) run as one
+    // native insn when the PC reaches their entry: same a0/a1, PC = ra, per
+    // routine Hits (cleared by Load/Reset). Off by default. The routine
+    // insns are not seen by breakpoints: a breakpoint on the entry runs the
+    // routine normally. Suspended while statistics or a timing model count
+    // every insn
+    __property bool             NativeLibcalls    = { read=FNativeLibcalls, write=FNativeLibcalls };
+    __property TRiscVLibcalls  *Libcalls          = { read=getLibcalls };
+
+    // Traps: machine mode only (mtvec, mepc, mcause, mtval, mstatus, mie/mip,
+    // mret), user mode entered by mret. Synchronous traps (ecall, ebreak,
+    // illegal insn) go to mtvec once the guest sets it, with mtvec = 0 ecall/
+    // ebreak are nops and illegal insns stop the emulator (programs without
+    // a trap handler). Memory faults stop the emulator, with GuardedMemory
+    // they are load/store access faults once mtvec is set.
+    // Interrupts (CLINT timer and software) are taken on basic block entry
+    // only, both by Run() and Step(). mtime is virtual: instructions retired
+    // + ticks slept in wfi (a sleeping hart jumps to the mtimecmp deadline)
+    __property Mode             Privilege         = { read=getPrivilege };
+    __property bool             Waiting           = { read=getWaiting };
+    __property unsigned __int64 Time              = { read=getTime };
+    __property unsigned long    TimerFrequency    = { read=FTimerFrequency, write=FTimerFrequency };
+    __property bool             HostWait          = { read=FHostWait, write=FHostWait };   // wfi sleeps the host thread (TimerFrequency)
     __property         char *Memory[unsigned long Address] = { read=getMemory };
 };
 //---------------------------------------------------------------------------
@@ -91,141 +425,208 @@ public:
 /*                                 3                    2 2   2 1   1 1      1 1
 RV32I                              1                    5 4   0 9   5 4      2 1   7 6      0
 +---------------------------------+----------------------+-----+-----+--------+-----+--------+
-| R-type (Register / register)    | funct7               | rs2 | rs1 | funct3 | rd  | opcode | 0110011 0x33      DecodeFunct_7
-| I-type (Immediate - Bits)       | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 0010011 0x13      DecodeImm_I
-| I-type (Immediate - Load)       | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 0000011 0x03      DecodeImm_I
-| S-type (Store)                  | imm[11:5+4:0]        | rs2 | rs1 | funct3 | imm | opcode | 0100011 0x23      DecodeImm_S
-| B-type (Branch)                 | imm[12+10:5+4:1+11]  | rs2 | rs1 | funct3 | imm | opcode | 1100011 0x63      DecodeImm_B
-| U-type (Upper immediate)        | imm[31:12]                                | rd  | opcode | 0110111 0x37 lui / 0010111 0x17 auipc     DecodeImm_U
-| J-type (Jump) - Only jal        | imm[20+10:1+11+19:12]                     | rd  | opcode | 1101111 0x6F      DecodeImm_J
-| jalr                            | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 1100111 0x67      DecodeImm_I
-| ecall / ebreak                  | imm[31:30]                                | rd  | opcode | 1110011 0x73      DecodeImm_U
-| fence                           |                                           | rd  | opcode | 0001111 0x0f      <nop>
+| R-type (Register / register)    | funct7               | rs2 | rs1 | funct3 | rd  | opcode | 0110011 0x33      fmtR
+| I-type (Immediate - Bits)       | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 0010011 0x13      fmtI
+| I-type (Immediate - Load)       | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 0000011 0x03      fmtI
+| S-type (Store)                  | imm[11:5+4:0]        | rs2 | rs1 | funct3 | imm | opcode | 0100011 0x23      fmtS
+| B-type (Branch)                 | imm[12+10:5+4:1+11]  | rs2 | rs1 | funct3 | imm | opcode | 1100011 0x63      fmtB
+| U-type (Upper immediate)        | imm[31:12]                                | rd  | opcode | 0110111 0x37 lui / 0010111 0x17 auipc     fmtU
+| J-type (Jump) - Only jal        | imm[20+10:1+11+19:12]                     | rd  | opcode | 1101111 0x6F      fmtJ
+| jalr                            | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 1100111 0x67      fmtI
+| ecall / ebreak / mret / wfi     | funct12                    | rs1 | funct3 | rd  | opcode | 1110011 0x73      fmtI
+| csrrw / csrrs / csrrc (+i)      | csr                        | rs1 | funct3 | rd  | opcode | 1110011 0x73      fmtI (rs1 = uimm for *i)
+| fence                           | imm[11:0]                  | rs1 | funct3 | rd  | opcode | 0001111 0x0f      fmtI <nop>
 +---------------------------------+----------------------+-----+-----+--------+-----+--------+
+
+
+Configurations: RiscV_RV32Isa has the one instruction table (rows tagged
+with their extension) and the executors, RiscV_RV32<AExtensions> decodes
+only the rows of AExtensions (RiscV::Extension flags, decode table built at
+compile time) and has its own run loop instances calling Process()
+directly: the extensions left out cost nothing, not even a check.
+Load/store executors are instanced per memory policy (LoadAt/StoreAt), the
+guarded memory run loop decodes to the GuardedHandler column
 */
-class RiscV_RV32I : public RiscV
+class RiscV_RV32Isa : public RiscV
 {
     typedef RiscV inherited;
 
-
-    enum OpCodeType {
-        R_type      = 0x33,
-        I_bits_type = 0x13,
-        I_load_type = 0x03,
-        S_type      = 0x23,
-        B_type      = 0x63,
-        lui         = 0x37,
-        auipc       = 0x17,
-        jal         = 0x6f,
-        jalr        = 0x67,
-        ecall_ebreak= 0x73,
-        fence       = 0x0f
+public:
+    enum InsnFormat {
+        fmtR,
+        fmtI,
+        fmtS,
+        fmtB,
+        fmtU,
+        fmtJ
     };
-    enum OpCode_R {   // funct7   funct3
-        R_add       = 0x000 >>1 | 0x0,  // add+mul+sub 0
-        R_mul       = 0x010 >>1 | 0x0,
-        R_sub       = 0x200 >>1 | 0x0,
-
-        R_ssl       = 0x000 >>1 | 0x1,  // ssl+mulh    1
-        R_mulh      = 0x010 >>1 | 0x1,
 
-        R_slt       = 0x000 >>1 | 0x2,  // slt+mulhsu  2
-        R_mulhsu    = 0x010 >>1 | 0x2,
-
-        R_sltu      = 0x000 >>1 | 0x3,  // sltu+mulhu  3
-        R_mulhu     = 0x010 >>1 | 0x3,
-
-        R_xor       = 0x000 >>1 | 0x4,  // xor+div     4
-        R_div       = 0x010 >>1 | 0x4,
+    typedef void (RiscV_RV32Isa::*THandler)();
+
+    // One row per instruction: (Instruction & Mask) == Match selects Handler
+    typedef struct {
+        const char   *Name;
+        unsigned long Mask;
+        unsigned long Match;
+        Extension     Isa;
+        InsnFormat    Format;
+        THandler      Handler;
+        THandler      GuardedHandler;   // Guarded memory run loop (loads/stores: LoadGuarded/StoreGuarded)
+    } TInsnDesc;
+
+    // Decode table: [opcode[6:2] + funct3][funct7 bits 30,25] => FInsnTable row
+    // (row 0 = illegal instruction), built at compile time from the FInsnTable
+    // rows of a configuration
+    enum {
+        DecodeKeys1 = 256,
+        DecodeKeys2 = 4
+    };
+    typedef struct {
+        unsigned char Row[DecodeKeys1][DecodeKeys2];
+        int           Ambiguous;   // Rows sharing a key (must be 0)
+    } TDecodeTable;
 
-        R_srl       = 0x000 >>1 | 0x5,  // sr          5
-        R_divu      = 0x010 >>1 | 0x5,
-        R_sra       = 0x200 >>1 | 0x5,
+private:
+    static const TDecodeTable FDecodeTable;     // Every extension (tools)
+
+    // Memory policy of the load/store executors: checked (LoadPtr/StorePtr)
+    // or guarded memory run loop (LoadGuarded/StoreGuarded)
+    template<bool AGuarded> char *LoadAt (unsigned long AAddress, int ASize) { return AGuarded ? LoadGuarded(AAddress) : LoadPtr(AAddress, ASize); }
+    template<bool AGuarded> char *StoreAt(unsigned long AAddress, int ASize) { return AGuarded ? StoreGuarded(AAddress, ASize) : StorePtr(AAddress, ASize); }
+
+    // Sign extension by arithmetic shift (no branches)
+    static long DecodeImm_R(unsigned long AInstruction);
+    static long DecodeImm_I(unsigned long AInstruction);
+    static long DecodeImm_S(unsigned long AInstruction);
+    static long DecodeImm_B(unsigned long AInstruction);
+    static long DecodeImm_U(unsigned long AInstruction);
+    static long DecodeImm_J(unsigned long AInstruction);
+
+    // Table handler: immediate extraction for AFormat inlined in every
+    // instruction handler (one indirect call per instruction)
+    template<InsnFormat AFormat, THandler AExecute>
+    void Dispatch();
+
+    void Execute_add   ();
+    void Execute_sub   ();
+    void Execute_sll   ();
+    void Execute_slt   ();
+    void Execute_sltu  ();
+    void Execute_xor   ();
+    void Execute_srl   ();
+    void Execute_sra   ();
+    void Execute_or    ();
+    void Execute_and   ();
+
+    void Execute_mul   ();
+    void Execute_mulh  ();
+    void Execute_mulhsu();
+    void Execute_mulhu ();
+    void Execute_div   ();
+    void Execute_divu  ();
+    void Execute_rem   ();
+    void Execute_remu  ();
+
+    void Execute_addi  ();
+    void Execute_slti  ();
+    void Execute_sltiu ();
+    void Execute_xori  ();
+    void Execute_ori   ();
+    void Execute_andi  ();
+    void Execute_slli  ();
+    void Execute_srli  ();
+    void Execute_srai  ();
+
+    template<bool AGuarded> void Execute_lb    ();
+    template<bool AGuarded> void Execute_lh    ();
+    template<bool AGuarded> void Execute_lw    ();
+    template<bool AGuarded> void Execute_lbu   ();
+    template<bool AGuarded> void Execute_lhu   ();
+
+    template<bool AGuarded> void Execute_sb    ();
+    template<bool AGuarded> void Execute_sh    ();
+    template<bool AGuarded> void Execute_sw    ();
+
+    void Execute_beq   ();
+    void Execute_bne   ();
+    void Execute_blt   ();
+    void Execute_bge   ();
+    void Execute_bltu  ();
+    void Execute_bgeu  ();
 
-        R_or        = 0x000 >>1 | 0x6,  // or+rem      6
-        R_rem       = 0x010 >>1 | 0x6,
+    void Execute_lui   ();
+    void Execute_auipc ();
+    void Execute_jal   ();
+    void Execute_jalr  ();
+    void Execute_system();
+    void Execute_csrrw ();
+    void Execute_csrrs ();
+    void Execute_csrrc ();
+    void Execute_csrrwi();
+    void Execute_csrrsi();
+    void Execute_csrrci();
+    void ExecuteCsr(int AFunct3, unsigned long AOperand);
+    void Execute_fence ();
 
-        R_and       = 0x000 >>1 | 0x7,  // and+remu    7
-        R_remu      = 0x010 >>1 | 0x7
-    };
+    __property  int imm   = { read=Fimm   };
+    __property  int rs1   = { read=Frs1   };
+    __property  int rs2   = { read=Frs2   };
+    __property  int rd    = { read=Frd    };
 
-    enum OpCode_I_load {
-        I_lb        = 0x0,      // rd = M[rs1+imm][0:7]
-        I_lh        = 0x1,      // rd = M[rs1+imm][0:15]
-        I_lw        = 0x2,      // rd = M[rs1+imm][0:31]
-        I_lbu       = 0x4,      // rd = M[rs1+imm][0:7]  zero-extends
-        I_lhu       = 0x5       // rd = M[rs1+imm][0:15] zero-extends
-    };
-    enum OpCode_I_bits {
-        I_addi      = 0x0,      // rd = rs1 + imm
-        I_xori      = 0x4,      // rd = rs1  imm
-        I_ori       = 0x6,      // rd = rs1 | imm
-        I_andi      = 0x7,      // rd = rs1 & imm
-        I_slli      = 0x1,      // imm[5:11]=0x00 rd = rs1 << imm[0:4]
-        I_srli_srai = 0x5,      // imm[5:11]=0x00 rd = rs1 >> imm[0:4] / imm[5:11]=0x20 rd = rs1 >> imm[0:4] msb-extends
-        I_slti      = 0x2,      // rd = (rs1 < imm)?1:0
-        I_sltiu     = 0x3       // rd = (rs1 < imm)?1:0 zero-extends
-    };
-    enum OpCode_S {
-        S_sb        = 0x0,      // M[rs1+imm][0:7]  = rs2[0:7]
-        S_sh        = 0x1,      // M[rs1+imm][0:15] = rs2[0:15]
-        S_sw        = 0x2       // M[rs1+imm][0:31] = rs2[0:31]
-    };
+protected:
+    static const TInsnDesc    FInsnTable[];
+    static const int          FcInsnTable;
 
-    enum OpCode_B {
-        B_beq       = 0x0,      // if(rs1 == rs2) PC += imm
-        B_bne       = 0x1,      // if(rs1 != rs2) PC += imm
-        B_blt       = 0x4,      // if(rs1 <  rs2) PC += imm
-        B_bge       = 0x5,      // if(rs1 >= rs2) PC += imm
-        B_bltu      = 0x6,      // if(rs1 <  rs2) PC += imm zero-extends
-        B_bgeu      = 0x7       // if(rs1 >= rs2) PC += imm zero-extends
-    };
+    template<unsigned long AExtensions>
+    static constexpr TDecodeTable BuildDecodeTable();
+    static int FindRow(unsigned long AInstruction, const TDecodeTable &ATable);    // 0 => illegal
 
-private:
+    unsigned long FInsn;     // Instruction being executed
     int Fimm;
-    int Ffunct;  // funct7 + funct3 = 10-bits function code
     int Frs1;
     int Frs2;
     int Frd;
-    int Fopcode; // Exctracted but unused
-
-    void DecodeFunct_7 ();
-    void DecodeImm_I   ();
-    void DecodeImm_S   ();
-    void DecodeImm_B   ();
-    void DecodeImm_U   ();
-    void DecodeImm_J   ();
-
-    void Execute_R     ();
-    void Execute_I_bits();
-    void Execute_I_load();
-    void Execute_S     ();
-    void Execute_B     ();
-    void Execute_lui   ();
-    void Execute_auipc ();
-    void Execute_jal   ();
-    void Execute_jalr  ();
-    void Execute_ecall_ebreak();
-    void Execute_fence ();
 
+    RiscV_RV32Isa() : RiscV() {}
+
+public:
+    // Instruction set description (tools, table-vs-reference checks), every
+    // extension included
+    static int              InsnCount();
+    static const TInsnDesc &InsnInfo (int AIndex);       // 1..InsnCount()
+    static int              FindInsn (unsigned long AInstruction); // 0 => illegal
+    static long             DecodeImm(unsigned long AInstruction, InsnFormat AFormat);
+};
+
+template<unsigned long AExtensions>
+class RiscV_RV32 : public RiscV_RV32Isa
+{
+    friend class RiscV;     // RunLoop<RiscV_RV32> => Process()
+
+    static const TDecodeTable FDecodeTable;
+
+    template<bool AGuarded>
     bool Decode();
-    void Execute();
 
-    void Execute_IllegalFunction();
+    void ProcessGuardedMemory();    // Guarded memory run loop: TInsnDesc::GuardedHandler
 
-    __property  int imm   = { read=Fimm   };
-    __property  int funct = { read=Ffunct };
-    __property  int rs1   = { read=Frs1   };
-    __property  int rs2   = { read=Frs2   };
-    __property  int rd    = { read=Frd    };
+    static bool IsLegal(unsigned long AInstruction);  // This configuration only
 
 protected:
-    virtual void Process();
+    virtual void       Process();
+    virtual StopReason RunChecked(unsigned long ACount, bool AResume);
 
 public:
-    RiscV_RV32I() : RiscV() {}
+    RiscV_RV32() : RiscV_RV32Isa() { FMisa = misaBase | (AExtensions & extM ? misaM : 0); FLegalInsn = IsLegal; }
 };
 
+typedef RiscV_RV32<RiscV::extZicsr> RiscV_RV32I;
+typedef RiscV_RV32<RiscV::extAll>   RiscV_RV32IM;   // GUI, headless modes
+
+// Instantiated by EmulatorU.cpp
+extern template class RiscV_RV32<RiscV::extZicsr>;
+extern template class RiscV_RV32<RiscV::extAll>;
+
 //---------------------------------------------------------------------------
 #endif
 //---------------------------------------------------------------------------
@@ -0,0 +1,263 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "FramebufferU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+enum {
+    MaxDimension = 8192
+};
+//---------------------------------------------------------------------------
+
+TRiscVFramebuffer::TRiscVFramebuffer()
+{
+    FpMemory = NULL;
+    FcMemory = 0;
+    Disable();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFramebuffer::SetMemory(const char *ApMemory, unsigned long AcMemory)
+{
+    FpMemory = ApMemory;
+    FcMemory = AcMemory;
+    Disable();
+}
+//---------------------------------------------------------------------------
+
+int TRiscVFramebuffer::BytesPerPixel(PixelFormat AFormat)
+{
+    switch (AFormat) {
+        case pixelGray8:    return 1;
+        case pixelRGB565:   return 2;
+        case pixelXRGB8888: return 4;
+    }
+    throw Exception("Invalid pixel format");
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFramebuffer::Configure(unsigned long ABase, int AWidth, int AHeight, PixelFormat AFormat)
+{
+int              cBytesPerPixel = BytesPerPixel(AFormat);
+unsigned __int64 cBytes;
+
+    if (!FpMemory)
+        throw Exception("Program non loaded");
+
+    if (AWidth < 1 || AHeight < 1 || AWidth > MaxDimension || AHeight > MaxDimension)
+        throw Exception("Invalid framebuffer size");
+
+    cBytes = (unsigned __int64)AWidth * AHeight * cBytesPerPixel;
+
+    if (ABase % cBytesPerPixel)
+        throw Exception("Framebuffer address misaligned");
+
+    if (ABase > FcMemory || cBytes > FcMemory - ABase)
+        throw Exception("Framebuffer outside memory");
+
+    FBase          = ABase;
+    FcBytes        = (unsigned long)cBytes;
+    FWidth         = AWidth;
+    FHeight        = AHeight;
+    FFormat        = AFormat;
+    FBytesPerPixel = cBytesPerPixel;
+
+    FTilesX = (AWidth  + TileSize - 1) >> TileBits;
+    FTilesY = (AHeight + TileSize - 1) >> TileBits;
+    FDirtyBits.assign((FTilesX * FTilesY + 31) / 32, 0);
+
+    Invalidate();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFramebuffer::Disable()
+{
+    FBase          = 0;
+    FcBytes        = 0;
+    FWidth         = 0;
+    FHeight        = 0;
+    FFormat        = pixelRGB565;
+    FBytesPerPixel = 2;
+    FTilesX        = 0;
+    FTilesY        = 0;
+    FDirty         = false;
+    FDirtyBits.clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFramebuffer::Invalidate()
+{
+int cTiles = FTilesX * FTilesY;
+
+    for (int c=0; c<cTiles; c++)
+        FDirtyBits[c >> 5] |= 1UL << (c & 31);
+
+    FDirty = cTiles != 0;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFramebuffer::MarkTile(unsigned long APixel)
+{
+int Tile = (int)(APixel / FWidth >> TileBits) * FTilesX + (int)(APixel % FWidth >> TileBits);
+
+    FDirtyBits[Tile >> 5] |= 1UL << (Tile & 31);
+    FDirty = true;
+}
+//---------------------------------------------------------------------------
+
+// Tiles of the pixels in [AOffset, AOffset+ASize): one per tile crossed
+// (a word store touches one or two tiles)
+void TRiscVFramebuffer::MarkDirty(unsigned long AOffset, unsigned long ASize)
+{
+unsigned long Last  = std::min((unsigned __int64)AOffset + ASize, (unsigned __int64)FcBytes) - 1;
+unsigned long Pixel = AOffset / FBytesPerPixel;
+unsigned long End   = Last / FBytesPerPixel + 1;
+unsigned long X;
+
+    if (!ASize)
+        return;
+
+    while (Pixel < End) {
+        MarkTile(Pixel);
+
+        // Next tile column, or first pixel of next row
+        X      = Pixel % FWidth;
+        Pixel += std::min(TileSize - (X & (TileSize - 1)), FWidth - X);
+    }
+}
+//---------------------------------------------------------------------------
+
+unsigned long TRiscVFramebuffer::PixelAt(unsigned long AOffset)
+{
+const unsigned char *p = (const unsigned char *)FpMemory + FBase + AOffset;
+unsigned long        Value;
+
+    switch (FFormat) {
+        case pixelGray8:
+            return *p * 0x010101UL;
+
+        case pixelRGB565:
+            Value = p[0] | (p[1] << 8);
+            return ((Value >> 11) * 255 / 31) << 16
+                 | ((Value >> 5 & 0x3f) * 255 / 63) << 8
+                 | ((Value & 0x1f) * 255 / 31);
+
+        default:
+            return (p[0] | (p[1] << 8) | (p[2] << 16));
+    }
+}
+//---------------------------------------------------------------------------
+
+// Runs of dirty tiles on a tile row make a rectangle, extended downwards
+// when the row below has a run with the same columns
+void TRiscVFramebuffer::CopyDirty(unsigned long *ApFrame, int AStride, std::vector<TDirtyRect> &ARects)
+{
+TDirtyRect Rect;
+int        Tile;
+int        Run;
+size_t     Merged;
+
+    ARects.clear();
+
+    if (!FDirty)
+        return;
+
+    for (int ty=0; ty<FTilesY; ty++)
+        for (int tx=0; tx<FTilesX; tx=Run) {
+            Tile = ty * FTilesX + tx;
+            Run  = tx + 1;
+
+            if (!(FDirtyBits[Tile >> 5] >> (Tile & 31) & 1))
+                continue;
+
+            for (; Run<FTilesX; Run++) {
+                Tile = ty * FTilesX + Run;
+                if (!(FDirtyBits[Tile >> 5] >> (Tile & 31) & 1))
+                    break;
+            }
+
+            Rect.Left   = tx << TileBits;
+            Rect.Top    = ty << TileBits;
+            Rect.Right  = std::min(Run << TileBits, FWidth);
+            Rect.Bottom = std::min((ty + 1) << TileBits, FHeight);
+
+            for (int y=Rect.Top; y<Rect.Bottom; y++)
+                for (int x=Rect.Left; x<Rect.Right; x++)
+                    ApFrame[y * AStride + x] = PixelAt(((unsigned long)y * FWidth + x) * FBytesPerPixel);
+
+            for (Merged=0; Merged<ARects.size(); Merged++)
+                if (ARects[Merged].Bottom == Rect.Top && ARects[Merged].Left == Rect.Left
+                    && ARects[Merged].Right == Rect.Right)
+                        break;
+
+            if (Merged < ARects.size())
+                ARects[Merged].Bottom = Rect.Bottom;
+            else
+                ARects.push_back(Rect);
+        }
+
+    std::fill(FDirtyBits.begin(), FDirtyBits.end(), 0);
+    FDirty = false;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFramebuffer::SavePPM(const String &AFileName)
+{
+char                Header[32];
+std::vector<char>   Data;
+TFileStream        *pStream;
+unsigned long       Pixel;
+size_t              Index;
+
+    if (!FcBytes)
+        throw Exception("Framebuffer not configured");
+
+    sprintf(Header, "P6\n%d %d\n255\n", FWidth, FHeight);
+    Data.assign(Header, Header + strlen(Header));
+    Index = Data.size();
+    Data.resize(Index + (size_t)FWidth * FHeight * 3);
+
+    for (unsigned long Offset=0; Offset<FcBytes; Offset+=FBytesPerPixel) {
+        Pixel         = PixelAt(Offset);
+        Data[Index++] = (char)(Pixel >> 16);
+        Data[Index++] = (char)(Pixel >> 8);
+        Data[Index++] = (char)Pixel;
+    }
+
+    pStream = new TFileStream(AFileName, fmCreate);
+    try
+    {
+        pStream->WriteBuffer(&Data[0], (int)Data.size());
+    }
+    catch(...)
+    {
+        delete pStream;
+        throw;
+    }
+    delete pStream;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,126 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef FramebufferUH
+#define FramebufferUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Linear framebuffer
+
+A window of guest memory (Base, Width x Height pixels, rows packed) read by
+the host as the display. Every guest store and device write landing in the
+window marks the TileSize x TileSize tiles it touches in a bitmap (one
+subtraction and compare per store outside the window); the host copies out
+only the dirty tiles, merged into rectangles, converted to 0x00RRGGBB
+(pf32bit TBitmap scanline layout), or dumps whole frames as binary PPM.
+Pixel formats are little endian:
+    pixelGray8      1 byte,  luminance
+    pixelRGB565     2 bytes, R 15:11 G 10:5 B 4:0
+    pixelXRGB8888   4 bytes, R 23:16 G 15:8 B 7:0
+The window is plain RAM: reverse execution restores it like any other page
+(the whole frame is marked dirty on restore).
+*/
+class TRiscVFramebuffer
+{
+public:
+    enum PixelFormat {
+        pixelGray8,
+        pixelRGB565,
+        pixelXRGB8888
+    };
+
+    enum {
+        TileBits = 4,
+        TileSize = 1 << TileBits
+    };
+
+    typedef struct {
+        int Left;           // Pixels, Right/Bottom excluded
+        int Top;
+        int Right;
+        int Bottom;
+    } TDirtyRect;
+
+private:
+    const char                *FpMemory;
+    unsigned long              FcMemory;
+
+    unsigned long              FBase;
+    unsigned long              FcBytes;         // 0 => disabled
+    int                        FWidth;
+    int                        FHeight;
+    PixelFormat                FFormat;
+    int                        FBytesPerPixel;
+
+    int                        FTilesX;
+    int                        FTilesY;
+    std::vector<unsigned long> FDirtyBits;      // 32 tiles per item, row major
+    bool                       FDirty;          // Any bit set
+
+    void MarkDirty(unsigned long AOffset, unsigned long ASize);
+    void MarkTile (unsigned long APixel);
+    unsigned long PixelAt(unsigned long AOffset);
+
+    bool getEnabled() { return FcBytes != 0; }
+
+public:
+    TRiscVFramebuffer();
+
+    void SetMemory(const char *ApMemory, unsigned long AcMemory);  // Disables the framebuffer
+
+    void Configure(unsigned long ABase, int AWidth, int AHeight, PixelFormat AFormat);
+    void Disable  ();
+
+    // Store path (guest stores, device writes, debugger writes): the range
+    // [AAddress, AAddress + ASize) clipped to the frame (MarkDirty() clips
+    // the end)
+    void OnStore(unsigned long AAddress, unsigned long ASize)
+    {
+        if (AAddress - FBase < FcBytes)
+            MarkDirty(AAddress - FBase, ASize);
+        else if (FBase - AAddress < ASize && FcBytes)   // Starts below the frame
+            MarkDirty(0, ASize - (FBase - AAddress));
+    }
+
+    void Invalidate();      // Whole frame dirty
+
+    // Dirty tiles converted into ApFrame (Width x Height, AStride pixels per
+    // row) and cleared. ARects receives the updated rectangles
+    void CopyDirty(unsigned long *ApFrame, int AStride, std::vector<TDirtyRect> &ARects);
+
+    // Whole frame from guest memory as binary PPM (P6), dirty tiles unchanged
+    void SavePPM(const String &AFileName);
+
+    static int BytesPerPixel(PixelFormat AFormat);
+
+    __property bool          Enabled = { read=getEnabled };
+    __property unsigned long Base    = { read=FBase     };
+    __property unsigned long Size    = { read=FcBytes   };
+    __property int           Width   = { read=FWidth    };
+    __property int           Height  = { read=FHeight   };
+    __property PixelFormat   Format  = { read=FFormat   };
+    __property bool          Dirty   = { read=FDirty    };
+};
+//---------------------------------------------------------------------------
+#endif
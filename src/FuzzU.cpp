@@ -0,0 +1,516 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+
+#include "FuzzU.h"
+#include "StateHashU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const unsigned long SetupInstructions = 1000000000;     // To reach the target
+
+// Symbols treated as crash addresses when the program has them
+static const char *CrashSymbols[] = { "abort", "__assert_func", "__assert_fail", "panic" };
+
+// Boundary values for byte mutations
+static const unsigned char Interesting[] = { 0x00, 0x01, 0x20, 0x40, 0x7F, 0x80, 0xFF };
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Snapshot executor
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+TRiscVFuzzer::TRiscVFuzzer(RiscV *ApCPU)
+{
+    FpCPU       = ApCPU;
+    FReady      = false;
+    FPC         = 0;
+    FInstret    = 0;
+    FExit       = 0;
+    FcRestored  = 0;
+    FBuffer     = 0;
+    FBufferSize = 0;
+    FBudget     = 1000000;
+    FPrevBlock  = 0;
+    FCrashPC    = 0;
+    FMap.assign(MapSize, 0);
+}
+//---------------------------------------------------------------------------
+
+TRiscVFuzzer::~TRiscVFuzzer()
+{
+    if (FpCPU->FpFuzzer == this)
+        FpCPU->FpFuzzer = NULL;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFuzzer::Snapshot(unsigned long ABuffer, unsigned long ABufferSize)
+{
+    if (!FpCPU->FpMemory || FpCPU->FSparseMemory || FpCPU->FpGuard)
+        throw Exception("Fuzzing needs a program loaded in flat memory");
+
+    if (ABuffer >= FpCPU->FcMemory || ABufferSize > FpCPU->FcMemory - ABuffer)
+        throw Exception("Fuzz buffer outside guest memory");
+
+    FMemory.assign(FpCPU->FpMemory, FpCPU->FpMemory + FpCPU->FcMemory);
+    memcpy(FReg, FpCPU->FReg, sizeof(FReg));
+    FPC      = FpCPU->FPC;
+    FInstret = FpCPU->FInstret;
+    FMachine = FpCPU->FMachine;
+    FExit    = FReg[RiscV::ra];
+
+    FDirty.assign((FpCPU->FcMemory + RiscV::PageSize - 1) >> RiscV::PageBits, 0);
+    FDirtyPages.clear();
+
+    FBuffer     = ABuffer;
+    FBufferSize = ABufferSize;
+
+    FpCPU->FBreakpoints.AddBreakpoint(FExit);
+    if (FMachine.Mtvec)
+        FpCPU->FBreakpoints.AddBreakpoint(FMachine.Mtvec & ~3UL);
+
+    FpCPU->FpFuzzer = this;
+    FReady = true;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFuzzer::AddCrash(unsigned long AAddress)
+{
+    FCrashes.insert(AAddress);
+    FpCPU->FBreakpoints.AddBreakpoint(AAddress);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFuzzer::MarkDirty(unsigned long AAddress, unsigned long ASize)
+{
+    for (unsigned long a=AAddress & ~(RiscV::PageSize - 1UL); a<AAddress + ASize; a+=RiscV::PageSize)
+        BeforeWrite(a, 1);
+}
+//---------------------------------------------------------------------------
+
+// Dirty pages only, coverage map cleared
+void TRiscVFuzzer::Restore()
+{
+unsigned long Offset;
+
+    for (size_t p=0; p<FDirtyPages.size(); p++) {
+        Offset = FDirtyPages[p] << RiscV::PageBits;
+        memcpy(FpCPU->FpMemory + Offset, &FMemory[Offset], std::min((unsigned long)RiscV::PageSize, FpCPU->FcMemory - Offset));
+        FDirty[FDirtyPages[p]] = 0;
+
+        if (FpCPU->FpStateHash)
+            FpCPU->FpStateHash->BeforeWrite(Offset, 1);
+    }
+
+    FcRestored = (unsigned long)FDirtyPages.size();
+    FDirtyPages.clear();
+
+    memcpy(FpCPU->FReg, FReg, sizeof(FReg));
+    FpCPU->FPC      = FPC;
+    FpCPU->FInstret = FInstret;
+    FpCPU->FMachine = FMachine;
+
+    FpCPU->FInterruptAt = 0;    // Checked again on next block entry
+    FpCPU->FFramebuffer.Invalidate();
+
+    memset(&FMap[0], 0, MapSize);
+    FPrevBlock = 0;
+}
+//---------------------------------------------------------------------------
+
+TRiscVFuzzer::Result TRiscVFuzzer::TestOneInput(const unsigned char *AData, size_t ASize)
+{
+unsigned long     Length    = ASize < FBufferSize ? (unsigned long)ASize : FBufferSize;
+unsigned long     Remaining = FBudget;
+unsigned __int64  Start;
+RiscV::StopReason Stop;
+bool              Resume    = false;
+unsigned long     Cause;
+char              Reason[64];
+
+    if (!FReady)
+        throw Exception("No fuzzing snapshot");
+
+    Restore();
+
+    MarkDirty(FBuffer, Length);
+    if (Length)
+        memcpy(FpCPU->FpMemory + FBuffer, AData, Length);
+    if (FpCPU->FpStateHash && Length)
+        FpCPU->FpStateHash->BeforeWrite(FBuffer, Length);
+    FpCPU->FReg[RiscV::a0] = FBuffer;
+    FpCPU->FReg[RiscV::a1] = Length;
+
+    FCrashReason = "";
+    FCrashPC     = 0;
+
+    for (;;) {
+        Start = FpCPU->FInstret;
+
+        try
+        {
+            Stop = FpCPU->Run(Remaining, Resume);
+        }
+        catch (Exception &exception)
+        {
+            FCrashReason = exception.Message;
+            FCrashPC     = FpCPU->FPC;
+            return fuzzCrash;
+        }
+
+        Remaining -= (unsigned long)std::min(FpCPU->FInstret - Start, (unsigned __int64)Remaining);
+
+        if (Stop != RiscV::stopBreakpoint)
+            return fuzzTimeout;     // Budget over, or wfi nothing can wake
+
+        if (FpCPU->FPC == FExit)
+            return fuzzExit;
+
+        if (FCrashes.count(FpCPU->FPC)) {
+            FCrashReason = "Crash address";
+            FCrashPC     = FpCPU->FPC;
+            return fuzzCrash;
+        }
+
+        // Trap handler entry: interrupts and environment calls go on
+        Cause = FpCPU->FMachine.Mcause;
+        if ((Cause & RiscV::causeInterrupt) || Cause == RiscV::causeEcallUser || Cause == RiscV::causeEcallMachine) {
+            Resume = true;
+            continue;
+        }
+
+        sprintf(Reason, "Trap cause %lu, mtval 0x%08lx", Cause, FpCPU->FMachine.Mtval);
+        FCrashReason = Reason;
+        FCrashPC     = FpCPU->FMachine.Mepc;
+        return fuzzCrash;
+    }
+}
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Campaign
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Edge hit count => AFL bucket bit
+static unsigned char Bucket(unsigned char ACount)
+{
+    if (ACount < 3)
+        return ACount;
+    if (ACount == 3)
+        return 4;
+    if (ACount < 8)
+        return 8;
+    if (ACount < 16)
+        return 16;
+    if (ACount < 32)
+        return 32;
+
+    return ACount < 128 ? 64 : 128;
+}
+//---------------------------------------------------------------------------
+
+TRiscVFuzzCampaign::TRiscVFuzzCampaign() : FFuzzer(&FCPU)
+{
+    FVirgin.assign(TRiscVFuzzer::MapSize, 0);
+    FSeed       = (unsigned long)time(NULL) | 1;
+    FcEdges     = 0;
+    FBufferSize = 0;
+}
+//---------------------------------------------------------------------------
+
+// Symbol name or number
+unsigned long TRiscVFuzzCampaign::Address(const String &ASymbol)
+{
+unsigned long Address;
+int           Value;
+
+    if (FImage.FindSymbol(AnsiString(ASymbol).c_str(), Address))
+        return Address;
+
+    if (!TryStrToInt(ASymbol, Value))
+        throw Exception("Unknown symbol: " + ASymbol);
+
+    return (unsigned long)Value;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFuzzCampaign::Setup(const String &AFileName, const String &ATarget, const String &ABuffer,
+                               unsigned long ABufferSize, unsigned long AStackSize)
+{
+unsigned long Target;
+unsigned long Crash;
+
+    FImage.LoadFromFile(AFileName);
+    FImage.LoadCore(FCPU, FRam, AStackSize);
+
+    Target = Address(ATarget);
+    FCPU.Breakpoints->AddBreakpoint(Target);
+
+    if (FCPU.Run(SetupInstructions) != RiscV::stopBreakpoint || FCPU.PC != Target)
+        throw Exception("Fuzz target not reached: " + ATarget);
+
+    FCPU.Breakpoints->RemoveBreakpoint(Target);
+
+    FBufferSize = ABufferSize;
+    FFuzzer.Snapshot(Address(ABuffer), ABufferSize);
+
+    for (size_t s=0; s<sizeof(CrashSymbols)/sizeof(CrashSymbols[0]); s++)
+        if (FImage.FindSymbol(CrashSymbols[s], Crash))
+            FFuzzer.AddCrash(Crash);
+}
+//---------------------------------------------------------------------------
+
+// xorshift32
+unsigned long TRiscVFuzzCampaign::Random(unsigned long ARange)
+{
+    FSeed ^= FSeed << 13;
+    FSeed ^= FSeed >> 17;
+    FSeed ^= FSeed << 5;
+
+    return ARange ? FSeed % ARange : 0;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFuzzCampaign::Mutate(TInput &AInput)
+{
+int           cMutations = 1 + Random(4);
+unsigned long Length, From, To;
+
+    for (int m=0; m<cMutations; m++)
+        switch (Random(7)) {
+            case 0:     // Bit flip
+                if (!AInput.empty())
+                    AInput[Random(AInput.size())] ^= 1 << Random(8);
+                break;
+
+            case 1:     // Random byte
+                if (!AInput.empty())
+                    AInput[Random(AInput.size())] = (unsigned char)Random(256);
+                break;
+
+            case 2:     // Boundary byte
+                if (!AInput.empty())
+                    AInput[Random(AInput.size())] = Interesting[Random(sizeof(Interesting))];
+                break;
+
+            case 3:     // Insert
+                if (AInput.size() < FBufferSize)
+                    AInput.insert(AInput.begin() + Random(AInput.size() + 1), (unsigned char)Random(256));
+                break;
+
+            case 4:     // Delete
+                if (AInput.size() > 1)
+                    AInput.erase(AInput.begin() + Random(AInput.size()));
+                break;
+
+            case 5:     // Copy a chunk over another place
+                if (AInput.size() >= 2) {
+                    Length = 1 + Random(AInput.size() / 2);
+                    From   = Random(AInput.size() - Length + 1);
+                    To     = Random(AInput.size() - Length + 1);
+                    memmove(&AInput[To], &AInput[From], Length);
+                }
+                break;
+
+            case 6: {   // Splice: head of this one, tail of another corpus input
+                const TInput &Other = FCorpus[Random(FCorpus.size())];
+
+                To = Random(std::min(AInput.size(), Other.size()) + 1);
+                AInput.resize(To);
+                AInput.insert(AInput.end(), Other.begin() + To, Other.end());
+                break;
+            }
+        }
+
+    if (AInput.size() > FBufferSize)
+        AInput.resize(FBufferSize);
+}
+//---------------------------------------------------------------------------
+
+// Edges or hit count buckets not seen before (map scanned by 64-bit words)
+bool TRiscVFuzzCampaign::NewCoverage()
+{
+const unsigned char    *pMap   = FFuzzer.Map;
+const unsigned __int64 *pWords = (const unsigned __int64 *)pMap;
+unsigned char           Bits;
+bool                    New    = false;
+
+    for (int w=0; w<TRiscVFuzzer::MapSize / 8; w++)
+        if (pWords[w])
+            for (int i=w*8; i<w*8 + 8; i++) {
+                Bits = pMap[i] ? Bucket(pMap[i]) : 0;
+
+                if (Bits & ~FVirgin[i]) {
+                    if (!FVirgin[i])
+                        FcEdges++;
+
+                    FVirgin[i] |= Bits;
+                    New = true;
+                }
+            }
+
+    return New;
+}
+//---------------------------------------------------------------------------
+
+TRiscVFuzzCampaign::TInput TRiscVFuzzCampaign::LoadInput(const String &AFileName)
+{
+TFileStream *pStream = new TFileStream(AFileName, fmOpenRead | fmShareDenyWrite);
+TInput       Input;
+
+    try
+    {
+        Input.resize((size_t)pStream->Size);
+        if (!Input.empty())
+            pStream->ReadBuffer(&Input[0], (int)Input.size());
+    }
+    catch(...)
+    {
+        delete pStream;
+        throw;
+    }
+    delete pStream;
+
+    return Input;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVFuzzCampaign::SaveInput(const String &AFileName, const TInput &AInput)
+{
+TFileStream *pStream = new TFileStream(AFileName, fmCreate);
+
+    try
+    {
+        if (!AInput.empty())
+            pStream->WriteBuffer(&AInput[0], (int)AInput.size());
+    }
+    catch(...)
+    {
+        delete pStream;
+        throw;
+    }
+    delete pStream;
+}
+//---------------------------------------------------------------------------
+
+// Corpus files are the seeds (crash-* skipped), an empty corpus starts from one zero byte
+int TRiscVFuzzCampaign::Fuzz(const String &ACorpus, unsigned long ARuns, TStrings *AReport)
+{
+String                 Directory = IncludeTrailingPathDelimiter(ACorpus);
+TSearchRec             SearchRec;
+TInput                 Input;
+TRiscVFuzzer::Result   Result;
+int                    cCrashes  = 0;
+int                    cSaved    = 0;
+unsigned long          cTimeouts = 0;
+char                   Line[300];
+double                 Seconds;
+
+std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+    if (FindFirst(Directory + "*", faAnyFile & ~faDirectory, SearchRec) == 0) {
+        do {
+            if (SearchRec.Name.Pos("crash-") != 1)
+                FCorpus.push_back(LoadInput(Directory + SearchRec.Name));
+        } while (FindNext(SearchRec) == 0);
+
+        FindClose(SearchRec);
+    }
+
+    if (FCorpus.empty())
+        FCorpus.push_back(TInput(1, 0));
+
+    for (size_t c=0; c<FCorpus.size(); c++) {
+        FFuzzer.TestOneInput(FCorpus[c].empty() ? NULL : &FCorpus[c][0], FCorpus[c].size());
+        NewCoverage();
+    }
+
+    for (unsigned long r=0; r<ARuns; r++) {
+        Input = FCorpus[Random(FCorpus.size())];
+        Mutate(Input);
+
+        Result = FFuzzer.TestOneInput(Input.empty() ? NULL : &Input[0], Input.size());
+
+        if (Result == TRiscVFuzzer::fuzzCrash) {
+            if (FCrashPCs.insert(FFuzzer.CrashPC).second) {
+                sprintf(Line, "crash-%06d", cCrashes++);
+                SaveInput(Directory + Line, Input);
+
+                sprintf(Line + strlen(Line), ": pc 0x%08lx, %s", FFuzzer.CrashPC, AnsiString(FFuzzer.CrashReason).c_str());
+                AReport->Add(Line);
+            }
+        }
+        else if (Result == TRiscVFuzzer::fuzzTimeout)
+            cTimeouts++;
+        else if (NewCoverage()) {
+            FCorpus.push_back(Input);
+
+            do
+                sprintf(Line, "id-%06d", cSaved++);
+            while (FileExists(Directory + Line));
+            SaveInput(Directory + Line, Input);
+        }
+    }
+
+    Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    sprintf(Line, "%lu executions in %.1f s (%.0f/s), corpus %d, edges %lu, crashes %d, timeouts %lu",
+            ARuns, Seconds, Seconds > 0 ? ARuns / Seconds : 0.0, (int)FCorpus.size(), FcEdges, cCrashes, cTimeouts);
+    AReport->Add(Line);
+
+    return cCrashes;
+}
+//---------------------------------------------------------------------------
+
+TRiscVFuzzer::Result TRiscVFuzzCampaign::Replay(const String &AFileName, TStrings *AReport)
+{
+TInput               Input  = LoadInput(AFileName);
+TRiscVFuzzer::Result Result = FFuzzer.TestOneInput(Input.empty() ? NULL : &Input[0], Input.size());
+char                 Line[300];
+
+    switch (Result) {
+        case TRiscVFuzzer::fuzzExit:
+            sprintf(Line, "exit, %lu pages restored", FFuzzer.PagesRestored);
+            break;
+
+        case TRiscVFuzzer::fuzzCrash:
+            sprintf(Line, "crash: pc 0x%08lx, %s", FFuzzer.CrashPC, AnsiString(FFuzzer.CrashReason).c_str());
+            break;
+
+        default:
+            sprintf(Line, "timeout (%lu insns)", FFuzzer.Budget);
+            break;
+    }
+
+    AReport->Add(Line);
+    return Result;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,182 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef FuzzUH
+#define FuzzUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <set>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+#include "ElfU.h"
+//---------------------------------------------------------------------------
+
+/*
+Snapshot fuzzing
+
+The guest runs up to the entry of the fuzz target, a function
+    void target(const unsigned char *data, unsigned long size);
+where Snapshot() saves registers, trap state and the whole (flat) guest
+memory; ra at that point is the exit address. Every TestOneInput() call
+(libFuzzer style entry point) restores the snapshot, copies the input into
+the guest buffer, passes buffer and size in a0/a1 and runs until:
+  - the target returns                                  => fuzzExit
+  - a guest fault (core exception), an exception trap
+    entering the handler (mtvec) or a Crash address    => fuzzCrash
+  - Budget insns or a wfi nothing can wake             => fuzzTimeout
+Guest stores mark their page dirty (core hook, one bit per page) and the
+restore copies back only those pages, so reset cost follows the pages the
+input touched, not the memory size.
+Edge coverage is an AFL style map of 8-bit counters indexed by (previous
+block ^ block) hashes, fed by the core at every basic block exit. A libFuzzer
+build can register Map with __sanitizer_cov_8bit_counters_init().
+*/
+class TRiscVFuzzer
+{
+public:
+    enum Result {
+        fuzzExit,
+        fuzzCrash,
+        fuzzTimeout
+    };
+
+    enum {
+        MapSize = 1 << 16
+    };
+
+private:
+    RiscV                      *FpCPU;
+    bool                        FReady;         // Snapshot taken
+
+    // Snapshot
+    std::vector<char>           FMemory;
+    unsigned long               FReg[32];
+    unsigned long               FPC;
+    unsigned __int64            FInstret;
+    RiscV::TMachineState        FMachine;
+    unsigned long               FExit;          // ra at the target entry
+
+    std::vector<unsigned char>  FDirty;         // Per page: written since restore
+    std::vector<unsigned long>  FDirtyPages;
+    unsigned long               FcRestored;     // Pages copied by the last restore
+
+    unsigned long               FBuffer;        // Guest input buffer
+    unsigned long               FBufferSize;
+    unsigned long               FBudget;        // Insns per execution
+    std::set<unsigned long>     FCrashes;       // Crash addresses (abort, assert...)
+
+    std::vector<unsigned char>  FMap;
+    unsigned long               FPrevBlock;
+
+    String                      FCrashReason;
+    unsigned long               FCrashPC;
+
+    void Restore();
+    void MarkDirty(unsigned long AAddress, unsigned long ASize);
+
+    const unsigned char *getMap() { return &FMap[0]; }
+
+public:
+    TRiscVFuzzer(RiscV *ApCPU);
+    ~TRiscVFuzzer();
+
+    // CPU stopped at the target entry (flat memory only), hooks installed
+    void   Snapshot(unsigned long ABuffer, unsigned long ABufferSize);
+    void   AddCrash(unsigned long AAddress);
+
+    Result TestOneInput(const unsigned char *AData, size_t ASize);  // Input truncated to the buffer size
+
+    // Hooks called by the core
+    void BeforeWrite(unsigned long AAddress, int ASize)
+    {
+        unsigned long Page = AAddress >> RiscV::PageBits;
+
+        if (Page < FDirty.size() && !FDirty[Page]) {
+            FDirty[Page] = 1;
+            FDirtyPages.push_back(Page);
+        }
+
+        if (((AAddress + ASize - 1) >> RiscV::PageBits) != Page)
+            BeforeWrite(AAddress + ASize - 1, 1);
+    }
+
+    void Edge(unsigned long APC)
+    {
+        unsigned long Block = (APC * 2654435761UL) >> 16;
+
+        FMap[(Block ^ FPrevBlock) & (MapSize - 1)]++;
+        FPrevBlock = (Block & (MapSize - 1)) >> 1;
+    }
+
+    __property const unsigned char *Map          = { read=getMap };     // MapSize counters, last execution
+    __property unsigned long        Budget       = { read=FBudget, write=FBudget };
+    __property unsigned long        PagesRestored = { read=FcRestored };
+    __property String               CrashReason  = { read=FCrashReason };
+    __property unsigned long        CrashPC      = { read=FCrashPC };
+};
+
+/*
+Coverage-guided fuzzing campaign (headless): the ELF program runs to the
+target once, then inputs mutated from the corpus (bit flips, random and
+boundary bytes, inserts, deletes, copies, splices) are executed; an input
+hitting an edge or an edge count bucket (1, 2, 3, 4-7, 8-15, 16-31, 32-127,
+128+) not seen before joins the corpus and is saved as id-<n>, the first
+input crashing at every address as crash-<n>.
+*/
+class TRiscVFuzzCampaign
+{
+    typedef std::vector<unsigned char> TInput;
+
+    TElfImage                   FImage;
+    std::vector<char>           FRam;
+    RiscV_RV32IM                FCPU;
+    TRiscVFuzzer                FFuzzer;
+
+    std::vector<TInput>         FCorpus;
+    std::vector<unsigned char>  FVirgin;        // Buckets seen, per map entry
+    std::set<unsigned long>     FCrashPCs;
+    unsigned long               FSeed;
+    unsigned long               FcEdges;        // Map entries ever hit
+    unsigned long               FBufferSize;
+
+    unsigned long Random(unsigned long ARange);
+    void          Mutate(TInput &AInput);
+    bool          NewCoverage();
+    unsigned long Address(const String &ASymbol);
+
+    static TInput LoadInput(const String &AFileName);
+    static void   SaveInput(const String &AFileName, const TInput &AInput);
+
+public:
+    TRiscVFuzzCampaign();
+
+    void Setup(const String &AFileName, const String &ATarget, const String &ABuffer, unsigned long ABufferSize,
+               unsigned long AStackSize);
+    int  Fuzz  (const String &ACorpus, unsigned long ARuns, TStrings *AReport);   // Returns crashes found
+    TRiscVFuzzer::Result Replay(const String &AFileName, TStrings *AReport);
+
+    __property TRiscVFuzzer *Fuzzer = { read=getFuzzer };
+
+private:
+    TRiscVFuzzer *getFuzzer() { return &FFuzzer; }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,901 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <exception>
+
+#ifdef _WIN32
+#include <winsock.h>
+#pragma comment(lib, "wsock32.lib")
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define INVALID_SOCKET  (-1)
+#define closesocket     close
+#endif
+
+#include "GdbServerU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const unsigned long PacketSize = 0x4000;    // qSupported PacketSize=4000, longest reply too
+
+static const char TargetXml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<architecture>riscv:rv32</architecture>"
+    "</target>";
+//---------------------------------------------------------------------------
+
+static int HexDigit(char AChar)
+{
+    if (AChar >= '0' && AChar <= '9') return AChar - '0';
+    if (AChar >= 'a' && AChar <= 'f') return AChar - 'a' + 10;
+    if (AChar >= 'A' && AChar <= 'F') return AChar - 'A' + 10;
+
+    throw Exception("Invalid hex digit");
+}
+//---------------------------------------------------------------------------
+
+static std::string HexBytes(const unsigned char *ApData, unsigned long ASize)
+{
+static const char Digits[] = "0123456789abcdef";
+std::string Result;
+
+    for (unsigned long c=0; c<ASize; c++) {
+        Result += Digits[ApData[c] >> 4];
+        Result += Digits[ApData[c] & 15];
+    }
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+// Register values are sent in target (little endian) byte order
+static std::string HexWord(unsigned long AValue)
+{
+unsigned char Bytes[4];
+
+    for (int c=0; c<4; c++)
+        Bytes[c] = (unsigned char)(AValue >> (c * 8));
+
+    return HexBytes(Bytes, 4);
+}
+//---------------------------------------------------------------------------
+
+static unsigned long WordHex(const char *ApHex)
+{
+unsigned long Value = 0;
+
+    for (int c=0; c<4; c++)
+        Value |= (unsigned long)(HexDigit(ApHex[c*2]) << 4 | HexDigit(ApHex[c*2+1])) << (c * 8);
+
+    return Value;
+}
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Connection
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+TGdbServer::TGdbServer(RiscV *ApCPU)
+{
+#ifdef _WIN32
+WSADATA Data;
+
+    if (WSAStartup(MAKEWORD(1, 1), &Data))
+        throw Exception("Winsock not available");
+#endif
+
+    FpCPU     = ApCPU;
+    FListen   = INVALID_SOCKET;
+    FClient   = INVALID_SOCKET;
+    FPort     = 0;
+    FNoAck    = false;
+    FRunChunk = 100000;
+}
+//---------------------------------------------------------------------------
+
+TGdbServer::~TGdbServer()
+{
+    Close();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+//---------------------------------------------------------------------------
+
+void TGdbServer::Listen(unsigned short APort)
+{
+sockaddr_in Address;
+socklen_t   Length = sizeof(Address);
+int         Reuse  = 1;
+
+    Close();
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family      = AF_INET;
+    Address.sin_port        = htons(APort);
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    FListen = socket(AF_INET, SOCK_STREAM, 0);
+    if (FListen == (TSocket)INVALID_SOCKET)
+        throw Exception("Cannot create socket");
+
+    setsockopt(FListen, SOL_SOCKET, SO_REUSEADDR, (const char *)&Reuse, sizeof(Reuse));
+
+    if (bind(FListen, (sockaddr *)&Address, sizeof(Address))
+        || listen(FListen, 1)
+        || getsockname(FListen, (sockaddr *)&Address, &Length)) {
+            Close();
+            throw Exception("Cannot listen on port " + IntToStr(APort));
+    }
+
+    FPort = ntohs(Address.sin_port);
+}
+//---------------------------------------------------------------------------
+
+void TGdbServer::Close()
+{
+    if (FClient != (TSocket)INVALID_SOCKET) {
+        shutdown(FClient, 2);
+        closesocket(FClient);
+        FClient = INVALID_SOCKET;
+    }
+
+    if (FListen != (TSocket)INVALID_SOCKET) {
+        shutdown(FListen, 2);
+        closesocket(FListen);
+        FListen = INVALID_SOCKET;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool TGdbServer::Serve()
+{
+TSocket     Listener = FListen;
+TSocket     Client;
+std::string Packet;
+std::string Reply;
+bool        Detach = false;
+int         NoDelay = 1;
+
+    if (Listener == (TSocket)INVALID_SOCKET)
+        return false;
+
+    Client = accept(Listener, NULL, NULL);
+    if (Client == (TSocket)INVALID_SOCKET)
+        return false;   // Closed
+
+    setsockopt(Client, IPPROTO_TCP, TCP_NODELAY, (const char *)&NoDelay, sizeof(NoDelay));
+
+    FClient = Client;
+    FNoAck  = false;
+    FInput.clear();
+
+    while (!Detach && GetPacket(Packet)) {
+        try {
+            Reply = Handle(Packet, Detach);
+        }
+        catch (Exception &e) {
+            Reply = "E01";
+        }
+        catch (std::exception &e) {     // Allocation, containers
+            Reply = "E01";
+        }
+
+        if (Packet != "k")
+            PutPacket(Reply);
+
+        if (Packet == "QStartNoAckMode")
+            FNoAck = true;
+    }
+
+    ClearPoints();
+
+    if (FClient != (TSocket)INVALID_SOCKET) {
+        closesocket(FClient);
+        FClient = INVALID_SOCKET;
+    }
+
+    return FListen != (TSocket)INVALID_SOCKET;
+}
+//---------------------------------------------------------------------------
+
+bool TGdbServer::Receive(bool AWait)
+{
+fd_set  Set;
+timeval Timeout = { 0, 0 };
+char    Buffer[4096];
+int     Length;
+
+    if (FClient == (TSocket)INVALID_SOCKET)
+        return false;
+
+    FD_ZERO(&Set);
+    FD_SET(FClient, &Set);
+
+    if (select((int)FClient + 1, &Set, NULL, NULL, AWait ? NULL : &Timeout) <= 0)
+        return !AWait;
+
+    Length = recv(FClient, Buffer, sizeof(Buffer), 0);
+    if (Length <= 0)
+        return false;
+
+    FInput.append(Buffer, Length);
+    return true;
+}
+//---------------------------------------------------------------------------
+
+// $<payload>#<checksum>, acks and stray bytes are skipped
+bool TGdbServer::GetPacket(std::string &APacket)
+{
+size_t        Start;
+size_t        End;
+unsigned char Sum;
+
+    for (;;) {
+        Start = FInput.find('$');
+        End   = (Start == std::string::npos) ? Start : FInput.find('#', Start);
+
+        if (End != std::string::npos && End + 2 < FInput.size()) {
+            APacket = FInput.substr(Start + 1, End - Start - 1);
+
+            Sum = 0;
+            for (size_t c=0; c<APacket.size(); c++)
+                Sum += (unsigned char)APacket[c];
+
+            try {
+                if (Sum != (HexDigit(FInput[End+1]) << 4 | HexDigit(FInput[End+2])))
+                    Start = std::string::npos;
+            }
+            catch (Exception &e) {
+                Start = std::string::npos;
+            }
+
+            FInput.erase(0, End + 3);
+
+            if (!FNoAck)
+                send(FClient, Start == std::string::npos ? "-" : "+", 1, 0);
+
+            if (Start != std::string::npos && !APacket.empty())
+                return true;
+
+            continue;
+        }
+
+        if (Start == std::string::npos)
+            FInput.clear();     // Acks, Ctrl-C while stopped
+
+        if (!Receive(true))
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+
+void TGdbServer::PutPacket(const std::string &APacket)
+{
+static const char Digits[] = "0123456789abcdef";
+std::string   Frame = "$" + APacket + "#";
+unsigned char Sum   = 0;
+size_t        Ack;
+
+    for (size_t c=0; c<APacket.size(); c++)
+        Sum += (unsigned char)APacket[c];
+
+    Frame += Digits[Sum >> 4];
+    Frame += Digits[Sum & 15];
+
+    for (;;) {
+        if (send(FClient, Frame.data(), (int)Frame.size(), 0) != (int)Frame.size() || FNoAck)
+            return;
+
+        while ((Ack = FInput.find_first_of("+-")) == std::string::npos)
+            if (!Receive(true))
+                return;
+
+        if (FInput[Ack] == '+') {
+            FInput.erase(0, Ack + 1);
+            return;
+        }
+
+        FInput.erase(0, Ack + 1);   // '-' => retransmit
+    }
+}
+//---------------------------------------------------------------------------
+
+// Ctrl-C (0x03) received while the target is running
+bool TGdbServer::Interrupted()
+{
+size_t Break;
+
+    if (!Receive(false))
+        return true;    // Connection lost => stop
+
+    Break = FInput.find('\x03');
+    if (Break == std::string::npos)
+        return false;
+
+    FInput.erase(Break, 1);
+    return true;
+}
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Commands
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+std::string TGdbServer::Handle(const std::string &APacket, bool &ADetach)
+{
+const char   *pArgs = APacket.c_str() + 1;
+char         *pEnd;
+unsigned long Address;
+unsigned long Length;
+std::string   Data;
+size_t        Colon;
+
+    switch (APacket[0]) {
+        case '?':
+            return "S05";
+
+        case 'g':
+            return ReadRegisters();
+
+        case 'G':
+            WriteRegisters(APacket.substr(1));
+            return "OK";
+
+        case 'p':
+            return ReadRegister(strtoul(pArgs, NULL, 16));
+
+        case 'P':
+            pEnd = NULL;
+            Address = strtoul(pArgs, &pEnd, 16);
+            if (*pEnd != '=' || strlen(pEnd + 1) < 8)
+                return "E01";
+
+            WriteRegister(Address, WordHex(pEnd + 1));
+            return "OK";
+
+        case 'm':
+            Address = strtoul(pArgs, &pEnd, 16);
+            Length  = strtoul(pEnd + 1, NULL, 16);
+            return ReadMemory(Address, Length);
+
+        case 'M':
+        case 'X':
+            Address = strtoul(pArgs, &pEnd, 16);
+            Length  = strtoul(pEnd + 1, NULL, 16);
+            Colon   = APacket.find(':');
+            if (Colon == std::string::npos)
+                return "E01";
+
+            for (size_t c=Colon+1; c<APacket.size(); c++)
+                if (APacket[0] == 'M') {
+                    Data += (char)(HexDigit(APacket[c]) << 4 | HexDigit(APacket[c+1]));
+                    c++;
+                }
+                else if (APacket[c] == '}' && c + 1 < APacket.size())
+                    Data += (char)(APacket[++c] ^ 0x20);
+                else
+                    Data += APacket[c];
+
+            if (Data.size() != Length)
+                return "E01";
+
+            if (Length)
+                FpCPU->WriteMemory(Address, Data.data(), Length);
+            return "OK";
+
+        case 's':
+            return Step();
+
+        case 'c':
+            if (*pArgs)
+                FpCPU->GoTo(strtoul(pArgs, NULL, 16));
+            return Continue();
+
+        case 'Z':
+            return InsertPoint(APacket.substr(1));
+
+        case 'z':
+            return RemovePoint(APacket.substr(1));
+
+        case 'H':
+        case 'T':
+            return "OK";    // Single thread
+
+        case 'D':
+            ADetach = true;
+            return "OK";
+
+        case 'k':
+            ADetach = true;
+            return "";
+
+        case 'q':
+        case 'Q':
+            return Query(APacket);
+
+        case 'v':
+            if (APacket.compare(0, 5, "vKill") == 0) {
+                ADetach = true;
+                return "OK";
+            }
+            return "";      // vCont, vMustReplyEmpty, ...
+    }
+
+    return "";              // Unsupported
+}
+//---------------------------------------------------------------------------
+
+std::string TGdbServer::StopReply(RiscV::StopReason AReason)
+{
+TRiscVBreakpoints *pEngine = FpCPU->Breakpoints;
+char               Buffer[64];
+
+    if (AReason == RiscV::stopWatchpoint)
+        for (size_t c=0; c<FWatches.size(); c++)
+            if (FWatches[c].Id == pEngine->HitId) {
+                sprintf(Buffer, "T05%s:%lx;",
+                    FWatches[c].Type == '2' ? "watch" : FWatches[c].Type == '3' ? "rwatch" : "awatch",
+                    pEngine->HitAddress);
+                return Buffer;
+            }
+
+    // Breakpoints/watchpoints set by the emulator UI are plain traps for GDB
+    return "S05";
+}
+//---------------------------------------------------------------------------
+
+// Core exceptions (segmentation fault, illegal instruction, ...) are shown on
+// the GDB console and reported as SIGSEGV
+std::string TGdbServer::Fault(Exception &AException)
+{
+AnsiString  Message = AnsiString(AException.Message + "\n");
+
+    PutPacket("O" + HexBytes((const unsigned char *)Message.c_str(), Message.Length()));
+
+    return "S0b";
+}
+//---------------------------------------------------------------------------
+
+std::string TGdbServer::Step()
+{
+    FpCPU->Breakpoints->ResetHit();
+
+    try {
+        FpCPU->Step();
+    }
+    catch (Exception &e) {
+        return Fault(e);
+    }
+
+    return FpCPU->Breakpoints->WatchHit ? StopReply(RiscV::stopWatchpoint) : std::string("S05");
+}
+//---------------------------------------------------------------------------
+
+// Runs in chunks of FRunChunk insns through the fast run loop, polling Ctrl-C
+// in between (also while the hart sleeps in wfi)
+std::string TGdbServer::Continue()
+{
+RiscV::StopReason Reason;
+bool              Resume = true;
+
+    try {
+        for (;;) {
+            Reason = FpCPU->Run(FRunChunk, Resume);
+            Resume = false;
+
+            if (Reason != RiscV::stopCount && Reason != RiscV::stopWait)
+                return StopReply(Reason);
+
+            if (Interrupted())
+                return "S02";
+        }
+    }
+    catch (Exception &e) {
+        return Fault(e);
+    }
+}
+//---------------------------------------------------------------------------
+
+// x0..x31, pc
+std::string TGdbServer::ReadRegisters()
+{
+std::string Result;
+
+    for (int c=0; c<=32; c++)
+        Result += ReadRegister(c);
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+void TGdbServer::WriteRegisters(const std::string &AHex)
+{
+    if (AHex.size() < 33 * 8)
+        throw Exception("Register packet too short");
+
+    for (int c=1; c<=32; c++)
+        WriteRegister(c, WordHex(AHex.c_str() + c * 8));
+}
+//---------------------------------------------------------------------------
+
+std::string TGdbServer::ReadRegister(int AIndex)
+{
+    if (AIndex < 0 || AIndex > 32)
+        return "E01";
+
+    return HexWord(AIndex == 32 ? FpCPU->PC : FpCPU->Registers[AIndex]);
+}
+//---------------------------------------------------------------------------
+
+void TGdbServer::WriteRegister(int AIndex, unsigned long AValue)
+{
+    if (AIndex == 32) {
+        if (AValue != FpCPU->PC)
+            FpCPU->GoTo(AValue);
+    }
+    else if (AIndex)
+        FpCPU->WriteRegister(AIndex, AValue);
+}
+//---------------------------------------------------------------------------
+
+// Length checked before allocating: the reply (2 hex digits per byte) must
+// fit a packet, the core checks the range
+std::string TGdbServer::ReadMemory(unsigned long AAddress, unsigned long ALength)
+{
+std::vector<unsigned char> Data;
+
+    if (ALength > PacketSize / 2)
+        return "E01";
+
+    if (!ALength)
+        return "";
+
+    Data.resize(ALength);
+
+    FpCPU->ReadMemory(AAddress, &Data[0], ALength);
+
+    return HexBytes(&Data[0], ALength);
+}
+//---------------------------------------------------------------------------
+
+// <type>,<address>,<kind/length>
+std::string TGdbServer::InsertPoint(const std::string &AArgs)
+{
+TRiscVBreakpoints *pEngine = FpCPU->Breakpoints;
+char              *pEnd;
+unsigned long      Address = strtoul(AArgs.c_str() + 2, &pEnd, 16);
+unsigned long      Length  = strtoul(pEnd + 1, NULL, 16);
+TGdbWatch          Watch;
+
+    switch (AArgs[0]) {
+        case '0':   // Software breakpoint
+        case '1':   // Hardware breakpoint: the same thing here
+            if (!pEngine->IsBreakpoint(Address)) {
+                pEngine->AddBreakpoint(Address);
+                FSwBreaks.push_back(Address);
+            }
+            return "OK";
+
+        case '2':
+        case '3':
+        case '4':
+            Watch.Type    = AArgs[0];
+            Watch.Address = Address;
+            Watch.Length  = Length;
+            Watch.Id      = pEngine->AddWatchpoint(Address, Length,
+                                AArgs[0] == '2' ? TRiscVBreakpoints::watchWrite :
+                                AArgs[0] == '3' ? TRiscVBreakpoints::watchRead  :
+                                                  TRiscVBreakpoints::watchAccess);
+            FWatches.push_back(Watch);
+            return "OK";
+    }
+
+    return "";
+}
+//---------------------------------------------------------------------------
+
+std::string TGdbServer::RemovePoint(const std::string &AArgs)
+{
+TRiscVBreakpoints *pEngine = FpCPU->Breakpoints;
+char              *pEnd;
+unsigned long      Address = strtoul(AArgs.c_str() + 2, &pEnd, 16);
+unsigned long      Length  = strtoul(pEnd + 1, NULL, 16);
+
+    switch (AArgs[0]) {
+        case '0':
+        case '1':
+            // Breakpoints already set from the emulator UI are left alone
+            for (size_t c=0; c<FSwBreaks.size(); c++)
+                if (FSwBreaks[c] == Address) {
+                    pEngine->RemoveBreakpoint(Address);
+                    FSwBreaks.erase(FSwBreaks.begin() + c);
+                    break;
+                }
+            return "OK";
+
+        case '2':
+        case '3':
+        case '4':
+            for (size_t c=0; c<FWatches.size(); c++)
+                if (FWatches[c].Type == AArgs[0] && FWatches[c].Address == Address && FWatches[c].Length == Length) {
+                    pEngine->RemoveWatchpoint(FWatches[c].Id);
+                    FWatches.erase(FWatches.begin() + c);
+                    break;
+                }
+            return "OK";
+    }
+
+    return "";
+}
+//---------------------------------------------------------------------------
+
+void TGdbServer::ClearPoints()
+{
+TRiscVBreakpoints *pEngine = FpCPU->Breakpoints;
+
+    for (size_t c=0; c<FSwBreaks.size(); c++)
+        pEngine->RemoveBreakpoint(FSwBreaks[c]);
+
+    for (size_t c=0; c<FWatches.size(); c++)
+        pEngine->RemoveWatchpoint(FWatches[c].Id);
+
+    FSwBreaks.clear();
+    FWatches.clear();
+}
+//---------------------------------------------------------------------------
+
+std::string TGdbServer::Query(const std::string &APacket)
+{
+static const std::string Features = "qXfer:features:read:target.xml:";
+unsigned long Offset;
+unsigned long Length;
+char         *pEnd;
+std::string   Xml = TargetXml;
+
+    if (APacket.compare(0, 10, "qSupported") == 0)
+        return "PacketSize=4000;qXfer:features:read+;QStartNoAckMode+";
+
+    if (APacket == "QStartNoAckMode" || APacket.compare(0, 7, "qSymbol") == 0)
+        return "OK";
+
+    if (APacket.compare(0, 9, "qAttached") == 0)
+        return "1";
+
+    if (APacket == "qC")
+        return "QC1";
+
+    if (APacket == "qfThreadInfo")
+        return "m1";
+
+    if (APacket == "qsThreadInfo")
+        return "l";
+
+    if (APacket.compare(0, Features.size(), Features) == 0) {
+        Offset = strtoul(APacket.c_str() + Features.size(), &pEnd, 16);
+        Length = strtoul(pEnd + 1, NULL, 16);
+
+        if (Offset >= Xml.size())
+            return "l";
+
+        if (Length >= Xml.size() - Offset)
+            return "l" + Xml.substr(Offset);
+
+        return "m" + Xml.substr(Offset, Length);
+    }
+
+    return "";
+}
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Server thread
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+__fastcall TGdbServerThread::TGdbServerThread(TGdbServer *ApServer)
+    : TThread(false)
+{
+    FpServer = ApServer;
+}
+//---------------------------------------------------------------------------
+
+void __fastcall TGdbServerThread::Execute()
+{
+    try {
+        while (!Terminated && FpServer->Serve())
+            ;
+    }
+    catch (...) {
+        // Server closed while serving
+    }
+}
+//---------------------------------------------------------------------------
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+   Client
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+TGdbClient::TGdbClient()
+{
+#ifdef _WIN32
+WSADATA Data;
+
+    if (WSAStartup(MAKEWORD(1, 1), &Data))
+        throw Exception("Winsock not available");
+#endif
+
+    FSocket  = INVALID_SOCKET;
+    FTimeout = 10000;
+}
+//---------------------------------------------------------------------------
+
+TGdbClient::~TGdbClient()
+{
+    Close();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+//---------------------------------------------------------------------------
+
+void TGdbClient::Connect(unsigned short APort)
+{
+sockaddr_in Address;
+int         NoDelay = 1;
+
+    Close();
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family      = AF_INET;
+    Address.sin_port        = htons(APort);
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    FSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (FSocket == (TSocket)INVALID_SOCKET)
+        throw Exception("Cannot create socket");
+
+    if (connect(FSocket, (sockaddr *)&Address, sizeof(Address))) {
+        Close();
+        throw Exception("Cannot connect to port " + IntToStr(APort));
+    }
+
+    setsockopt(FSocket, IPPROTO_TCP, TCP_NODELAY, (const char *)&NoDelay, sizeof(NoDelay));
+    FInput.clear();
+}
+//---------------------------------------------------------------------------
+
+void TGdbClient::Close()
+{
+    if (FSocket != (TSocket)INVALID_SOCKET) {
+        shutdown(FSocket, 2);
+        closesocket(FSocket);
+        FSocket = INVALID_SOCKET;
+    }
+}
+//---------------------------------------------------------------------------
+
+void TGdbClient::Receive()
+{
+fd_set  Set;
+timeval Timeout = { FTimeout / 1000, FTimeout % 1000 * 1000 };
+char    Buffer[4096];
+int     Length;
+
+    FD_ZERO(&Set);
+    FD_SET(FSocket, &Set);
+
+    if (select((int)FSocket + 1, &Set, NULL, NULL, &Timeout) <= 0)
+        throw Exception("No reply from the GDB stub");
+
+    Length = recv(FSocket, Buffer, sizeof(Buffer), 0);
+    if (Length <= 0)
+        throw Exception("GDB stub closed the connection");
+
+    FInput.append(Buffer, Length);
+}
+//---------------------------------------------------------------------------
+
+// Next $<payload>#<checksum> (acked), bytes before it skipped
+std::string TGdbClient::GetPacket()
+{
+size_t      Start;
+size_t      End;
+std::string Packet;
+
+    for (;;) {
+        Start = FInput.find('$');
+        End   = (Start == std::string::npos) ? Start : FInput.find('#', Start);
+
+        if (End != std::string::npos && End + 2 < FInput.size()) {
+            Packet = FInput.substr(Start + 1, End - Start - 1);
+            FInput.erase(0, End + 3);
+            send(FSocket, "+", 1, 0);
+
+            return Packet;
+        }
+
+        Receive();
+    }
+}
+//---------------------------------------------------------------------------
+
+std::string TGdbClient::Exchange(const std::string &APacket)
+{
+static const char Digits[] = "0123456789abcdef";
+std::string   Frame = "$" + APacket + "#";
+std::string   Reply;
+unsigned char Sum   = 0;
+size_t        Ack;
+
+    if (FSocket == (TSocket)INVALID_SOCKET)
+        throw Exception("GDB client not connected");
+
+    for (size_t c=0; c<APacket.size(); c++)
+        Sum += (unsigned char)APacket[c];
+
+    Frame += Digits[Sum >> 4];
+    Frame += Digits[Sum & 15];
+
+    if (send(FSocket, Frame.data(), (int)Frame.size(), 0) != (int)Frame.size())
+        throw Exception("GDB stub closed the connection");
+
+    while ((Ack = FInput.find_first_of("+-")) == std::string::npos)
+        Receive();
+
+    if (FInput[Ack] == '-')
+        throw Exception("GDB stub rejected packet " + String(APacket.c_str()));
+    FInput.erase(0, Ack + 1);
+
+    if (APacket == "k")
+        return "";          // No reply
+
+    do
+        Reply = GetPacket();
+    while (Reply.size() > 1 && Reply[0] == 'O' && Reply != "OK");
+
+    return Reply;
+}
+//---------------------------------------------------------------------------
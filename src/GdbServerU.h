@@ -0,0 +1,143 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef GdbServerUH
+#define GdbServerUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+
+/*
+GDB remote serial protocol stub
+
+Listens on 127.0.0.1 (port 0 => any free port, see Port) and serves one
+client at a time, e.g.:
+    gdb-multiarch -ex "set architecture riscv:rv32" -ex "target remote :3333"
+
+Supported: registers (g/G/p/P), memory (m/M/X), step, continue (executed by
+RiscV::Run() in chunks, Ctrl-C interrupts between chunks), software
+breakpoints (Z0) and write/read/access watchpoints (Z2/Z3/Z4).
+*/
+class TGdbServer
+{
+#ifdef _WIN32
+    typedef NativeUInt TSocket; // SOCKET
+#else
+    typedef int        TSocket;
+#endif
+
+    typedef struct {
+        char          Type;     // '2' write, '3' read, '4' access
+        unsigned long Address;
+        unsigned long Length;
+        int           Id;       // TRiscVBreakpoints watchpoint id
+    } TGdbWatch;
+
+    RiscV                  *FpCPU;
+    TSocket                 FListen;
+    TSocket                 FClient;
+    unsigned short          FPort;
+    bool                    FNoAck;         // QStartNoAckMode accepted
+    unsigned long           FRunChunk;      // Insns per Run() call while continuing
+    std::string             FInput;         // Received bytes not yet parsed
+    std::vector<TGdbWatch>  FWatches;
+    std::vector<unsigned long> FSwBreaks;   // Breakpoints set by the client
+
+    bool        Receive(bool AWait);
+    bool        GetPacket(std::string &APacket);
+    void        PutPacket(const std::string &APacket);
+    bool        Interrupted();
+
+    std::string Handle(const std::string &APacket, bool &ADetach);
+    std::string StopReply(RiscV::StopReason AReason);
+    std::string Continue();
+    std::string Step();
+    std::string ReadRegisters();
+    void        WriteRegisters(const std::string &AHex);
+    std::string ReadRegister (int AIndex);
+    void        WriteRegister(int AIndex, unsigned long AValue);
+    std::string ReadMemory   (unsigned long AAddress, unsigned long ALength);
+    std::string InsertPoint  (const std::string &AArgs);
+    std::string RemovePoint  (const std::string &AArgs);
+    std::string Query        (const std::string &APacket);
+    std::string Fault        (Exception &AException);
+    void        ClearPoints  ();
+
+public:
+    TGdbServer(RiscV *ApCPU);
+    ~TGdbServer();
+
+    void Listen(unsigned short APort);  // Localhost only
+    bool Serve();                       // Serve one client (false => server closed)
+    void Close();                       // Also unblocks Serve() from another thread
+
+    __property unsigned short Port     = { read=FPort };
+    __property unsigned long  RunChunk = { read=FRunChunk, write=FRunChunk };
+};
+//---------------------------------------------------------------------------
+
+// Serves clients until the server is closed
+class TGdbServerThread : public TThread
+{
+    TGdbServer *FpServer;
+
+protected:
+    void __fastcall Execute();
+
+public:
+    __fastcall TGdbServerThread(TGdbServer *ApServer);
+};
+//---------------------------------------------------------------------------
+
+/*
+Minimal GDB client for scripted checks of the stub (headless --gdb-check):
+one packet out, its reply back, acks handled. Console output packets (O) are
+skipped, a reply missing for Timeout ms is an error
+*/
+class TGdbClient
+{
+#ifdef _WIN32
+    typedef NativeUInt TSocket; // SOCKET
+#else
+    typedef int        TSocket;
+#endif
+
+    TSocket         FSocket;
+    std::string     FInput;         // Received bytes not yet parsed
+    int             FTimeout;
+
+    void        Receive();
+    std::string GetPacket();
+
+public:
+    TGdbClient();
+    ~TGdbClient();
+
+    void        Connect(unsigned short APort);   // Localhost
+    std::string Exchange(const std::string &APacket);
+    void        Close();
+
+    __property int Timeout = { read=FTimeout, write=FTimeout };
+};
+//---------------------------------------------------------------------------
+#endif
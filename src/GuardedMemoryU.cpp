@@ -0,0 +1,206 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "GuardedMemoryU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const unsigned __int64 AddressSpace = (unsigned __int64)1 << 32;
+
+static thread_local TRiscVGuardedMemory *ArmedMemory = NULL; // Per emulation thread
+//---------------------------------------------------------------------------
+
+#ifdef _WIN32
+// Address space only: pages are committed by Map()
+static char *Reserve()
+{
+void *pBase = VirtualAlloc(NULL, AddressSpace + TRiscVGuardedMemory::GuardSize, MEM_RESERVE, PAGE_NOACCESS);
+
+    if (!pBase)
+        throw Exception("Cannot reserve guarded memory");
+
+    return (char *)pBase;
+}
+//---------------------------------------------------------------------------
+
+// Access violation inside the reservation while armed: handled by the
+// __except block of the emulator loop, anything else goes on searching
+int TRiscVGuardedMemory::Filter(_EXCEPTION_POINTERS *AInfo)
+{
+char *pFault;
+
+    if (ArmedMemory != this || AInfo->ExceptionRecord->ExceptionCode != EXCEPTION_ACCESS_VIOLATION)
+        return EXCEPTION_CONTINUE_SEARCH;
+
+    pFault = (char *)AInfo->ExceptionRecord->ExceptionInformation[1];
+    if (!Owns(pFault))
+        return EXCEPTION_CONTINUE_SEARCH;
+
+    ArmedMemory   = NULL;
+    FFaultAddress = (unsigned long)(pFault - FpBase);
+
+    return EXCEPTION_EXECUTE_HANDLER;
+}
+#endif
+//---------------------------------------------------------------------------
+
+TRiscVGuardedMemory::TRiscVGuardedMemory()
+{
+    FpBase        = NULL;
+    FFaultAddress = 0;
+
+    if (!Supported())
+        throw Exception("Guarded memory not supported on this host");
+
+#ifdef _WIN32
+    FpBase = Reserve();
+#endif
+}
+//---------------------------------------------------------------------------
+
+TRiscVGuardedMemory::~TRiscVGuardedMemory()
+{
+    Disarm();
+
+#ifdef _WIN32
+    if (FpBase)
+        VirtualFree(FpBase, 0, MEM_RELEASE);
+#endif
+}
+//---------------------------------------------------------------------------
+
+// Win64: room for 4 GiB and guest words in a 32-bit long, as the whole core
+// assumes
+bool TRiscVGuardedMemory::Supported()
+{
+#ifdef _WIN32
+    return sizeof(void *) >= 8 && sizeof(long) == 4;
+#else
+    return false;
+#endif
+}
+//---------------------------------------------------------------------------
+
+size_t TRiscVGuardedMemory::HostPageSize()
+{
+#ifdef _WIN32
+SYSTEM_INFO Info;
+
+    GetSystemInfo(&Info);
+
+    return Info.dwPageSize;
+#else
+    return 4096;    // Not supported (no object is ever built)
+#endif
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVGuardedMemory::Owns(const char *ApAddress)
+{
+    return ApAddress >= FpBase && ApAddress < FpBase + AddressSpace + GuardSize;
+}
+//---------------------------------------------------------------------------
+
+char * TRiscVGuardedMemory::Map(unsigned long AAddress, unsigned long ASize)
+{
+unsigned __int64 Page  = HostPageSize();
+unsigned __int64 Start = AAddress / Page * Page;
+unsigned __int64 End   = std::min(((unsigned __int64)AAddress + ASize + Page - 1) / Page * Page, AddressSpace);
+
+    if (Start >= End)
+        return FpBase + AAddress;
+
+#ifdef _WIN32
+    // Pages already committed keep their content
+    if (!VirtualAlloc(FpBase + Start, End - Start, MEM_COMMIT, PAGE_READWRITE))
+        throw Exception("Cannot map guarded memory");
+#endif
+
+    FRegions.push_back(std::make_pair(Start, End));
+
+    return FpBase + AAddress;
+}
+//---------------------------------------------------------------------------
+
+// Covered by the union of the regions (they may overlap or be adjacent)
+bool TRiscVGuardedMemory::IsMapped(unsigned long AAddress, unsigned long ASize)
+{
+unsigned __int64 Address = AAddress;
+unsigned __int64 End     = Address + ASize;
+size_t           r;
+
+    while (Address < End) {
+        for (r=0; r<FRegions.size(); r++)
+            if (Address >= FRegions[r].first && Address < FRegions[r].second)
+                break;
+
+        if (r == FRegions.size())
+            return false;
+
+        Address = FRegions[r].second;
+    }
+
+    return true;
+}
+//---------------------------------------------------------------------------
+
+// Any byte of [AAddress, AAddress + ASize) in a region
+bool TRiscVGuardedMemory::Overlaps(unsigned long AAddress, unsigned long ASize)
+{
+unsigned __int64 End = (unsigned __int64)AAddress + ASize;
+
+    for (size_t r=0; r<FRegions.size(); r++)
+        if (AAddress < FRegions[r].second && End > FRegions[r].first)
+            return true;
+
+    return false;
+}
+//---------------------------------------------------------------------------
+
+// Same reservation (Base unchanged): mapped pages are discarded
+void TRiscVGuardedMemory::Clear()
+{
+#ifdef _WIN32
+    VirtualFree(FpBase, AddressSpace + GuardSize, MEM_DECOMMIT);
+#endif
+    FRegions.clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVGuardedMemory::Arm()
+{
+    ArmedMemory = this;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVGuardedMemory::Disarm()
+{
+    if (ArmedMemory == this)
+        ArmedMemory = NULL;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef GuardedMemoryUH
+#define GuardedMemoryUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+
+struct _EXCEPTION_POINTERS;
+//---------------------------------------------------------------------------
+
+/*
+Guard page guest memory (opt-in, Win64 hosts only)
+
+The whole 32-bit guest address space is reserved inaccessible, plus
+GuardSize bytes past 4 GiB (an access at 0xFFFFFFFF + size), and only the
+regions given to Map() are readable/writable. Guest address + Base is the
+host address: the core does no bounds checks, an access outside the mapped
+regions faults in hardware.
+While armed (RiscV::Run()/Step()) a fault inside the reservation goes back
+to the emulator loop (structured exception filter), that re-executes the
+insn with the checks (CLINT registers are never mapped) or reports a
+precise guest fault (PC = faulting insn, no state changed by it).
+Faults outside the reservation, or while not armed, go to the previous
+handler (default: the process dies), so host code must access only mapped
+regions (IsMapped).
+The 4 GiB reservation needs a 64-bit host and the core keeps guest words
+in a 32-bit long: Win64 is the only such host the backend runs on, elsewhere
+Supported() is false and the constructor throws.
+*/
+class TRiscVGuardedMemory
+{
+public:
+    enum { GuardSize = 1 << 16 };
+
+private:
+    char         *FpBase;
+
+    // Mapped regions [first, second), host page aligned
+    std::vector<std::pair<unsigned __int64, unsigned __int64> > FRegions;
+
+    unsigned long FFaultAddress;
+
+    static size_t HostPageSize();
+    bool          Owns(const char *ApAddress);    // Inside the reservation
+    unsigned long getSize() { return (unsigned long)-1; }
+
+public:
+    TRiscVGuardedMemory();
+    ~TRiscVGuardedMemory();
+
+    static bool Supported();
+
+    // Region readable/writable, zero filled if new (bounds rounded to host
+    // pages). Returns its host address
+    char *Map(unsigned long AAddress, unsigned long ASize);
+    bool  IsMapped(unsigned long AAddress, unsigned long ASize);
+    bool  Overlaps(unsigned long AAddress, unsigned long ASize);
+    void  Clear();  // Unmaps every region
+
+    // Fault recovery: the caller does __try ..
+    // __except(Filter(GetExceptionInformation())) around the guest code and
+    // Arm() before it, a guest fault returns there with FaultAddress.
+    // Disarm() on every exit
+    int  Filter(_EXCEPTION_POINTERS *AInfo);
+    void Arm();
+    void Disarm();
+
+    // RiscV::Load(Base, Size, ...) with RiscV::GuardedMemory set
+    __property char          *Base         = { read=FpBase };
+    __property unsigned long  Size         = { read=getSize };   // Whole address space
+    __property unsigned long  FaultAddress = { read=FFaultAddress };
+};
+//---------------------------------------------------------------------------
+#endif
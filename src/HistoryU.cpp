@@ -0,0 +1,332 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <algorithm>
+
+#include "HistoryU.h"
+#include "GuardedMemoryU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const unsigned __int64 NoHit = (unsigned __int64)-1;
+//---------------------------------------------------------------------------
+
+TRiscVHistory::TRiscVHistory(RiscV *ApCPU, unsigned long AInterval, int AMaxCheckpoints)
+{
+    if (!AInterval || AMaxCheckpoints < 1)
+        throw Exception("Invalid history parameters");
+
+    FpCPU           = ApCPU;
+    FInterval       = AInterval;
+    FMaxCheckpoints = AMaxCheckpoints;
+    FInputPos       = 0;
+    FEpoch          = 0;
+    FNextCheckpoint = 0;
+    FReplaying      = false;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::Clear()
+{
+    FCheckpoints.clear();
+    FInputs.clear();
+    FInputPos = 0;
+
+    // One epoch slot for every (even partial) page of guest memory
+    FPageEpoch.assign((FpCPU->FcMemory + RiscV::PageSize - 1) >> RiscV::PageBits, 0);
+    FSparseEpoch.clear();
+    FEpoch = 0;
+
+    Checkpoint();
+}
+//---------------------------------------------------------------------------
+
+unsigned __int64 TRiscVHistory::getOldest()
+{
+    return FCheckpoints.empty() ? FpCPU->FInstret : FCheckpoints.front().Instret;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::NewEpoch()
+{
+    if (!++FEpoch) {    // Wrap around => no page can look already saved
+        std::fill(FPageEpoch.begin(), FPageEpoch.end(), 0);
+        FSparseEpoch.clear();
+        FEpoch = 1;
+    }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::Checkpoint()
+{
+    FCheckpoints.push_back(TCheckpoint());
+
+TCheckpoint &Current = FCheckpoints.back();
+
+    Current.Instret    = FpCPU->FInstret;
+    Current.PC         = FpCPU->FPC;
+    Current.InputIndex = FInputPos;
+    memcpy(Current.RegFile, FpCPU->FReg, sizeof(Current.RegFile));
+    Current.Machine    = FpCPU->FMachine;
+
+    NewEpoch();
+    FNextCheckpoint = Current.Instret + FInterval;
+
+    if (FCheckpoints.size() > FMaxCheckpoints) {
+        FCheckpoints.pop_front();
+        CompactInputs();
+    }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::SavePage(unsigned long APage)
+{
+unsigned long Start = APage << RiscV::PageBits;
+unsigned long Size  = RiscV::PageSize;
+
+    // Last page of the host buffer: sparse memory (if enabled) continues it
+    if (Start < FpCPU->FcMemory && !FpCPU->FSparseMemory && FpCPU->FcMemory - Start < Size)
+        Size = FpCPU->FcMemory - Start;
+
+    // Guarded memory: the store is going to fault, nothing to save
+    if (FpCPU->FpGuard && !FpCPU->FpGuard->IsMapped(Start, Size))
+        return;
+
+    FCheckpoints.back().Pages.push_back(TPageImage());
+    FCheckpoints.back().Pages.back().Page = APage;
+    FCheckpoints.back().Pages.back().Data.resize(Size);
+    FpCPU->RawRead(Start, &FCheckpoints.back().Pages.back().Data[0], Size);
+
+    if (APage < FPageEpoch.size())
+        FPageEpoch[APage] = FEpoch;
+    else
+        FSparseEpoch[APage] = FEpoch;
+}
+//---------------------------------------------------------------------------
+
+// Drop input events older than the oldest checkpoint (only when they are
+// the larger part of the log, so the cost is amortized)
+void TRiscVHistory::CompactInputs()
+{
+size_t Dead = FCheckpoints.front().InputIndex;
+
+    if (Dead < FInputs.size()/2)
+        return;
+
+    FInputs.erase(FInputs.begin(), FInputs.begin() + Dead);
+    FInputPos -= Dead;
+    for (size_t c=0; c<FCheckpoints.size(); c++)
+        FCheckpoints[c].InputIndex -= Dead;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::LogHostWrite(unsigned long AAddress, const void *ApData, int ASize)
+{
+TInputEvent Event;
+
+    if (FReplaying)
+        return;
+
+    Event.Instret = FpCPU->FInstret;
+    Event.Kind    = inputHostWrite;
+    Event.Address = AAddress;
+    Event.Size    = ASize;
+    Event.Value   = 0;
+    memcpy(&Event.Value, ApData, ASize);
+
+    FInputs.push_back(Event);
+    FInputPos = FInputs.size();
+}
+//---------------------------------------------------------------------------
+
+unsigned long TRiscVHistory::LogDeviceRead(unsigned long AValue)
+{
+TInputEvent Event;
+
+    // On re-execution the guest must see the recorded value: any other
+    // event means the replay went another way than the recorded run
+    if (FReplaying) {
+        if (FInputPos >= FInputs.size() || FInputs[FInputPos].Kind != inputDeviceRead
+            || FInputs[FInputPos].Instret != FpCPU->FInstret)
+            throw Exception( String("Reverse execution: replay diverged at instruction ") + FpCPU->FInstret );
+
+        return FInputs[FInputPos++].Value;
+    }
+
+    Event.Instret = FpCPU->FInstret;
+    Event.Kind    = inputDeviceRead;
+    Event.Address = 0;
+    Event.Size    = sizeof(unsigned long);
+    Event.Value   = AValue;
+
+    FInputs.push_back(Event);
+    FInputPos = FInputs.size();
+
+    return AValue;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::ApplyHostWrites()
+{
+    while (FInputPos < FInputs.size()
+           && FInputs[FInputPos].Instret == FpCPU->FInstret
+           && FInputs[FInputPos].Kind    == inputHostWrite) {
+        memcpy( FpCPU->HostPtr(FInputs[FInputPos].Address, FInputs[FInputPos].Size),
+                &FInputs[FInputPos].Value, FInputs[FInputPos].Size );
+        FInputPos++;
+    }
+}
+//---------------------------------------------------------------------------
+
+// Undo every interval back to ACheckpoint (newest first) and drop later checkpoints
+void TRiscVHistory::Restore(size_t ACheckpoint)
+{
+    for (size_t c=FCheckpoints.size(); c-- > ACheckpoint; )
+        for (size_t p=FCheckpoints[c].Pages.size(); p-- > 0; ) {
+            TPageImage &Image = FCheckpoints[c].Pages[p];
+            FpCPU->RawWrite(Image.Page << RiscV::PageBits, &Image.Data[0], Image.Data.size());
+        }
+
+    FCheckpoints.erase(FCheckpoints.begin() + ACheckpoint + 1, FCheckpoints.end());
+
+TCheckpoint &Current = FCheckpoints.back();
+
+    Current.Pages.clear();
+    memcpy(FpCPU->FReg, Current.RegFile, sizeof(Current.RegFile));
+    FpCPU->FPC      = Current.PC;
+    FpCPU->FInstret = Current.Instret;
+    FpCPU->FMachine = Current.Machine;
+    FInputPos       = Current.InputIndex;
+
+    FpCPU->FInterruptAt = 0;    // Checked again on next block entry
+    FpCPU->FFramebuffer.Invalidate();
+
+    NewEpoch();
+    FNextCheckpoint = Current.Instret + FInterval;
+}
+//---------------------------------------------------------------------------
+
+// Index of last checkpoint taken at (or strictly before) AInstret, -1 if none
+int TRiscVHistory::Nearest(unsigned __int64 AInstret, bool AStrict)
+{
+int Low = 0, High = (int)FCheckpoints.size() - 1, Found = -1;
+
+    while (Low <= High) {
+        int Middle = (Low + High) / 2;
+        if (FCheckpoints[Middle].Instret < AInstret
+            || (!AStrict && FCheckpoints[Middle].Instret == AInstret)) {
+            Found = Middle;
+            Low   = Middle + 1;
+        }
+        else
+            High  = Middle - 1;
+    }
+    return Found;
+}
+//---------------------------------------------------------------------------
+
+// Re-execute up to ATarget feeding recorded inputs. If AScan returns the last
+// instruction count (before ATarget) where the run loop would have stopped on
+// a breakpoint or watchpoint, NoHit if none.
+unsigned __int64 TRiscVHistory::Replay(unsigned __int64 ATarget, bool AScan)
+{
+TRiscVBreakpoints &Engine  = FpCPU->FBreakpoints;
+unsigned __int64   LastHit = NoHit;
+
+    FReplaying = true;
+    try
+    {
+        for (;;) {
+            ApplyHostWrites();
+            if (FpCPU->FInstret >= ATarget)
+                break;
+            if (AScan && Engine.IsBreakpoint(FpCPU->FPC))
+                LastHit = FpCPU->FInstret;
+
+            Engine.ResetHit();
+            FpCPU->Step();
+
+            if (AScan && Engine.WatchHit && FpCPU->FInstret < ATarget)
+                LastHit = FpCPU->FInstret;  // Stop is after the accessing insn
+        }
+    }
+    catch (...)
+    {
+        FReplaying = false;
+        throw;
+    }
+    FReplaying = false;
+    Engine.ResetHit();
+
+    // Inputs after ATarget belong to a future that will be re-executed live
+    FInputs.erase(FInputs.begin() + FInputPos, FInputs.end());
+
+    return LastHit;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::GoTo(unsigned __int64 AInstret)
+{
+int Checkpoint = Nearest(AInstret, false);
+
+    if (AInstret > FpCPU->FInstret || Checkpoint < 0)
+        throw Exception( String("Instruction count ") + AInstret + " out of history" );
+
+    Restore(Checkpoint);
+    Replay(AInstret, false);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVHistory::StepBack()
+{
+    if (FpCPU->FInstret <= Oldest)
+        throw Exception("Beginning of history reached");
+
+    GoTo(FpCPU->FInstret - 1);
+}
+//---------------------------------------------------------------------------
+
+// Scan intervals backward (newest first) for the last breakpoint/watchpoint
+// hit. Returns false (stopping at the oldest checkpoint) if never hit.
+bool TRiscVHistory::ContinueBack()
+{
+unsigned __int64 End        = FpCPU->FInstret;
+int              Checkpoint = Nearest(End, true);
+unsigned __int64 Hit;
+
+    while (Checkpoint >= 0) {
+        Restore(Checkpoint);
+        Hit = Replay(End, true);
+        if (Hit != NoHit) {
+            GoTo(Hit);
+            return true;
+        }
+
+        End = FCheckpoints[Checkpoint].Instret;
+        Checkpoint--;
+    }
+
+    if (!FCheckpoints.empty())
+        GoTo(FCheckpoints.front().Instret);
+
+    return false;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,127 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+//---------------------------------------------------------------------------
+#ifndef HistoryUH
+#define HistoryUH
+//---------------------------------------------------------------------------
+#include <deque>
+#include <unordered_map>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+
+/*
+Reverse execution
+
+Every Interval instructions a checkpoint (PC, registers, trap state) is
+taken. Between two checkpoints the first write to every memory page saves the
+page content (undo log), so restoring a checkpoint costs only the pages
+dirtied after it.
+Values entering the guest from outside (device writes, device/time reads) are
+recorded with their instruction count and fed again on re-execution.
+
+Any earlier instruction count is reached by restoring the nearest checkpoint
+and replaying at most Interval instructions.
+*/
+class TRiscVHistory
+{
+    enum InputKind {
+        inputHostWrite,     // Host wrote guest memory between two instructions
+        inputDeviceRead     // Guest read a nondeterministic value (device, time)
+    };
+
+    typedef struct {
+        unsigned __int64    Instret;    // Instruction count when event occurred
+        InputKind           Kind;
+        unsigned long       Address;    // inputHostWrite only
+        int                 Size;       // inputHostWrite only
+        unsigned long       Value;
+    } TInputEvent;
+
+    typedef struct {
+        unsigned long       Page;       // Page index (address >> RiscV::PageBits)
+        std::vector<char>   Data;       // Content before first write after checkpoint
+    } TPageImage;
+
+    typedef struct {
+        unsigned __int64        Instret;    // Instruction count when taken
+        unsigned long           PC;
+        unsigned long           RegFile[32];
+        RiscV::TMachineState    Machine;    // CSRs, CLINT, wfi
+        size_t                  InputIndex; // First input event after checkpoint
+        std::vector<TPageImage> Pages;      // Undo log of the interval
+    } TCheckpoint;
+
+    RiscV                   *FpCPU;
+    unsigned long            FInterval;         // Instructions between checkpoints
+    size_t                   FMaxCheckpoints;   // Oldest checkpoints dropped beyond this
+    std::deque<TCheckpoint>  FCheckpoints;
+    std::vector<TInputEvent> FInputs;
+    size_t                   FInputPos;         // Next input event (== FInputs.size() while recording)
+    std::vector<unsigned>    FPageEpoch;        // Epoch of last saved pre-image, per page of the host buffer
+    std::unordered_map<unsigned long, unsigned> FSparseEpoch;   // Same, sparse memory pages
+    unsigned                 FEpoch;            // Current checkpoint interval
+    unsigned __int64         FNextCheckpoint;
+    bool                     FReplaying;
+
+    void    Checkpoint();
+    void    NewEpoch();
+    void    SavePage(unsigned long APage);
+    void    CompactInputs();
+    void    ApplyHostWrites();
+    void    Restore(size_t ACheckpoint);
+    int     Nearest(unsigned __int64 AInstret, bool AStrict);
+
+    unsigned __int64 Replay(unsigned __int64 ATarget, bool AScan);
+
+    unsigned __int64 getOldest();
+
+public:
+    TRiscVHistory(RiscV *ApCPU, unsigned long AInterval, int AMaxCheckpoints);
+
+    void Clear();   // Forget everything and checkpoint current state
+
+    // Hooks called by the core
+    void BeforeStep()
+    {
+        if (FpCPU->FInstret >= FNextCheckpoint)
+            Checkpoint();
+    }
+
+    void BeforeWrite(unsigned long AAddress, int ASize)
+    {
+        for (unsigned long Page = AAddress >> RiscV::PageBits; Page <= (AAddress + ASize - 1) >> RiscV::PageBits; Page++)
+            if (Page < FPageEpoch.size() ? FPageEpoch[Page] != FEpoch : FSparseEpoch[Page] != FEpoch)
+                SavePage(Page);
+    }
+
+    void          LogHostWrite(unsigned long AAddress, const void *ApData, int ASize);
+    unsigned long LogDeviceRead(unsigned long AValue);
+
+    // Reverse execution
+    void GoTo        (unsigned __int64 AInstret);
+    void StepBack    ();
+    bool ContinueBack();
+
+    __property unsigned __int64 Oldest    = { read=getOldest  };  // Earliest reachable instruction count
+    __property bool             Replaying = { read=FReplaying };
+};
+//---------------------------------------------------------------------------
+#endif
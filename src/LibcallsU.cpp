@@ -0,0 +1,291 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include "LibcallsU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+typedef struct {
+    unsigned long Match;
+    unsigned long Mask;
+} TSignatureWord;
+
+// Masks: whole insn, branch without offset, jal without offset
+static const unsigned long Insn   = 0xFFFFFFFF;
+static const unsigned long Branch = 0x01FFF07F;
+static const unsigned long Jal    = 0x00000FFF;
+
+static const TSignatureWord Mulsi3[] = {
+    { 0x00050613, Insn },       // mv    a2, a0
+    { 0x00000513, Insn },       // li    a0, 0
+    { 0x0015f693, Insn },       // andi  a3, a1, 1
+    { 0x00068463, Insn },       // beqz  a3, +8
+    { 0x00c50533, Insn },       // add   a0, a0, a2
+    { 0x0015d593, Insn },       // srli  a1, a1, 1
+    { 0x00161613, Insn },       // slli  a2, a2, 1
+    { 0xfe0596e3, Insn },       // bnez  a1, -20
+    { 0x00008067, Insn }        // ret
+};
+
+static const TSignatureWord Udivsi3[] = {
+    { 0x00058613, Insn },       // mv    a2, a1
+    { 0x00050593, Insn },       // mv    a1, a0
+    { 0xfff00513, Insn },       // li    a0, -1
+    { 0x02060c63, Insn },       // beqz  a2, ret
+    { 0x00100693, Insn },       // li    a3, 1
+    { 0x00b67a63, Insn },       // bgeu  a2, a1, +20
+    { 0x00c05863, Insn },       // blez  a2, +16
+    { 0x00161613, Insn },       // slli  a2, a2, 1
+    { 0x00169693, Insn },       // slli  a3, a3, 1
+    { 0xfeb66ae3, Insn },       // bgtu  a1, a2, -12
+    { 0x00000513, Insn },       // li    a0, 0
+    { 0x00c5e663, Insn },       // bltu  a1, a2, +12
+    { 0x40c585b3, Insn },       // sub   a1, a1, a2
+    { 0x00d56533, Insn },       // or    a0, a0, a3
+    { 0x0016d693, Insn },       // srli  a3, a3, 1
+    { 0x00165613, Insn },       // srli  a2, a2, 1
+    { 0xfe0696e3, Insn },       // bnez  a3, -20
+    { 0x00008067, Insn }        // ret
+};
+
+// Falls into __udivsi3 (checked after these two)
+static const TSignatureWord Divsi3[] = {
+    { 0x00054063, Branch },     // bltz  a0, negative dividend
+    { 0x0005c063, Branch }      // bltz  a1, negative divisor
+};
+static const int Divsi3Words = sizeof(Divsi3) / sizeof(Divsi3[0]);
+
+// Negative dividend path (first branch target): the divisor test tells how
+// a zero divisor is taken
+static const TSignatureWord Divsi3Negative[] = {
+    { 0x40a00533, Insn },       // neg   a0, a0
+    { 0x00b04063, Branch }      // bgtz  a1, negate quotient (older div.S: bgez a1)
+};
+
+static const TSignatureWord Umodsi3[] = {
+    { 0x00008293, Insn },       // mv    t0, ra
+    { 0x000000ef, Jal  },       // jal   __udivsi3
+    { 0x00058513, Insn },       // mv    a0, a1
+    { 0x00028067, Insn }        // jr    t0
+};
+
+static const TSignatureWord Modsi3[] = {
+    { 0x00008293, Insn },       // mv    t0, ra
+    { 0x0005c063, Branch },     // bltz  a1, negative divisor
+    { 0x00054063, Branch },     // bltz  a0, negative dividend
+    { 0x000000ef, Jal  },       // jal   __udivsi3
+    { 0x00058513, Insn },       // mv    a0, a1
+    { 0x00028067, Insn }        // jr    t0
+};
+
+static const struct {
+    TRiscVLibcalls::Routine  Routine;
+    const char              *Name;
+    const TSignatureWord    *pSignature;
+    int                      cSignature;
+} Signatures[] = {
+    { TRiscVLibcalls::libMulsi3,  "__mulsi3",  Mulsi3,  sizeof(Mulsi3)  / sizeof(Mulsi3[0])  },
+    { TRiscVLibcalls::libDivsi3,  "__divsi3",  Divsi3,  sizeof(Divsi3)  / sizeof(Divsi3[0])  },
+    { TRiscVLibcalls::libUdivsi3, "__udivsi3", Udivsi3, sizeof(Udivsi3) / sizeof(Udivsi3[0]) },
+    { TRiscVLibcalls::libModsi3,  "__modsi3",  Modsi3,  sizeof(Modsi3)  / sizeof(Modsi3[0])  },
+    { TRiscVLibcalls::libUmodsi3, "__umodsi3", Umodsi3, sizeof(Umodsi3) / sizeof(Umodsi3[0]) }
+};
+//---------------------------------------------------------------------------
+
+static bool Matches(const char *ApCode, unsigned long ASize, const TSignatureWord *ApSignature, int ACount)
+{
+unsigned long Word;
+
+    if (ASize < ACount * sizeof(Word))
+        return false;
+
+    for (int w=0; w<ACount; w++) {
+        memcpy(&Word, ApCode + w * sizeof(Word), sizeof(Word));
+        if ((Word & ApSignature[w].Mask) != ApSignature[w].Match)
+            return false;
+    }
+
+    return true;
+}
+//---------------------------------------------------------------------------
+
+// Unsigned division as __udivsi3 leaves it: a0 = quotient (-1 if divisor
+// 0), a1 = remainder (the dividend if divisor 0)
+static void Udiv(unsigned long &AA0, unsigned long &AA1)
+{
+unsigned long Dividend = AA0;
+unsigned long Divisor  = AA1;
+
+    AA0 = Divisor ? Dividend / Divisor : (unsigned long)-1;
+    AA1 = Divisor ? Dividend % Divisor : Dividend;
+}
+//---------------------------------------------------------------------------
+
+TRiscVLibcalls::TRiscVLibcalls()
+{
+    FTextStart = 0;
+    FTextEnd   = 0;
+    FcRoutines = 0;
+    FZeroDivisorNegative = false;
+    ClearHits();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVLibcalls::ClearHits()
+{
+    memset(FHits, 0, sizeof(FHits));
+}
+//---------------------------------------------------------------------------
+
+void TRiscVLibcalls::Add(unsigned long AAddress, Routine ARoutine)
+{
+    if (AAddress - FTextStart >= FTextEnd - FTextStart || (AAddress & 0x3))
+        return;
+
+    if (!FEntries[(AAddress - FTextStart) >> 2])
+        FcRoutines++;
+
+    FEntries[(AAddress - FTextStart) >> 2] = (unsigned char)ARoutine;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVLibcalls::Build(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd)
+{
+const char    *pCode;
+unsigned long  cCode;
+unsigned long  Branch;
+unsigned long  Target;
+
+    FTextStart = ATextStart;
+    FTextEnd   = ATextEnd;
+    FcRoutines = 0;
+    FZeroDivisorNegative = false;
+    FEntries.assign((ATextEnd - ATextStart) >> 2, libNone);
+    ClearHits();
+
+    for (unsigned long Address=ATextStart; Address<ATextEnd; Address+=4) {
+        pCode = ApMemory + Address;
+        cCode = ATextEnd - Address;
+
+        for (size_t r=0; r<sizeof(Signatures)/sizeof(Signatures[0]); r++)
+            if (Matches(pCode, cCode, Signatures[r].pSignature, Signatures[r].cSignature) &&
+                (Signatures[r].Routine != libDivsi3 ||
+                 Matches(pCode + Divsi3Words * 4, cCode - Divsi3Words * 4, Udivsi3, sizeof(Udivsi3) / sizeof(Udivsi3[0]))))
+            {
+                Add(Address, Signatures[r].Routine);
+
+                // __divsi3: "bltz a0" target (B-type offset)
+                if (Signatures[r].Routine == libDivsi3) {
+                    memcpy(&Branch, pCode, sizeof(Branch));
+                    Target = Address + ((Branch >> 31 ? 0xFFFFF000 : 0) | (Branch >> 7 & 0x1) << 11 |
+                                        (Branch >> 25 & 0x3F) << 5 | (Branch >> 8 & 0xF) << 1);
+
+                    if (Target - ATextStart < ATextEnd - ATextStart &&
+                        Matches(ApMemory + Target, ATextEnd - Target, Divsi3Negative, sizeof(Divsi3Negative) / sizeof(Divsi3Negative[0])))
+                            FZeroDivisorNegative = true;
+                }
+                break;
+            }
+    }
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVLibcalls::AddSymbol(unsigned long AAddress, const std::string &AName)
+{
+    for (size_t r=0; r<sizeof(Signatures)/sizeof(Signatures[0]); r++)
+        if (AName == Signatures[r].Name) {
+            Add(AAddress, Signatures[r].Routine);
+            return true;
+        }
+
+    return false;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVLibcalls::AddSymbols(const std::map<std::string, unsigned long> &ASymbols)
+{
+    for (std::map<std::string, unsigned long>::const_iterator Symbol=ASymbols.begin(); Symbol!=ASymbols.end(); Symbol++)
+        AddSymbol(Symbol->second, Symbol->first);
+}
+//---------------------------------------------------------------------------
+
+// Signed routines: the libgcc sign handling around __udivsi3, a1 included
+void TRiscVLibcalls::Execute(Routine ARoutine, unsigned long &AA0, unsigned long &AA1)
+{
+bool Negative;
+
+    FHits[ARoutine]++;
+
+    switch (ARoutine)
+    {
+        case libMulsi3:
+            AA0 = AA0 * AA1;
+            AA1 = 0;
+            break;
+
+        case libUdivsi3:
+            Udiv(AA0, AA1);
+            break;
+
+        case libUmodsi3:
+            Udiv(AA0, AA1);
+            AA0 = AA1;
+            break;
+
+        case libDivsi3:
+            // Signs differ; a zero divisor is positive (quotient 1 for a
+            // negative dividend) unless div.S takes it as negative (-1)
+            Negative = ((long)AA0 < 0) != ((long)AA1 < 0) && (AA1 || !FZeroDivisorNegative);
+            if ((long)AA0 < 0)
+                AA0 = -AA0;
+            if ((long)AA1 < 0)
+                AA1 = -AA1;
+            Udiv(AA0, AA1);
+            if (Negative)
+                AA0 = -AA0;
+            break;
+
+        case libModsi3:
+            Negative = (long)AA0 < 0;
+            if ((long)AA1 < 0)
+                AA1 = -AA1;
+            if (Negative)
+                AA0 = -AA0;
+            Udiv(AA0, AA1);
+            AA0 = Negative ? -AA1 : AA1;
+            break;
+
+        default:
+            break;
+    }
+}
+//---------------------------------------------------------------------------
+
+const char * TRiscVLibcalls::Name(Routine ARoutine)
+{
+    for (size_t r=0; r<sizeof(Signatures)/sizeof(Signatures[0]); r++)
+        if (Signatures[r].Routine == ARoutine)
+            return Signatures[r].Name;
+
+    return "";
+}
+//---------------------------------------------------------------------------
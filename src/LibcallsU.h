@@ -0,0 +1,98 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef LibcallsUH
+#define LibcallsUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <map>
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Native libgcc arithmetic routines
+
+RV32I programs (no M extension) multiply and divide through the libgcc
+shift-and-subtract routines, dozens of insns per call. Their entries are
+found at load time by code signature (the libgcc riscv muldi3.S/div.S
+sequences, branch and jump offsets masked where they depend on the layout)
+or added by symbol name. With RiscV::NativeLibcalls the core runs a call
+reaching an entry as a single insn: Execute() leaves a0/a1 as the libgcc
+code does (__udivsi3: quotient and remainder, the mod routines rely on it),
+other caller saved registers are not written, and the PC returns to ra.
+A negative number divided by zero follows the __divsi3 found: newer div.S
+tests the divisor with bgtz (quotient -1), older with bgez (quotient 1).
+*/
+class TRiscVLibcalls
+{
+public:
+    enum Routine {
+        libNone,
+        libMulsi3,
+        libDivsi3,
+        libUdivsi3,
+        libModsi3,
+        libUmodsi3,
+        libCount
+    };
+
+    enum {
+        RetInsn = 0x00008067            // jalr x0, 0(ra): what a native call stands for
+    };
+
+private:
+    unsigned long              FTextStart;
+    unsigned long              FTextEnd;
+    std::vector<unsigned char> FEntries;        // .text word => Routine
+    int                        FcRoutines;      // Entries found
+    bool                       FZeroDivisorNegative;    // __divsi3 found with "bgtz a1" (else "bgez a1")
+    unsigned __int64           FHits[libCount];
+
+    void Add(unsigned long AAddress, Routine ARoutine);
+
+    unsigned __int64 getHits(Routine ARoutine) { return FHits[ARoutine]; }
+
+public:
+    TRiscVLibcalls();
+
+    // Entries by code signature (every program load), hits cleared
+    void Build(const char *ApMemory, unsigned long ATextStart, unsigned long ATextEnd);
+
+    // Entries by name (after Build()): false => not a libgcc routine handled
+    bool AddSymbol (unsigned long AAddress, const std::string &AName);
+    void AddSymbols(const std::map<std::string, unsigned long> &ASymbols);
+    void ClearHits ();
+
+    Routine At(unsigned long APC)
+    {
+        return APC - FTextStart < FTextEnd - FTextStart ? (Routine)FEntries[(APC - FTextStart) >> 2] : libNone;
+    }
+
+    // Routine results in a0/a1 (hit counted)
+    void Execute(Routine ARoutine, unsigned long &AA0, unsigned long &AA1);
+
+    static const char *Name(Routine ARoutine);
+
+    __property int              Routines               = { read=FcRoutines };
+    __property unsigned __int64 Hits[Routine Index]    = { read=getHits };
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,209 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <algorithm>
+
+#include "ListingU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static bool AddressLess(const TRiscVListing::TSymbol &A, const TRiscVListing::TSymbol &B)
+{
+    return A.Address < B.Address;
+}
+//---------------------------------------------------------------------------
+
+static bool AddressEqual(const TRiscVListing::TSymbol &A, const TRiscVListing::TSymbol &B)
+{
+    return A.Address == B.Address;
+}
+//---------------------------------------------------------------------------
+
+TRiscVListing::TRiscVListing()
+{
+    FTextStart = 0;
+    FTextEnd   = 0;
+    FSorted    = true;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVListing::Clear()
+{
+    FTextStart = 0;
+    FTextEnd   = 0;
+    FRows.clear();
+    FSymbols.clear();
+    FSorted    = true;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVListing::SetText(unsigned long ATextStart, unsigned long ATextEnd)
+{
+    if (ATextEnd < ATextStart)
+        ATextEnd = ATextStart;
+
+    FTextStart = ATextStart & ~3UL;
+    FTextEnd   = ATextEnd;
+    FRows.assign((FTextEnd - FTextStart + 3) >> 2, -1);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVListing::SetRow(unsigned long AAddress, int ARow)
+{
+    if (AAddress >= FTextStart && AAddress < FTextEnd)
+        FRows[(AAddress - FTextStart) >> 2] = ARow;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVListing::AddSymbol(unsigned long AAddress, const std::string &AName)
+{
+TSymbol Symbol;
+
+    Symbol.Address = AAddress;
+    Symbol.Name    = AName;
+
+    if (!FSymbols.empty() && AAddress <= FSymbols.back().Address)
+        FSorted = false;
+
+    FSymbols.push_back(Symbol);
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVListing::AddSymbolLine(const char *ALine)
+{
+unsigned long Address;
+char          Name[256];
+
+    if (sscanf(ALine, "%lx <%255[^>]>:", &Address, Name) != 2)
+        return false;
+
+    AddSymbol(Address, Name);
+    return true;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVListing::AddSymbols(TStrings *AListing)
+{
+    for (int c=0; c<AListing->Count; c++)
+        AddSymbolLine(AnsiString(AListing->Strings[c]).c_str());
+}
+//---------------------------------------------------------------------------
+
+// No mapping symbols ($x, $d) or assembler locals
+void TRiscVListing::AddSymbols(const std::map<std::string, unsigned long> &ASymbols)
+{
+std::map<std::string, unsigned long>::const_iterator Symbol;
+
+    for (Symbol = ASymbols.begin(); Symbol != ASymbols.end(); ++Symbol)
+        if (Symbol->second >= FTextStart && Symbol->second < FTextEnd
+            && Symbol->first[0] != '$' && Symbol->first.compare(0, 2, ".L"))
+            AddSymbol(Symbol->second, Symbol->first);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVListing::AddFunctions(TRiscVCfg *ACfg)
+{
+unsigned long Entry;
+char          Name[16];
+
+    for (int f=0; f<ACfg->FunctionCount; f++)
+        if (!FindFunction(ACfg->Functions[f], Entry) || Entry != ACfg->Functions[f]) {
+            sprintf(Name, "fn_%08lx", ACfg->Functions[f]);
+            AddSymbol(ACfg->Functions[f], Name);
+        }
+}
+//---------------------------------------------------------------------------
+
+// Stable: the first name added for an address is kept
+void TRiscVListing::Sort()
+{
+    if (FSorted)
+        return;
+
+    std::stable_sort(FSymbols.begin(), FSymbols.end(), AddressLess);
+    FSymbols.erase(std::unique(FSymbols.begin(), FSymbols.end(), AddressEqual), FSymbols.end());
+    FSorted = true;
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVListing::FindFunction(unsigned long AAddress, unsigned long &AEntry)
+{
+TSymbol                        Key;
+std::vector<TSymbol>::iterator Symbol;
+
+    Sort();
+
+    Key.Address = AAddress;
+    Symbol = std::upper_bound(FSymbols.begin(), FSymbols.end(), Key, AddressLess);
+    if (Symbol == FSymbols.begin())
+        return false;
+
+    AEntry = (--Symbol)->Address;
+    return true;
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVListing::FindSymbol(const std::string &AName, unsigned long &AAddress)
+{
+    for (size_t s=0; s<FSymbols.size(); s++)
+        if (FSymbols[s].Name == AName) {
+            AAddress = FSymbols[s].Address;
+            return true;
+        }
+
+    return false;
+}
+//---------------------------------------------------------------------------
+
+std::string TRiscVListing::SymbolName(unsigned long AAddress)
+{
+TSymbol                        Key;
+std::vector<TSymbol>::iterator Symbol;
+char                           Buffer[300];
+
+    Sort();
+
+    Key.Address = AAddress;
+    Symbol = std::upper_bound(FSymbols.begin(), FSymbols.end(), Key, AddressLess);
+
+    if (Symbol == FSymbols.begin())
+        sprintf(Buffer, "0x%08lx", AAddress);
+    else if ((--Symbol)->Address == AAddress)
+        return Symbol->Name;
+    else
+        sprintf(Buffer, "%s+0x%lx", Symbol->Name.c_str(), AAddress - Symbol->Address);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
+
+const TRiscVListing::TSymbol & TRiscVListing::getSymbol(int AIndex)
+{
+    Sort();
+
+    if (AIndex < 0 || AIndex >= (int)FSymbols.size())
+        throw Exception("Invalid symbol index");
+
+    return FSymbols[AIndex];
+}
+//---------------------------------------------------------------------------
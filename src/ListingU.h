@@ -0,0 +1,94 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef ListingUH
+#define ListingUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <map>
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "CfgU.h"
+//---------------------------------------------------------------------------
+
+/*
+Program address index
+
+Built once per program load and shared by the debugger, the profiler and
+the reports: a dense .text word => listing row array (the debugger finds
+the row of the PC in O(1)) and a symbol table sorted by address (function
+and offset of an address by binary search). Symbols come from objdump
+listings ("<address> <name>:" lines) or ELF symbol tables.
+*/
+class TRiscVListing
+{
+public:
+    typedef struct {
+        unsigned long Address;
+        std::string   Name;
+    } TSymbol;
+
+private:
+    unsigned long        FTextStart;
+    unsigned long        FTextEnd;
+    std::vector<int>     FRows;         // .text word => listing row (-1 => none)
+    std::vector<TSymbol> FSymbols;      // Sorted by address once FSorted
+    bool                 FSorted;
+
+    void Sort();
+
+    int getSymbolCount() { Sort(); return (int)FSymbols.size(); }
+    const TSymbol &getSymbol(int AIndex);
+
+public:
+    TRiscVListing();
+
+    void Clear();
+
+    // Rows: SetText() sizes the index (all rows -1), SetRow() fills it
+    void SetText(unsigned long ATextStart, unsigned long ATextEnd);
+    void SetRow (unsigned long AAddress, int ARow);
+    int  Row    (unsigned long AAddress)
+    {
+        if (AAddress < FTextStart || AAddress >= FTextEnd || (AAddress & 0x3))
+            return -1;
+
+        return FRows[(AAddress - FTextStart) >> 2];
+    }
+
+    // Symbols (first name wins on addresses with several)
+    void AddSymbol    (unsigned long AAddress, const std::string &AName);
+    bool AddSymbolLine(const char *ALine);          // objdump "<address> <name>:" line
+    void AddSymbols   (TStrings *AListing);         // All symbol lines of a listing
+    void AddSymbols   (const std::map<std::string, unsigned long> &ASymbols);  // ELF: .text labels only (SetText first)
+    void AddFunctions (TRiscVCfg *ACfg);            // Call targets with no symbol as fn_<address>
+
+    bool        FindFunction(unsigned long AAddress, unsigned long &AEntry);       // Nearest symbol at or below
+    bool        FindSymbol  (const std::string &AName, unsigned long &AAddress);
+    std::string SymbolName  (unsigned long AAddress);     // "name", "name+0x10" or "0x00001234"
+
+    __property unsigned long  TextStart        = { read=FTextStart };
+    __property unsigned long  TextEnd          = { read=FTextEnd };
+    __property int            SymbolCount      = { read=getSymbolCount };
+    __property const TSymbol &Symbols[int Index] = { read=getSymbol };
+};
+//---------------------------------------------------------------------------
+#endif
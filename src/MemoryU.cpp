@@ -0,0 +1,133 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <string.h>
+#include <algorithm>
+
+#include "MemoryU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static char ZeroPage[TRiscVMemory::PageSize];   // Read only by contract (ReadPtr)
+//---------------------------------------------------------------------------
+
+TRiscVMemory::TRiscVMemory()
+{
+    FTables.resize(TableCount);
+    FcPages        = 0;
+    FCachePage     = (unsigned long)-1;
+    FpCachePage    = NULL;
+    FCacheWritable = false;
+}
+//---------------------------------------------------------------------------
+
+TRiscVMemory::~TRiscVMemory()
+{
+    Clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVMemory::Clear()
+{
+    for (size_t t=0; t<FTables.size(); t++) {
+        for (size_t p=0; p<FTables[t].size(); p++)
+            delete [] FTables[t][p];
+
+        FTables[t].clear();
+    }
+
+    FcPages        = 0;
+    FCachePage     = (unsigned long)-1;
+    FpCachePage    = NULL;
+    FCacheWritable = false;
+}
+//---------------------------------------------------------------------------
+
+const char * TRiscVMemory::LookupRead(unsigned long APage)
+{
+std::vector<char *> &Table = FTables[APage >> TableBits];
+char                *pPage = Table.empty() ? NULL : Table[APage & (TableSize - 1)];
+
+    FCachePage     = APage;
+    FpCachePage    = pPage ? pPage : ZeroPage;
+    FCacheWritable = pPage != NULL;
+
+    return FpCachePage;
+}
+//---------------------------------------------------------------------------
+
+char * TRiscVMemory::LookupWrite(unsigned long APage)
+{
+std::vector<char *> &Table = FTables[APage >> TableBits];
+char               **ppPage;
+
+    if (Table.empty())
+        Table.assign(TableSize, (char *)NULL);
+
+    ppPage = &Table[APage & (TableSize - 1)];
+
+    if (!*ppPage) {
+        *ppPage = new char[PageSize];
+        memset(*ppPage, 0, PageSize);
+        FcPages++;
+    }
+
+    FCachePage     = APage;
+    FpCachePage    = *ppPage;
+    FCacheWritable = true;
+
+    return *ppPage;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVMemory::Read(unsigned long AAddress, void *ApData, unsigned long ASize)
+{
+unsigned long Chunk;
+
+    for (; ASize; ASize -= Chunk, AAddress += Chunk, ApData = (char *)ApData + Chunk) {
+        Chunk = std::min(ASize, PageSize - (AAddress & (PageSize - 1)));
+        memcpy(ApData, ReadPtr(AAddress), Chunk);
+    }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVMemory::Write(unsigned long AAddress, const void *ApData, unsigned long ASize)
+{
+unsigned long Chunk;
+
+    for (; ASize; ASize -= Chunk, AAddress += Chunk, ApData = (const char *)ApData + Chunk) {
+        Chunk = std::min(ASize, PageSize - (AAddress & (PageSize - 1)));
+        memcpy(WritePtr(AAddress), ApData, Chunk);
+    }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVMemory::GetPages(std::vector<unsigned long> &APages)
+{
+    APages.clear();
+
+    for (size_t t=0; t<FTables.size(); t++)
+        for (size_t p=0; p<FTables[t].size(); p++)
+            if (FTables[t][p])
+                APages.push_back((unsigned long)((t << TableBits) | p));
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,87 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef MemoryUH
+#define MemoryUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Sparse guest memory
+
+The whole 32-bit address space in PageSize pages, through a two level page
+table (TableCount tables of TableSize pages, allocated on first use). A page
+is allocated (zero filled) on the first write to it; reads of pages never
+written see one shared zero page. The last page looked up is cached (one
+entry), so runs of accesses to the same page skip the table walk.
+Pointers returned are valid up to the end of their page only.
+*/
+class TRiscVMemory
+{
+public:
+    enum {
+        PageBits   = 12,
+        PageSize   = 1 << PageBits,
+        TableBits  = 10,
+        TableSize  = 1 << TableBits,
+        TableCount = 1 << (32 - PageBits - TableBits)
+    };
+
+private:
+    std::vector<std::vector<char *> > FTables;  // [TableCount][TableSize], NULL => zero page
+    unsigned long                     FcPages;  // Pages allocated
+
+    unsigned long FCachePage;       // Last page looked up (-1 => none)
+    char         *FpCachePage;
+    bool          FCacheWritable;   // FpCachePage is not the zero page
+
+    const char *LookupRead (unsigned long APage);
+    char       *LookupWrite(unsigned long APage);
+
+public:
+    TRiscVMemory();
+    ~TRiscVMemory();
+
+    void Clear();   // Frees every page
+
+    const char *ReadPtr(unsigned long AAddress)
+    {
+        unsigned long Page = AAddress >> PageBits;
+        return (Page == FCachePage ? FpCachePage : LookupRead(Page)) + (AAddress & (PageSize - 1));
+    }
+
+    char *WritePtr(unsigned long AAddress)
+    {
+        unsigned long Page = AAddress >> PageBits;
+        return (Page == FCachePage && FCacheWritable ? FpCachePage : LookupWrite(Page)) + (AAddress & (PageSize - 1));
+    }
+
+    // Any range (page crossing, wrapping at 4 GiB)
+    void Read (unsigned long AAddress, void *ApData, unsigned long ASize);
+    void Write(unsigned long AAddress, const void *ApData, unsigned long ASize);
+
+    void GetPages(std::vector<unsigned long> &APages);   // Allocated page numbers, ascending
+
+    __property unsigned long PageCount = { read=FcPages };
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,187 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+#include "PacerU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+TRiscVPacer::TRiscVPacer(RiscV *ApCPU)
+{
+    FpCPU       = ApCPU;
+    FFrequency  = ApCPU->TimerFrequency;
+    FSleepSlack = std::chrono::milliseconds(1);
+    FAchieved   = 0;
+    Start();
+
+#ifdef _WIN32
+    timeBeginPeriod(1);     // 1 ms sleep granularity (default ~15.6 ms)
+#endif
+}
+//---------------------------------------------------------------------------
+
+TRiscVPacer::~TRiscVPacer()
+{
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPacer::setFrequency(unsigned long AFrequency)
+{
+    FFrequency = AFrequency;
+
+    if (AFrequency)
+        FpCPU->TimerFrequency = AFrequency;
+
+    Start();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPacer::Start()
+{
+    FOrigin      = TClock::now();
+    FOriginTime  = FpCPU->Time;
+    FSliceEnd    = FOrigin;
+    FReportStart = FOrigin;
+    FReportTime  = FOriginTime;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPacer::BeginSlice(unsigned long AMilliseconds)
+{
+    FSliceEnd = TClock::now() + std::chrono::milliseconds(AMilliseconds);
+}
+//---------------------------------------------------------------------------
+
+RiscV::StopReason TRiscVPacer::Run(bool AResume)
+{
+bool              HostWait = FpCPU->HostWait;
+RiscV::StopReason Reason;
+
+    FpCPU->HostWait = false;    // wfi time is slept here, on the schedule
+    try
+    {
+        Reason = RunSlice(AResume);
+    }
+    catch(...)
+    {
+        FpCPU->HostWait = HostWait;
+        throw;
+    }
+    FpCPU->HostWait = HostWait;
+
+    return Reason;
+}
+//---------------------------------------------------------------------------
+
+RiscV::StopReason TRiscVPacer::RunSlice(bool AResume)
+{
+TClock::time_point  Now;
+TClock::time_point  Due;
+double              Elapsed;
+unsigned __int64    Target;
+unsigned __int64    Quantum;
+RiscV::StopReason   Reason;
+
+    for (;;) {
+        Now = TClock::now();
+        Measure(Now);
+
+        if (Now >= FSliceEnd)
+            return RiscV::stopCount;
+
+        if (FFrequency) {
+            // Guest time due now, schedule moved forward if too far behind
+            Elapsed = std::chrono::duration<double>(Now - FOrigin).count();
+            Target  = FOriginTime + (unsigned __int64)(Elapsed * FFrequency);
+            Quantum = std::max((unsigned __int64)FFrequency * QuantumMs / 1000, (unsigned __int64)1);
+
+            if (Target > FpCPU->Time + (unsigned __int64)FFrequency * MaxLagMs / 1000) {
+                FOrigin      = Now;
+                FOriginTime  = FpCPU->Time;
+                Target       = FOriginTime;
+            }
+
+            if (FpCPU->Time > Target) {
+                // Ahead: wait for the wall clock (slice end at most)
+                Due = FOrigin + std::chrono::duration_cast<TClock::duration>(
+                          std::chrono::duration<double>((double)(FpCPU->Time - FOriginTime) / FFrequency));
+                SleepUntil(std::min(Due, FSliceEnd));
+                continue;
+            }
+
+            Quantum += Target - FpCPU->Time;
+        }
+        else
+            Quantum = std::max((unsigned __int64)(FAchieved * QuantumMs / 1000), (unsigned __int64)10000);
+
+        Reason  = FpCPU->Run((unsigned long)std::min(Quantum, (unsigned __int64)0x7fffffff), AResume);
+        AResume = false;
+
+        if (Reason == RiscV::stopBreakpoint || Reason == RiscV::stopWatchpoint)
+            return Reason;
+    }
+}
+//---------------------------------------------------------------------------
+
+// OS sleep up to FSleepSlack before AWake, then spin: the slack follows the
+// worst recent overshoot (slowly decaying, MaxSpinUs at most)
+void TRiscVPacer::SleepUntil(TClock::time_point AWake)
+{
+TClock::time_point Early = AWake - FSleepSlack;
+TClock::time_point Now   = TClock::now();
+
+    if (Now < Early) {
+        std::this_thread::sleep_until(Early);
+
+        Now         = TClock::now();
+        FSleepSlack = std::max(FSleepSlack - FSleepSlack / 8, std::max(Now - Early, TClock::duration::zero()));
+        FSleepSlack = std::min(FSleepSlack, TClock::duration(std::chrono::microseconds(MaxSpinUs)));
+    }
+
+    while (TClock::now() < AWake)
+        std::this_thread::yield();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPacer::Measure(TClock::time_point ANow)
+{
+double Seconds = std::chrono::duration<double>(ANow - FReportStart).count();
+
+    if (Seconds * 1000 < ReportMs)
+        return;
+
+    FAchieved    = (FpCPU->Time - FReportTime) / Seconds;
+    FReportStart = ANow;
+    FReportTime  = FpCPU->Time;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,89 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef PacerUH
+#define PacerUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <chrono>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+
+/*
+Real-time pacing
+
+Keeps guest time (RiscV::Time: instructions + ticks slept in wfi) at
+Frequency ticks per second of a monotonic clock, anchored at Start(): the
+CPU runs up to one QuantumMs ahead of the schedule, then the host thread
+sleeps until the wall clock catches up. The last part of every wait is spun
+(the sleep overshoot is measured, up to MaxSpinUs), so wakeups are precise
+with a 1 ms OS timer. Falling behind by more than MaxLagMs (slow host, UI stalls) moves
+the schedule forward instead of bursting to catch up.
+Frequency = 0 => unthrottled: quanta sized on the measured speed, no sleeps.
+
+Run() works in wall-clock slices (BeginSlice): it returns at the end of the
+slice or on a breakpoint/watchpoint, a hart in wfi sleeps on the schedule
+(CPU HostWait is off while pacing). mtime follows Frequency.
+*/
+class TRiscVPacer
+{
+    typedef std::chrono::steady_clock TClock;
+
+    enum {
+        QuantumMs = 2,          // Guest time run between clock checks
+        MaxLagMs  = 100,
+        MaxSpinUs = 1000,       // Spin limit of a wait (CPU cost vs wakeup precision)
+        ReportMs  = 500         // Achieved frequency measure window
+    };
+
+    RiscV              *FpCPU;
+    unsigned long       FFrequency;     // Ticks per second, 0 => unthrottled
+
+    TClock::time_point  FOrigin;        // Schedule anchor (wall clock)
+    unsigned __int64    FOriginTime;    // Guest time at FOrigin
+    TClock::time_point  FSliceEnd;
+    TClock::duration    FSleepSlack;    // Recent worst sleep overshoot (spun)
+
+    TClock::time_point  FReportStart;
+    unsigned __int64    FReportTime;
+    double              FAchieved;
+
+    RiscV::StopReason RunSlice(bool AResume);
+    void SleepUntil(TClock::time_point AWake);
+    void Measure   (TClock::time_point ANow);
+
+    void setFrequency(unsigned long AFrequency);
+
+public:
+    TRiscVPacer(RiscV *ApCPU);
+    ~TRiscVPacer();
+
+    void Start();       // Anchor the schedule at current guest time (run start, after a pause)
+    void BeginSlice(unsigned long AMilliseconds);
+
+    // Runs until the slice ends (stopCount) or a breakpoint/watchpoint stop
+    RiscV::StopReason Run(bool AResume = false);
+
+    __property unsigned long Frequency = { read=FFrequency, write=setFrequency };   // Restarts the schedule
+    __property double        Achieved  = { read=FAchieved };    // Guest ticks per second (last ReportMs)
+};
+//---------------------------------------------------------------------------
+#endif
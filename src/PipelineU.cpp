@@ -0,0 +1,269 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "PipelineU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const char *PredictorNames[] = { "not-taken", "btfn", "bimodal" };
+static const char *StallNames[]     = { "load-use", "mul/div", "branch", "jump", "system" };
+//---------------------------------------------------------------------------
+
+TRiscVPipeline::TRiscVPipeline()
+{
+    Configure(DefaultConfig());
+}
+//---------------------------------------------------------------------------
+
+// Small in-order core: forwarding, branches resolved in EX, iterative divider
+TRiscVPipeline::TConfig TRiscVPipeline::DefaultConfig()
+{
+    TConfig Config = { predBackwardTaken, 10, 2, 3, 34, 2, 1, 2 };
+
+    return Config;
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVPipeline::ParsePredictor(const String &AText, Predictor &APredictor)
+{
+    for (int p=predNotTaken; p<=predBimodal; p++)
+        if (AText == PredictorNames[p]) {
+            APredictor = (Predictor)p;
+            return true;
+        }
+
+    return false;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPipeline::Configure(const TConfig &AConfig)
+{
+    if (AConfig.BimodalBits < 0 || AConfig.BimodalBits > 20 || AConfig.LoadLatency < 1
+        || AConfig.MulLatency < 1 || AConfig.DivLatency < 1)
+        throw Exception("Invalid pipeline configuration");
+
+    FConfig      = AConfig;
+    FCounterMask = (1 << FConfig.BimodalBits) - 1;
+
+    Clear();
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPipeline::Clear()
+{
+    FCounters.assign(FCounterMask + 1, 1);  // Weakly not taken
+
+    FCycle        = 0;
+    FInstructions = 0;
+    FBranches     = 0;
+    FMispredicts  = 0;
+
+    memset(FReady,  0, sizeof(FReady));
+    memset(FStalls, 0, sizeof(FStalls));
+
+    for (int r=0; r<32; r++)
+        FProducer[r] = stallLoadUse;
+}
+//---------------------------------------------------------------------------
+
+// Source register needed ANeeded cycles after issue (store data: MEM)
+void TRiscVPipeline::Wait(int AReg, int ANeeded, unsigned __int64 &AIssue)
+{
+    if (AReg && FReady[AReg] > AIssue + ANeeded) {
+        FStalls[FProducer[AReg]] += FReady[AReg] - (AIssue + ANeeded);
+        AIssue = FReady[AReg] - ANeeded;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVPipeline::Predict(unsigned long APC, unsigned long AInsn, bool ATaken)
+{
+unsigned char *pCounter;
+bool           Predicted;
+
+    switch (FConfig.BranchPredictor) {
+        case predNotTaken:
+            return ATaken;
+
+        case predBackwardTaken:
+            return ATaken != ((AInsn & 0x80000000) != 0);    // Offset sign
+
+        default:
+            pCounter  = &FCounters[(APC >> 2) & FCounterMask];
+            Predicted = *pCounter >= 2;
+
+            if (ATaken && *pCounter < 3)
+                (*pCounter)++;
+            else if (!ATaken && *pCounter > 0)
+                (*pCounter)--;
+
+            return Predicted != ATaken;
+    }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPipeline::Retire(unsigned long APC, unsigned long AInsn, bool ATaken)
+{
+int              rd      = (AInsn >> 7)  & 0x1F;
+int              rs1     = (AInsn >> 15) & 0x1F;
+int              rs2     = (AInsn >> 20) & 0x1F;
+unsigned __int64 Issue   = FCycle;
+unsigned __int64 Next;
+int              Latency = 1;           // ALU: forwarded to the next insn
+Stall            Producer = stallLoadUse;
+
+    switch (AInsn & 0x7F) {
+        case 0x33:  // R-type, M extension
+            Wait(rs1, 0, Issue);
+            Wait(rs2, 0, Issue);
+
+            if ((AInsn >> 25) == 0x01) {
+                Producer = stallMulDiv;
+                Latency  = AInsn & 0x4000 ? FConfig.DivLatency : FConfig.MulLatency;
+            }
+            break;
+
+        case 0x03:  // Loads
+            Wait(rs1, 0, Issue);
+            Latency = FConfig.LoadLatency;
+            break;
+
+        case 0x13:  // ALU immediate, jalr
+        case 0x67:
+            Wait(rs1, 0, Issue);
+            break;
+
+        case 0x23:  // Stores: data needed in MEM
+            Wait(rs1, 0, Issue);
+            Wait(rs2, 1, Issue);
+            rd = 0;
+            break;
+
+        case 0x63:  // Branches
+            Wait(rs1, 0, Issue);
+            Wait(rs2, 0, Issue);
+            rd = 0;
+            break;
+
+        case 0x73:  // System: CSR source
+            Wait((AInsn >> 14) & 1 ? 0 : rs1, 0, Issue);
+            break;
+
+        case 0x0F:  // fence
+            rd = 0;
+            break;
+    }
+
+    Next = Issue + 1;
+
+    // Divider not pipelined: EX busy until the result
+    if (Producer == stallMulDiv && (AInsn & 0x4000)) {
+        FStalls[stallMulDiv] += Latency - 1;
+        Next = Issue + Latency;
+    }
+
+    if (rd) {
+        FReady[rd]    = Issue + Latency;
+        FProducer[rd] = Producer;
+    }
+
+    switch (AInsn & 0x7F) {
+        case 0x63:
+            FBranches++;
+            if (Predict(APC, AInsn, ATaken)) {
+                FMispredicts++;
+                FStalls[stallBranch] += FConfig.BranchPenalty;
+                Next                 += FConfig.BranchPenalty;
+            }
+            break;
+
+        case 0x6F:
+            FStalls[stallJump] += FConfig.JalPenalty;
+            Next               += FConfig.JalPenalty;
+            break;
+
+        case 0x67:
+            FStalls[stallJump] += FConfig.JalrPenalty;
+            Next               += FConfig.JalrPenalty;
+            break;
+
+        case 0x73:
+            FStalls[stallSystem] += FConfig.BranchPenalty;
+            Next                 += FConfig.BranchPenalty;
+            break;
+    }
+
+    FCycle = Next;
+    FInstructions++;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVPipeline::Report(TStrings *AReport)
+{
+char Buffer[256];
+char Entries[32] = "";
+
+    if (FConfig.BranchPredictor == predBimodal)
+        sprintf(Entries, " (%lu entries)", FCounterMask + 1);
+
+    sprintf(Buffer, "Predictor %s%s, load %d, mul %d, div %d, branch/jal/jalr penalty %d/%d/%d",
+        PredictorNames[FConfig.BranchPredictor], Entries,
+        FConfig.LoadLatency, FConfig.MulLatency, FConfig.DivLatency,
+        FConfig.BranchPenalty, FConfig.JalPenalty, FConfig.JalrPenalty);
+    AReport->Add(Buffer);
+
+    sprintf(Buffer, "Instructions %14.0f, cycles %14.0f, CPI %.3f",
+        (double)FInstructions, (double)FCycle, FInstructions ? (double)FCycle / FInstructions : 0.0);
+    AReport->Add(Buffer);
+
+    sprintf(Buffer, "Branches     %14.0f, mispredicted %14.0f (%.2f%%)",
+        (double)FBranches, (double)FMispredicts, FBranches ? FMispredicts * 100.0 / FBranches : 0.0);
+    AReport->Add(Buffer);
+
+    for (int s=0; s<stallCount; s++) {
+        sprintf(Buffer, "  %-10s stalls %14.0f  %6.3f CPI",
+            StallNames[s], (double)FStalls[s], FInstructions ? (double)FStalls[s] / FInstructions : 0.0);
+        AReport->Add(Buffer);
+    }
+}
+//---------------------------------------------------------------------------
+
+String TRiscVPipeline::FormatJson()
+{
+char Buffer[512];
+
+    sprintf(Buffer, "{\"predictor\":\"%s\",\"instructions\":%.0f,\"cycles\":%.0f,\"cpi\":%.4f,"
+                    "\"branches\":%.0f,\"mispredicts\":%.0f,\"stalls\":{\"load_use\":%.0f,"
+                    "\"mul_div\":%.0f,\"branch\":%.0f,\"jump\":%.0f,\"system\":%.0f}}",
+        PredictorNames[FConfig.BranchPredictor],
+        (double)FInstructions, (double)FCycle, FInstructions ? (double)FCycle / FInstructions : 0.0,
+        (double)FBranches, (double)FMispredicts,
+        (double)FStalls[stallLoadUse], (double)FStalls[stallMulDiv], (double)FStalls[stallBranch],
+        (double)FStalls[stallJump], (double)FStalls[stallSystem]);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,116 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef PipelineUH
+#define PipelineUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+
+/*
+Five stage in-order pipeline timing model
+
+A scoreboard updated once per retired insn (no cycle by cycle simulation):
+every register has the cycle its value can be forwarded from, an insn
+issues (enters EX) one cycle after the previous one or when its sources
+are ready. With full forwarding, stalls come from:
+    load-use        a load result is ready after MEM (LoadLatency)
+    mul/div         mul pipelined (MulLatency to the result), div not
+                    pipelined (DivLatency cycles holding EX)
+    branch          misprediction flushes IF/ID (BranchPenalty), with a
+                    static (not taken, backward taken) or bimodal predictor
+    jump            jal target known in ID (JalPenalty), jalr in EX
+                    (JalrPenalty), system insns flush (traps, CSRs)
+Caches are not part of it (see TRiscVCaches).
+*/
+class TRiscVPipeline
+{
+public:
+    enum Predictor {
+        predNotTaken,
+        predBackwardTaken,  // Backward taken, forward not taken
+        predBimodal         // 2-bit counters indexed by PC
+    };
+
+    typedef struct {
+        Predictor BranchPredictor;
+        int       BimodalBits;      // log2 of the counters
+        int       LoadLatency;      // Cycles from EX to a load result
+        int       MulLatency;
+        int       DivLatency;
+        int       BranchPenalty;    // Mispredicted branch
+        int       JalPenalty;
+        int       JalrPenalty;
+    } TConfig;
+
+    enum Stall {
+        stallLoadUse,
+        stallMulDiv,
+        stallBranch,
+        stallJump,
+        stallSystem,
+        stallCount
+    };
+
+private:
+    TConfig                     FConfig;
+    std::vector<unsigned char>  FCounters;      // Bimodal, 0..1 not taken, 2..3 taken
+    unsigned long               FCounterMask;
+
+    unsigned __int64            FCycle;         // Issue cycle of the next insn
+    unsigned __int64            FReady[32];     // Cycle a register value can be forwarded
+    Stall                       FProducer[32];  // Stall class of a wait on the register
+
+    unsigned __int64            FInstructions;
+    unsigned __int64            FStalls[stallCount];
+    unsigned __int64            FBranches;
+    unsigned __int64            FMispredicts;
+
+    void Wait   (int AReg, int ANeeded, unsigned __int64 &AIssue);
+    bool Predict(unsigned long APC, unsigned long AInsn, bool ATaken);   // true => mispredicted
+
+public:
+    TRiscVPipeline();
+
+    void Configure(const TConfig &AConfig);
+    void Clear();
+
+    // AInsn at APC executed, ATaken => the PC did not fall through
+    void Retire(unsigned long APC, unsigned long AInsn, bool ATaken);
+
+    void   Report(TStrings *AReport);
+    String FormatJson();    // One JSON object per line
+
+    static TConfig DefaultConfig();
+    static bool    ParsePredictor(const String &AText, Predictor &APredictor);
+
+    __property TConfig          Config       = { read=FConfig };
+    __property unsigned __int64 Cycles       = { read=FCycle };
+    __property unsigned __int64 Instructions = { read=FInstructions };
+    __property unsigned __int64 Branches     = { read=FBranches };
+    __property unsigned __int64 Mispredicts  = { read=FMispredicts };
+    __property unsigned __int64 Stalls[Stall Index] = { read=getStalls };
+
+private:
+    unsigned __int64 getStalls(Stall AIndex) { return FStalls[AIndex]; }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,165 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <algorithm>
+
+#include "ProfilerU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+TRiscVProfiler::TRiscVProfiler()
+{
+    FInterval = 1000;
+    FpListing = NULL;
+    Reset(0);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVProfiler::Reset(unsigned long AEntry)
+{
+TFrame Frame = { AEntry, (unsigned long)-1 };
+
+    FStack.assign(1, Frame);
+    FcLost      = 0;
+    FSamples.clear();
+    FcSamples   = 0;
+    FNextSample = FInterval;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVProfiler::Link(unsigned long APC, unsigned long AInsn, unsigned long ANextPC)
+{
+int    rd  = (AInsn >> 7)  & 0x1F;
+int    rs1 = (AInsn >> 15) & 0x1F;
+TFrame Frame;
+
+    if (TRiscVCfg::IsLinkRegister(rd)) {                // Call
+        if (FStack.size() >= MaxDepth) {
+            FcLost++;
+            return;
+        }
+
+        Frame.Entry  = ANextPC;
+        Frame.Return = APC + 4;
+        FStack.push_back(Frame);
+    }
+    else if (!rd && (AInsn & 0x7F) == 0x67 && TRiscVCfg::IsLinkRegister(rs1)) {    // Return
+        if (FcLost) {
+            FcLost--;
+            return;
+        }
+
+        for (size_t f=FStack.size()-1; f>=1; f--)
+            if (FStack[f].Return == ANextPC) {
+                FStack.resize(f);
+                return;
+            }
+
+        if (FStack.size() > 1)
+            FStack.pop_back();
+    }
+}
+//---------------------------------------------------------------------------
+
+// Idle loops skipped in one go count as the samples they span
+void TRiscVProfiler::Sample(unsigned long APC, unsigned __int64 AInstret)
+{
+unsigned __int64 cSamples;
+
+    if (!FInterval) {
+        FNextSample = (unsigned __int64)-1;
+        return;
+    }
+
+    cSamples = (AInstret - FNextSample) / FInterval + 1;
+
+    FKey.resize(FStack.size());
+    for (size_t f=0; f<FStack.size(); f++)
+        FKey[f] = FStack[f].Entry;
+    FKey.back() = FunctionOf(APC);
+
+    FSamples[FKey] += cSamples;
+    FcSamples      += cSamples;
+    FNextSample    += cSamples * FInterval;
+}
+//---------------------------------------------------------------------------
+
+// Nearest symbol at or below APC, unless the innermost frame entry is nearer
+unsigned long TRiscVProfiler::FunctionOf(unsigned long APC)
+{
+unsigned long Entry = FStack.back().Entry;
+unsigned long Symbol;
+
+    if (!FpListing || !FpListing->FindFunction(APC, Symbol))
+        return Entry;
+
+    return Entry <= APC && Entry > Symbol ? Entry : Symbol;
+}
+//---------------------------------------------------------------------------
+
+std::string TRiscVProfiler::Name(unsigned long AEntry)
+{
+char Buffer[16];
+
+    if (FpListing)
+        return FpListing->SymbolName(AEntry);
+
+    sprintf(Buffer, "0x%08lx", AEntry);
+    return Buffer;
+}
+//---------------------------------------------------------------------------
+
+static bool Heavier(const std::pair<unsigned __int64, std::string> &A, const std::pair<unsigned __int64, std::string> &B)
+{
+    return A.first > B.first || (A.first == B.first && A.second < B.second);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVProfiler::Folded(TStrings *AFolded)
+{
+std::vector<std::pair<unsigned __int64, std::string> >                   Lines;
+std::map<std::vector<unsigned long>, unsigned __int64>::iterator         Stack;
+std::string                                                              Line;
+char                                                                     Count[32];
+
+    for (Stack = FSamples.begin(); Stack != FSamples.end(); ++Stack) {
+        Line.clear();
+
+        for (size_t f=0; f<Stack->first.size(); f++) {
+            if (f)
+                Line += ';';
+            Line += Name(Stack->first[f]);
+        }
+
+        std::replace(Line.begin(), Line.end(), ' ', '_');
+        Lines.push_back(std::make_pair(Stack->second, Line));
+    }
+
+    std::sort(Lines.begin(), Lines.end(), Heavier);
+
+    for (size_t l=0; l<Lines.size(); l++) {
+        sprintf(Count, " %.0f", (double)Lines[l].first);
+        AFolded->Add((Lines[l].second + Count).c_str());
+    }
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef ProfilerUH
+#define ProfilerUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <map>
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "ListingU.h"
+//---------------------------------------------------------------------------
+
+/*
+Call stack sampling profiler
+
+A shadow call stack follows the guest calling convention: jal/jalr linking
+ra/t0 push a frame (callee entry, return address), jalr x0 through ra/t0
+returns to the matching frame (frames skipped by tail calls or longjmp are
+dropped, an unknown return address pops one frame). Calls and returns end
+basic blocks, so the core calls AfterBlock() once per block exit only.
+Every Interval insns (checked at block exits) the stack is sampled: callers
+by their entry, the innermost frame by the function of the PC (tail jumps
+show the function actually running). Output is folded stacks, one
+"caller;...;callee count" line per distinct stack, for flamegraph tools.
+Names come from the program listing symbols (see TRiscVListing), raw
+addresses without one.
+*/
+class TRiscVProfiler
+{
+public:
+    enum { MaxDepth = 256 };    // Deeper calls are not tracked (runaway recursion)
+
+private:
+    typedef struct {
+        unsigned long Entry;
+        unsigned long Return;
+    } TFrame;
+
+    std::vector<TFrame>                                       FStack;
+    unsigned long                                             FcLost;      // Frames beyond MaxDepth
+    std::map<std::vector<unsigned long>, unsigned __int64>    FSamples;    // Function entries => count
+    std::vector<unsigned long>                                FKey;
+    TRiscVListing                                            *FpListing;
+    unsigned long                                             FInterval;
+    unsigned __int64                                          FNextSample;
+    unsigned __int64                                          FcSamples;
+
+    void Link  (unsigned long APC, unsigned long AInsn, unsigned long ANextPC);
+    void Sample(unsigned long APC, unsigned __int64 AInstret);
+
+    unsigned long FunctionOf(unsigned long APC);
+    std::string   Name      (unsigned long AEntry);
+
+public:
+    TRiscVProfiler();
+
+    void Reset(unsigned long AEntry);           // Empty stack at AEntry, samples cleared
+
+    // Last insn of a block (AInsn at APC) executed, ANextPC = new PC
+    void AfterBlock(unsigned long APC, unsigned long AInsn, unsigned long ANextPC, unsigned __int64 AInstret)
+    {
+        if (AInstret >= FNextSample)
+            Sample(APC, AInstret);      // Block insns ran in the caller frame
+
+        if ((AInsn & 0x7F) == 0x67 || ((AInsn & 0x7F) == 0x6F && (AInsn & 0xF80)))
+            Link(APC, AInsn, ANextPC);      // jalr, jal linking (not plain jumps)
+    }
+
+    void Folded(TStrings *AFolded);     // Folded stacks, heaviest first
+
+    __property unsigned long    Interval = { read=FInterval, write=FInterval };    // Insns per sample
+    __property TRiscVListing   *Listing  = { read=FpListing, write=FpListing };    // Symbols (host owned, NULL => addresses)
+    __property unsigned __int64 Samples  = { read=FcSamples };
+    __property int              Depth    = { read=getDepth };
+
+private:
+    int getDepth() { return (int)FStack.size(); }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,187 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <string.h>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "SharedMemoryU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static_assert(sizeof(std::atomic<unsigned int>) == sizeof(unsigned int) && std::atomic<unsigned int>::is_always_lock_free,
+              "TRiscVSharedMemory: Sequence must be a lock-free 32-bit field");
+//---------------------------------------------------------------------------
+
+// An object of the same name may be a live simulator's: taken over only
+// with AForce. POSIX unlinks it (readers still mapping the old one keep its
+// pages instead of faulting on a shrunk file), Windows maps the same object
+TRiscVSharedMemory::TRiscVSharedMemory(const String &AName, unsigned long ARamSize, bool AForce)
+{
+unsigned __int64 cBytes = (unsigned __int64)HeaderSize + ARamSize;
+
+    FName    = AName;
+    FpHeader = NULL;
+    FcRam    = ARamSize;
+
+    if (AName.IsEmpty() || ARamSize == 0)
+        throw Exception("Invalid shared memory name or size");
+
+#ifdef _WIN32
+    FhMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(cBytes >> 32), (DWORD)cBytes,
+                                  ("Local\\" + AName).c_str());
+    if (!FhMapping)
+        throw Exception("Cannot create shared memory: " + AName);
+
+    if (GetLastError() == ERROR_ALREADY_EXISTS && !AForce) {
+        CloseHandle(FhMapping);
+        throw Exception("Shared memory already in use: " + AName);
+    }
+
+    FpHeader = (THeader *)MapViewOfFile(FhMapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)cBytes);
+    if (!FpHeader) {
+        CloseHandle(FhMapping);
+        throw Exception("Cannot map shared memory: " + AName);
+    }
+    memset((void *)FpHeader, 0, (size_t)cBytes);   // Reused mapping
+#else
+    AnsiString Path = AnsiString("/" + AName);
+    int        hFile;
+    void      *pBase;
+
+    if (AForce)
+        shm_unlink(Path.c_str());
+
+    hFile = shm_open(Path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (hFile < 0 && errno == EEXIST)
+        throw Exception("Shared memory already in use: " + AName);
+    if (hFile < 0)
+        throw Exception("Cannot create shared memory: " + AName);
+
+    if (ftruncate(hFile, (off_t)cBytes) != 0) {
+        close(hFile);
+        shm_unlink(Path.c_str());
+        throw Exception("Cannot size shared memory: " + AName);
+    }
+
+    // The mapping keeps the object alive, the descriptor is not needed
+    pBase = mmap(NULL, (size_t)cBytes, PROT_READ | PROT_WRITE, MAP_SHARED, hFile, 0);
+    close(hFile);
+    if (pBase == MAP_FAILED) {
+        shm_unlink(Path.c_str());
+        throw Exception("Cannot map shared memory: " + AName);
+    }
+    FpHeader = (THeader *)pBase;
+#endif
+
+    FpHeader->Magic                = Magic;
+    FpHeader->Version              = Version;
+    FpHeader->HeaderSize           = HeaderSize;
+    FpHeader->Regions[0].Kind      = regionRam;
+    FpHeader->Regions[0].Address   = 0;
+    FpHeader->Regions[0].Offset    = HeaderSize;
+    FpHeader->Regions[0].Size      = ARamSize;
+    FpHeader->RegionCount          = 1;
+}
+//---------------------------------------------------------------------------
+
+TRiscVSharedMemory::~TRiscVSharedMemory()
+{
+    if (!FpHeader)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(FpHeader);
+    CloseHandle(FhMapping);
+#else
+    munmap(FpHeader, (size_t)HeaderSize + FcRam);
+    shm_unlink(AnsiString("/" + FName).c_str());
+#endif
+}
+//---------------------------------------------------------------------------
+
+// Single writer. The odd value is ordered before the field stores (release
+// fence), the closing even value after them (release increment): a reader
+// that sees the even Sequence sees every field written before it, one that
+// saw the odd value retries
+void TRiscVSharedMemory::BeginUpdate()
+{
+    FpHeader->Sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVSharedMemory::EndUpdate()
+{
+    FpHeader->Sequence.fetch_add(1, std::memory_order_release);
+}
+//---------------------------------------------------------------------------
+
+bool TRiscVSharedMemory::AddRegion(RegionKind AKind, unsigned long AAddress, unsigned long ASize)
+{
+TRegion *pRegion;
+
+    if (FpHeader->RegionCount >= MaxRegions || AAddress >= FcRam || ASize > FcRam - AAddress)
+        return false;
+
+    BeginUpdate();
+    pRegion          = &FpHeader->Regions[FpHeader->RegionCount];
+    pRegion->Kind    = AKind;
+    pRegion->Address = AAddress;
+    pRegion->Offset  = HeaderSize + AAddress;
+    pRegion->Size    = ASize;
+    FpHeader->RegionCount++;
+    EndUpdate();
+
+    return true;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVSharedMemory::ClearRegions()
+{
+    BeginUpdate();
+    memset(&FpHeader->Regions[1], 0, sizeof(TRegion) * (MaxRegions - 1));
+    FpHeader->RegionCount = 1;
+    EndUpdate();
+}
+//---------------------------------------------------------------------------
+
+// ~40 stores per call: cheap at one call per run slice
+void TRiscVSharedMemory::Publish(RiscV *ApCPU)
+{
+    BeginUpdate();
+    FpHeader->Instret   = ApCPU->InstructionCount;
+    FpHeader->PC        = ApCPU->PC;
+    FpHeader->Privilege = ApCPU->Privilege;
+    for (int r=0; r<32; r++)
+        FpHeader->Reg[r] = ApCPU->Registers[r];
+    EndUpdate();
+}
+//---------------------------------------------------------------------------
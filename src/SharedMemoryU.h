@@ -0,0 +1,122 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef SharedMemoryUH
+#define SharedMemoryUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <atomic>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+
+/*
+Guest RAM exported as a named shared memory object
+
+The object is one header page followed by the guest RAM, and the RAM part
+is the buffer given to RiscV::Load(): the emulator runs on the shared pages
+themselves, nothing is copied and guest stores cost what they cost on a
+private buffer. Other processes open the object by name (POSIX:
+/dev/shm/<name>, Windows: Local\<name>) and map it read-only to watch the
+memory live.
+The header (little endian, fixed-width fields, layout below) describes the
+regions (RAM offset in the object, guest address, size) and holds PC,
+registers, privilege and insn count as of the last Publish(). Publish() is
+called by the host between run slices, not per insn, so the snapshot of the
+registers lags the memory by up to one slice.
+Sequence is a seqlock: odd while Publish() writes the header. A reader
+copies the fields it needs, then takes them only if Sequence was even and
+unchanged before and after the copy (retry otherwise). RAM is never locked.
+Sequence is a lock-free std::atomic with the layout of a plain 32-bit
+field, so readers in other languages read it as such.
+An existing object of the same name belongs to another simulator (or to a
+killed one): creation fails unless AForce, which replaces it.
+*/
+class TRiscVSharedMemory
+{
+public:
+    enum {
+        Magic       = 0x4D535652,   // "RVSM"
+        Version     = 1,
+        HeaderSize  = 4096,         // RAM offset in the object
+        MaxRegions  = 8
+    };
+
+    enum RegionKind {
+        regionRam         = 0,      // Whole RAM buffer (always region 0)
+        regionText        = 1,      // Program code
+        regionFramebuffer = 2       // Framebuffer window (TRiscVFramebuffer)
+    };
+
+    typedef struct {
+        unsigned int     Kind;      // RegionKind
+        unsigned int     Address;   // Guest address
+        unsigned int     Offset;    // Offset in the object
+        unsigned int     Size;      // Bytes
+    } TRegion;
+
+    typedef struct {
+        unsigned int     Magic;
+        unsigned int     Version;
+        unsigned int     HeaderSize;
+        std::atomic<unsigned int> Sequence; // Seqlock, odd while updating
+        unsigned __int64 Instret;       // Insns retired
+        unsigned int     PC;
+        unsigned int     Privilege;     // RiscV::Mode
+        unsigned int     Reg[32];
+        unsigned int     RegionCount;
+        unsigned int     Reserved;
+        TRegion          Regions[MaxRegions];
+    } THeader;
+
+private:
+    String            FName;
+    THeader          *FpHeader;     // Mapping base
+    unsigned long     FcRam;
+#ifdef _WIN32
+    void             *FhMapping;
+#endif
+
+    char *getRam() { return (char *)FpHeader + HeaderSize; }
+
+    void BeginUpdate();
+    void EndUpdate();
+
+public:
+    // Creates the object <AName>, RAM zero filled. AForce => an existing
+    // object is replaced (POSIX) or reused (Windows) instead of an error
+    TRiscVSharedMemory(const String &AName, unsigned long ARamSize, bool AForce = false);
+    ~TRiscVSharedMemory();          // Unmaps and removes the name
+
+    // Guest window [AAddress, AAddress + ASize) inside RAM; false when
+    // full or outside RAM
+    bool AddRegion(RegionKind AKind, unsigned long AAddress, unsigned long ASize);
+    void ClearRegions();            // Keeps the RAM region
+
+    // Registers, PC, privilege and insn count of ApCPU into the header
+    void Publish(RiscV *ApCPU);
+
+    __property String         Name    = { read=FName };
+    __property char          *Ram     = { read=getRam };    // RiscV::Load() buffer
+    __property unsigned long  RamSize = { read=FcRam };
+    __property THeader       *Header  = { read=FpHeader };
+};
+//---------------------------------------------------------------------------
+#endif
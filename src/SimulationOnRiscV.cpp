@@ -3,13 +3,1008 @@
 #include <vcl.h>
 #pragma hdrstop
 #include <tchar.h>
+#include <stdio.h>
+#include <algorithm>
+#include "BenchmarkU.h"
+#include "CacheU.h"
+#include "ConformanceU.h"
+#include "CoverageU.h"
+#include "DisassemblerU.h"
+#include "ElfU.h"
+#include "FuzzU.h"
+#include "GdbServerU.h"
+#include "PipelineU.h"
+#include "ProfilerU.h"
+#include "SharedMemoryU.h"
+#include "StateHashU.h"
 //---------------------------------------------------------------------------
 USEFORM("frmMainU.cpp", frmMain);
 //---------------------------------------------------------------------------
+
+// Headless reports go to the console of the calling process (if any)
+static bool AttachParentConsole()
+{
+    return AttachConsole(ATTACH_PARENT_PROCESS) && freopen("CONOUT$", "w", stdout);
+}
+//---------------------------------------------------------------------------
+
+static const int HeadlessErrorCode = -1;
+
+// A headless mode (--<mode>) that throws reports on stderr: redirected, or
+// else the calling console (already attached by the mode or not), no dialog
+static int HeadlessError(const String &AMessage)
+{
+HANDLE hError = GetStdHandle(STD_ERROR_HANDLE);
+
+    if ((hError == NULL || hError == INVALID_HANDLE_VALUE)
+        && (GetConsoleWindow() || AttachConsole(ATTACH_PARENT_PROCESS)))
+            freopen("CONOUT$", "w", stderr);
+
+    fprintf(stderr, "\n%s\n", AnsiString(AMessage).c_str());
+    fflush(stderr);
+
+    return HeadlessErrorCode;
+}
+//---------------------------------------------------------------------------
+
+// Headless ISA conformance run:
+//     SimulationOnRiscV --isa-tests <directory> [<file mask>]
+// Report saved as isa-tests.txt in <directory> (and printed on the calling
+// console), exit code = number of failed tests
+static int RunIsaTests()
+{
+TRiscVConformance  Conformance;
+TStringList       *pReport = new TStringList();
+int                cFailed;
+
+    try
+    {
+        cFailed = Conformance.RunSuite(ParamStr(2), ParamCount() >= 3 ? ParamStr(3) : String("rv32u?-p-*"), pReport);
+        pReport->SaveToFile(IncludeTrailingPathDelimiter(ParamStr(2)) + "isa-tests.txt");
+
+        if (AttachParentConsole())
+            printf("\n%s", AnsiString(pReport->Text).c_str());
+    }
+    catch(...)
+    {
+        delete pReport;
+        throw;
+    }
+    delete pReport;
+
+    return cFailed;
+}
+//---------------------------------------------------------------------------
+
+// Headless decoder check:
+//     SimulationOnRiscV --decoder-check
+// Decode table vs reference decoder over every opcode/funct3/funct7
+// combination, then the same program on every core configuration (RV32I
+// traps on the M insns), printed on the calling console, exit code =
+// number of mismatching words + failed configurations
+static int RunDecoderCheck()
+{
+TStringList *pReport = new TStringList();
+int          cFailed;
+
+    try
+    {
+        cFailed = TRiscVConformance::CheckDecoder(pReport) + TRiscVConformance::CheckConfigurations(pReport);
+
+        if (AttachParentConsole())
+            printf("\n%s", AnsiString(pReport->Text).c_str());
+    }
+    catch(...)
+    {
+        delete pReport;
+        throw;
+    }
+    delete pReport;
+
+    return cFailed;
+}
+//---------------------------------------------------------------------------
+
+// Headless speed benchmark:
+//     SimulationOnRiscV --benchmark [<JSON output file>] [<instructions per run>]
+// JSON Lines saved to benchmark.json by default (and text table printed on
+// the calling console)
+static int RunBenchmark()
+{
+TRiscVBenchmark                        Benchmark;
+std::vector<TRiscVBenchmark::TResult>  Results;
+TStringList                           *pJson = new TStringList();
+bool                                   Console;
+
+    try
+    {
+        if (ParamCount() >= 3)
+            Benchmark.Instructions = StrToInt(ParamStr(3));
+
+        Console = AttachParentConsole();
+
+        Benchmark.RunAll(Results);
+
+        for (size_t c=0; c<Results.size(); c++) {
+            pJson->Add(TRiscVBenchmark::FormatJson(Results[c]));
+
+            if (Console)
+                printf("%s\n", AnsiString(TRiscVBenchmark::FormatText(Results[c])).c_str());
+        }
+
+        pJson->SaveToFile(ParamCount() >= 2 ? ParamStr(2) : String("benchmark.json"));
+    }
+    catch(...)
+    {
+        delete pJson;
+        throw;
+    }
+    delete pJson;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+static const unsigned long HeadlessStackSize = 1 << 20;
+
+// Headless framebuffer run:
+//     SimulationOnRiscV --frames <ELF file> <output directory> [<frames>]
+//                       [<instructions per frame>] [<width>x<height>x<bits per pixel>]
+// The framebuffer is the guest "framebuffer" symbol (320x240x16 by default,
+// 8 = gray, 16 = RGB565, 32 = XRGB8888). Frames with dirty tiles are saved
+// as frame-<n>.ppm in <output directory> and their dirty rectangles printed
+// on the calling console
+static int RunFrames()
+{
+TElfImage                                   Image;
+RiscV_RV32IM                                CPU;
+std::vector<char>                           Ram;
+std::vector<unsigned long>                  Frame;
+std::vector<TRiscVFramebuffer::TDirtyRect>  Rects;
+String                                      Directory = IncludeTrailingPathDelimiter(ParamStr(3));
+unsigned long                               Base;
+unsigned long                               Instructions = 1000000;
+int                                         cFrames = 60;
+int                                         Width = 320, Height = 240, Bits = 16;
+unsigned __int64                            cPixels;
+char                                        Name[32];
+bool                                        Console;
+
+    if (ParamCount() >= 4)
+        cFrames = StrToInt(ParamStr(4));
+
+    if (ParamCount() >= 5)
+        Instructions = StrToInt(ParamStr(5));
+
+    if (ParamCount() >= 6 && (sscanf(AnsiString(ParamStr(6)).c_str(), "%dx%dx%d", &Width, &Height, &Bits) != 3
+                              || (Bits != 8 && Bits != 16 && Bits != 32)))
+        throw Exception("Invalid framebuffer geometry: " + ParamStr(6));
+
+    Image.LoadFromFile(ParamStr(2));
+    if (!Image.FindSymbol("framebuffer", Base))
+        throw Exception("No framebuffer symbol: " + ParamStr(2));
+
+    Image.LoadCore(CPU, Ram, HeadlessStackSize);
+    CPU.Framebuffer->Configure(Base, Width, Height, Bits == 8  ? TRiscVFramebuffer::pixelGray8
+                                                  : Bits == 32 ? TRiscVFramebuffer::pixelXRGB8888
+                                                               : TRiscVFramebuffer::pixelRGB565);
+    Frame.assign((size_t)Width * Height, 0);
+
+    Console = AttachParentConsole();
+
+    for (int c=0; c<cFrames; c++) {
+        CPU.Run(Instructions);
+
+        if (!CPU.Framebuffer->Dirty)
+            continue;
+
+        CPU.Framebuffer->CopyDirty(&Frame[0], Width, Rects);
+
+        sprintf(Name, "frame-%05d.ppm", c);
+        CPU.Framebuffer->SavePPM(Directory + Name);
+
+        if (Console) {
+            cPixels = 0;
+            for (size_t r=0; r<Rects.size(); r++)
+                cPixels += (unsigned __int64)(Rects[r].Right - Rects[r].Left) * (Rects[r].Bottom - Rects[r].Top);
+
+            printf("%s  %4d rects %8.0f pixels\n", Name, (int)Rects.size(), (double)cPixels);
+        }
+    }
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+// Headless run with execution statistics:
+//     SimulationOnRiscV --stats <ELF file> <stats file> [<instructions>]
+//                       [<instructions per dump>]
+// The stats file is rewritten every dump: a *.json file gets one JSON
+// object per dump (JSON Lines, the run history), any other the text table
+// of the last dump. Stops early when the guest waits with no interrupt
+// pending; a fault saves the stats up to the faulting insn
+static int RunStats()
+{
+TElfImage          Image;
+RiscV_RV32IM       CPU;
+std::vector<char>  Ram;
+TStringList       *pStats = new TStringList();
+bool               Json = SameText(ExtractFileExt(ParamStr(3)), ".json");
+unsigned __int64   Instructions = 100000000;
+unsigned long      Interval = 10000000;
+unsigned __int64   c = 0;
+unsigned long      cRun;
+
+    try
+    {
+        if (ParamCount() >= 4)
+            Instructions = StrToInt64(ParamStr(4));
+
+        if (ParamCount() >= 5)
+            Interval = StrToInt(ParamStr(5));
+
+        Image.LoadFromFile(ParamStr(2));
+
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+        CPU.Statistics = true;
+
+        try
+        {
+            while (c < Instructions) {
+                cRun = (unsigned long)std::min<unsigned __int64>(Interval, Instructions - c);
+
+                if (CPU.Run(cRun) == RiscV::stopWait)
+                    c = Instructions;
+                else
+                    c += cRun;
+
+                if (!Json)
+                    pStats->Clear();
+
+                pStats->Add(Json ? CPU.Stats->FormatJson() : CPU.Stats->FormatText());
+                pStats->SaveToFile(ParamStr(3));
+            }
+        }
+        catch(...)
+        {
+            if (!Json)
+                pStats->Clear();
+
+            pStats->Add(Json ? CPU.Stats->FormatJson() : CPU.Stats->FormatText());
+            pStats->SaveToFile(ParamStr(3));
+            throw;
+        }
+
+        if (AttachParentConsole())
+            printf("\n%s\n", AnsiString(CPU.Stats->FormatText()).c_str());
+    }
+    catch(...)
+    {
+        delete pStats;
+        throw;
+    }
+    delete pStats;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+// Headless run through the cache timing model:
+//     SimulationOnRiscV --caches <ELF file> <report file> [<instructions>]
+//                       [<L1 I>] [<L1 D>] [<L2>] [<memory latency>]
+// Caches as "<size>[K|M]:<ways>:<line size>[:lru|fifo|random[:<latency>]]"
+// ("none" => no L2). Data regions: the loaded image and the stack above it
+static int RunCaches()
+{
+TElfImage          Image;
+RiscV_RV32IM       CPU;
+TRiscVCaches       Caches;
+std::vector<char>  Ram;
+TStringList       *pReport = new TStringList();
+unsigned long      Instructions = 100000000;
+
+    try
+    {
+        if (ParamCount() >= 4)
+            Instructions = StrToInt(ParamStr(4));
+
+        Caches.Configure(TRiscVCache::ParseConfig(ParamCount() >= 5 ? ParamStr(5) : String("16K:2:64:lru:0"),   0),
+                         TRiscVCache::ParseConfig(ParamCount() >= 6 ? ParamStr(6) : String("16K:4:64:lru:1"),   1),
+                         TRiscVCache::ParseConfig(ParamCount() >= 7 ? ParamStr(7) : String("256K:8:64:lru:10"), 10),
+                         ParamCount() >= 8 ? StrToInt(ParamStr(8)) : 100);
+
+        Image.LoadFromFile(ParamStr(2));
+
+        Caches.AddRegion("image", 0, Image.Size);
+        Caches.AddRegion("stack", Image.Size, HeadlessStackSize);
+
+        CPU.Caches = &Caches;
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+
+        CPU.Run(Instructions);
+
+        Caches.Report(pReport, CPU.InstructionCount, 20);
+        pReport->SaveToFile(ParamStr(3));
+
+        if (AttachParentConsole())
+            printf("\n%s", AnsiString(pReport->Text).c_str());
+    }
+    catch(...)
+    {
+        delete pReport;
+        throw;
+    }
+    delete pReport;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+// Headless run through the pipeline timing model:
+//     SimulationOnRiscV --pipeline <ELF file> <report file> [<instructions>]
+//                       [not-taken|btfn|bimodal]
+// Text report, or one JSON object for a *.json report file
+static int RunPipeline()
+{
+TElfImage                Image;
+RiscV_RV32IM             CPU;
+TRiscVPipeline           Pipeline;
+TRiscVPipeline::TConfig  Config = TRiscVPipeline::DefaultConfig();
+std::vector<char>        Ram;
+TStringList             *pReport = new TStringList();
+unsigned long            Instructions = 100000000;
+
+    try
+    {
+        if (ParamCount() >= 4)
+            Instructions = StrToInt(ParamStr(4));
+
+        if (ParamCount() >= 5 && !TRiscVPipeline::ParsePredictor(ParamStr(5), Config.BranchPredictor))
+            throw Exception("Invalid branch predictor: " + ParamStr(5));
+
+        Pipeline.Configure(Config);
+
+        Image.LoadFromFile(ParamStr(2));
+
+        CPU.Pipeline = &Pipeline;
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+
+        CPU.Run(Instructions);
+
+        if (SameText(ExtractFileExt(ParamStr(3)), ".json"))
+            pReport->Add(Pipeline.FormatJson());
+        else
+            Pipeline.Report(pReport);
+
+        pReport->SaveToFile(ParamStr(3));
+
+        if (AttachParentConsole())
+            printf("\n%s", AnsiString(pReport->Text).c_str());
+    }
+    catch(...)
+    {
+        delete pReport;
+        throw;
+    }
+    delete pReport;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+// Headless run through the call stack sampling profiler:
+//     SimulationOnRiscV --profile <ELF file> <folded file> [<instructions>]
+//                       [<sample interval>]
+// Folded stacks (flamegraph.pl, speedscope...) named from the ELF symbols
+static int RunProfile()
+{
+TElfImage          Image;
+RiscV_RV32IM       CPU;
+TRiscVProfiler     Profiler;
+TRiscVListing      Listing;
+std::vector<char>  Ram;
+TStringList       *pFolded = new TStringList();
+unsigned long      Instructions = 100000000;
+
+    try
+    {
+        if (ParamCount() >= 4)
+            Instructions = StrToInt(ParamStr(4));
+
+        if (ParamCount() >= 5)
+            Profiler.Interval = StrToInt(ParamStr(5));
+
+        Image.LoadFromFile(ParamStr(2));
+
+        Listing.SetText(Image.TextStart, Image.TextEnd);
+        Listing.AddSymbols(Image.Symbols);
+
+        CPU.Profiler = &Profiler;
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+
+        Listing.AddFunctions(CPU.Cfg);
+        Profiler.Listing = &Listing;
+
+        CPU.Run(Instructions);
+
+        Profiler.Folded(pFolded);
+        pFolded->SaveToFile(ParamStr(3));
+
+        if (AttachParentConsole())
+            printf("\n%.0f samples, %d stacks\n", (double)Profiler.Samples, pFolded->Count);
+    }
+    catch(...)
+    {
+        delete pFolded;
+        throw;
+    }
+    delete pFolded;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+// Headless run collecting code coverage:
+//     SimulationOnRiscV --coverage <ELF file> <coverage file> [<instructions>]
+// A *.info coverage file gets an lcov tracefile (merged by lcov -a), any
+// other name the text format: an existing file is merged, so runs add up
+static int RunCoverage()
+{
+TElfImage          Image;
+RiscV_RV32IM       CPU;
+TRiscVCoverage     Coverage;
+TRiscVListing      Listing;
+std::vector<char>  Ram;
+TStringList       *pCoverage = new TStringList();
+unsigned long      Instructions = 100000000;
+bool               Lcov = SameText(ExtractFileExt(ParamStr(3)), ".info");
+
+    try
+    {
+        if (ParamCount() >= 4)
+            Instructions = StrToInt(ParamStr(4));
+
+        Image.LoadFromFile(ParamStr(2));
+
+        CPU.Coverage = &Coverage;
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+
+        Listing.SetText(Image.TextStart, Image.TextEnd);
+        Listing.AddSymbols(Image.Symbols);
+        Listing.AddFunctions(CPU.Cfg);
+
+        if (!Lcov && FileExists(ParamStr(3))) {
+            pCoverage->LoadFromFile(ParamStr(3));
+            Coverage.Merge(pCoverage);
+            pCoverage->Clear();
+        }
+
+        CPU.Run(Instructions);
+
+        if (Lcov)
+            Coverage.Lcov(pCoverage, &Listing, ParamStr(2));
+        else
+            Coverage.Save(pCoverage, &Listing);
+        pCoverage->SaveToFile(ParamStr(3));
+
+        if (AttachParentConsole())
+            printf("\n%d/%d insns executed, %d/%d branch directions\n", Coverage.Executed, Coverage.Instructions,
+                   Coverage.BranchDirections, 2 * Coverage.Branches);
+    }
+    catch(...)
+    {
+        delete pCoverage;
+        throw;
+    }
+    delete pCoverage;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+// Headless snapshot fuzzing of a guest function
+//     void target(const unsigned char *data, unsigned long size):
+//     SimulationOnRiscV --fuzz <ELF file> <target> <buffer> <buffer size>
+//                       <corpus directory | input file> [<executions, default 100000>]
+//                       [<instructions per execution, default 1000000>]
+// Target and buffer are symbols or numbers. A corpus directory is fuzzed
+// (new inputs and crashes saved in it), exit code = crashes found; an input
+// file is run once, exit code 0 exit, 1 crash, 2 timeout
+static int RunFuzz()
+{
+TRiscVFuzzCampaign  Campaign;
+TStringList        *pReport = new TStringList();
+unsigned long       Executions = 100000;
+int                 Result;
+
+    try
+    {
+        if (ParamCount() >= 7)
+            Executions = StrToInt(ParamStr(7));
+
+        if (ParamCount() >= 8)
+            Campaign.Fuzzer->Budget = StrToInt(ParamStr(8));
+
+        Campaign.Setup(ParamStr(2), ParamStr(3), ParamStr(4), StrToInt(ParamStr(5)), HeadlessStackSize);
+
+        if (DirectoryExists(ParamStr(6)))
+            Result = Campaign.Fuzz(ParamStr(6), Executions, pReport);
+        else
+            Result = Campaign.Replay(ParamStr(6), pReport);
+
+        if (AttachParentConsole())
+            printf("\n%s", AnsiString(pReport->Text).c_str());
+    }
+    catch(...)
+    {
+        delete pReport;
+        throw;
+    }
+    delete pReport;
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+// Headless run hashing the machine state (see TRiscVStateHash):
+//     SimulationOnRiscV --state-hash <ELF file> <hash file> [<instructions>]
+//                       [<instructions per hash>]
+// A new hash file gets one "<insns> <hash>" line per interval. An existing
+// one is a reference run: the run stops at the first interval whose hash
+// differs from it (exit code 1), the two runs diverged inside that interval
+// (run both again with a smaller one to narrow it down)
+static int RunStateHash()
+{
+TElfImage          Image;
+RiscV_RV32IM       CPU;
+TRiscVStateHash    Hash(&CPU);
+std::vector<char>  Ram;
+TStringList       *pHashes = new TStringList();
+bool               Compare = FileExists(ParamStr(3));
+unsigned __int64   Instructions = 100000000;
+unsigned long      Interval = 1000000;
+unsigned __int64   c = 0;
+unsigned long      cRun;
+String             Line;
+int                Result = 0;
+
+    try
+    {
+        if (ParamCount() >= 4)
+            Instructions = StrToInt64(ParamStr(4));
+
+        if (ParamCount() >= 5)
+            Interval = StrToInt(ParamStr(5));
+
+        if (Compare)
+            pHashes->LoadFromFile(ParamStr(3));
+
+        Image.LoadFromFile(ParamStr(2));
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+
+        for (int i=0; c < Instructions; i++) {
+            cRun = (unsigned long)std::min<unsigned __int64>(Interval, Instructions - c);
+
+            if (CPU.Run(cRun) == RiscV::stopWait)
+                Instructions = c + cRun;
+            c += cRun;
+
+            Line = IntToStr((__int64)CPU.InstructionCount) + " " + IntToHex((__int64)Hash.StateHash(), 16);
+
+            if (!Compare)
+                pHashes->Add(Line);
+            else if (i >= pHashes->Count || pHashes->Strings[i] != Line) {
+                Result = 1;
+                break;
+            }
+        }
+
+        if (!Compare)
+            pHashes->SaveToFile(ParamStr(3));
+
+        if (AttachParentConsole()) {
+            if (Result)
+                printf("\nDiverged between insn %s and %s: %s\n", AnsiString(IntToStr((__int64)(c - cRun))).c_str(),
+                       AnsiString(IntToStr((__int64)c)).c_str(), AnsiString(Line).c_str());
+            else
+                printf("\n%s\n", AnsiString(Line).c_str());
+        }
+    }
+    catch(...)
+    {
+        delete pHashes;
+        throw;
+    }
+    delete pHashes;
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+// Headless disassembly of an ELF program:
+//     SimulationOnRiscV --disassemble <ELF file> <listing file>
+// objdump style listing of .text with the ELF symbols, the debugger loads
+// it back when pasted as source
+static int RunDisassemble()
+{
+TElfImage           Image;
+TRiscVListing       Listing;
+TRiscVDisassembler  Disassembler;
+TStringList        *pListing = new TStringList();
+
+    try
+    {
+        Image.LoadFromFile(ParamStr(2));
+
+        Listing.SetText(Image.TextStart, Image.TextEnd);
+        Listing.AddSymbols(Image.Symbols);
+
+        Disassembler.Listing = &Listing;
+        Disassembler.SetText(Image.Data, Image.TextStart, Image.TextEnd);
+        Disassembler.Save(pListing);
+        pListing->SaveToFile(ParamStr(3));
+    }
+    catch(...)
+    {
+        delete pListing;
+        throw;
+    }
+    delete pListing;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+// Headless run on shared guest RAM (see TRiscVSharedMemory):
+//     SimulationOnRiscV --shared-memory <ELF file> <name> [<instructions>]
+//                       [<instructions per publish>] [--force]
+// Other processes map <name> read-only and watch memory and registers while
+// it runs; registers are published once per interval. The object is removed
+// when the run ends. An existing <name> is an error, --force replaces it
+// (object left by a killed run)
+static int RunSharedMemory()
+{
+TElfImage           Image;
+RiscV_RV32IM        CPU;
+TRiscVSharedMemory *pShared = NULL;
+unsigned __int64    Instructions = 100000000;
+unsigned long       Interval = 1000000;
+unsigned __int64    c = 0;
+unsigned long       cRun;
+unsigned long       cRam;
+bool                Force   = ParamStr(ParamCount()) == "--force";
+int                 cParams = ParamCount() - (Force ? 1 : 0);
+
+    try
+    {
+        if (cParams >= 4)
+            Instructions = StrToInt64(ParamStr(4));
+
+        if (cParams >= 5)
+            Interval = StrToInt(ParamStr(5));
+
+        Image.LoadFromFile(ParamStr(2));
+
+        cRam    = Image.Size + HeadlessStackSize;
+        pShared = new TRiscVSharedMemory(ParamStr(3), cRam, Force);
+        Image.LoadCore(CPU, pShared->Ram, cRam);
+        pShared->AddRegion(TRiscVSharedMemory::regionText, Image.TextStart, Image.TextEnd - Image.TextStart);
+        pShared->Publish(&CPU);
+
+        while (c < Instructions) {
+            cRun = (unsigned long)std::min<unsigned __int64>(Interval, Instructions - c);
+
+            if (CPU.Run(cRun) == RiscV::stopWait)
+                Instructions = c + cRun;
+            c += cRun;
+
+            pShared->Publish(&CPU);
+        }
+
+        if (AttachParentConsole())
+            printf("\n%s insns, PC %08lX\n", AnsiString(IntToStr((__int64)CPU.InstructionCount)).c_str(), CPU.PC);
+    }
+    catch(...)
+    {
+        delete pShared;
+        throw;
+    }
+    delete pShared;
+
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+// GDB register/memory hex: target (little endian) byte order
+static std::string GdbHex(const void *ApData, int ASize)
+{
+std::string Result;
+char        Byte[3];
+
+    for (int c=0; c<ASize; c++) {
+        sprintf(Byte, "%02x", ((const unsigned char *)ApData)[c]);
+        Result += Byte;
+    }
+
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+static int GdbCheck(TStrings *AReport, const String &AName, const std::string &AReply, bool APassed)
+{
+    if (APassed)
+        AReport->Add("ok    " + AName);
+    else
+        AReport->Add("FAIL  " + AName + "  (reply \"" + String(AReply.c_str()) + "\")");
+
+    return APassed ? 0 : 1;
+}
+//---------------------------------------------------------------------------
+
+static const int GdbCheckSteps = 64;    // Reference trace searched for a breakpoint target
+
+// Headless check of the GDB stub: a scripted client on localhost drives a
+// server running the ELF program (qSupported, m, g, Z0, c, s, z0, D) and
+// the replies are compared with a reference core stepped directly:
+//     SimulationOnRiscV --gdb-check <ELF file>
+// Report printed on the calling console, exit code = number of failed checks
+static int RunGdbCheck()
+{
+TElfImage                   Image;
+RiscV_RV32IM                CPU;
+RiscV_RV32IM                Reference;
+std::vector<char>           Ram;
+std::vector<char>           ReferenceRam;
+std::vector<unsigned long>  Trace;      // Reference PC before every step
+TGdbServer                  Server(&CPU);
+TGdbServerThread           *pThread = NULL;
+TGdbClient                  Client;
+TStringList                *pReport = new TStringList();
+std::string                 Reply;
+std::string                 Expected;
+unsigned long               Value;
+int                         iTarget = 0;
+int                         cFailed = 0;
+char                        Packet[64];
+
+    try
+    {
+        Image.LoadFromFile(ParamStr(2));
+
+        // Reference trace: the breakpoint goes on a PC first reached after
+        // the entry, so the stop must come at its first visit
+        Image.LoadCore(Reference, ReferenceRam, HeadlessStackSize);
+
+        for (int c=0; c<=GdbCheckSteps; c++) {
+            Trace.push_back(Reference.PC);
+            Reference.Step();
+        }
+
+        for (int c=GdbCheckSteps-1; c>0 && !iTarget; c--)
+            iTarget = (int)(std::find(Trace.begin(), Trace.end(), Trace[c]) - Trace.begin());
+
+        if (!iTarget)
+            throw Exception("No breakpoint target in the first insns: " + ParamStr(2));
+
+        // Reference state at the breakpoint
+        Image.LoadCore(Reference, ReferenceRam, HeadlessStackSize);
+
+        for (int c=0; c<iTarget; c++)
+            Reference.Step();
+
+        for (int c=0; c<32; c++) {
+            Value     = Reference.Registers[c];
+            Expected += GdbHex(&Value, 4);
+        }
+        Expected += GdbHex(&Trace[iTarget], 4);
+
+        // Stub under test
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+
+        Server.Listen(0);
+        pThread = new TGdbServerThread(&Server);
+        Client.Connect(Server.Port);
+
+        Reply    = Client.Exchange("qSupported:swbreak+");
+        cFailed += GdbCheck(pReport, "qSupported", Reply, Reply.find("PacketSize=") != std::string::npos);
+
+        sprintf(Packet, "m%lx,4", Image.Entry);
+        Reply    = Client.Exchange(Packet);
+        cFailed += GdbCheck(pReport, "m entry insn", Reply, Reply == GdbHex(Image.Data + Image.Entry, 4));
+
+        Reply    = Client.Exchange("g");
+        cFailed += GdbCheck(pReport, "g at entry", Reply, Reply.size() == 33 * 8 && Reply.substr(32 * 8) == GdbHex(&Trace[0], 4));
+
+        sprintf(Packet, "Z0,%lx,4", Trace[iTarget]);
+        Reply    = Client.Exchange(Packet);
+        cFailed += GdbCheck(pReport, "Z0 " + IntToHex((int)Trace[iTarget], 8), Reply, Reply == "OK");
+
+        Reply    = Client.Exchange("c");
+        cFailed += GdbCheck(pReport, "c to breakpoint", Reply, Reply == "S05");
+
+        Reply    = Client.Exchange("g");
+        cFailed += GdbCheck(pReport, "g at breakpoint (insn " + IntToStr(iTarget) + ")", Reply, Reply == Expected);
+
+        Packet[0] = 'z';
+        Reply    = Client.Exchange(Packet);
+        cFailed += GdbCheck(pReport, "z0", Reply, Reply == "OK");
+
+        Reply    = Client.Exchange("s");
+        cFailed += GdbCheck(pReport, "s", Reply, Reply == "S05");
+
+        Reply    = Client.Exchange("p20");
+        cFailed += GdbCheck(pReport, "pc after s", Reply, Reply == GdbHex(&Trace[iTarget + 1], 4));
+
+        Reply    = Client.Exchange("D");
+        cFailed += GdbCheck(pReport, "D", Reply, Reply == "OK");
+
+        Client.Close();
+        Server.Close();     // Unblocks the server thread
+        pThread->Terminate();
+        pThread->WaitFor();
+
+        if (AttachParentConsole())
+            printf("\n%s%d failed\n", AnsiString(pReport->Text).c_str(), cFailed);
+    }
+    catch(...)
+    {
+        if (pThread) {
+            Server.Close();
+            pThread->Terminate();
+            pThread->WaitFor();
+            delete pThread;
+        }
+        delete pReport;
+        throw;
+    }
+    delete pThread;
+    delete pReport;
+
+    return cFailed;
+}
+//---------------------------------------------------------------------------
+
+// Edge inputs of the libcall check (every a0, a1 pair): 0, small values,
+// INT_MAX, INT_MIN, -1 and their neighbours
+static const unsigned long LibcallCheckValues[] = {
+    0x00000000, 0x00000001, 0x00000002, 0x00000007, 0x7FFFFFFF,
+    0x80000000, 0x80000001, 0xFFFFFFF9, 0xFFFFFFFE, 0xFFFFFFFF
+};
+static const int LibcallCheckSteps = 10000;     // Guest routine insns limit
+
+// Headless check of the native libcalls: every libgcc routine found in the
+// ELF program (code signature or symbol) runs on the edge inputs as guest
+// code and natively, a0/a1 and the return PC must match:
+//     SimulationOnRiscV --libcall-check <ELF file>
+// Report printed on the calling console, exit code = number of mismatches
+static int RunLibcallCheck()
+{
+TElfImage                Image;
+RiscV_RV32IM             CPU;
+std::vector<char>        Ram;
+TStringList             *pReport = new TStringList();
+TRiscVLibcalls::Routine  Routine;
+unsigned long            ReturnPC;
+unsigned long            Result[2][3];  // Guest, native: a0, a1, PC
+unsigned long            cRam;
+int                      cValues = sizeof(LibcallCheckValues) / sizeof(LibcallCheckValues[0]);
+int                      cFailed = 0;
+int                      cRoutineFailed;
+int                      cSteps;
+char                     Line[160];
+
+    try
+    {
+        Image.LoadFromFile(ParamStr(2));
+        Image.LoadCore(CPU, Ram, HeadlessStackSize);
+        cRam = (unsigned long)Ram.size();
+        CPU.Libcalls->AddSymbols(Image.Symbols);
+
+        // Routines return to the program entry (never executed)
+        ReturnPC = Image.Entry;
+
+        for (unsigned long Address=Image.TextStart; Address<Image.TextEnd; Address+=4) {
+            Routine = CPU.Libcalls->At(Address);
+            if (Routine == TRiscVLibcalls::libNone)
+                continue;
+
+            cRoutineFailed = 0;
+
+            for (int x=0; x<cValues; x++)
+                for (int y=0; y<cValues; y++) {
+                    for (int Native=0; Native<2; Native++) {
+                        CPU.Reset(Address, cRam);
+                        CPU.NativeLibcalls = Native != 0;
+                        CPU.WriteRegister(RiscV::ra, ReturnPC);
+                        CPU.WriteRegister(RiscV::a0, LibcallCheckValues[x]);
+                        CPU.WriteRegister(RiscV::a1, LibcallCheckValues[y]);
+
+                        for (cSteps=0; CPU.PC != ReturnPC && cSteps<LibcallCheckSteps; cSteps++)
+                            CPU.Step();
+
+                        Result[Native][0] = CPU.Registers[RiscV::a0];
+                        Result[Native][1] = CPU.Registers[RiscV::a1];
+                        Result[Native][2] = CPU.PC;
+                    }
+
+                    // The native run must be one call
+                    if (!memcmp(Result[0], Result[1], sizeof(Result[0])) && CPU.Libcalls->Hits[Routine] == 1)
+                        continue;
+
+                    sprintf(Line, "FAIL  %s(%08lX, %08lX): guest a0 %08lX a1 %08lX pc %08lX, native a0 %08lX a1 %08lX pc %08lX",
+                            TRiscVLibcalls::Name(Routine), LibcallCheckValues[x], LibcallCheckValues[y],
+                            Result[0][0], Result[0][1], Result[0][2], Result[1][0], Result[1][1], Result[1][2]);
+                    pReport->Add(Line);
+                    cRoutineFailed++;
+                }
+
+            sprintf(Line, "%s  %-10s %08lX  %d inputs", cRoutineFailed ? "FAIL" : "ok  ",
+                    TRiscVLibcalls::Name(Routine), Address, cValues * cValues);
+            pReport->Add(Line);
+            cFailed += cRoutineFailed;
+        }
+
+        pReport->Add(IntToStr(CPU.Libcalls->Routines) + " routines, " + IntToStr(cFailed) + " mismatches");
+
+        if (AttachParentConsole())
+            printf("\n%s", AnsiString(pReport->Text).c_str());
+    }
+    catch(...)
+    {
+        delete pReport;
+        throw;
+    }
+    delete pReport;
+
+    return cFailed;
+}
+//---------------------------------------------------------------------------
 int WINAPI _tWinMain(HINSTANCE, HINSTANCE, LPTSTR, int)
 {
+bool Headless = ParamCount() >= 1 && ParamStr(1).Pos("--") == 1;
+
     try
     {
+         if (ParamCount() >= 2 && ParamStr(1) == "--isa-tests")
+             return RunIsaTests();
+
+         if (ParamCount() >= 1 && ParamStr(1) == "--decoder-check")
+             return RunDecoderCheck();
+
+         if (ParamCount() >= 1 && ParamStr(1) == "--benchmark")
+             return RunBenchmark();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--frames")
+             return RunFrames();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--stats")
+             return RunStats();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--caches")
+             return RunCaches();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--pipeline")
+             return RunPipeline();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--profile")
+             return RunProfile();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--coverage")
+             return RunCoverage();
+
+         if (ParamCount() >= 6 && ParamStr(1) == "--fuzz")
+             return RunFuzz();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--state-hash")
+             return RunStateHash();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--disassemble")
+             return RunDisassemble();
+
+         if (ParamCount() >= 3 && ParamStr(1) == "--shared-memory")
+             return RunSharedMemory();
+
+         if (ParamCount() >= 2 && ParamStr(1) == "--gdb-check")
+             return RunGdbCheck();
+
+         if (ParamCount() >= 2 && ParamStr(1) == "--libcall-check")
+             return RunLibcallCheck();
+
          Application->Initialize();
          Application->MainFormOnTaskBar = true;
          Application->CreateForm(__classid(TfrmMain), &frmMain);
@@ -17,10 +1012,16 @@ int WINAPI _tWinMain(HINSTANCE, HINSTANCE, LPTSTR, int)
     }
     catch (Exception &exception)
     {
+         if (Headless)
+             return HeadlessError(exception.Message);
+
          Application->ShowException(&exception);
     }
     catch (...)
     {
+         if (Headless)
+             return HeadlessError("Unknown exception");
+
          try
          {
              throw Exception("");
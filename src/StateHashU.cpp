@@ -0,0 +1,264 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include "StateHashU.h"
+#include "GuardedMemoryU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+// xxHash64 primes
+static const unsigned __int64 Prime1 = 0x9E3779B185EBCA87ULL;
+static const unsigned __int64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const unsigned __int64 Prime3 = 0x165667B19E3779F9ULL;
+static const unsigned __int64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+
+// Seeds: a leaf, a node, the root and the CPU state never hash alike
+enum {
+    seedLeaf = 1,
+    seedNode,
+    seedRoot,
+    seedState
+};
+
+static const unsigned long PageMask = (1UL << (32 - RiscV::PageBits)) - 1;   // Page numbers wrap at 4 GiB
+//---------------------------------------------------------------------------
+
+static inline unsigned __int64 Rotl(unsigned __int64 AValue, int ABits)
+{
+    return (AValue << ABits) | (AValue >> (64 - ABits));
+}
+//---------------------------------------------------------------------------
+
+TRiscVStateHash::TRiscVStateHash(RiscV *ApCPU)
+{
+std::vector<unsigned __int64> Words(RiscV::PageSize / sizeof(unsigned __int64), 0);
+
+    FpCPU      = ApCPU;
+    FcRehashed = 0;
+    FTables.assign(TableCount, NULL);
+
+    FZeroLeaf = Digest(&Words[0], Words.size(), seedLeaf);
+    Words.assign(TableSize, FZeroLeaf);
+    FEmptyNode = Digest(&Words[0], Words.size(), seedNode);
+
+    FpCPU->FpStateHash = this;
+    Clear();
+}
+//---------------------------------------------------------------------------
+
+TRiscVStateHash::~TRiscVStateHash()
+{
+    for (size_t t=0; t<FTables.size(); t++)
+        delete FTables[t];
+
+    if (FpCPU->FpStateHash == this)
+        FpCPU->FpStateHash = NULL;
+}
+//---------------------------------------------------------------------------
+
+// Single lane xxHash64 round over ACount 64-bit words
+unsigned __int64 TRiscVStateHash::Digest(const void *ApWords, size_t ACount, unsigned __int64 ASeed)
+{
+unsigned __int64 Hash = ASeed * Prime1 + Prime4 + ACount;
+unsigned __int64 Word;
+
+    for (size_t w=0; w<ACount; w++) {
+        memcpy(&Word, (const char *)ApWords + w * sizeof(Word), sizeof(Word));
+        Hash ^= Rotl(Word * Prime2, 31) * Prime1;
+        Hash  = Rotl(Hash, 27) * Prime1 + Prime4;
+    }
+
+    Hash ^= Hash >> 33;
+    Hash *= Prime2;
+    Hash ^= Hash >> 29;
+    Hash *= Prime3;
+    Hash ^= Hash >> 32;
+
+    return Hash;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVStateHash::Clear()
+{
+unsigned long              cPages = (unsigned long)(((unsigned __int64)FpCPU->FcMemory + RiscV::PageSize - 1) >> RiscV::PageBits);
+std::vector<unsigned long> Sparse;
+
+    for (size_t t=0; t<FTables.size(); t++) {
+        delete FTables[t];
+        FTables[t] = NULL;
+    }
+
+    FNodes.assign(TableCount, FEmptyNode);
+    FRoot = Digest(&FNodes[0], FNodes.size(), seedRoot);
+    FDirtyPages.clear();
+
+    for (unsigned long p=0; p<cPages; p++)
+        MarkDirty(p);
+
+    FpCPU->FSparse.GetPages(Sparse);
+    for (size_t p=0; p<Sparse.size(); p++)
+        MarkDirty(Sparse[p]);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVStateHash::MarkDirty(unsigned long APage)
+{
+TTable        *pTable = FTables[APage >> TableBits];
+unsigned long  Index  = APage & (TableSize - 1);
+
+    if (!pTable) {
+        pTable = new TTable;
+        pTable->Leaves.assign(TableSize, FZeroLeaf);
+        pTable->Dirty.assign(TableSize, 0);
+        pTable->Stale = false;
+        FTables[APage >> TableBits] = pTable;
+    }
+
+    if (!pTable->Dirty[Index]) {
+        pTable->Dirty[Index] = 1;
+        FDirtyPages.push_back(APage);
+    }
+}
+//---------------------------------------------------------------------------
+
+void TRiscVStateHash::MarkRange(unsigned long AAddress, unsigned long ASize)
+{
+unsigned long Page = AAddress >> RiscV::PageBits;
+unsigned long Last = ((AAddress + ASize - 1) >> RiscV::PageBits) & PageMask;
+
+    for (;;) {
+        MarkDirty(Page);
+
+        if (Page == Last)
+            break;
+        Page = (Page + 1) & PageMask;
+    }
+}
+//---------------------------------------------------------------------------
+
+// Guest view of the page: host buffer, sparse pages, guarded regions
+unsigned __int64 TRiscVStateHash::PageHash(unsigned long APage)
+{
+unsigned long     Address = APage << RiscV::PageBits;
+unsigned __int64  Words[RiscV::PageSize / sizeof(unsigned __int64)];
+
+    if (FpCPU->FpGuard)
+        return FpCPU->FpGuard->IsMapped(Address, RiscV::PageSize) ?
+               Digest(FpCPU->FpMemory + Address, RiscV::PageSize / sizeof(unsigned __int64), seedLeaf) : FZeroLeaf;
+
+    if (Address < FpCPU->FcMemory && FpCPU->FcMemory - Address >= RiscV::PageSize)
+        return Digest(FpCPU->FpMemory + Address, RiscV::PageSize / sizeof(unsigned __int64), seedLeaf);
+
+    FpCPU->RawRead(Address, Words, RiscV::PageSize);
+    return Digest(Words, RiscV::PageSize / sizeof(unsigned __int64), seedLeaf);
+}
+//---------------------------------------------------------------------------
+
+// Dirty pages rehashed, then their tables, then the root
+void TRiscVStateHash::Update()
+{
+TTable *pTable;
+
+    FcRehashed = (unsigned long)FDirtyPages.size();
+
+    if (FDirtyPages.empty())
+        return;
+
+    for (size_t p=0; p<FDirtyPages.size(); p++) {
+        pTable = FTables[FDirtyPages[p] >> TableBits];
+        pTable->Leaves[FDirtyPages[p] & (TableSize - 1)] = PageHash(FDirtyPages[p]);
+        pTable->Dirty [FDirtyPages[p] & (TableSize - 1)] = 0;
+        pTable->Stale = true;
+    }
+
+    for (size_t p=0; p<FDirtyPages.size(); p++) {
+        pTable = FTables[FDirtyPages[p] >> TableBits];
+
+        if (pTable->Stale) {
+            FNodes[FDirtyPages[p] >> TableBits] = Digest(&pTable->Leaves[0], TableSize, seedNode);
+            pTable->Stale = false;
+        }
+    }
+
+    FDirtyPages.clear();
+    FRoot = Digest(&FNodes[0], FNodes.size(), seedRoot);
+}
+//---------------------------------------------------------------------------
+
+unsigned __int64 TRiscVStateHash::MemoryHash()
+{
+    Update();
+    return FRoot;
+}
+//---------------------------------------------------------------------------
+
+unsigned __int64 TRiscVStateHash::StateHash()
+{
+const RiscV::TMachineState &Machine = FpCPU->FMachine;
+unsigned __int64            Words[32 + 13];
+int                         cWords = 0;
+
+    Words[cWords++] = MemoryHash();
+    for (int r=1; r<32; r++)
+        Words[cWords++] = FpCPU->FReg[r];
+
+    Words[cWords++] = FpCPU->FPC;
+    Words[cWords++] = Machine.Priv;
+    Words[cWords++] = Machine.Mstatus;
+    Words[cWords++] = Machine.Mie;
+    Words[cWords++] = Machine.Mtvec;
+    Words[cWords++] = Machine.Mscratch;
+    Words[cWords++] = Machine.Mepc;
+    Words[cWords++] = Machine.Mcause;
+    Words[cWords++] = Machine.Mtval;
+    Words[cWords++] = Machine.Msip;
+    Words[cWords++] = Machine.Mtimecmp;
+    Words[cWords++] = Machine.TimeOffset;
+    Words[cWords++] = Machine.Wfi;
+
+    return Digest(Words, cWords, seedState);
+}
+//---------------------------------------------------------------------------
+
+void TRiscVStateHash::Diff(TRiscVStateHash &AOther, std::vector<unsigned long> &APages)
+{
+unsigned __int64 Mine, Theirs;
+
+    APages.clear();
+
+    if (MemoryHash() == AOther.MemoryHash())
+        return;
+
+    for (unsigned long t=0; t<TableCount; t++) {
+        if (FNodes[t] == AOther.FNodes[t])
+            continue;
+
+        for (unsigned long i=0; i<TableSize; i++) {
+            Mine   = FTables[t]        ? FTables[t]->Leaves[i]        : FZeroLeaf;
+            Theirs = AOther.FTables[t] ? AOther.FTables[t]->Leaves[i] : AOther.FZeroLeaf;
+
+            if (Mine != Theirs)
+                APages.push_back((t << TableBits) | i);
+        }
+    }
+}
+//---------------------------------------------------------------------------
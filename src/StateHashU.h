@@ -0,0 +1,109 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef StateHashUH
+#define StateHashUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+#include <vector>
+//---------------------------------------------------------------------------
+#include "EmulatorU.h"
+//---------------------------------------------------------------------------
+
+/*
+Incremental machine state hash
+
+A Merkle tree over the 32-bit guest address space laid out like the sparse
+memory page table: one leaf hash per page, one node per TableSize pages,
+the root over the TableCount nodes. Guest stores (core hook, one byte per
+page) and host writes mark pages dirty; a query rehashes the dirty pages
+only, then the nodes above them, so its cost follows the pages written
+since the previous query, not the memory size. Pages never written hash as
+zero pages, tables without any as empty tables.
+StateHash() combines the memory root with registers, PC and trap state, so
+two runs can be compared (and bisected) by hashes taken at the same insn
+counts; Diff() walks two trees down to the pages that differ.
+Covered memory: the host buffer given to Load(), sparse pages and every
+page written since the hash was attached (guarded regions beyond the buffer
+are seen once written).
+Not thread safe: query from the emulation thread or with the CPU stopped.
+*/
+class TRiscVStateHash
+{
+public:
+    enum {
+        TableBits  = TRiscVMemory::TableBits,
+        TableSize  = TRiscVMemory::TableSize,
+        TableCount = TRiscVMemory::TableCount
+    };
+
+private:
+    typedef struct {
+        std::vector<unsigned __int64> Leaves;   // Page hashes
+        std::vector<unsigned char>    Dirty;    // Per page: written since the last query
+        bool                          Stale;    // Leaves changed, Hash not updated
+    } TTable;
+
+    RiscV                         *FpCPU;
+    std::vector<TTable *>          FTables;     // [TableCount], NULL => zero pages only
+    std::vector<unsigned __int64>  FNodes;      // [TableCount] table hashes
+    std::vector<unsigned long>     FDirtyPages;
+    unsigned __int64               FRoot;
+    unsigned __int64               FZeroLeaf;   // Hash of a zero page
+    unsigned __int64               FEmptyNode;  // Hash of a table of zero pages
+    unsigned long                  FcRehashed;  // Pages hashed by the last update
+
+    void             MarkDirty(unsigned long APage);
+    void             MarkRange(unsigned long AAddress, unsigned long ASize);
+    void             Update();
+    unsigned __int64 PageHash(unsigned long APage);
+
+    static unsigned __int64 Digest(const void *ApWords, size_t ACount, unsigned __int64 ASeed);
+
+public:
+    TRiscVStateHash(RiscV *ApCPU);  // Attached to the CPU until destroyed
+    ~TRiscVStateHash();
+
+    void Clear();                   // Whole memory dirty (done by Load and on attach)
+
+    unsigned __int64 StateHash();   // Memory + registers, PC, trap state
+    unsigned __int64 MemoryHash();  // Merkle root
+
+    // Pages (numbers, ascending) whose content differs between the two
+    // states, compared top-down: unchanged tables are skipped whole
+    void Diff(TRiscVStateHash &AOther, std::vector<unsigned long> &APages);
+
+    // Hooks called by the core (and by host writes bypassing it)
+    void BeforeWrite(unsigned long AAddress, unsigned long ASize)
+    {
+        unsigned long Page   = AAddress >> RiscV::PageBits;
+        TTable       *pTable = FTables[Page >> TableBits];
+
+        if (!pTable || !pTable->Dirty[Page & (TableSize - 1)])
+            MarkDirty(Page);
+
+        if ((AAddress & (RiscV::PageSize - 1)) + ASize > RiscV::PageSize)
+            MarkRange(AAddress, ASize);
+    }
+
+    __property unsigned long PagesRehashed = { read=FcRehashed };
+};
+//---------------------------------------------------------------------------
+#endif
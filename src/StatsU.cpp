@@ -0,0 +1,126 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#pragma hdrstop
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "StatsU.h"
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+//---------------------------------------------------------------------------
+
+static const char *ClassNames[TRiscVStats::classCount] = { "alu", "load", "store", "branch", "jump", "system" };
+//---------------------------------------------------------------------------
+
+void TRiscVStats::Clear()
+{
+    memset(Instructions, 0, sizeof(Instructions));
+    memset(Loads,        0, sizeof(Loads));
+    memset(Stores,       0, sizeof(Stores));
+
+    BranchesTaken = 0;
+    IdleSkipped   = 0;
+    Mmio          = 0;
+    Traps         = 0;
+    Interrupts    = 0;
+    RunCalls      = 0;
+    RunSeconds    = 0;
+    MaxRunSeconds = 0;
+}
+//---------------------------------------------------------------------------
+
+void TRiscVStats::RunEnded(double ASeconds)
+{
+    RunCalls++;
+    RunSeconds   += ASeconds;
+    MaxRunSeconds = std::max(MaxRunSeconds, ASeconds);
+}
+//---------------------------------------------------------------------------
+
+unsigned __int64 TRiscVStats::Retired() const
+{
+unsigned __int64 cRetired = 0;
+
+    for (int c=0; c<classCount; c++)
+        cRetired += Instructions[c];
+
+    return cRetired;
+}
+//---------------------------------------------------------------------------
+
+String TRiscVStats::FormatText() const
+{
+unsigned __int64 cRetired = Retired();
+char             Buffer[1024];
+int              Length;
+
+    Length = sprintf(Buffer, "Instructions retired  %14.0f\n", (double)cRetired);
+
+    for (int c=0; c<classCount; c++)
+        Length += sprintf(Buffer + Length, "  %-8s            %14.0f %6.2f%%\n", ClassNames[c],
+            (double)Instructions[c], cRetired ? Instructions[c] * 100.0 / cRetired : 0.0);
+
+    sprintf(Buffer + Length,
+        "Branches taken        %14.0f %6.2f%%\n"
+        "Loads  8/16/32 bit    %14.0f %14.0f %14.0f\n"
+        "Stores 8/16/32 bit    %14.0f %14.0f %14.0f\n"
+        "Idle insns skipped    %14.0f\n"
+        "MMIO accesses         %14.0f\n"
+        "Traps (interrupts)    %14.0f (%.0f)\n"
+        "Run() calls           %14.0f %10.3f s total %10.3f ms max",
+        (double)BranchesTaken, Instructions[classBranch] ? BranchesTaken * 100.0 / Instructions[classBranch] : 0.0,
+        (double)Loads[0],  (double)Loads[1],  (double)Loads[2],
+        (double)Stores[0], (double)Stores[1], (double)Stores[2],
+        (double)IdleSkipped,
+        (double)Mmio,
+        (double)Traps, (double)Interrupts,
+        (double)RunCalls, RunSeconds, MaxRunSeconds * 1e3);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
+
+String TRiscVStats::FormatJson() const
+{
+char Buffer[1024];
+int  Length;
+
+    Length = sprintf(Buffer, "{\"retired\":%.0f", (double)Retired());
+
+    for (int c=0; c<classCount; c++)
+        Length += sprintf(Buffer + Length, ",\"%s\":%.0f", ClassNames[c], (double)Instructions[c]);
+
+    sprintf(Buffer + Length,
+        ",\"branches_taken\":%.0f,\"loads\":[%.0f,%.0f,%.0f],\"stores\":[%.0f,%.0f,%.0f],"
+        "\"idle_skipped\":%.0f,\"mmio\":%.0f,\"traps\":%.0f,\"interrupts\":%.0f,"
+        "\"run_calls\":%.0f,\"run_seconds\":%.6f,\"max_run_seconds\":%.6f}",
+        (double)BranchesTaken,
+        (double)Loads[0],  (double)Loads[1],  (double)Loads[2],
+        (double)Stores[0], (double)Stores[1], (double)Stores[2],
+        (double)IdleSkipped,
+        (double)Mmio,
+        (double)Traps, (double)Interrupts,
+        (double)RunCalls, RunSeconds, MaxRunSeconds);
+
+    return Buffer;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,112 @@
+/*
+    RISC-V RV32I Emulator
+    Copyright (C) 2024  Daniele Giovanardi   daniele.giovanardi@madenetwork.it
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+//---------------------------------------------------------------------------
+#ifndef StatsUH
+#define StatsUH
+//---------------------------------------------------------------------------
+#include <classes.hpp>
+//---------------------------------------------------------------------------
+
+/*
+Execution statistics
+
+Instructions retired by class, conditional branches taken, loads/stores by
+width and idle loop insns skipped are counted by RiscV::RunLoop() through a
+policy (template parameter): TRiscVStatsOff has empty inline members, so
+with RiscV::Statistics off the run loop is the same code it was without
+statistics.
+
+The other counters are gated at run time (if (FStatistics)) on purpose, not
+through the policy: RiscV::ClintPtr() (Mmio), RiscV::EnterTrap() (Traps,
+Interrupts), RiscV::Run() (RunCalls, RunSeconds) and the single step path
+RiscV::Step() (instruction classes) run once per CLINT access, trap, Run()
+call or debugger step, outside the per-instruction loop, where one
+predictable test costs nothing measurable and a template parameter would
+have to be threaded through the trap and MMIO code.
+
+Instruction classes by major opcode (M extension = ALU, fence = system).
+*/
+class TRiscVStats
+{
+public:
+    enum InsnClass {
+        classAlu,
+        classLoad,
+        classStore,
+        classBranch,
+        classJump,
+        classSystem,
+        classCount
+    };
+
+    unsigned __int64 Instructions[classCount];
+    unsigned __int64 BranchesTaken;
+    unsigned __int64 Loads[4];          // By funct3 & 3: 1, 2, 4 bytes ([3] not an RV32 width)
+    unsigned __int64 Stores[4];
+    unsigned __int64 IdleSkipped;
+    unsigned __int64 Mmio;
+    unsigned __int64 Traps;             // Interrupts included
+    unsigned __int64 Interrupts;
+    unsigned __int64 RunCalls;
+    double           RunSeconds;        // Wall time, all calls
+    double           MaxRunSeconds;
+
+    TRiscVStats() { Clear(); }
+
+    void Clear();
+
+    // AInsn executed, ATaken => the PC did not fall through
+    void Retire(unsigned long AInsn, bool ATaken)
+    {
+        switch (AInsn & 0x7F) {
+            case 0x03:  Instructions[classLoad]++;   Loads[(AInsn >> 12) & 3]++;  break;
+            case 0x23:  Instructions[classStore]++;  Stores[(AInsn >> 12) & 3]++; break;
+            case 0x63:  Instructions[classBranch]++; BranchesTaken += ATaken;     break;
+            case 0x67:
+            case 0x6F:  Instructions[classJump]++;   break;
+            case 0x0F:
+            case 0x73:  Instructions[classSystem]++; break;
+            default:    Instructions[classAlu]++;    break;
+        }
+    }
+
+    void RunEnded(double ASeconds);
+
+    unsigned __int64 Retired() const;   // All classes
+
+    String FormatText() const;
+    String FormatJson() const;  // One JSON object per line
+};
+//---------------------------------------------------------------------------
+
+// RiscV::RunLoop() policies
+struct TRiscVStatsOn
+{
+    static void Retire(TRiscVStats &AStats, unsigned long AInsn, bool ATaken) { AStats.Retire(AInsn, ATaken); }
+    static void Skip  (TRiscVStats &AStats, unsigned long ACount)             { AStats.IdleSkipped += ACount; }
+};
+
+struct TRiscVStatsOff
+{
+    static void Retire(TRiscVStats &, unsigned long, bool) {}
+    static void Skip  (TRiscVStats &, unsigned long)       {}
+};
+//---------------------------------------------------------------------------
+#endif
@@ -82,32 +82,16 @@ TfrmMain *frmMain;
 //---------------------------------------------------------------------------
 
 __fastcall TfrmMain::TfrmMain(TComponent* Owner)
-    : TForm(Owner)
-{
-char *RegNames[] =
-{
-        "zero",
-        "ra",
-        "sp",
-        "gp",
-        "tp",
-        "t0", "t1", "t2",
-        "s0",
-        "s1",
-        "a0", "a1",
-        "a2", "a3", "a4", "a5", "a6", "a7",
-        "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11",
-        "t3", "t4", "t5", "t6"
-};
-
+    : TForm(Owner), FPacer(&FRiscV_CPU)
+{
     // Registers StringGrid setup
     RegDump->RowCount     = 32;
     RegDump->ColCount     = 2;
     RegDump->ColWidths[0] = 32;
     RegDump->ColWidths[1] = 112;
 
-    for (unsigned long c=0; c<sizeof(RegNames)/sizeof(RegNames[0]); c++)
-        RegDump->Cells[0][c] = RegNames[c];
+    for (int c=0; c<=RiscV::t6; c++)
+        RegDump->Cells[0][c] = TRiscVDisassembler::RegName(c);
 
     // Debugger instructions StringGrid setup
     DebInsn->ColCount = 4;
@@ -123,8 +107,17 @@ char *RegNames[] =
     // Init vars
     FpDebuggerMem = NULL;
     FpRiscVMem = NULL;
+    FpShared   = NULL;
     FcRiscVMem = 0;
     FState     = stateStopped;
+    FRunAt     = (unsigned long)-1;
+    FVideoWatch = 0;
+    FMemWatch  = 0;
+    FResume    = false;
+    FPaced     = false;
+    FpGdbServer = NULL;
+    FpGdbThread = NULL;
+    FDisassembler.Listing = &FListing;
 
     // Load default program
     btnLoadAsm->Click();
@@ -181,6 +174,7 @@ wchar_t *pHex;
 void TfrmMain::RefreshDebug()
 {
 TGridRect DebuggerRow;
+int       Row;
 
     DebuggerRow.Left  = 0;
     DebuggerRow.Right = DebInsn->ColCount-1;
@@ -192,20 +186,24 @@ TGridRect DebuggerRow;
     // PC
     editCurPC->Text = ConvertToString(FRiscV_CPU.PC);
 
+    // Shared memory readers see the registers shown
+    if (FpShared)
+        FpShared->Publish(&FRiscV_CPU);
+
     // Program line
-    for (int c=0; c<=DebInsn->RowCount; c++)
-        if (DebInsn->Objects[0][c] == (TObject *)FRiscV_CPU.PC)
-        {
-            DebuggerRow.Top    =
-            DebuggerRow.Bottom = c;
-            DebInsn->Selection = DebuggerRow;
-
-            // Scroll grid if selected row is not visible
-            if (c < DebInsn->TopRow
-                || c > DebInsn->TopRow + DebInsn->VisibleRowCount)
-                    DebInsn->TopRow = c;
-            break;
-        }
+    Row = FListing.Row(FRiscV_CPU.PC);
+    if (Row >= 0)
+    {
+        DebuggerRow.Top    =
+        DebuggerRow.Bottom = Row;
+        DebInsn->Selection = DebuggerRow;
+
+        // Scroll grid if selected row is not visible
+        if (Row < DebInsn->TopRow
+            || Row > DebInsn->TopRow + DebInsn->VisibleRowCount)
+                DebInsn->TopRow = Row;
+    }
+    RefreshListing();
 
     // Memory
     for (int c=0; c<(FcRiscVMem/16); c++)
@@ -223,6 +221,28 @@ TGridRect DebuggerRow;
 }
 //---------------------------------------------------------------------------
 
+// Insn text of the visible DebInsn rows: the disassembler renders a row
+// once (again if its word changed), scrolling costs only the rows shown
+void TfrmMain::RefreshListing()
+{
+const TRiscVDisassembler::TEntry *pInsn;
+unsigned long                     Address;
+
+    for (int Row=DebInsn->TopRow; Row<DebInsn->RowCount && Row<=DebInsn->TopRow + DebInsn->VisibleRowCount; Row++) {
+        Address = (unsigned long)(NativeInt)DebInsn->Objects[0][Row];
+        if (FListing.Row(Address) != Row)   // Label/comment row
+            continue;
+
+        pInsn = &FDisassembler.Insn(Address);
+        if (DebInsn->Cells[2][Row] != pInsn->Mnemonic || DebInsn->Cells[3][Row] != pInsn->Operands) {
+            DebInsn->Cells[1][Row] = IntToHex((int)pInsn->Word, 8).LowerCase();
+            DebInsn->Cells[2][Row] = pInsn->Mnemonic;
+            DebInsn->Cells[3][Row] = pInsn->Operands;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
 void TfrmMain::RedrawMemory()
 {
 TGridRect SelectedRow;
@@ -276,7 +296,9 @@ void TfrmMain::UpdateVideo(TVideoPort *ANewValues)
     Ball->Left = ANewValues->BallLeft;
     Ball->Top  = ANewValues->BallTop;
 
-    ANewValues->ToBeUpdated = 0; // Flag reset
+    // Flag reset (through the CPU, so it is replayed by reverse execution)
+    short NoUpdate = 0;
+    FRiscV_CPU.DeviceWrite(portsVideo + offsetof(TVideoPort, ToBeUpdated), &NoUpdate, sizeof(NoUpdate));
 
     memoOutput->Lines->Add(Now().FormatString("hh:nn:ss,zzz") + " - Graph. update - "
         "Ball left: " + Ball->Left + ", "
@@ -287,6 +309,52 @@ void TfrmMain::UpdateVideo(TVideoPort *ANewValues)
 }
 //---------------------------------------------------------------------------
 
+// Show ball position currently stored in video port (e.g. after reverse execution)
+void TfrmMain::RestoreVideo()
+{
+TVideoPort *pVideoPort = (TVideoPort *)(RiscVMem+portsVideo);
+
+    Ball->Left = pVideoPort->BallLeft;
+    Ball->Top  = pVideoPort->BallTop;
+}
+//---------------------------------------------------------------------------
+
+void TfrmMain::EnableButtons(bool AEnabled)
+{
+    btnRun     ->Enabled =  AEnabled;
+    btnStop    ->Enabled = !AEnabled;
+    btnRunAt   ->Enabled =  AEnabled;
+    btnGoTo    ->Enabled =  AEnabled;
+    btnStep    ->Enabled =  AEnabled;
+    btnStepBack->Enabled =  AEnabled && chkHistory->Checked;
+    btnRunBack ->Enabled =  AEnabled && chkHistory->Checked;
+    btnReset   ->Enabled =  AEnabled;
+    btnLoadAsm ->Enabled =  AEnabled;
+    btnGdb     ->Enabled =  AEnabled;
+    btnStepOver->Enabled =  AEnabled;
+}
+//---------------------------------------------------------------------------
+
+// "Run at" address becomes a temporary breakpoint (unless already set by user)
+void TfrmMain::AddRunAtBreakpoint(unsigned long AAddress)
+{
+    if (FRiscV_CPU.Breakpoints->IsBreakpoint(AAddress))
+        return;
+
+    FRiscV_CPU.Breakpoints->AddBreakpoint(AAddress);
+    FRunAt = AAddress;
+}
+//---------------------------------------------------------------------------
+
+void TfrmMain::RemoveRunAtBreakpoint()
+{
+    if (FRunAt != (unsigned long)-1) {
+        FRiscV_CPU.Breakpoints->RemoveBreakpoint(FRunAt);
+        FRunAt = (unsigned long)-1;
+    }
+}
+//---------------------------------------------------------------------------
+
 
 
 //---------------------------------------------------------------------------
@@ -317,11 +385,17 @@ unsigned long   TextSegmentStart = 0,  // Boundary of .text segment
                 TextSegmentEnd   = 0;
 
 
-    // (Re)Allocate memory for new program
-    if (FpRiscVMem)
-        delete [] FpRiscVMem;
-    FcRiscVMem = 0;
-    FpRiscVMem = new char[ConvertToInt(editMemSize->Text)];
+    // (Re)Allocate memory for new program (shared: named object other
+    // processes map read-only, see TRiscVSharedMemory). The old program goes
+    // first (the shared object name is reused), a failed allocation leaves
+    // none loaded
+    UnloadProgram();
+    if (chkSharedMemory->Checked) {
+        FpShared   = new TRiscVSharedMemory("SimulationOnRiscV", ConvertToInt(editMemSize->Text));
+        FpRiscVMem = FpShared->Ram;
+    }
+    else
+        FpRiscVMem = new char[ConvertToInt(editMemSize->Text)];
     FcRiscVMem = ConvertToInt(editMemSize->Text);
     memset(FpRiscVMem, 0, FcRiscVMem);
 
@@ -336,6 +410,7 @@ unsigned long   TextSegmentStart = 0,  // Boundary of .text segment
     editTextEnd  ->Clear();
 
     // Assembler output parsing
+    FListing.Clear();
     DebInsn->RowCount = 1; // Value 0 not accepted
     for (c=0; c<Assembler->Count; c++) {
         if (Assembler->Strings[c] == "Disassembly of section .text:")
@@ -376,22 +451,27 @@ unsigned long   TextSegmentStart = 0,  // Boundary of .text segment
                 // Fill .text
                 *(unsigned long *)(FpRiscVMem+iOffset) = ConvertToInt(Atoms[1]);
 
-                // Debugger instructions info
+                // Debugger instructions info (insn text by RefreshListing())
                 DebInsn->Cells[0][DebInsn->RowCount-1] = Atoms[0]; // Code offset
-                DebInsn->Cells[1][DebInsn->RowCount-1] = Atoms[1]; // Hex-coded insn
-                DebInsn->Cells[2][DebInsn->RowCount-1] = Atoms[2]; // Mnemonic insn
+                DebInsn->Cells[1][DebInsn->RowCount-1] = "";
+                DebInsn->Cells[2][DebInsn->RowCount-1] = "";
                 DebInsn->Cells[3][DebInsn->RowCount-1] = "";
-                if (Atoms.Length > 3)                              // [Params + comments]
-                    for (int AtomOffset=3; AtomOffset<Atoms.Length; AtomOffset++)
-                        DebInsn->Cells[3][DebInsn->RowCount-1] = DebInsn->Cells[3][DebInsn->RowCount-1] + " " + Atoms[AtomOffset];
             }
             else {  // Else don't parse anything and copy line content in 4th col
                 DebInsn->Cells[3][DebInsn->RowCount-1] = Assembler->Strings[c];
                 DebInsn->Objects[0][DebInsn->RowCount-1] = (TObject *)-1;
+                FListing.AddSymbolLine(AnsiString(Assembler->Strings[c]).c_str());    // "<address> <name>:"
             }
         }
     }
 
+    // PC => row index
+    FListing.SetText(TextSegmentStart, TextSegmentEnd);
+    for (c=0; c<DebInsn->RowCount; c++)
+        if (DebInsn->Objects[0][c] != (TObject *)-1)
+            FListing.SetRow((unsigned long)(NativeInt)DebInsn->Objects[0][c], c);
+    FDisassembler.SetText(FpRiscVMem, TextSegmentStart, TextSegmentEnd);
+
     //.text info (first) update
     editTextStart->Text = ConvertToString(TextSegmentStart);
     editTextEnd  ->Text = ConvertToString(TextSegmentEnd);
@@ -411,6 +491,13 @@ unsigned long   TextSegmentStart = 0,  // Boundary of .text segment
         TextSegmentEnd                    // TextSegmentEnd
     );
 
+    if (FpShared)
+        FpShared->AddRegion(TRiscVSharedMemory::regionText, TextSegmentStart, TextSegmentEnd - TextSegmentStart);
+
+    // libgcc routines by listing symbol (signatures found by Load)
+    for (c=0; c<FListing.SymbolCount; c++)
+        FRiscV_CPU.Libcalls->AddSymbol(FListing.Symbols[c].Address, FListing.Symbols[c].Name);
+
     // Reset to setup
     btnReset->Click();
 }
@@ -425,48 +512,139 @@ void __fastcall TfrmMain::btnStopClick(TObject *Sender)
 
 void __fastcall TfrmMain::btnRunClick(TObject *Sender)
 {
-    FBreakpoint       = (unsigned long)-1;
     DebMemory->TopRow = ConvertToInt(editMemWatch->Text)/16; // Memory watch address visible only on Run (button)
     Run();
 }
 //---------------------------------------------------------------------------
 
+// Program memory released: the core, its framebuffer and the disassembler
+// are detached first, the commands report "Program not loaded"
+void TfrmMain::UnloadProgram()
+{
+    FRiscV_CPU.Load(NULL, 0, 0, 0, 0, 0);
+    FDisassembler.SetText(NULL, 0, 0);
+    FListing.Clear();
+
+    if (FpShared) {
+        delete FpShared;
+        FpShared = NULL;
+    }
+    else if (FpRiscVMem)
+        delete [] FpRiscVMem;
+    FpRiscVMem = NULL;
+    FcRiscVMem = 0;
+}
+//---------------------------------------------------------------------------
+
 void TfrmMain::Run()
 {
     if (!FpRiscVMem || !FcRiscVMem)
         throw Exception("Program not loaded");
 
-    btnRun  ->Enabled = false;
-    btnStop ->Enabled = true;
-    btnRunAt->Enabled = false;
-    btnGoTo ->Enabled = false;
-    btnStep ->Enabled = false;
-    btnReset->Enabled = false;
-    btnLoadAsm->Enabled = false;
+    EnableButtons(false);
+
+    // Video port update flag written => run loop stops to update graphics
+    FVideoWatch = FRiscV_CPU.Breakpoints->AddWatchpoint(
+        portsVideo + offsetof(TVideoPort, ToBeUpdated), sizeof(short), TRiscVBreakpoints::watchWrite);
+
+    if (chkMemWatch->Checked)
+        FMemWatch = FRiscV_CPU.Breakpoints->AddWatchpoint(
+            ConvertToInt(editMemWatch->Text), sizeof(long), TRiscVBreakpoints::watchWrite);
+
+    FResume = true; // Don't stop on the breakpoint we are standing on
+    FState  = stateRunning;
 
-    FState = stateRunning;
+    // Paced: guest clock (0 => unthrottled), every tick runs an exec. block
+    // interval slice. Otherwise exec. block size insns per tick
+    FPaced = chkPacing->Checked;
+
+    if (FPaced) {
+        FPacer.Frequency    = (unsigned long)(StrToFloat(editGuestClock->Text) * 1000000);
+        TimerStep->Interval = 1;
+    }
+    else
+        TimerStep->Interval = editExecBlockInterval->Text.ToInt();
 
-    TimerStep->Interval = editExecBlockInterval->Text.ToInt();
     TimerStep->Enabled  = true; // Start execution
 }
 //---------------------------------------------------------------------------
 
+void TfrmMain::StopRun()
+{
+    FRiscV_CPU.Breakpoints->RemoveWatchpoint(FVideoWatch);
+    FRiscV_CPU.Breakpoints->RemoveWatchpoint(FMemWatch);
+    FVideoWatch = 0;
+    FMemWatch   = 0;
+    RemoveRunAtBreakpoint();
+
+    if (FRiscV_CPU.NativeLibcalls)
+        LogLibcalls();
+
+    EnableButtons(true);
+}
+//---------------------------------------------------------------------------
+
+// Native libcall hits since Load/Reset (routines called only)
+void TfrmMain::LogLibcalls()
+{
+String Line;
+
+    for (int r=TRiscVLibcalls::libNone+1; r<TRiscVLibcalls::libCount; r++)
+        if (FRiscV_CPU.Libcalls->Hits[(TRiscVLibcalls::Routine)r])
+            Line += String(" ") + TRiscVLibcalls::Name((TRiscVLibcalls::Routine)r) + " " +
+                    UIntToStr(FRiscV_CPU.Libcalls->Hits[(TRiscVLibcalls::Routine)r]);
+
+    if (!Line.IsEmpty())
+        memoOutput->Lines->Add(Now().FormatString("hh:nn:ss,zzz") + " - Native libcalls -" + Line);
+}
+//---------------------------------------------------------------------------
+
 void __fastcall TfrmMain::TimerStepTimer(TObject *Sender)
 {
-String ExceptionMessage;
+String            ExceptionMessage;
+TVideoPort       *pVideoPort = (TVideoPort *)(RiscVMem+portsVideo);
+unsigned __int64  BlockEnd;
+bool              BlockDone = false;
 
     // Stop timer to execute entire block
     TimerStep->Enabled = false;
     Application->ProcessMessages(); // Needed to stop the timer
 
-    // Execute block
+    // Execute block (run loop stops on breakpoints and watchpoints)
     try
     {
-        for (int c=0; c<editExecBlockSize->Text.ToInt(); c++) {
-            if (FRiscV_CPU.PC == FBreakpoint) // If breakpoint set => request stop
-                FState = stateStopping;
-            else
-                btnStepClick(TimerStep);
+        BlockEnd = FRiscV_CPU.InstructionCount + editExecBlockSize->Text.ToInt();
+        if (FPaced)
+            FPacer.BeginSlice(editExecBlockInterval->Text.ToInt());
+
+        while (FState == stateRunning && !BlockDone) {
+            switch (FPaced ? FPacer.Run(FResume)
+                           : FRiscV_CPU.Run((unsigned long)(BlockEnd - FRiscV_CPU.InstructionCount), FResume))
+            {
+                case RiscV::stopBreakpoint:
+                    FState = stateStopping;
+                    break;
+
+                case RiscV::stopWatchpoint:
+                    if (FRiscV_CPU.Breakpoints->HitId == FVideoWatch) {
+                        if (pVideoPort->ToBeUpdated)        // Update graphics if flag set
+                            UpdateVideo(pVideoPort);
+                    }
+                    else {
+                        FState = stateStopping;
+                        memoOutput->Lines->Add(Now().FormatString("hh:nn:ss,zzz") + " - Watchpoint - "
+                            "address " + ConvertToString(FRiscV_CPU.Breakpoints->HitAddress) + " "
+                            "written by insn at " + ConvertToString(FRiscV_CPU.PC - sizeof(long))
+                        );
+                    }
+                    break;
+
+                case RiscV::stopCount:
+                case RiscV::stopWait:
+                    BlockDone = true;   // Block/slice over or hart in wfi: next timer tick goes on
+                    break;
+            }
+            FResume = false;
         }
     }
     catch(Exception &e)
@@ -475,22 +653,20 @@ String ExceptionMessage;
         ExceptionMessage = e.Message;
     }
 
+    if (FPaced)
+        lblGuestClock->Caption = FormatFloat("0.00", FPacer.Achieved / 1000000) + " MHz";
+
     // Refresh debug grids
     RefreshDebug();
 
-    // Show exception (if raised) or take action by execution state
+    // Show exception (if raised) and take action by execution state
     if (!ExceptionMessage.IsEmpty())
         ShowMessage(ExceptionMessage);
-    else if (FState == stateRunning)
+
+    if (FState == stateRunning)
         TimerStep->Enabled = true;      // Restart timer
     else if (FState == stateStopping) {
-            btnRun  ->Enabled = true;
-            btnStop ->Enabled = false;
-            btnRunAt->Enabled = true;
-            btnGoTo ->Enabled = true;
-            btnStep ->Enabled = true;
-            btnReset->Enabled = true;
-            btnLoadAsm->Enabled = true;
+            StopRun();
 
             FState = stateStopped;
 
@@ -568,7 +744,7 @@ TGridRect DebuggerRow;
 void __fastcall TfrmMain::btnRunAtClick(TObject *Sender)
 {
     if (!editRunAt->Text.Trim().IsEmpty()) {
-        FBreakpoint = ConvertToInt(editRunAt->Text);
+        AddRunAtBreakpoint(ConvertToInt(editRunAt->Text));
         Run();
     }
 }
@@ -592,6 +768,154 @@ int NewPC;
 }
 //---------------------------------------------------------------------------
 
+void __fastcall TfrmMain::btnStepBackClick(TObject *Sender)
+{
+    if (!FpRiscVMem || !FcRiscVMem)
+        throw Exception("Program not loaded");
+
+    FRiscV_CPU.StepBack();
+
+    RestoreVideo();
+    RefreshDebug();
+}
+//---------------------------------------------------------------------------
+
+// Reverse continue: back to the last breakpoint hit ("Run at" address included)
+void __fastcall TfrmMain::btnRunBackClick(TObject *Sender)
+{
+bool Hit;
+
+    if (!FpRiscVMem || !FcRiscVMem)
+        throw Exception("Program not loaded");
+
+    if (!editRunAt->Text.Trim().IsEmpty())
+        AddRunAtBreakpoint(ConvertToInt(editRunAt->Text));
+
+    try
+    {
+        Hit = FRiscV_CPU.ContinueBack();
+    }
+    catch(...)
+    {
+        RemoveRunAtBreakpoint();
+        throw;
+    }
+    RemoveRunAtBreakpoint();
+
+    if (!Hit)
+        memoOutput->Lines->Add(Now().FormatString("hh:nn:ss,zzz") + " - Beginning of history reached");
+
+    RestoreVideo();
+    RefreshDebug();
+}
+//---------------------------------------------------------------------------
+
+// Toggle breakpoint on selected instruction (marked with '*'). Not while
+// the GDB server thread runs the core (breakpoints are the debugger's)
+void __fastcall TfrmMain::DebInsnDblClick(TObject *Sender)
+{
+int           Row     = DebInsn->Row;
+unsigned long Address = (unsigned long)(NativeInt)DebInsn->Objects[0][Row];
+
+    if (Address == (unsigned long)-1 || FpGdbThread)
+        return;
+
+    if (FRiscV_CPU.Breakpoints->ToggleBreakpoint(Address))
+        DebInsn->Cells[0][Row] = "*" + DebInsn->Cells[0][Row];
+    else if (DebInsn->Cells[0][Row].Pos("*") == 1)
+        DebInsn->Cells[0][Row] = DebInsn->Cells[0][Row].SubString(2, DebInsn->Cells[0][Row].Length()-1);
+}
+//---------------------------------------------------------------------------
+
+// Step over: a call (jal/jalr linking ra/t0) runs until it returns to the
+// next insn, any other insn is single stepped
+void __fastcall TfrmMain::btnStepOverClick(TObject *Sender)
+{
+    if (!FpRiscVMem || !FcRiscVMem)
+        throw Exception("Program not loaded");
+
+    if (!FRiscV_CPU.Cfg->IsCall(FRiscV_CPU.PC)) {
+        btnStep->Click();
+        return;
+    }
+
+    AddRunAtBreakpoint(FRiscV_CPU.PC + sizeof(long));
+    Run();
+}
+//---------------------------------------------------------------------------
+
+// GDB remote stub: while active the program is controlled by the debugger
+// only (server thread), so the emulator buttons are disabled, and so are the
+// options changing the core under the thread (history, native libcalls)
+void __fastcall TfrmMain::btnGdbClick(TObject *Sender)
+{
+    if (!FpGdbServer) {
+        if (!FpRiscVMem || !FcRiscVMem)
+            throw Exception("Program not loaded");
+
+        FpGdbServer = new TGdbServer(&FRiscV_CPU);
+        try
+        {
+            FpGdbServer->Listen(gdbPort);
+        }
+        catch(...)
+        {
+            delete FpGdbServer;
+            FpGdbServer = NULL;
+            throw;
+        }
+
+        FpGdbThread = new TGdbServerThread(FpGdbServer);
+
+        EnableButtons(false);
+        btnStop          ->Enabled = false;
+        btnGdb           ->Enabled = true;
+        btnGdb           ->Caption = "Stop GDB";
+        chkHistory       ->Enabled = false;
+        chkNativeLibcalls->Enabled = false;
+
+        memoOutput->Lines->Add(Now().FormatString("hh:nn:ss,zzz") + " - GDB server listening on localhost:" + IntToStr(FpGdbServer->Port));
+    }
+    else {
+        FpGdbServer->Close();   // Unblocks the server thread
+        FpGdbThread->Terminate();
+        FpGdbThread->WaitFor();
+
+        delete FpGdbThread;
+        delete FpGdbServer;
+        FpGdbThread = NULL;
+        FpGdbServer = NULL;
+
+        EnableButtons(true);
+        btnGdb           ->Caption = "GDB server";
+        chkHistory       ->Enabled = true;
+        chkNativeLibcalls->Enabled = true;
+
+        RestoreVideo();
+        RefreshDebug();
+    }
+}
+//---------------------------------------------------------------------------
+
+void __fastcall TfrmMain::DebInsnTopLeftChanged(TObject *Sender)
+{
+    RefreshListing();
+}
+//---------------------------------------------------------------------------
 
+void __fastcall TfrmMain::chkNativeLibcallsClick(TObject *Sender)
+{
+    FRiscV_CPU.NativeLibcalls = chkNativeLibcalls->Checked;
+}
+//---------------------------------------------------------------------------
 
+// Reverse execution is opt-in: its per insn hook also turns idle loop
+// skipping off. History starts from the current state
+void __fastcall TfrmMain::chkHistoryClick(TObject *Sender)
+{
+    FRiscV_CPU.EnableHistory(chkHistory->Checked ? historyInterval : 0, historyCheckpoints);
 
+    btnStepBack->Enabled = chkHistory->Checked && btnRun->Enabled;
+    btnRunBack ->Enabled = chkHistory->Checked && btnRun->Enabled;
+}
+//---------------------------------------------------------------------------
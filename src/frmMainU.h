@@ -27,7 +27,12 @@
 #include <Vcl.Grids.hpp>
 #include <Vcl.ExtCtrls.hpp>
 //---------------------------------------------------------------------------
+#include "DisassemblerU.h"
 #include "EmulatorU.h"
+#include "GdbServerU.h"
+#include "ListingU.h"
+#include "PacerU.h"
+#include "SharedMemoryU.h"
 //---------------------------------------------------------------------------
 
 class TfrmMain : public TForm
@@ -71,6 +76,18 @@ __published:	// IDE-managed Components
     TMemo *Memo1;
     TLabel *Label12;
     TEdit *editMemWatch;
+    TButton *btnStepBack;
+    TButton *btnRunBack;
+    TCheckBox *chkMemWatch;
+    TButton *btnGdb;
+    TButton *btnStepOver;
+    TLabel *Label13;
+    TLabel *lblGuestClock;
+    TEdit *editGuestClock;
+    TCheckBox *chkPacing;
+    TCheckBox *chkNativeLibcalls;
+    TCheckBox *chkSharedMemory;
+    TCheckBox *chkHistory;
     void __fastcall btnLoadAsmClick(TObject *Sender);
     void __fastcall btnRunClick(TObject *Sender);
     void __fastcall btnStopClick(TObject *Sender);
@@ -80,6 +97,14 @@ __published:	// IDE-managed Components
     void __fastcall btnResetClick(TObject *Sender);
     void __fastcall btnGoToClick(TObject *Sender);
     void __fastcall btnRunAtClick(TObject *Sender);
+    void __fastcall btnStepBackClick(TObject *Sender);
+    void __fastcall btnRunBackClick(TObject *Sender);
+    void __fastcall DebInsnDblClick(TObject *Sender);
+    void __fastcall btnGdbClick(TObject *Sender);
+    void __fastcall btnStepOverClick(TObject *Sender);
+    void __fastcall DebInsnTopLeftChanged(TObject *Sender);
+    void __fastcall chkNativeLibcallsClick(TObject *Sender);
+    void __fastcall chkHistoryClick(TObject *Sender);
 private:	// User declarations
 
     enum ProgramState {
@@ -92,6 +117,15 @@ private:	// User declarations
         portsVideo = 0x1b00
     };
 
+    enum History : int {
+        historyInterval    = 100000, // Insns between reverse execution checkpoints
+        historyCheckpoints = 10000   // Max checkpoints kept (oldest dropped)
+    };
+
+    enum Gdb : int {
+        gdbPort = 3333              // GDB remote stub (localhost)
+    };
+
     typedef struct {
         short ToBeUpdated; // +0
         short BallLeft;    // +2
@@ -99,21 +133,39 @@ private:	// User declarations
     } TVideoPort;
 
 
-    RiscV_RV32I     FRiscV_CPU;     // CPU
+    RiscV_RV32IM    FRiscV_CPU;     // CPU
+    TRiscVPacer     FPacer;         // Real-time pacing of FRiscV_CPU
+    bool            FPaced;         // Running paced (slices of exec. block interval) instead of blocks per tick
     ProgramState    FState;         // RISC-V program running state
     char           *FpDebuggerMem;  // Memory for debugger comparison (same of RISC-V)
     char           *FpRiscVMem;     // Memory for RISC-V processor (ROM + RAM)
+    TRiscVSharedMemory *FpShared;   // Owner of FpRiscVMem when exported as shared memory (NULL => new[])
     int             FcRiscVMem;     // Memory size
-    unsigned long   FBreakpoint;    // Breakpoint set by "Run At" button
+    unsigned long   FRunAt;         // Temporary breakpoint set by "Run At"/"Step over" buttons (-1 => none)
+    int             FVideoWatch;    // Watchpoint on video port update flag (while running)
+    int             FMemWatch;      // Watchpoint on memory watch address (0 => none)
+    bool            FResume;        // Next run block starts on a breakpoint to be skipped
+    TRiscVListing   FListing;       // PC => DebInsn row and symbols (built on program load)
+    TRiscVDisassembler FDisassembler; // DebInsn insn text (visible rows, cached)
+    TGdbServer     *FpGdbServer;    // GDB remote stub (NULL => not active)
+    TGdbServerThread *FpGdbThread;
 
     int     ConvertToInt(String AHex);
     String  ConvertToString(long AValue);
     void    RefreshDebug();
+    void    RefreshListing();
     void    RedrawMemory();
     void    RedrawMemoryRow(int ARow);
     void    UpdateVideo(TVideoPort *ANewValues);
+    void    RestoreVideo();
+    void    EnableButtons(bool AEnabled);
+    void    AddRunAtBreakpoint(unsigned long AAddress);
+    void    RemoveRunAtBreakpoint();
 
+    void    UnloadProgram();
     void    Run();
+    void    StopRun();
+    void    LogLibcalls();
 
     __property char *RiscVMem = { read = FpRiscVMem };
 